@@ -0,0 +1,1315 @@
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "ir/dag.h"
+#include "ir/flatDag.h"
+#include "ir/flatBlock.h"
+#include "exec/executor.h"
+#include "exec/matrixEvaluator.h"
+#include "exec/tiledEvaluator.h"
+#include "exec/dagPartitioning.h"
+#include "exec/coordinator.h"
+#include "opt/elementwiseFusion.h"
+#include "opt/matrixChainOrder.h"
+#include "opt/shapeInference.h"
+#include "opt/densityAnalysis.h"
+#include "opt/reductionPushDown.h"
+#include "opt/constantFolding.h"
+#include "opt/deadCodeElimination.h"
+#include "exec/bufferAssignment.h"
+#include "io/objectStore.h"
+#include "io/asyncLoader.h"
+#include "io/matrixFile.h"
+#include "matrix/gemm.h"
+#include "matrix/sparse.h"
+#include <fstream>
+#include "ir/instruction.h"
+#include "cfg/basicBlock.h"
+#include "cfg/controlFlowGraph.h"
+#include "opt/loopInvariantCodeMotion.h"
+#include "opt/loopUnrolling.h"
+#include "cfg/inductionVariables.h"
+#include "cfg/ssaForm.h"
+#include "opt/globalValueNumbering.h"
+#include "support/compilationContext.h"
+#include "trace/tracer.h"
+
+using namespace std;
+
+// Builds a synthetic basic block with 'size' three-address instructions
+// of the form 'vX <- vY op vZ' or 'vX <- vY op CONSTANT'. A handful of
+// variables and constants are reused all over the block, so their DAG
+// leaves end up with very large predecessor lists.
+static BasicBlock * generateBasicBlock(CompilationContext &context, unsigned size,
+		unsigned numberOfVariables) {
+	vector<Constant *> constants;
+	for (int i = 0; i < 4; i++)
+		constants.push_back(context.create<Constant>(context.create<Integer>(i)));
+
+	vector<LocalVariable *> variables;
+	Instruction *first = 0;
+	Instruction *last = 0;
+
+	for (unsigned i = 0; i < numberOfVariables; i++) {
+		LocalVariable *variable = context.create<LocalVariable>(i);
+		variables.push_back(variable);
+		if (first == 0)
+			first = variable;
+		else
+			last->link(variable);
+		last = variable;
+	}
+
+	for (unsigned i = 0; i < size; i++) {
+		LocalVariable *destination = variables[rand() % numberOfVariables];
+		Instruction *left = variables[rand() % numberOfVariables];
+		Instruction *right;
+		if (rand() % 2)
+			right = constants[rand() % constants.size()];
+		else
+			right = variables[rand() % numberOfVariables];
+
+		BinaryInstruction *expression;
+		if (rand() % 2)
+			expression = context.create<Add>(left, right);
+		else
+			expression = context.create<Mul>(left, right);
+
+		last = last->link(context.create<Move>(destination, expression));
+	}
+	return context.create<BasicBlock>(first, last, &context);
+}
+
+// keeps the compiler from optimizing the block walks away
+static volatile uint64_t walkChecksum;
+
+// Compares walking the linked instruction list against walking the
+// flat form of the same block, and reports the memory used by each form.
+static void benchmarkFlatBlocks(unsigned maxSize) {
+	cout << "instructions\tlist walk (ns/instruction)\tflat walk (ns/instruction)"
+			<< "\tDAG from flat (ns/instruction)\tlist bytes\tflat bytes" << endl;
+	for (unsigned size = 1 << 10; size <= maxSize; size <<= 1) {
+		CompilationContext context;
+		srand(size);
+		BasicBlock *basicBlock = generateBasicBlock(context, size, 64);
+		size_t listBytes = context.getArena().getBytesAllocated();
+
+		// touch the opcode and operands of every instruction
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		uint64_t checksum = 0;
+		for (Instruction *i = basicBlock->getFirst(); i != 0; i = i->getNext()) {
+			checksum += i->getInstructionID();
+			if (i->getInstructionID() == MOVE) {
+				Instruction *rightValue = ((Move *) i)->getRightValue();
+				checksum += rightValue->getInstructionID();
+				if (rightValue->getInstructionID() == ADD || rightValue->getInstructionID() == MUL)
+					checksum += (uintptr_t) ((BinaryInstruction *) rightValue)->getFirstOperand()
+							^ (uintptr_t) ((BinaryInstruction *) rightValue)->getSecondOperand();
+			}
+		}
+		chrono::steady_clock::time_point end = chrono::steady_clock::now();
+		double listNanoseconds = chrono::duration<double, nano>(end - start).count();
+
+		FlatBlock *flatBlock = basicBlock->lower();
+		size_t flatBytes = context.getArena().getBytesAllocated() - listBytes;
+
+		start = chrono::steady_clock::now();
+		for (const FlatInstruction &i : *flatBlock) {
+			checksum += i.opcode + (i.operand0 ^ i.operand1);
+		}
+		end = chrono::steady_clock::now();
+		double flatNanoseconds = chrono::duration<double, nano>(end - start).count();
+
+		start = chrono::steady_clock::now();
+		DAG *dag = new DAG(basicBlock);
+		end = chrono::steady_clock::now();
+		double dagNanoseconds = chrono::duration<double, nano>(end - start).count();
+		delete dag;
+
+		cout << size << "\t" << listNanoseconds / size << "\t" << flatNanoseconds / size
+				<< "\t" << dagNanoseconds / size << "\t" << listBytes << "\t" << flatBytes << endl;
+		walkChecksum = checksum;
+	}
+}
+
+// Builds a wide block: 'width' independent additions over distinct variables
+static BasicBlock * generateWideBasicBlock(CompilationContext &context, unsigned width) {
+	vector<LocalVariable *> variables;
+	for (unsigned i = 0; i < 3 * width; i++)
+		variables.push_back(context.create<LocalVariable>(i));
+
+	Instruction *first = variables[0];
+	Instruction *last = first;
+	for (unsigned i = 1; i < 2 * width; i++)
+		last = last->link(variables[i]);
+
+	for (unsigned i = 0; i < width; i++) {
+		Add *expression = context.create<Add>(variables[2 * i], variables[2 * i + 1]);
+		last = last->link(context.create<Move>(variables[2 * width + i], expression));
+	}
+	return context.create<BasicBlock>(first, last, &context);
+}
+
+// Executes a wide DAG whose operator nodes spin for a fixed amount of work,
+// with a growing number of worker threads
+static void benchmarkExecutor(unsigned width) {
+	CompilationContext context;
+	DAG dag(generateWideBasicBlock(context, width));
+	FlatDAG flatDAG = dag.freeze();
+
+	cout << "threads\texecute (ms)\tspeedup" << endl;
+	double baseline = 0;
+	for (unsigned threads = 1; threads <= ThreadPool::defaultNumberOfThreads(); threads <<= 1) {
+		ThreadPool pool(threads);
+		Executor executor(pool);
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		executor.execute(flatDAG, [&flatDAG](FlatDAG::NodeId n) {
+			if (flatDAG.isLeaf(n))
+				return;
+			uint64_t checksum = n;
+			for (int i = 0; i < 100000; i++)
+				checksum = checksum * 31 + i;
+			walkChecksum = checksum;
+		});
+		chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+		double milliseconds = chrono::duration<double, milli>(end - start).count();
+		if (threads == 1)
+			baseline = milliseconds;
+		cout << threads << "\t" << milliseconds << "\t" << baseline / milliseconds << endl;
+	}
+}
+
+// Builds 'sum = v0 + v1 + ... + v<length>' as a chain of additions
+static BasicBlock * generateChainBasicBlock(CompilationContext &context, unsigned length,
+		vector<LocalVariable *> &inputs, LocalVariable *&sum) {
+	for (unsigned i = 0; i <= length; i++)
+		inputs.push_back(context.create<LocalVariable>(i));
+
+	Instruction *first = inputs[0];
+	Instruction *last = first;
+	for (unsigned i = 1; i <= length; i++)
+		last = last->link(inputs[i]);
+
+	Instruction *partial = inputs[0];
+	for (unsigned i = 1; i <= length; i++) {
+		LocalVariable *t = context.create<LocalVariable>(length + i);
+		last = last->link(t)->link(context.create<Move>(t, context.create<Add>(partial, inputs[i])));
+		partial = t;
+	}
+	sum = (LocalVariable *) partial;
+	return context.create<BasicBlock>(first, last, &context);
+}
+
+// Evaluates an addition chain over large matrices with and without fusion
+static void benchmarkFusion(unsigned rows) {
+	cout << "chain\tunfused (ms)\tfused (ms)\tspeedup" << endl;
+	for (unsigned length = 2; length <= 8; length <<= 1) {
+		double milliseconds[2];
+		for (int fuse = 0; fuse < 2; fuse++) {
+			CompilationContext context;
+			vector<LocalVariable *> inputs;
+			LocalVariable *sum;
+			DAG dag(generateChainBasicBlock(context, length, inputs, sum));
+			if (fuse)
+				ElementwiseFusion(unordered_set<LocalVariable *>({ sum })).run(dag);
+
+			FlatDAG flatDAG = dag.freeze();
+			MatrixEvaluator evaluator(flatDAG);
+			for (LocalVariable *input : inputs) {
+				Matrix matrix(ELEMENT_DOUBLE, rows, rows);
+				matrix.fill(1);
+				evaluator.bind(input, matrix);
+			}
+
+			ThreadPool pool(1);
+			Executor executor(pool);
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			executor.execute(flatDAG, [&evaluator](FlatDAG::NodeId n) {
+				evaluator.evaluate(n);
+			});
+			chrono::steady_clock::time_point end = chrono::steady_clock::now();
+			milliseconds[fuse] = chrono::duration<double, milli>(end - start).count();
+		}
+		cout << length << "\t" << milliseconds[0] << "\t" << milliseconds[1]
+				<< "\t" << milliseconds[0] / milliseconds[1] << endl;
+	}
+}
+
+// Builds 'product = m0 * m1 * ... * m<length - 1>', multiplied left to right,
+// over matrices of random dimensions
+static BasicBlock * generateProductChain(CompilationContext &context, unsigned length,
+		LocalVariable *&product) {
+	vector<unsigned> dimensions;
+	for (unsigned i = 0; i <= length; i++)
+		dimensions.push_back(1 + rand() % 1000);
+
+	vector<LocalVariable *> factors;
+	for (unsigned i = 0; i < length; i++) {
+		factors.push_back(context.create<LocalVariable>(i));
+		factors[i]->setShape(Shape(dimensions[i], dimensions[i + 1]));
+	}
+
+	Instruction *first = factors[0];
+	Instruction *last = first;
+	for (unsigned i = 1; i < length; i++)
+		last = last->link(factors[i]);
+
+	Instruction *partial = factors[0];
+	for (unsigned i = 1; i < length; i++) {
+		LocalVariable *t = context.create<LocalVariable>(length + i);
+		last = last->link(t)->link(context.create<Move>(t, context.create<Mul>(partial, factors[i])));
+		partial = t;
+	}
+	product = (LocalVariable *) partial;
+	return context.create<BasicBlock>(first, last, &context);
+}
+
+// Values of 'results' after evaluating the DAG of 'basicBlock', with
+// 'inputs' bound to 'matrices', after reordering its chains when 'reorder'
+static vector<Matrix> evaluateChains(BasicBlock *basicBlock, const vector<LocalVariable *> &inputs,
+		const vector<Matrix> &matrices, const vector<LocalVariable *> &results, bool reorder) {
+	// nodes on the heap: a removed node is freed, even if a user is left
+	DAG dag(basicBlock, 0);
+	if (reorder)
+		MatrixChainOrder(unordered_set<LocalVariable *>(results.begin(), results.end())).run(dag);
+	ShapeInference().run(dag);
+
+	FlatDAG flatDAG = dag.freeze();
+	MatrixEvaluator evaluator(flatDAG);
+	for (unsigned i = 0; i < inputs.size(); i++)
+		evaluator.bind(inputs[i], matrices[i]);
+	for (FlatDAG::NodeId n = 0; n < flatDAG.getNumberOfNodes(); n++)
+		evaluator.evaluate(n);
+
+	vector<Matrix> values;
+	for (LocalVariable *result : results)
+		values.push_back(evaluator.getValue(flatDAG.getNodeId(dag.getNode(result))).getMatrix());
+	return values;
+}
+
+// Regression check of two chains sharing a product: 'r1 = (A * B) * C'
+// is reordered to 'A * (B * C)', whose 'B * C' is the product 'p' of
+// 'r2 = D * p', then reordered to '(D * B) * C'. The first chain keeps
+// using 'p'. Returns true when r1 and r2 have the values of the block
+// as written.
+static bool checkSharedChainProduct() {
+	CompilationContext context;
+	vector<LocalVariable *> inputs;
+	unsigned dimensions[][2] = { { 100, 10 }, { 10, 100 }, { 100, 10 }, { 1, 10 } };
+	for (unsigned i = 0; i < 4; i++) {
+		inputs.push_back(context.create<LocalVariable>(i));
+		inputs[i]->setShape(Shape(dimensions[i][0], dimensions[i][1]));
+	}
+	LocalVariable *a = inputs[0], *b = inputs[1], *c = inputs[2], *d = inputs[3];
+	LocalVariable *p = context.create<LocalVariable>(4);
+	LocalVariable *r2 = context.create<LocalVariable>(5);
+	LocalVariable *x = context.create<LocalVariable>(6);
+	LocalVariable *r1 = context.create<LocalVariable>(7);
+
+	// declared so that r1 is the last node of the flat DAG: its chain is
+	// rewritten first
+	Instruction *last = c->link(b)->link(d)->link(a);
+	last = last->link(p)->link(context.create<Move>(p, context.create<Mul>(b, c)));
+	last = last->link(r2)->link(context.create<Move>(r2, context.create<Mul>(d, p)));
+	last = last->link(x)->link(context.create<Move>(x, context.create<Mul>(a, b)));
+	last = last->link(r1)->link(context.create<Move>(r1, context.create<Mul>(x, c)));
+	BasicBlock *basicBlock = context.create<BasicBlock>(c, last, &context);
+
+	// small integers: every order computes the same values exactly
+	srand(8);
+	vector<Matrix> matrices;
+	for (unsigned i = 0; i < 4; i++) {
+		matrices.push_back(Matrix(ELEMENT_DOUBLE, dimensions[i][0], dimensions[i][1]));
+		for (unsigned row = 0; row < dimensions[i][0]; row++) {
+			for (unsigned column = 0; column < dimensions[i][1]; column++)
+				matrices[i].set(row, column, rand() % 4);
+		}
+	}
+
+	vector<LocalVariable *> results({ r1, r2 });
+	vector<Matrix> expected = evaluateChains(basicBlock, inputs, matrices, results, false);
+	vector<Matrix> reordered = evaluateChains(basicBlock, inputs, matrices, results, true);
+	for (unsigned i = 0; i < results.size(); i++) {
+		if (!expected[i].sameShape(reordered[i])
+				|| memcmp(expected[i].getRawData(), reordered[i].getRawData(), expected[i].getBytes()) != 0)
+			return false;
+	}
+	return true;
+}
+
+// Scalar multiplications of product chains before and after reordering
+static void benchmarkChainOrder() {
+	cout << "chain\tmultiplications before\tafter\tratio\tpass (us)" << endl;
+	srand(42);
+	for (unsigned length = 4; length <= 64; length <<= 1) {
+		CompilationContext context;
+		LocalVariable *product;
+		DAG dag(generateProductChain(context, length, product));
+
+		MatrixChainOrder chainOrder(unordered_set<LocalVariable *>({ product }));
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		chainOrder.run(dag);
+		chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+		cout << length << "\t" << chainOrder.getCostBefore() << "\t" << chainOrder.getCostAfter()
+				<< "\t" << (double) chainOrder.getCostBefore() / chainOrder.getCostAfter()
+				<< "\t" << chrono::duration<double, micro>(end - start).count() << endl;
+	}
+}
+
+// Peak matrix memory of random blocks over 1024x1024 matrices, with and
+// without buffer reuse; the final values of all the variables are live out
+static void benchmarkBufferAssignment(unsigned maxSize) {
+	cout << "instructions\tpeak before (MB)\tpeak after (MB)\tbuffers\tin-place\tplan (ns/node)" << endl;
+	for (unsigned size = 1 << 10; size <= maxSize; size <<= 2) {
+		CompilationContext context;
+		srand(size);
+		BasicBlock *basicBlock = generateBasicBlock(context, size, 64);
+
+		unordered_set<LocalVariable *> liveOut;
+		for (Instruction *i = basicBlock->getFirst(); i != 0; i = i->getNext()) {
+			if (i->getInstructionID() == LOCALVARIABLE) {
+				((LocalVariable *) i)->setShape(Shape(1024, 1024));
+				liveOut.insert((LocalVariable *) i);
+			}
+		}
+
+		DAG dag(basicBlock);
+		ShapeInference().run(dag);
+		FlatDAG flatDAG = dag.freeze();
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		BufferAssignment assignment(dag, flatDAG, liveOut);
+		chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+		cout << size << "\t" << assignment.getPeakBytesBefore() / 1e6
+				<< "\t" << assignment.getPeakBytesAfter() / 1e6
+				<< "\t" << assignment.getNumberOfBuffers() << "\t" << assignment.getNumberOfInPlaceUpdates()
+				<< "\t" << chrono::duration<double, nano>(end - start).count() / flatDAG.getNumberOfNodes() << endl;
+	}
+}
+
+// Builds 'sum = 2 * load(object0) + ... + 2 * load(object<count - 1>)'
+static BasicBlock * generateLoadBasicBlock(CompilationContext &context, unsigned count,
+		LocalVariable *&sum) {
+	Constant *two = context.create<Constant>(context.create<Integer>(2));
+	Instruction *first = 0;
+	Instruction *last = 0;
+	LocalVariable *partial = 0;
+	unsigned slot = 0;
+
+	for (unsigned i = 0; i < count; i++) {
+		LocalVariable *object = context.create<LocalVariable>(slot++);
+		LocalVariable *scaled = context.create<LocalVariable>(slot++);
+		Instruction *load = context.create<Move>(object, context.create<Load>("object" + to_string(i), &context.getArena()));
+		Instruction *scale = context.create<Move>(scaled, context.create<Mul>(object, two));
+		if (first == 0)
+			first = object;
+		else
+			last->link(object);
+		last = object->link(load)->link(scaled)->link(scale);
+
+		if (partial == 0) {
+			partial = scaled;
+		} else {
+			LocalVariable *t = context.create<LocalVariable>(slot++);
+			last = last->link(t)->link(context.create<Move>(t, context.create<Add>(partial, scaled)));
+			partial = t;
+		}
+	}
+	sum = partial;
+	return context.create<BasicBlock>(first, last, &context);
+}
+
+// Executes a block whose loads take 20ms each from a local directory,
+// with a growing number of requests in flight
+static void benchmarkLoads(unsigned count) {
+	char directory[] = "/tmp/dagBenchmarkXXXXXX";
+	if (mkdtemp(directory) == 0)
+		return;
+	LocalDirectoryStore objects(directory);
+	for (unsigned i = 0; i < count; i++) {
+		Matrix object(ELEMENT_DOUBLE, 128, 128);
+		object.fill(i);
+		objects.store("object" + to_string(i), object);
+	}
+	DelayedStore remote(objects, chrono::milliseconds(20));
+
+	cout << "in flight\texecute (ms)\tpeak in flight" << endl;
+	for (unsigned inFlight = 1; inFlight <= count; inFlight <<= 1) {
+		CompilationContext context;
+		LocalVariable *sum;
+		DAG dag(generateLoadBasicBlock(context, count, sum));
+		FlatDAG flatDAG = dag.freeze();
+		MatrixEvaluator evaluator(flatDAG);
+		AsyncLoader loader(remote, inFlight);
+		evaluator.setLoader(&loader);
+
+		ThreadPool pool;
+		Executor executor(pool);
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		executor.execute(flatDAG, [&evaluator](FlatDAG::NodeId n) {
+			evaluator.evaluate(n);
+		}, Executor::OrderingEdges(), [&evaluator](FlatDAG::NodeId n, const Executor::Completion &done) {
+			return evaluator.startLoad(n, done);
+		});
+		chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+		cout << inFlight << "\t" << chrono::duration<double, milli>(end - start).count()
+				<< "\t" << loader.getPeakInFlight() << endl;
+	}
+
+	for (unsigned i = 0; i < count; i++)
+		remove((string(directory) + "/object" + to_string(i)).c_str());
+	rmdir(directory);
+}
+
+// Sum of the elements, touching every page of the matrix
+static double sumElements(const Matrix &matrix) {
+	const double *data = matrix.getData<double>();
+	double sum = 0;
+	for (size_t i = 0; i < matrix.getSize(); i++)
+		sum += data[i];
+	return sum;
+}
+
+// Time to open a binary matrix file and read all its elements: copied
+// with read() into a new matrix, or mapped in place
+static void benchmarkMatrixFiles(unsigned rows) {
+	char path[] = "/tmp/dagBenchmarkMatrixXXXXXX";
+	int fileDescriptor = mkstemp(path);
+	if (fileDescriptor < 0)
+		return;
+	close(fileDescriptor);
+
+	Matrix matrix(ELEMENT_DOUBLE, rows, rows);
+	matrix.fill(1);
+	writeMatrixFile(path, matrix);
+
+	cout << "matrix file (MB)\tread (ms)\tmap (ms)\tmap + sum (ms)\tread + sum (ms)" << endl;
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	Matrix copy(ELEMENT_DOUBLE, rows, rows);
+	ifstream input(path, ios::binary);
+	input.seekg(MATRIX_FILE_DATA_OFFSET);
+	input.read((char *) copy.getRawData(), copy.getBytes());
+	chrono::steady_clock::time_point read = chrono::steady_clock::now();
+	walkChecksum = (long) sumElements(copy);
+	chrono::steady_clock::time_point readSum = chrono::steady_clock::now();
+
+	Matrix mapped = mapMatrixFile(path);
+	chrono::steady_clock::time_point map = chrono::steady_clock::now();
+	walkChecksum = (long) sumElements(mapped);
+	chrono::steady_clock::time_point mapSum = chrono::steady_clock::now();
+
+	cout << matrix.getBytes() / 1e6
+			<< "\t" << chrono::duration<double, milli>(read - start).count()
+			<< "\t" << chrono::duration<double, milli>(map - readSum).count()
+			<< "\t" << chrono::duration<double, milli>(mapSum - readSum).count()
+			<< "\t" << chrono::duration<double, milli>(readSum - start).count() << endl;
+	remove(path);
+}
+
+// Evaluates 'e = a + b + c + d' over matrix files, writing e to a file:
+// whole (mapped inputs, one result matrix) and tiled with working sets
+// smaller than the data
+static void benchmarkOutOfCore(unsigned rows, unsigned columns) {
+	char directory[] = "/tmp/dagBenchmarkTilesXXXXXX";
+	if (mkdtemp(directory) == 0)
+		return;
+	string path(directory);
+	CompilationContext context;
+	vector<LocalVariable *> inputs;
+	LocalVariable *sum;
+	DAG dag(generateChainBasicBlock(context, 3, inputs, sum));
+	ElementwiseFusion(unordered_set<LocalVariable *>({ sum })).run(dag);
+	FlatDAG flatDAG = dag.freeze();
+
+	Matrix input(ELEMENT_DOUBLE, rows, columns);
+	input.fill(1);
+	for (unsigned i = 0; i < inputs.size(); i++)
+		writeMatrixFile(path + "/input" + to_string(i), input);
+	double megabytes = 5 * input.getBytes() / 1e6;
+
+	cout << "out of core (" << megabytes << " MB)\tworking set (MB)\ttiles\ttime (ms)\tMB/s" << endl;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	{
+		MatrixEvaluator evaluator(flatDAG);
+		for (unsigned i = 0; i < inputs.size(); i++)
+			evaluator.bind(inputs[i], mapMatrixFile(path + "/input" + to_string(i)));
+		for (FlatDAG::NodeId n = 0; n < flatDAG.getNumberOfNodes(); n++)
+			evaluator.evaluate(n);
+		writeMatrixFile(path + "/result", evaluator.getValue(flatDAG.getNodeId(dag.getNode(sum))).getMatrix());
+	}
+	double milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	cout << "whole\t" << megabytes << "\t1\t" << milliseconds << "\t" << megabytes / milliseconds * 1e3 << endl;
+
+	for (size_t workingSet = 1 << 20; workingSet <= input.getBytes(); workingSet <<= 2) {
+		start = chrono::steady_clock::now();
+		vector<unique_ptr<MatrixFileReader> > readers;
+		TiledEvaluator evaluator(flatDAG, workingSet);
+		for (unsigned i = 0; i < inputs.size(); i++) {
+			readers.push_back(unique_ptr<MatrixFileReader>(new MatrixFileReader(path + "/input" + to_string(i))));
+			evaluator.bindTiles(inputs[i], readers.back().get());
+		}
+		MatrixFileWriter writer(path + "/result", ELEMENT_DOUBLE, rows, columns);
+		evaluator.setSink(sum, &writer);
+		evaluator.run();
+		milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		cout << "tiled\t" << workingSet / 1e6 << "\t" << evaluator.getNumberOfTiles()
+				<< "\t" << milliseconds << "\t" << megabytes / milliseconds * 1e3 << endl;
+	}
+
+	for (unsigned i = 0; i < inputs.size(); i++)
+		remove((path + "/input" + to_string(i)).c_str());
+	remove((path + "/result").c_str());
+	rmdir(directory);
+}
+
+// Evaluates 'sum(v0 + v1 + ... + v<length>)' over large matrices: the
+// fused chain materializes the final matrix, the pushed down sum only
+// reduces the inputs
+static void benchmarkReductions(unsigned rows) {
+	cout << "chain\tfused (ms)\tpushed down (ms)\tspeedup" << endl;
+	for (unsigned length = 2; length <= 8; length <<= 1) {
+		double milliseconds[2];
+		for (int pushDown = 0; pushDown < 2; pushDown++) {
+			CompilationContext context;
+			vector<LocalVariable *> inputs;
+			LocalVariable *sum;
+			BasicBlock *basicBlock = generateChainBasicBlock(context, length, inputs, sum);
+			for (LocalVariable *input : inputs)
+				input->setShape(Shape(rows, rows));
+			LocalVariable *total = context.create<LocalVariable>(2 * length + 1);
+			basicBlock->setLast(basicBlock->getLast()->link(total)->link(
+					context.create<Move>(total, context.create<Reduction>(SUM, sum))));
+
+			DAG dag(basicBlock);
+			unordered_set<LocalVariable *> liveOut({ total });
+			if (pushDown)
+				ReductionPushDown(liveOut).run(dag);
+			ElementwiseFusion(liveOut).run(dag);
+
+			FlatDAG flatDAG = dag.freeze();
+			MatrixEvaluator evaluator(flatDAG);
+			for (LocalVariable *input : inputs) {
+				Matrix matrix(ELEMENT_DOUBLE, rows, rows);
+				matrix.fill(1);
+				evaluator.bind(input, matrix);
+			}
+
+			ThreadPool pool(1);
+			Executor executor(pool);
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			executor.execute(flatDAG, [&evaluator](FlatDAG::NodeId n) {
+				evaluator.evaluate(n);
+			});
+			chrono::steady_clock::time_point end = chrono::steady_clock::now();
+			milliseconds[pushDown] = chrono::duration<double, milli>(end - start).count();
+			walkChecksum += (long) evaluator.getValue(flatDAG.getNodeId(dag.getNode(total))).getScalar();
+		}
+		cout << length << "\t" << milliseconds[0] << "\t" << milliseconds[1]
+				<< "\t" << milliseconds[0] / milliseconds[1] << endl;
+	}
+}
+
+// Square matrix products: the naive triple loop against the packed,
+// cache blocked product, for float and double
+template<typename T>
+static void naiveProduct(const Matrix &a, const Matrix &b, Matrix &c) {
+	size_t n = a.getRows();
+	const T *x = a.getData<T>();
+	const T *y = b.getData<T>();
+	T *z = c.getData<T>();
+	for (size_t i = 0; i < n; i++) {
+		for (size_t j = 0; j < n; j++) {
+			T sum = 0;
+			for (size_t p = 0; p < n; p++)
+				sum += x[i * n + p] * y[p * n + j];
+			z[i * n + j] = sum;
+		}
+	}
+}
+
+static void benchmarkGemm(unsigned maxRows) {
+	cout << "gemm (" << getInstructionSetName(getGemmKernels().isa) << ")\ttype\tnaive (GFLOP/s)\tblocked (GFLOP/s)\tspeedup" << endl;
+	for (unsigned rows = 128; rows <= maxRows; rows <<= 1) {
+		for (int isDouble = 0; isDouble < 2; isDouble++) {
+			ElementType type = isDouble ? ELEMENT_DOUBLE : ELEMENT_FLOAT;
+			Matrix a(type, rows, rows), b(type, rows, rows), c(type, rows, rows);
+			a.fill(1);
+			b.fill(2);
+			double flops = 2.0 * rows * rows * rows;
+
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			if (isDouble)
+				naiveProduct<double>(a, b, c);
+			else
+				naiveProduct<float>(a, b, c);
+			chrono::steady_clock::time_point naive = chrono::steady_clock::now();
+			matrixProduct(a, b, c);
+			chrono::steady_clock::time_point blocked = chrono::steady_clock::now();
+
+			double naiveSeconds = chrono::duration<double>(naive - start).count();
+			double blockedSeconds = chrono::duration<double>(blocked - naive).count();
+			cout << rows << "\t" << (isDouble ? "double" : "float")
+					<< "\t" << flops / naiveSeconds / 1e9 << "\t" << flops / blockedSeconds / 1e9
+					<< "\t" << naiveSeconds / blockedSeconds << endl;
+		}
+	}
+}
+
+// Builds 'sum = a0 * b + a1 * b + ... + a<count - 1> * b'; b is the last input
+static BasicBlock * generateProductSum(CompilationContext &context, unsigned count,
+		vector<LocalVariable *> &inputs, LocalVariable *&sum) {
+	for (unsigned i = 0; i <= count; i++)
+		inputs.push_back(context.create<LocalVariable>(i));
+
+	Instruction *first = inputs[0];
+	Instruction *last = first;
+	for (unsigned i = 1; i <= count; i++)
+		last = last->link(inputs[i]);
+
+	Instruction *partial = 0;
+	for (unsigned i = 0; i < count; i++) {
+		LocalVariable *t = context.create<LocalVariable>(count + 1 + 2 * i);
+		last = last->link(t)->link(context.create<Move>(t, context.create<Mul>(inputs[i], inputs[count])));
+		if (partial != 0) {
+			LocalVariable *s = context.create<LocalVariable>(count + 2 + 2 * i);
+			last = last->link(s)->link(context.create<Move>(s, context.create<Add>(partial, t)));
+			t = s;
+		}
+		partial = t;
+	}
+	sum = (LocalVariable *) partial;
+	return context.create<BasicBlock>(first, last, &context);
+}
+
+// Evaluates a fused addition chain over rows x rows matrices and a sum of
+// four independent products in worker processes, with both strategies and
+// transports, against a single process
+static void benchmarkDistributed(unsigned rows) {
+	cout << "distributed\tworkers\ttransport\tstrategy\ttime (ms)\ttransferred (MB)\tshared (MB)" << endl;
+	for (int products = 0; products < 2; products++) {
+		CompilationContext context;
+		vector<LocalVariable *> inputs;
+		LocalVariable *sum;
+		BasicBlock *basicBlock = products ? generateProductSum(context, 4, inputs, sum)
+				: generateChainBasicBlock(context, 3, inputs, sum);
+		unsigned size = products ? rows / 4 : rows;
+		for (LocalVariable *input : inputs)
+			input->setShape(Shape(size, size));
+
+		DAG dag(basicBlock);
+		unordered_set<LocalVariable *> liveOut({ sum });
+		ElementwiseFusion(liveOut).run(dag);
+		ShapeInference().run(dag);
+		FlatDAG flatDAG = dag.freeze();
+		Matrix input(ELEMENT_DOUBLE, size, size);
+		input.fill(1);
+		const char *name = products ? "products" : "elementwise";
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		{
+			MatrixEvaluator evaluator(flatDAG);
+			for (LocalVariable *variable : inputs)
+				evaluator.bind(variable, input);
+			for (FlatDAG::NodeId n = 0; n < flatDAG.getNumberOfNodes(); n++)
+				evaluator.evaluate(n);
+		}
+		double milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		cout << name << "\t0\t-\t-\t" << milliseconds << "\t0\t0" << endl;
+
+		DAGPartitioning::Strategy strategies[] = { DAGPartitioning::COMMUNICATION_AWARE, DAGPartitioning::ROW_BLOCKS };
+		for (unsigned workers = 1; workers <= 4; workers <<= 1) {
+			for (DAGPartitioning::Strategy strategy : strategies) {
+				DAGPartitioning partitioning(dag, flatDAG, liveOut, workers, strategy);
+				for (TransportKind kind : { SOCKET_TRANSPORT, SHARED_MEMORY_TRANSPORT }) {
+					Coordinator coordinator(partitioning, kind);
+					for (LocalVariable *variable : inputs)
+						coordinator.bind(variable, input);
+					start = chrono::steady_clock::now();
+					coordinator.run();
+					milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+					cout << name << "\t" << workers << "\t" << getTransportName(kind) << "\t"
+							<< (strategy == DAGPartitioning::ROW_BLOCKS ? "row blocks" : "communication aware")
+							<< "\t" << milliseconds << "\t" << coordinator.getBytesTransferred() / 1e6
+							<< "\t" << coordinator.getBytesShared() / 1e6 << endl;
+				}
+			}
+		}
+	}
+}
+
+// rows x columns matrix whose elements are 1 with probability 'density', 0 otherwise
+static Matrix randomSparseMatrix(unsigned rows, unsigned columns, double density) {
+	Matrix matrix(ELEMENT_DOUBLE, rows, columns);
+	double *data = matrix.getData<double>();
+	for (size_t i = 0; i < matrix.getSize(); i++)
+		data[i] = rand() < density * RAND_MAX ? 1 : 0;
+	return matrix;
+}
+
+// Sparse matrix times a dense vector (SpMV) and matrix (SpMM), and a chain
+// of additions of sparse matrices, evaluated dense and with the sparse
+// kernels picked by density analysis
+static void benchmarkSparse(unsigned rows) {
+	cout << "sparse	density	dense (ms)	sparse (ms)	speedup	dense inputs (MB)	sparse inputs (MB)" << endl;
+	const char *names[] = { "spmv", "spmm", "add" };
+	for (double density : { 0.05, 0.01 }) {
+		for (int operation = 0; operation < 3; operation++) {
+			CompilationContext context;
+			vector<LocalVariable *> inputs;
+			LocalVariable *sum;
+			BasicBlock *basicBlock = operation < 2 ? generateProductSum(context, 1, inputs, sum)
+					: generateChainBasicBlock(context, 3, inputs, sum);
+			// the products multiply a sparse matrix by a dense one
+			vector<Matrix> matrices;
+			srand(rows);
+			for (unsigned i = 0; i < inputs.size(); i++) {
+				bool dense = operation < 2 && i == inputs.size() - 1;
+				unsigned columns = !dense ? rows : operation == 0 ? 1 : 64;
+				inputs[i]->setShape(Shape(rows, columns));
+				inputs[i]->setDensity(dense ? 1 : density);
+				matrices.push_back(dense ? Matrix(ELEMENT_DOUBLE, rows, columns) : randomSparseMatrix(rows, columns, density));
+				if (dense)
+					matrices.back().fill(1);
+			}
+
+			double milliseconds[2];
+			size_t inputBytes[2] = { 0, 0 };
+			for (int sparse = 0; sparse < 2; sparse++) {
+				DAG dag(basicBlock);
+				unordered_set<LocalVariable *> liveOut({ sum });
+				ShapeInference().run(dag);
+				if (sparse)
+					DensityAnalysis().run(dag);
+				ElementwiseFusion(liveOut).run(dag);
+				ShapeInference().run(dag);
+
+				// the sparse inputs arrive compressed
+				FlatDAG flatDAG = dag.freeze();
+				MatrixEvaluator evaluator(flatDAG);
+				for (unsigned i = 0; i < inputs.size(); i++) {
+					RuntimeValue value(matrices[i]);
+					if (sparse && inputs[i]->getDensity() < 1)
+						value = RuntimeValue(SparseMatrix(matrices[i]));
+					inputBytes[sparse] += value.isSparse() ? value.getSparse().getBytes() : matrices[i].getBytes();
+					evaluator.bind(inputs[i], value);
+				}
+
+				chrono::steady_clock::time_point start = chrono::steady_clock::now();
+				for (FlatDAG::NodeId n = 0; n < flatDAG.getNumberOfNodes(); n++)
+					evaluator.evaluate(n);
+				milliseconds[sparse] = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+			}
+			cout << names[operation] << "\t" << density << "\t" << milliseconds[0] << "\t" << milliseconds[1]
+					<< "\t" << milliseconds[0] / milliseconds[1] << "\t" << inputBytes[0] / 1e6
+					<< "\t" << inputBytes[1] / 1e6 << endl;
+		}
+	}
+}
+
+// Builds a block of 'size' scalar instructions 'vX <- a op b', whose
+// operands are variables or the constants 0, 1, 2 and 3, and 'vX <- k',
+// so that variables hold constants too: every rewrite of ConstantFolding
+// has operands to apply to
+static BasicBlock * generateConstantBasicBlock(CompilationContext &context, unsigned size,
+		unsigned numberOfVariables) {
+	vector<Constant *> constants;
+	for (int i = 0; i < 4; i++)
+		constants.push_back(context.create<Constant>(context.create<Integer>(i)));
+
+	vector<LocalVariable *> variables;
+	Instruction *first = 0;
+	Instruction *last = 0;
+
+	for (unsigned i = 0; i < numberOfVariables; i++) {
+		LocalVariable *variable = context.create<LocalVariable>(i);
+		variable->setShape(Shape::scalar());
+		variables.push_back(variable);
+		if (first == 0)
+			first = variable;
+		else
+			last->link(variable);
+		last = variable;
+	}
+
+	for (unsigned i = 0; i < size; i++) {
+		LocalVariable *destination = variables[rand() % numberOfVariables];
+		if (rand() % 8 == 0) {
+			last = last->link(context.create<Move>(destination, constants[rand() % constants.size()]));
+			continue;
+		}
+
+		Instruction *left, *right;
+		if (rand() % 4)
+			left = variables[rand() % numberOfVariables];
+		else
+			left = constants[rand() % constants.size()];
+		if (rand() % 2)
+			right = constants[rand() % constants.size()];
+		else
+			right = variables[rand() % numberOfVariables];
+
+		BinaryInstruction *expression;
+		if (rand() % 2)
+			expression = context.create<Add>(left, right);
+		else
+			expression = context.create<Mul>(left, right);
+
+		last = last->link(context.create<Move>(destination, expression));
+	}
+	return context.create<BasicBlock>(first, last, &context);
+}
+
+// Constant folding of random scalar blocks (generateConstantBasicBlock)
+static void benchmarkConstantFolding(unsigned maxSize) {
+	cout << "instructions\tnodes\tremoved\tfolded\tsimplified\tstrength reduced\tpass (ns/node)" << endl;
+	for (unsigned size = 1 << 10; size <= maxSize; size <<= 2) {
+		CompilationContext context;
+		srand(size);
+		DAG dag(generateConstantBasicBlock(context, size, 64));
+		size_t numberOfNodes = dag.getDAGNodes().size();
+
+		ConstantFolding folding;
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		folding.run(dag);
+		chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+		cout << size << "\t" << numberOfNodes << "\t" << folding.getNumberOfRemovedNodes()
+				<< "\t" << folding.getNumberOfFoldedNodes() << "\t" << folding.getNumberOfSimplifiedNodes()
+				<< "\t" << folding.getNumberOfStrengthReducedNodes()
+				<< "\t" << chrono::duration<double, nano>(end - start).count() / numberOfNodes << endl;
+	}
+}
+
+// Dead code elimination of random blocks, when the final values of all
+// the variables are live out and when only one of them is
+static void benchmarkDeadCode(unsigned maxSize) {
+	cout << "instructions\tnodes\tremoved (all live)\tremoved (one live)\tpass (ns/node)" << endl;
+	for (unsigned size = 1 << 10; size <= maxSize; size <<= 2) {
+		unsigned removed[2];
+		size_t numberOfNodes = 0;
+		double nanoseconds = 0;
+		for (int one = 0; one < 2; one++) {
+			CompilationContext context;
+			srand(size);
+			BasicBlock *basicBlock = generateBasicBlock(context, size, 64);
+			DAG dag(basicBlock);
+			numberOfNodes = dag.getDAGNodes().size();
+
+			unordered_set<LocalVariable *> liveOut;
+			for (Instruction *i = basicBlock->getFirst(); i != 0; i = i->getNext()) {
+				if (i->getInstructionID() == LOCALVARIABLE && (!one || liveOut.empty()))
+					liveOut.insert((LocalVariable *) i);
+			}
+
+			DeadCodeElimination deadCode(liveOut);
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			removed[one] = deadCode.run(dag);
+			chrono::steady_clock::time_point end = chrono::steady_clock::now();
+			nanoseconds = chrono::duration<double, nano>(end - start).count();
+		}
+		cout << size << "\t" << numberOfNodes << "\t" << removed[0] << "\t" << removed[1]
+				<< "\t" << nanoseconds / numberOfNodes << endl;
+	}
+}
+
+// Edits of random blocks: one instruction 'vX <- vY op vZ' at a time gets
+// the other operator, and the DAG and its shapes are updated in place.
+// The work of an edit follows the values it changes: an edit early in the
+// block changes most of the values computed after it, one near the end
+// only a few. The DAG is built for edits: its instructions are indexed
+// as it is built, so the first edit costs what the others do. Building the DAG of the edited
+// block again, with its shapes, is what each edit would cost otherwise.
+static void benchmarkIncremental(unsigned maxSize) {
+	const unsigned edits = 16;
+	cout << "instructions\trebuild (ms)\tfirst edit (ms)\tedit anywhere (us)\tdirty nodes/edit"
+			<< "\tedit near the end (us)\tdirty nodes/edit" << endl;
+	for (unsigned size = 1 << 10; size <= maxSize; size <<= 2) {
+		CompilationContext context;
+		srand(size);
+		BasicBlock *basicBlock = generateBasicBlock(context, size, 64);
+		vector<Instruction *> instructions;
+		for (Instruction *i = basicBlock->getFirst(); i != 0; i = i->getNext())
+			instructions.push_back(i);
+
+		DAG dag(basicBlock, &context, true);
+		ShapeInference shapes;
+		shapes.run(dag);
+
+		// the first one, then edits anywhere and near the end
+		double nanoseconds[3] = { 0, 0, 0 };
+		size_t dirtyNodes[3] = { 0, 0, 0 };
+		for (unsigned e = 0; e <= 2 * edits; e++) {
+			unsigned kind = e == 0 ? 0 : e <= edits ? 1 : 2;
+			// after the declarations of the 64 variables, never the last instruction
+			size_t position = kind == 2 ? size + 62 - rand() % 64 : 64 + rand() % (size - 1);
+			Move *move = (Move *) instructions[position];
+			BinaryInstruction *expression = (BinaryInstruction *) move->getRightValue();
+			BinaryInstruction *edited;
+			if (expression->getInstructionID() == ADD)
+				edited = context.create<Mul>(expression->getFirstOperand(), expression->getSecondOperand());
+			else
+				edited = context.create<Add>(expression->getFirstOperand(), expression->getSecondOperand());
+			Move *replacement = context.create<Move>(move->getVariable(), edited);
+			move->getPrevious()->link(replacement)->link(move->getNext());
+			instructions[position] = replacement;
+
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			dag.replaceInstruction(move, replacement);
+			shapes.update(dag);
+			chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+			nanoseconds[kind] += chrono::duration<double, nano>(end - start).count();
+			dirtyNodes[kind] += dag.getDirtyNodes().size();
+			dag.clearDirtyNodes();
+		}
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		DAG rebuilt(basicBlock);
+		shapes.run(rebuilt);
+		chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+		cout << size << "\t" << chrono::duration<double, milli>(end - start).count()
+				<< "\t" << nanoseconds[0] / 1e6
+				<< "\t" << nanoseconds[1] / edits / 1e3 << "\t" << (double) dirtyNodes[1] / edits
+				<< "\t" << nanoseconds[2] / edits / 1e3 << "\t" << (double) dirtyNodes[2] / edits << endl;
+	}
+}
+
+// Builds 'count' loops in sequence, 'for (i = 0; i < tripCount; i++)',
+// each one recomputing 'invariant' expressions of the variables it does
+// not assign next to as many accumulations of the induction variable
+static BasicBlock * generateLoops(CompilationContext &context, unsigned count, unsigned invariant,
+		int tripCount) {
+	const unsigned inputs = 8;
+	vector<LocalVariable *> variables;
+	for (unsigned v = 0; v < inputs + 2 * invariant + 1; v++)
+		variables.push_back(context.create<LocalVariable>(v));
+	LocalVariable *i = variables.back();
+
+	BasicBlock *entry = context.create<BasicBlock>((Instruction *) 0, (Instruction *) 0, &context);
+	BasicBlock *previous = entry;
+	for (unsigned loop = 0; loop < count; loop++) {
+		BasicBlock *header = context.create<BasicBlock>((Instruction *) 0, (Instruction *) 0, &context);
+		BasicBlock *body = context.create<BasicBlock>((Instruction *) 0, (Instruction *) 0, &context);
+		previous->append(context.create<Move>(i, context.create<Constant>(context.create<Integer>(0))));
+		for (unsigned k = 0; k < invariant; k++) {
+			LocalVariable *temp = variables[inputs + k];
+			LocalVariable *accumulator = variables[inputs + invariant + k];
+			body->append(context.create<Move>(temp, context.create<Add>(variables[rand() % inputs],
+					variables[rand() % inputs])));
+			body->append(context.create<Move>(accumulator, context.create<Add>(accumulator,
+					context.create<Mul>(temp, i))));
+		}
+		body->append(context.create<Move>(i, context.create<Add>(i, context.create<Constant>(context.create<Integer>(1)))));
+
+		BasicBlock *next = context.create<BasicBlock>((Instruction *) 0, (Instruction *) 0, &context);
+		previous->setJump(header);
+		header->setBranch(BRANCH_LESS, i, context.create<Constant>(context.create<Integer>(tripCount)), body, next);
+		body->setJump(header);
+		previous = next;
+	}
+	return entry;
+}
+
+// instructions executed by a run of the loops, from the trip counts
+static uint64_t countExecutedInstructions(ControlFlowGraph &cfg) {
+	uint64_t executed = 0;
+	for (BasicBlock *block : cfg.getBlocks()) {
+		uint64_t times = 1;
+		for (Loop *loop = cfg.getLoopFor(block); loop != 0; loop = loop->parent)
+			times *= max(InductionVariables(cfg, loop).getTripCount(), 0LL);
+		for (Instruction *i = block->getFirst(); i != 0; i = i->getNext()) {
+			if (i->getInstructionID() != LOCALVARIABLE)
+				executed += times;
+		}
+	}
+	return executed;
+}
+
+static void benchmarkLoops(unsigned maxSize) {
+	cout << "loops\tblocks\tanalysis (ns/block)\tLICM (ns/instruction)\texecuted before\texecuted after"
+			"\tunroll (ns/copy)\tblocks unrolled" << endl;
+	for (unsigned count = 1 << 4; count * 16 <= maxSize; count <<= 2) {
+		CompilationContext context;
+		srand(count);
+		BasicBlock *entry = generateLoops(context, count, 4, 64);
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		ControlFlowGraph cfg(entry, &context);
+		chrono::steady_clock::time_point end = chrono::steady_clock::now();
+		double analysisNanoseconds = chrono::duration<double, nano>(end - start).count();
+		size_t numberOfBlocks = cfg.getBlocks().size();
+		uint64_t before = countExecutedInstructions(cfg);
+
+		LoopInvariantCodeMotion invariantCodeMotion;
+		start = chrono::steady_clock::now();
+		invariantCodeMotion.run(cfg);
+		end = chrono::steady_clock::now();
+		double motionNanoseconds = chrono::duration<double, nano>(end - start).count();
+		uint64_t after = countExecutedInstructions(cfg);
+
+		// short loops of the same shape unroll into one block
+		CompilationContext unrollContext;
+		srand(count);
+		ControlFlowGraph shortLoops(generateLoops(unrollContext, count, 4, 4), &unrollContext);
+		LoopUnrolling unrolling;
+		start = chrono::steady_clock::now();
+		unrolling.run(shortLoops);
+		end = chrono::steady_clock::now();
+		double unrollNanoseconds = chrono::duration<double, nano>(end - start).count();
+
+		cout << count << "\t" << numberOfBlocks << "\t" << analysisNanoseconds / numberOfBlocks
+				<< "\t" << motionNanoseconds / (count * 9) << "\t" << before << "\t" << after
+				<< "\t" << unrollNanoseconds / max(unrolling.getNumberOfCopiedInstructions(), 1u)
+				<< "\t" << shortLoops.getBlocks().size() << endl;
+	}
+}
+
+// Regression check of a body reading the counter after its update:
+//   i = 0; s = 0; while (i < 3) { i = i + 1; s = s + i; } print(s)
+// unrolls to one block where s folds to 1 + 2 + 3
+static bool checkUnrolledCounterUpdate() {
+	CompilationContext context;
+	LocalVariable *i = context.create<LocalVariable>(0);
+	LocalVariable *s = context.create<LocalVariable>(1);
+	Constant *zero = context.create<Constant>(context.create<Integer>(0));
+	Constant *one = context.create<Constant>(context.create<Integer>(1));
+	Constant *three = context.create<Constant>(context.create<Integer>(3));
+
+	BasicBlock *entry = context.create<BasicBlock>((Instruction *) 0, (Instruction *) 0, &context);
+	BasicBlock *header = context.create<BasicBlock>((Instruction *) 0, (Instruction *) 0, &context);
+	BasicBlock *body = context.create<BasicBlock>((Instruction *) 0, (Instruction *) 0, &context);
+	BasicBlock *exit = context.create<BasicBlock>((Instruction *) 0, (Instruction *) 0, &context);
+	entry->append(context.create<Move>(i, zero));
+	entry->append(context.create<Move>(s, zero));
+	entry->setJump(header);
+	header->setBranch(BRANCH_LESS, i, three, body, exit);
+	body->append(context.create<Move>(i, context.create<Add>(i, one)));
+	body->append(context.create<Move>(s, context.create<Add>(s, i)));
+	body->setJump(header);
+	exit->append(context.create<Print>(s));
+
+	ControlFlowGraph cfg(entry, &context);
+	if (LoopUnrolling().run(cfg) != 1 || cfg.getBlocks().size() != 1)
+		return false;
+	DAG dag(cfg.getEntry());
+	ConstantFolding().run(dag);
+	int value;
+	return ConstantFolding::getConstant(dag.getNode(s), value) && value == 6;
+}
+
+// 'count' if/else diamonds: the head of each computes a sum of inputs,
+// both arms recompute it and scale it, and the join recomputes it again
+static BasicBlock * generateDiamonds(CompilationContext &context, unsigned count) {
+	const unsigned inputs = 8;
+	vector<LocalVariable *> variables;
+	for (unsigned v = 0; v < inputs + 4; v++)
+		variables.push_back(context.create<LocalVariable>(v));
+	LocalVariable *sum = variables[inputs], *scaled = variables[inputs + 1], *total = variables[inputs + 2];
+	LocalVariable *term = variables[inputs + 3];
+
+	BasicBlock *entry = context.create<BasicBlock>((Instruction *) 0, (Instruction *) 0, &context);
+	BasicBlock *head = entry;
+	for (unsigned diamond = 0; diamond < count; diamond++) {
+		LocalVariable *left = variables[rand() % inputs], *right = variables[rand() % inputs];
+		BasicBlock *arms[2];
+		BasicBlock *join = context.create<BasicBlock>((Instruction *) 0, (Instruction *) 0, &context);
+		head->append(context.create<Move>(sum, context.create<Add>(left, right)));
+		for (unsigned arm = 0; arm < 2; arm++) {
+			arms[arm] = context.create<BasicBlock>((Instruction *) 0, (Instruction *) 0, &context);
+			arms[arm]->append(context.create<Move>(sum, context.create<Add>(right, left)));
+			arms[arm]->append(context.create<Move>(scaled, context.create<Mul>(sum,
+					context.create<Constant>(context.create<Integer>(arm + 2)))));
+			arms[arm]->setJump(join);
+		}
+		head->setBranch(BRANCH_LESS, left, right, arms[0], arms[1]);
+		join->append(context.create<Move>(sum, context.create<Add>(left, right)));
+		join->append(context.create<Move>(term, context.create<Add>(sum, scaled)));
+		join->append(context.create<Move>(total, context.create<Add>(total, term)));
+		head = join;
+	}
+	head->append(context.create<Print>(total));
+	return entry;
+}
+
+static void benchmarkValueNumbering(unsigned maxSize) {
+	cout << "diamonds\tinstructions\tSSA (ns/instruction)\tphis\tGVN (ns/instruction)\tremoved"
+			"\tdestruction (ns/copy)" << endl;
+	for (unsigned count = 1 << 4; count * 8 <= maxSize; count <<= 2) {
+		CompilationContext context;
+		srand(count);
+		ControlFlowGraph cfg(generateDiamonds(context, count), &context);
+		unsigned numberOfInstructions = count * 7 + 1;
+
+		SSAForm ssa(cfg);
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		ssa.construct();
+		chrono::steady_clock::time_point end = chrono::steady_clock::now();
+		double constructionNanoseconds = chrono::duration<double, nano>(end - start).count();
+
+		GlobalValueNumbering valueNumbering;
+		start = chrono::steady_clock::now();
+		valueNumbering.run(cfg);
+		end = chrono::steady_clock::now();
+		double numberingNanoseconds = chrono::duration<double, nano>(end - start).count();
+
+		start = chrono::steady_clock::now();
+		unsigned copies = ssa.destruct();
+		end = chrono::steady_clock::now();
+		double destructionNanoseconds = chrono::duration<double, nano>(end - start).count();
+
+		cout << count << "\t" << numberOfInstructions << "\t" << constructionNanoseconds / numberOfInstructions
+				<< "\t" << ssa.getNumberOfPhis() << "\t" << numberingNanoseconds / numberOfInstructions
+				<< "\t" << valueNumbering.getNumberOfRemovedInstructions()
+				<< "\t" << destructionNanoseconds / max(copies, 1u) << endl;
+	}
+}
+
+// Execution time of a wide block of matrix additions with tracing off,
+// on, and on with the hardware counters (best of 5 runs each)
+static void benchmarkTracing(unsigned width, unsigned rows) {
+	CompilationContext context;
+	DAG dag(generateWideBasicBlock(context, width));
+	FlatDAG flatDAG = dag.freeze();
+	MatrixEvaluator evaluator(flatDAG);
+	for (FlatDAG::NodeId n = 0; n < flatDAG.getNumberOfNodes(); n++) {
+		if (flatDAG.isLeaf(n) && flatDAG.getLabel(n) == LOCALVARIABLE) {
+			Matrix matrix(ELEMENT_DOUBLE, rows, rows);
+			matrix.fill(n);
+			evaluator.bind((LocalVariable *) flatDAG.getLeaf(n), matrix);
+		}
+	}
+
+	if (!isTracingCompiledIn())
+		cout << "(built without -DDAG_TRACING: the instrumentation is compiled out)" << endl;
+	cout << "tracing\texecute (ms)\toverhead\tevents" << endl;
+	ThreadPool pool;
+	Executor executor(pool);
+	double baseline = 0;
+	for (int mode = 0; mode < 3; mode++) {
+		if (mode > 0)
+			Tracer::enable(mode == 2);
+		double best = 0;
+		for (int run = 0; run < 5; run++) {
+			Tracer::clear();
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			executor.execute(flatDAG, [&evaluator](FlatDAG::NodeId n) {
+				evaluator.evaluate(n);
+			});
+			chrono::steady_clock::time_point end = chrono::steady_clock::now();
+			double milliseconds = chrono::duration<double, milli>(end - start).count();
+			if (run == 0 || milliseconds < best)
+				best = milliseconds;
+		}
+		Tracer::disable();
+		if (mode == 0)
+			baseline = best;
+		cout << (mode == 0 ? "off" : mode == 1 ? "on" : Tracer::hasCounters() ? "counters" : "counters (unavailable)")
+				<< "\t" << best << "\t" << (best / baseline - 1) * 100 << "%\t" << Tracer::getNumberOfEvents() << endl;
+	}
+	Tracer::clear();
+}
+
+int main(int argc, char** argv) {
+	unsigned maxSize = 1 << 18;
+	if (argc > 1)
+		maxSize = atoi(argv[1]);
+
+	cout << "instructions\tDAG build (ms)\tns/instruction\tfreeze (ms)\tlevels (ns/node)" << endl;
+	for (unsigned size = 1 << 10; size <= maxSize; size <<= 1) {
+		// block and DAG are released together with the context
+		CompilationContext context;
+		srand(size);
+		BasicBlock *basicBlock = generateBasicBlock(context, size, 64);
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		DAG *dag = new DAG(basicBlock);
+		chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+		double nanoseconds = chrono::duration<double, nano>(end - start).count();
+
+		// flat form: conversion and a full traversal computing the node levels
+		start = chrono::steady_clock::now();
+		FlatDAG flatDAG = dag->freeze();
+		end = chrono::steady_clock::now();
+		double freezeNanoseconds = chrono::duration<double, nano>(end - start).count();
+
+		start = chrono::steady_clock::now();
+		vector<uint32_t> levels = flatDAG.levels();
+		end = chrono::steady_clock::now();
+		double levelsNanoseconds = chrono::duration<double, nano>(end - start).count();
+
+		cout << size << "\t" << nanoseconds / 1e6 << "\t" << nanoseconds / size
+				<< "\t" << freezeNanoseconds / 1e6
+				<< "\t" << levelsNanoseconds / flatDAG.getNumberOfNodes() << endl;
+
+		delete dag;
+	}
+
+	cout << endl;
+	benchmarkFlatBlocks(maxSize);
+
+	cout << endl;
+	benchmarkExecutor(4096);
+
+	cout << endl;
+	benchmarkFusion(2048);
+
+	cout << endl;
+	benchmarkChainOrder();
+	cout << "shared chain product: " << (checkSharedChainProduct() ? "ok" : "FAILED") << endl;
+
+	cout << endl;
+	benchmarkBufferAssignment(maxSize);
+
+	cout << endl;
+	benchmarkLoads(16);
+
+	cout << endl;
+	benchmarkMatrixFiles(4096);
+
+	cout << endl;
+	benchmarkOutOfCore(8192, 1024);
+
+	cout << endl;
+	benchmarkReductions(2048);
+
+	cout << endl;
+	benchmarkGemm(1024);
+
+	cout << endl;
+	benchmarkDistributed(2048);
+
+	cout << endl;
+	benchmarkSparse(4096);
+
+	cout << endl;
+	benchmarkConstantFolding(maxSize);
+
+	cout << endl;
+	benchmarkDeadCode(maxSize);
+
+	cout << endl;
+	benchmarkIncremental(maxSize);
+
+	cout << endl;
+	benchmarkLoops(maxSize);
+	cout << "unrolled counter update: " << (checkUnrolledCounterUpdate() ? "ok" : "FAILED") << endl;
+
+	cout << endl;
+	benchmarkValueNumbering(maxSize);
+
+	cout << endl;
+	benchmarkTracing(1024, 64);
+	return 0;
+}
@@ -0,0 +1,421 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include "ir/dag.h"
+#include "ir/flatDag.h"
+#include "ir/instruction.h"
+#include "cfg/basicBlock.h"
+#include "cfg/controlFlowGraph.h"
+#include "ir/irParser.h"
+#include "support/compilationContext.h"
+
+using namespace std;
+
+// Compile time of a basic block, phase by phase, on synthetic blocks:
+//
+//   compileBenchmark [--instructions=N[,N...]] [--reuse=R] [--constants=C]
+//                    [--variables=V] [--mix=add:W,mul:W,dot:W,sum:W,copy:W]
+//   compileBenchmark --ir=FILE
+//
+// For each phase it reports ns/instruction, the heap allocations made
+// (operator new, counted below), the bytes taken from the context arena
+// and the peak RSS reached during the phase; the parse phases also report
+// the MB/s of text read. With --ir, the phases run on the entry block of
+// an IR file instead.
+
+// Heap allocations of the whole process, counted by the replaced global
+// operator new. Relaxed atomics: only the totals matter.
+static atomic<uint64_t> heapAllocations(0);
+static atomic<uint64_t> heapBytes(0);
+
+static void * allocateCounted(size_t size) {
+	heapAllocations.fetch_add(1, memory_order_relaxed);
+	heapBytes.fetch_add(size, memory_order_relaxed);
+	void *memory = malloc(size ? size : 1);
+	if (memory == 0)
+		throw bad_alloc();
+	return memory;
+}
+
+void * operator new(size_t size) {
+	return allocateCounted(size);
+}
+
+void * operator new[](size_t size) {
+	return allocateCounted(size);
+}
+
+void operator delete(void *memory) noexcept {
+	free(memory);
+}
+
+void operator delete[](void *memory) noexcept {
+	free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+	free(memory);
+}
+
+void operator delete[](void *memory, size_t) noexcept {
+	free(memory);
+}
+
+// Shape of the generated blocks
+struct GeneratorOptions {
+	unsigned numberOfInstructions;
+	double   reuse;              // probability that an operand is one of the few hot variables
+	unsigned numberOfConstants;  // size of the constant pool
+	unsigned numberOfVariables;
+	// op mix: relative weights of the right values
+	unsigned add;
+	unsigned mul;
+	unsigned dot;
+	unsigned sum;
+	unsigned copy;
+
+	GeneratorOptions() :
+			numberOfInstructions(0), reuse(0.5), numberOfConstants(4), numberOfVariables(64),
+			add(4), mul(4), dot(1), sum(1), copy(1) {
+	}
+};
+
+static const unsigned HOT_VARIABLES = 4;
+
+// A block of 'vX <- right value' instructions, after the declarations of
+// its variables. An operand is a constant one time in four, otherwise a
+// variable: one of the first HOT_VARIABLES with probability 'reuse' (their
+// DAG nodes get very large predecessor lists), any of them otherwise.
+static BasicBlock * generateBasicBlock(CompilationContext &context, const GeneratorOptions &options,
+		vector<LocalVariable *> &variables) {
+	vector<Constant *> constants;
+	for (unsigned i = 0; i < options.numberOfConstants; i++)
+		constants.push_back(context.create<Constant>(context.create<Integer>(i)));
+
+	Instruction *first = 0;
+	Instruction *last = 0;
+	for (unsigned i = 0; i < options.numberOfVariables; i++) {
+		LocalVariable *variable = context.create<LocalVariable>(i);
+		variables.push_back(variable);
+		if (first == 0)
+			first = variable;
+		else
+			last->link(variable);
+		last = variable;
+	}
+
+	unsigned hot = min(HOT_VARIABLES, options.numberOfVariables);
+	unsigned reuseThreshold = (unsigned) (options.reuse * RAND_MAX);
+	auto operand = [&]() -> Instruction * {
+		if (!constants.empty() && rand() % 4 == 0)
+			return constants[rand() % constants.size()];
+		if ((unsigned) rand() <= reuseThreshold)
+			return variables[rand() % hot];
+		return variables[rand() % variables.size()];
+	};
+
+	unsigned total = options.add + options.mul + options.dot + options.sum + options.copy;
+	for (unsigned i = 0; i < options.numberOfInstructions; i++) {
+		LocalVariable *destination = variables[rand() % variables.size()];
+		unsigned pick = rand() % total;
+		Instruction *rightValue;
+		if (pick < options.add)
+			rightValue = context.create<Add>(operand(), operand());
+		else if ((pick -= options.add) < options.mul)
+			rightValue = context.create<Mul>(operand(), operand());
+		else if ((pick -= options.mul) < options.dot)
+			rightValue = context.create<Dot>(operand(), operand());
+		else if ((pick -= options.dot) < options.sum)
+			rightValue = context.create<Reduction>(SUM, operand());
+		else
+			rightValue = operand();
+		last = last->link(context.create<Move>(destination, rightValue));
+	}
+	return context.create<BasicBlock>(first, last, &context);
+}
+
+// Peak resident set size in kB. Linux resets the peak when "5" is written
+// to /proc/self/clear_refs, which gives the peak of each phase; elsewhere
+// it is the peak of the process so far.
+static bool resetPeakResidentSize() {
+	ofstream clearRefs("/proc/self/clear_refs");
+	clearRefs << "5";
+	clearRefs.flush();
+	return clearRefs.good();
+}
+
+static long getPeakResidentSize() {
+	ifstream status("/proc/self/status");
+	string line;
+	while (getline(status, line)) {
+		if (line.compare(0, 6, "VmHWM:") == 0)
+			return atol(line.c_str() + 6);
+	}
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+// Measures one phase: call start() before it and stop() after it
+class Phase {
+public:
+	Phase(const string &n, CompilationContext &context) :
+			name(n), arena(context.getArena()), startAllocations(0), startBytes(0), startArenaBytes(0) {
+	}
+
+	void start() {
+		resetPeakResidentSize();
+		startAllocations = heapAllocations.load(memory_order_relaxed);
+		startBytes = heapBytes.load(memory_order_relaxed);
+		startArenaBytes = arena.getBytesAllocated();
+		startTime = chrono::steady_clock::now();
+	}
+
+	// 'inputBytes': the size of the text parsed by the phase, if any
+	void stop(unsigned numberOfInstructions, size_t inputBytes = 0) {
+		chrono::steady_clock::time_point end = chrono::steady_clock::now();
+		double nanoseconds = chrono::duration<double, nano>(end - startTime).count();
+		uint64_t allocations = heapAllocations.load(memory_order_relaxed) - startAllocations;
+		uint64_t bytes = heapBytes.load(memory_order_relaxed) - startBytes;
+		long peak = getPeakResidentSize();
+
+		cout << numberOfInstructions << "\t" << name << "\t" << nanoseconds / 1e6
+				<< "\t" << nanoseconds / numberOfInstructions
+				<< "\t" << allocations << "\t" << bytes
+				<< "\t" << arena.getBytesAllocated() - startArenaBytes
+				<< "\t" << peak << "\t";
+		if (inputBytes != 0)
+			cout << inputBytes / 1e6 / (nanoseconds / 1e9);
+		else
+			cout << "-";
+		cout << endl;
+	}
+
+private:
+	string name;
+	Arena &arena;
+	uint64_t startAllocations;
+	uint64_t startBytes;
+	size_t startArenaBytes;
+	chrono::steady_clock::time_point startTime;
+};
+
+// keeps the compiler from optimizing the lookups away
+static volatile long lookupChecksum;
+
+// Parses the rest of the input of 'parser' on another thread while this
+// thread builds the DAG of its entry block
+static void benchmarkOverlappedParsing(IRParser &parser, unsigned size) {
+	CompilationContext dagContext;
+	Phase overlapped("parse+DAG", dagContext);
+	overlapped.start();
+	DAG dag(0, &dagContext);
+	BasicBlock *entry = 0;
+	parser.parseConcurrently([&dag, &entry](BasicBlock *block, Instruction *instruction) {
+		if (entry == 0)
+			entry = block;
+		if (block == entry)
+			dag.addThreeAddressInstruction(instruction);
+	});
+	overlapped.stop(size, parser.getNumberOfBytes());
+	lookupChecksum += dag.getDAGNodes().size();
+}
+
+// The phases of a block read from an IR file (mapped, not copied)
+static void benchmarkFile(const string &path) {
+	CompilationContext context;
+	Phase parsing("parse", context);
+	parsing.start();
+	IRParser parser(path, context);
+	BasicBlock *entry = parser.parse();
+	unsigned size = max<size_t>(parser.getNumberOfInstructions(), 1);
+	parsing.stop(size, parser.getNumberOfBytes());
+	if (entry == 0)
+		return;
+
+	Phase construction("DAG", context);
+	construction.start();
+	DAG *dag = new DAG(entry);
+	construction.stop(size);
+
+	Phase levels("levels", context);
+	levels.start();
+	FlatDAG flatDAG = dag->freeze();
+	vector<uint32_t> nodeLevels = flatDAG.levels();
+	levels.stop(size);
+	lookupChecksum += nodeLevels.size();
+	delete dag;
+
+	CompilationContext overlappedContext;
+	IRParser overlappedParser(path, overlappedContext);
+	benchmarkOverlappedParsing(overlappedParser, size);
+}
+
+static void benchmarkBlock(const GeneratorOptions &options) {
+	CompilationContext context;
+	srand(options.numberOfInstructions);
+	unsigned size = options.numberOfInstructions;
+
+	Phase generation("generate", context);
+	generation.start();
+	vector<LocalVariable *> variables;
+	variables.reserve(options.numberOfVariables);
+	BasicBlock *basicBlock = generateBasicBlock(context, options, variables);
+	generation.stop(size);
+
+	Phase construction("DAG", context);
+	construction.start();
+	DAG *dag = new DAG(basicBlock);
+	construction.stop(size);
+
+	// every operation is found again by value numbering, and every
+	// variable by its latest node
+	Phase lookup("lookup", context);
+	lookup.start();
+	long found = 0;
+	for (Node *node : dag->getDAGNodes()) {
+		Operator op = node->getLabel();
+		const Node::NodeList &operands = node->getSuccessors();
+		if (op == ADD || op == MUL || op == DOT)
+			found += dag->addOperation(op, operands[0], operands[1]) == node;
+		else if (op == SUM)
+			found += dag->addReduction(op, operands[0]) == node;
+	}
+	for (LocalVariable *variable : variables)
+		found += dag->getNode(variable) != 0;
+	lookupChecksum += found;
+	lookup.stop(size);
+
+	// the flat form, and the levels from a traversal by indegrees
+	Phase levels("levels", context);
+	levels.start();
+	FlatDAG flatDAG = dag->freeze();
+	vector<uint32_t> nodeLevels = flatDAG.levels();
+	levels.stop(size);
+	lookupChecksum += nodeLevels.size();
+
+	// printed to a discarded stream
+	Phase printing("print", context);
+	ostringstream discarded;
+	streambuf *standardOutput = cout.rdbuf(discarded.rdbuf());
+	printing.start();
+	dag->print();
+	cout.rdbuf(standardOutput);
+	printing.stop(size);
+
+	// the text form of the block, parsed back
+	ostringstream text;
+	cout.rdbuf(text.rdbuf());
+	ControlFlowGraph(basicBlock, &context).print();
+	cout.rdbuf(standardOutput);
+	string program = text.str();
+	{
+		CompilationContext parsedContext;
+		Phase parsing("parse", parsedContext);
+		parsing.start();
+		IRParser parser(program.data(), program.size(), parsedContext);
+		parser.parse();
+		parsing.stop(size, program.size());
+	}
+	CompilationContext overlappedContext;
+	IRParser overlappedParser(program.data(), program.size(), overlappedContext);
+	benchmarkOverlappedParsing(overlappedParser, size);
+
+	Phase destruction("release", context);
+	destruction.start();
+	delete dag;
+	destruction.stop(size);
+}
+
+// "add:4,mul:4,dot:1,sum:1,copy:1"; missing operators keep their weight
+static bool parseMix(const char *mix, GeneratorOptions &options) {
+	stringstream stream(mix);
+	string entry;
+	while (getline(stream, entry, ',')) {
+		size_t colon = entry.find(':');
+		if (colon == string::npos)
+			return false;
+		string op = entry.substr(0, colon);
+		unsigned weight = atoi(entry.c_str() + colon + 1);
+		if (op == "add")
+			options.add = weight;
+		else if (op == "mul")
+			options.mul = weight;
+		else if (op == "dot")
+			options.dot = weight;
+		else if (op == "sum")
+			options.sum = weight;
+		else if (op == "copy")
+			options.copy = weight;
+		else
+			return false;
+	}
+	return options.add + options.mul + options.dot + options.sum + options.copy > 0;
+}
+
+int main(int argc, char** argv) {
+	GeneratorOptions options;
+	vector<unsigned> sizes;
+	string irFile;
+	for (int i = 1; i < argc; i++) {
+		const char *argument = argv[i];
+		const char *value = strchr(argument, '=');
+		value = value ? value + 1 : "";
+		if (strncmp(argument, "--instructions=", 15) == 0) {
+			stringstream stream(value);
+			string size;
+			while (getline(stream, size, ','))
+				sizes.push_back(atoi(size.c_str()));
+		} else if (strncmp(argument, "--reuse=", 8) == 0) {
+			options.reuse = atof(value);
+		} else if (strncmp(argument, "--constants=", 12) == 0) {
+			options.numberOfConstants = atoi(value);
+		} else if (strncmp(argument, "--variables=", 12) == 0) {
+			options.numberOfVariables = max(atoi(value), 1);
+		} else if (strncmp(argument, "--ir=", 5) == 0) {
+			irFile = value;
+		} else if (strncmp(argument, "--mix=", 6) != 0 || !parseMix(value, options)) {
+			cerr << "usage: " << argv[0] << " [--instructions=N[,N...]] [--reuse=R] [--constants=C]"
+					" [--variables=V] [--mix=add:W,mul:W,dot:W,sum:W,copy:W] | --ir=FILE" << endl;
+			return 1;
+		}
+	}
+	if (sizes.empty()) {
+		for (unsigned size = 1 << 10; size <= 1 << 18; size <<= 2)
+			sizes.push_back(size);
+	}
+
+	if (!resetPeakResidentSize())
+		cerr << "peak RSS is the peak of the process: /proc/self/clear_refs is not writable" << endl;
+	const char *columns = "instructions\tphase\tms\tns/instruction\theap allocations\theap bytes"
+			"\tarena bytes\tpeak RSS (kB)\tMB/s";
+	if (!irFile.empty()) {
+		cout << irFile << endl << columns << endl;
+		try {
+			benchmarkFile(irFile);
+		} catch (const exception &e) {
+			cerr << e.what() << endl;
+			return 1;
+		}
+		return 0;
+	}
+
+	cout << "reuse " << options.reuse << ", constants " << options.numberOfConstants
+			<< ", variables " << options.numberOfVariables << ", mix add:" << options.add
+			<< ",mul:" << options.mul << ",dot:" << options.dot << ",sum:" << options.sum
+			<< ",copy:" << options.copy << endl;
+	cout << columns << endl;
+	for (unsigned size : sizes) {
+		options.numberOfInstructions = size;
+		benchmarkBlock(options);
+	}
+	return 0;
+}
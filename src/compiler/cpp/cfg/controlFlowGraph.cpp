@@ -0,0 +1,366 @@
+#include "cfg/controlFlowGraph.h"
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+ControlFlowGraph::ControlFlowGraph(BasicBlock *entryBlock, CompilationContext *ctx) :
+		entry(entryBlock), context(ctx) {
+	analyze();
+}
+
+ControlFlowGraph::~ControlFlowGraph() {
+	clearLoops();
+	for (BasicBlock *block : ownedBlocks)
+		delete block;
+	for (Instruction *instruction : ownedInstructions)
+		delete instruction;
+	for (Value *value : ownedValues)
+		delete value;
+}
+
+void ControlFlowGraph::analyze() {
+	computeOrder();
+	computeDominators();
+	computeLoops();
+}
+
+void ControlFlowGraph::computeOrder() {
+	blocks.clear();
+	index.clear();
+
+	// iterative depth first search; a block is emitted after its successors
+	vector<BasicBlock *> postOrder;
+	vector<pair<BasicBlock *, size_t> > stack;
+	unordered_set<BasicBlock *> visited;
+	stack.push_back(make_pair(entry, 0));
+	visited.insert(entry);
+	while (!stack.empty()) {
+		BasicBlock *block = stack.back().first;
+		size_t next = stack.back().second;
+		if (next < block->getSuccessors().size()) {
+			stack.back().second++;
+			BasicBlock *successor = block->getSuccessors()[next];
+			if (visited.insert(successor).second)
+				stack.push_back(make_pair(successor, 0));
+			continue;
+		}
+		postOrder.push_back(block);
+		stack.pop_back();
+	}
+
+	blocks.assign(postOrder.rbegin(), postOrder.rend());
+	for (unsigned i = 0; i < blocks.size(); i++)
+		index[blocks[i]] = i;
+}
+
+void ControlFlowGraph::computeDominators() {
+	// Cooper, Harvey and Kennedy: iterate over the blocks in reverse post
+	// order, intersecting the dominators of the processed predecessors
+	const unsigned undefined = (unsigned) -1;
+	unsigned size = blocks.size();
+	immediateDominator.assign(size, undefined);
+	immediateDominator[0] = 0;
+
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (unsigned b = 1; b < size; b++) {
+			unsigned dominator = undefined;
+			for (BasicBlock *predecessor : blocks[b]->getPredecessors()) {
+				auto position = index.find(predecessor);
+				if (position == index.end())
+					continue;  // unreachable
+				unsigned p = position->second;
+				if (immediateDominator[p] == undefined)
+					continue;
+				if (dominator == undefined) {
+					dominator = p;
+					continue;
+				}
+				// walk both fingers up the tree until they meet
+				unsigned finger1 = p, finger2 = dominator;
+				while (finger1 != finger2) {
+					while (finger1 > finger2)
+						finger1 = immediateDominator[finger1];
+					while (finger2 > finger1)
+						finger2 = immediateDominator[finger2];
+				}
+				dominator = finger1;
+			}
+			if (immediateDominator[b] != dominator) {
+				immediateDominator[b] = dominator;
+				changed = true;
+			}
+		}
+	}
+
+	dominatorChildren.assign(size, vector<BasicBlock *>());
+	for (unsigned b = 1; b < size; b++)
+		dominatorChildren[immediateDominator[b]].push_back(blocks[b]);
+
+	// number the dominator tree so that dominance is an interval test
+	preorder.assign(size, 0);
+	postorder.assign(size, 0);
+	unsigned counter = 0;
+	vector<pair<unsigned, size_t> > stack;
+	stack.push_back(make_pair(0u, (size_t) 0));
+	preorder[0] = counter++;
+	while (!stack.empty()) {
+		unsigned b = stack.back().first;
+		size_t next = stack.back().second;
+		if (next < dominatorChildren[b].size()) {
+			stack.back().second++;
+			unsigned child = index[dominatorChildren[b][next]];
+			preorder[child] = counter++;
+			stack.push_back(make_pair(child, (size_t) 0));
+			continue;
+		}
+		postorder[b] = counter++;
+		stack.pop_back();
+	}
+}
+
+BasicBlock * ControlFlowGraph::getImmediateDominator(BasicBlock *block) const {
+	unsigned b = getIndex(block);
+	if (b == 0)
+		return 0;
+	return blocks[immediateDominator[b]];
+}
+
+bool ControlFlowGraph::dominates(BasicBlock *a, BasicBlock *b) const {
+	unsigned ia = getIndex(a), ib = getIndex(b);
+	return preorder[ia] <= preorder[ib] && postorder[ib] <= postorder[ia];
+}
+
+void ControlFlowGraph::clearLoops() {
+	for (Loop *loop : loops)
+		delete loop;
+	loops.clear();
+	innermostLoop.clear();
+}
+
+void ControlFlowGraph::computeLoops() {
+	clearLoops();
+
+	// a back edge goes to a block dominating its source
+	unordered_map<BasicBlock *, Loop *> byHeader;
+	vector<Loop *> found;
+	for (BasicBlock *block : blocks) {
+		for (BasicBlock *successor : block->getSuccessors()) {
+			if (!dominates(successor, block))
+				continue;
+			Loop *&loop = byHeader[successor];
+			if (loop == 0) {
+				loop = new Loop();
+				loop->header = successor;
+				loop->parent = 0;
+				loop->depth = 0;
+				loop->members.insert(successor);
+				found.push_back(loop);
+			}
+			loop->latches.push_back(block);
+
+			// the body: blocks reaching the latch backwards without the header
+			vector<BasicBlock *> stack;
+			if (loop->members.insert(block).second)
+				stack.push_back(block);
+			while (!stack.empty()) {
+				BasicBlock *member = stack.back();
+				stack.pop_back();
+				for (BasicBlock *predecessor : member->getPredecessors()) {
+					if (index.count(predecessor) && loop->members.insert(predecessor).second)
+						stack.push_back(predecessor);
+				}
+			}
+		}
+	}
+
+	for (Loop *loop : found) {
+		for (BasicBlock *block : loop->members)
+			loop->blocks.push_back(block);
+		sort(loop->blocks.begin(), loop->blocks.end(), [this](BasicBlock *a, BasicBlock *b) {
+			return index[a] < index[b];
+		});
+		for (BasicBlock *block : loop->blocks) {
+			bool isExiting = false;
+			for (BasicBlock *successor : block->getSuccessors()) {
+				if (loop->contains(successor))
+					continue;
+				isExiting = true;
+				if (find(loop->exits.begin(), loop->exits.end(), successor) == loop->exits.end())
+					loop->exits.push_back(successor);
+			}
+			if (isExiting)
+				loop->exiting.push_back(block);
+		}
+	}
+
+	// nesting: from the largest loop to the smallest, each block maps to the
+	// smallest loop seen so far containing it, which is the parent of the
+	// next loop it heads
+	stable_sort(found.begin(), found.end(), [](const Loop *a, const Loop *b) {
+		return a->members.size() > b->members.size();
+	});
+	for (Loop *loop : found) {
+		auto position = innermostLoop.find(loop->header);
+		loop->parent = position == innermostLoop.end() ? 0 : position->second;
+		loop->depth = loop->parent ? loop->parent->depth + 1 : 1;
+		for (BasicBlock *block : loop->blocks)
+			innermostLoop[block] = loop;
+	}
+
+	// innermost loops first
+	stable_sort(found.begin(), found.end(), [](const Loop *a, const Loop *b) {
+		return a->depth > b->depth;
+	});
+	loops = found;
+}
+
+Loop * ControlFlowGraph::getLoopFor(BasicBlock *block) const {
+	auto position = innermostLoop.find(block);
+	if (position == innermostLoop.end())
+		return 0;
+	return position->second;
+}
+
+BasicBlock * ControlFlowGraph::getPreheader(const Loop *loop) const {
+	BasicBlock *preheader = 0;
+	for (BasicBlock *predecessor : loop->header->getPredecessors()) {
+		if (loop->contains(predecessor))
+			continue;
+		if (preheader != 0 && preheader != predecessor)
+			return 0;
+		preheader = predecessor;
+	}
+	if (preheader == 0 || preheader->getSuccessors().size() != 1)
+		return 0;
+	return preheader;
+}
+
+BasicBlock * ControlFlowGraph::createBlock() {
+	if (context)
+		return context->create<BasicBlock>((Instruction *) 0, (Instruction *) 0, context);
+	BasicBlock *block = new BasicBlock(0, 0);
+	ownedBlocks.push_back(block);
+	return block;
+}
+
+unsigned ControlFlowGraph::insertPreheaders() {
+	unsigned inserted = 0;
+	for (Loop *loop : loops) {
+		if (getPreheader(loop) != 0)
+			continue;
+
+		// redirect the edges entering the loop to a new block jumping to the header
+		BasicBlock *preheader = createBlock();
+		vector<BasicBlock *> outside;
+		for (BasicBlock *predecessor : loop->header->getPredecessors()) {
+			if (!loop->contains(predecessor))
+				outside.push_back(predecessor);
+		}
+		for (BasicBlock *predecessor : outside)
+			predecessor->replaceSuccessor(loop->header, preheader);
+		preheader->setJump(loop->header);
+		if (loop->header == entry)
+			entry = preheader;
+		inserted++;
+	}
+	if (inserted)
+		analyze();
+	return inserted;
+}
+
+unsigned ControlFlowGraph::splitCriticalEdges() {
+	unsigned inserted = 0;
+	for (BasicBlock *block : blocks) {
+		if (block->getSuccessors().size() < 2)
+			continue;
+		vector<BasicBlock *> successors(block->getSuccessors().begin(), block->getSuccessors().end());
+		for (size_t s = 0; s < successors.size(); s++) {
+			BasicBlock *successor = successors[s];
+			// a branch with both edges to the same block is split once
+			if (successor->getPredecessors().size() < 2 || (s > 0 && successors[0] == successor))
+				continue;
+			BasicBlock *edge = createBlock();
+			block->replaceSuccessor(successor, edge);
+			edge->setJump(successor);
+			inserted++;
+		}
+	}
+	if (inserted)
+		analyze();
+	return inserted;
+}
+
+unsigned ControlFlowGraph::mergeBlocks() {
+	// in reverse post order a chain of blocks collapses into its first block
+	unsigned merged = 0;
+	for (BasicBlock *block : blocks) {
+		if (block == entry || block->getPredecessors().size() != 1)
+			continue;
+		BasicBlock *predecessor = block->getPredecessors()[0];
+		if (predecessor == block || predecessor->getSuccessors().size() != 1)
+			continue;
+
+		// the predecessor takes the instructions and the terminator
+		predecessor->splice(block);
+		vector<BasicBlock *> successors(block->getSuccessors().begin(), block->getSuccessors().end());
+		if (block->isConditional()) {
+			predecessor->setBranch(block->getCondition(), block->getConditionLeft(),
+					block->getConditionRight(), successors[0], successors[1]);
+		} else if (successors.size() == 1) {
+			predecessor->setJump(successors[0]);
+		} else {
+			predecessor->setExit();
+		}
+		block->setExit();
+		merged++;
+	}
+	if (merged)
+		analyze();
+	return merged;
+}
+
+void ControlFlowGraph::print() {
+	for (BasicBlock *block : blocks) {
+		unsigned b = getIndex(block);
+		cout << "B" << b << ":";
+		if (b != 0)
+			cout << "  idom B" << immediateDominator[b];
+		Loop *loop = getLoopFor(block);
+		if (loop)
+			cout << "  loop B" << getIndex(loop->header) << " depth " << loop->depth;
+		// the phi operands follow the order of the predecessors
+		Instruction *first = block->getFirst();
+		if (first != 0 && first->getInstructionID() == MOVE
+				&& ((Move *) first)->getRightValue()->getInstructionID() == PHI) {
+			cout << "  preds";
+			for (BasicBlock *predecessor : block->getPredecessors())
+				cout << " B" << getIndex(predecessor);
+		}
+		cout << "\n";
+
+		for (Instruction *i = block->getFirst(); i != 0; i = i->getNext()) {
+			cout << "\t";
+			i->print();
+			cout << "\n";
+		}
+
+		const BasicBlock::BlockList &successors = block->getSuccessors();
+		cout << "\t";
+		if (block->isConditional()) {
+			static const char *names[] = { "<", "<=", "!=" };
+			cout << "if";
+			block->getConditionLeft()->print();
+			cout << " " << names[block->getCondition()];
+			block->getConditionRight()->print();
+			cout << " goto B" << getIndex(successors[0]) << " else B" << getIndex(successors[1]);
+		} else if (successors.size() == 1) {
+			cout << "goto B" << getIndex(successors[0]);
+		} else {
+			cout << "exit";
+		}
+		cout << "\n";
+	}
+}
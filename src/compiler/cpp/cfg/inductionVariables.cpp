@@ -0,0 +1,166 @@
+#include "cfg/inductionVariables.h"
+#include <unordered_set>
+#include <stdint.h>
+
+using namespace std;
+
+int InductionVariables::getDefinedSlot(Instruction *instruction) {
+	if (instruction->getInstructionID() != MOVE)
+		return -1;
+	return ((Move *) instruction)->getVariable()->getSlotNumber();
+}
+
+bool InductionVariables::getConstant(Instruction *operand, int &value) {
+	if (operand->getInstructionID() != CONSTANT)
+		return false;
+	value = ((Constant *) operand)->valueNumber();
+	return true;
+}
+
+void InductionVariables::countDefinitions(const Loop *loop, vector<unsigned> &definitions) {
+	definitions.clear();
+	for (BasicBlock *block : loop->blocks) {
+		for (Instruction *i = block->getFirst(); i != 0; i = i->getNext()) {
+			int slot = getDefinedSlot(i);
+			if (slot < 0)
+				continue;
+			if ((size_t) slot >= definitions.size())
+				definitions.resize(slot + 1, 0);
+			definitions[slot]++;
+		}
+	}
+}
+
+InductionVariables::InductionVariables(ControlFlowGraph &cfg, const Loop *loop) :
+		control(0), tripCount(-1) {
+	vector<unsigned> definitions;
+	countDefinitions(loop, definitions);
+
+	for (BasicBlock *block : loop->blocks) {
+		for (Instruction *i = block->getFirst(); i != 0; i = i->getNext()) {
+			int slot = getDefinedSlot(i);
+			if (slot < 0 || definitions[slot] != 1)
+				continue;
+
+			// variable <- variable + step, or step + variable
+			Instruction *rightValue = ((Move *) i)->getRightValue();
+			if (rightValue->getInstructionID() != ADD)
+				continue;
+			Instruction *operand0 = ((Add *) rightValue)->getOperand0();
+			Instruction *operand1 = ((Add *) rightValue)->getOperand1();
+			if (operand1->getInstructionID() == LOCALVARIABLE) {
+				Instruction *temp = operand0;
+				operand0 = operand1;
+				operand1 = temp;
+			}
+			int step;
+			if (operand0->getInstructionID() != LOCALVARIABLE
+					|| ((LocalVariable *) operand0)->getSlotNumber() != slot
+					|| !getConstant(operand1, step))
+				continue;
+
+			InductionVariable variable;
+			variable.slot = slot;
+			variable.step = step;
+			variable.update = (Move *) i;
+			variable.updateBlock = block;
+			variable.hasInitialValue = false;
+			variable.initialValue = 0;
+			findInitialValue(cfg, loop, variable);
+			variables.push_back(variable);
+		}
+	}
+
+	computeTripCount(cfg, loop);
+}
+
+const InductionVariable * InductionVariables::find(int slot) const {
+	for (const InductionVariable &variable : variables) {
+		if (variable.slot == slot)
+			return &variable;
+	}
+	return 0;
+}
+
+bool InductionVariables::findInitialValue(ControlFlowGraph &cfg, const Loop *loop,
+		InductionVariable &variable) {
+	// the last assignment on the single path of blocks entering the loop
+	BasicBlock *block = cfg.getPreheader(loop);
+	unordered_set<BasicBlock *> visited;
+	while (block != 0 && visited.insert(block).second) {
+		for (Instruction *i = block->getLast(); i != 0; i = i->getPrevious()) {
+			if (getDefinedSlot(i) != variable.slot)
+				continue;
+			int value;
+			if (!getConstant(((Move *) i)->getRightValue(), value))
+				return false;
+			variable.hasInitialValue = true;
+			variable.initialValue = value;
+			return true;
+		}
+		if (block->getPredecessors().size() != 1)
+			return false;
+		block = block->getPredecessors()[0];
+	}
+	return false;
+}
+
+void InductionVariables::computeTripCount(ControlFlowGraph &cfg, const Loop *loop) {
+	BasicBlock *header = loop->header;
+	if (loop->exiting.size() != 1 || loop->exiting[0] != header || !header->isConditional())
+		return;
+
+	// the branch stays in the loop while the condition holds
+	if (!loop->contains(header->getSuccessors()[0]) || loop->contains(header->getSuccessors()[1]))
+		return;
+
+	Instruction *left = header->getConditionLeft()->resolve();
+	int bound;
+	if (left->getInstructionID() != LOCALVARIABLE || !getConstant(header->getConditionRight()->resolve(), bound))
+		return;
+	const InductionVariable *variable = find(((LocalVariable *) left)->getSlotNumber());
+	if (variable == 0 || !variable->hasInitialValue || variable->updateBlock == header
+			|| cfg.getLoopFor(variable->updateBlock) != loop)
+		return;
+
+	// the header tests the value on entry to each iteration, so the update
+	// must run once on every path back to it, outside of inner loops
+	for (BasicBlock *latch : loop->latches) {
+		if (!cfg.dominates(variable->updateBlock, latch))
+			return;
+	}
+
+	long long initial = variable->initialValue;
+	long long step = variable->step;
+	long long count = -1;
+	switch (header->getCondition()) {
+
+	case BRANCH_LESS:
+		if (initial >= bound)
+			count = 0;
+		else if (step > 0)
+			count = (bound - initial + step - 1) / step;
+		break;
+
+	case BRANCH_LESS_EQUAL:
+		if (initial > bound)
+			count = 0;
+		else if (step > 0)
+			count = (bound - initial) / step + 1;
+		break;
+
+	case BRANCH_NOT_EQUAL:
+		if (initial == bound)
+			count = 0;
+		else if (step != 0 && (bound - initial) % step == 0 && (bound - initial) / step > 0)
+			count = (bound - initial) / step;
+		break;
+	}
+
+	// the variable must not wrap around before the loop exits
+	long long last = initial + step * count;
+	if (count < 0 || last > INT32_MAX || last < INT32_MIN)
+		return;
+	tripCount = count;
+	control = variable;
+}
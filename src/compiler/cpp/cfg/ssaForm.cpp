@@ -0,0 +1,263 @@
+#include "cfg/ssaForm.h"
+
+using namespace std;
+
+void SSAForm::computeDominanceFrontiers(const ControlFlowGraph &cfg, vector<vector<BasicBlock *> > &frontiers) {
+	// a join point is in the frontier of the blocks from each of its
+	// predecessors up to (excluding) its immediate dominator
+	const vector<BasicBlock *> &blocks = cfg.getBlocks();
+	frontiers.assign(blocks.size(), vector<BasicBlock *>());
+	for (BasicBlock *block : blocks) {
+		if (block->getPredecessors().size() < 2)
+			continue;
+		BasicBlock *dominator = cfg.getImmediateDominator(block);
+		for (BasicBlock *predecessor : block->getPredecessors()) {
+			if (!cfg.isReachable(predecessor))
+				continue;
+			for (BasicBlock *runner = predecessor; runner != dominator; runner = cfg.getImmediateDominator(runner)) {
+				vector<BasicBlock *> &frontier = frontiers[cfg.getIndex(runner)];
+				if (frontier.empty() || frontier.back() != block)
+					frontier.push_back(block);
+			}
+		}
+	}
+}
+
+LocalVariable * SSAForm::newVersion(LocalVariable *origin, unsigned version) {
+	versions++;
+	return cfg.create<LocalVariable>(nextSlot++, origin, version);
+}
+
+unsigned SSAForm::construct() {
+	// the entry must not be a join point: it would need a phi with no
+	// edge for the values on entry
+	if (!cfg.getEntry()->getPredecessors().empty()) {
+		BasicBlock *entry = cfg.createBlock();
+		entry->setJump(cfg.getEntry());
+		cfg.setEntry(entry);
+		cfg.analyze();
+	}
+	cfg.splitCriticalEdges();
+
+	// one source variable per slot; versions get slots after all of them
+	vector<LocalVariable *> variables;
+	auto record = [&variables](Instruction *operand) {
+		if (operand->getInstructionID() == LOCALVARIABLE) {
+			LocalVariable *variable = (LocalVariable *) operand;
+			size_t slot = variable->getSlotNumber();
+			if (slot >= variables.size())
+				variables.resize(slot + 1, 0);
+			if (variables[slot] == 0)
+				variables[slot] = variable;
+		}
+		return operand;
+	};
+	for (BasicBlock *block : cfg.getBlocks()) {
+		for (Instruction *i = block->getFirst(); i != 0; i = i->getNext()) {
+			if (i->getInstructionID() == LOCALVARIABLE)
+				record(i);
+			else if (i->getInstructionID() == MOVE)
+				record(((Move *) i)->getVariable());
+			rewriteOperands(i, record);
+		}
+		if (block->isConditional()) {
+			record(block->getConditionLeft()->resolve());
+			record(block->getConditionRight()->resolve());
+		}
+	}
+	nextSlot = variables.size();
+
+	unsigned before = phis;
+	placePhis(variables);
+	rename(variables);
+	return phis - before;
+}
+
+void SSAForm::placePhis(vector<LocalVariable *> &variables) {
+	const vector<BasicBlock *> &blocks = cfg.getBlocks();
+	size_t numberOfSlots = variables.size();
+
+	// the blocks assigning each slot, and the slots read before being
+	// assigned in some block: only those can need a phi
+	vector<vector<BasicBlock *> > definitions(numberOfSlots);
+	vector<bool> global(numberOfSlots, false);
+	vector<unsigned> assignedIn(numberOfSlots, (unsigned) -1);
+	for (unsigned b = 0; b < blocks.size(); b++) {
+		auto read = [&](Instruction *operand) {
+			if (operand->getInstructionID() == LOCALVARIABLE) {
+				int slot = ((LocalVariable *) operand)->getSlotNumber();
+				if (assignedIn[slot] != b)
+					global[slot] = true;
+			}
+			return operand;
+		};
+		for (Instruction *i = blocks[b]->getFirst(); i != 0; i = i->getNext()) {
+			rewriteOperands(i, read);
+			if (i->getInstructionID() != MOVE)
+				continue;
+			int slot = ((Move *) i)->getVariable()->getSlotNumber();
+			if (assignedIn[slot] != b) {
+				assignedIn[slot] = b;
+				definitions[slot].push_back(blocks[b]);
+			}
+		}
+		if (blocks[b]->isConditional()) {
+			read(blocks[b]->getConditionLeft()->resolve());
+			read(blocks[b]->getConditionRight()->resolve());
+		}
+	}
+
+	vector<vector<BasicBlock *> > frontiers;
+	computeDominanceFrontiers(cfg, frontiers);
+
+	// iterated dominance frontier of the assignments of each global slot
+	Arena *arena = cfg.getContext() ? &cfg.getContext()->getArena() : 0;
+	vector<int> hasPhi(blocks.size(), -1);
+	vector<int> queued(blocks.size(), -1);
+	vector<BasicBlock *> worklist;
+	for (size_t slot = 0; slot < numberOfSlots; slot++) {
+		if (!global[slot] || definitions[slot].empty())
+			continue;
+		worklist = definitions[slot];
+		for (BasicBlock *block : worklist)
+			queued[cfg.getIndex(block)] = slot;
+		while (!worklist.empty()) {
+			BasicBlock *block = worklist.back();
+			worklist.pop_back();
+			for (BasicBlock *join : frontiers[cfg.getIndex(block)]) {
+				unsigned j = cfg.getIndex(join);
+				if (hasPhi[j] == (int) slot)
+					continue;
+				hasPhi[j] = slot;
+				LocalVariable *variable = variables[slot];
+				Phi *phi = cfg.create<Phi>(join->getPredecessors().size(), variable, arena);
+				join->prepend(cfg.createListed<Move>(variable, phi));
+				phis++;
+				if (queued[j] != (int) slot) {
+					queued[j] = slot;
+					worklist.push_back(join);
+				}
+			}
+		}
+	}
+}
+
+void SSAForm::rename(const vector<LocalVariable *> &variables) {
+	// current version of each source slot while walking the dominator tree
+	size_t numberOfSlots = variables.size();
+	vector<vector<Instruction *> > current(numberOfSlots);
+	vector<unsigned> counters(numberOfSlots, 0);
+	vector<int> log;   // slots pushed, popped when leaving a block
+
+	auto top = [&](Instruction *operand) -> Instruction * {
+		if (operand->getInstructionID() != LOCALVARIABLE)
+			return operand;
+		size_t slot = ((LocalVariable *) operand)->getOrigin()->getSlotNumber();
+		if (slot >= numberOfSlots || current[slot].empty())
+			return operand;
+		return current[slot].back();
+	};
+
+	struct Frame {
+		BasicBlock *block;
+		size_t child;
+		size_t logSize;
+	};
+	vector<Frame> stack;
+	stack.push_back(Frame { cfg.getEntry(), 0, 0 });
+	bool entering = true;
+	while (!stack.empty()) {
+		Frame &frame = stack.back();
+		BasicBlock *block = frame.block;
+
+		if (entering) {
+			frame.logSize = log.size();
+			for (Instruction *i = block->getFirst(); i != 0; i = i->getNext()) {
+				// the phi operands are set from the predecessors
+				if (!isPhi(i))
+					rewriteOperands(i, top);
+				if (i->getInstructionID() != MOVE)
+					continue;
+				Move *move = (Move *) i;
+				LocalVariable *origin = move->getVariable()->getOrigin();
+				int slot = origin->getSlotNumber();
+				LocalVariable *version = newVersion(origin, ++counters[slot]);
+				move->setVariable(version);
+				current[slot].push_back(version);
+				log.push_back(slot);
+			}
+			if (block->isConditional()) {
+				block->setConditionOperands(top(block->getConditionLeft()->resolve()),
+						top(block->getConditionRight()->resolve()));
+			}
+
+			// the phi operands for the edges leaving the block
+			for (BasicBlock *successor : block->getSuccessors()) {
+				const BasicBlock::BlockList &predecessors = successor->getPredecessors();
+				for (size_t j = 0; j < predecessors.size(); j++) {
+					if (predecessors[j] != block)
+						continue;
+					for (Instruction *i = successor->getFirst(); i != 0 && isPhi(i); i = i->getNext()) {
+						Move *move = (Move *) i;
+						Phi *phi = (Phi *) move->getRightValue();
+						phi->setOperand(j, top(move->getVariable()->getOrigin()));
+					}
+				}
+			}
+		}
+
+		const vector<BasicBlock *> &children = cfg.getDominatorChildren(block);
+		if (frame.child < children.size()) {
+			BasicBlock *child = children[frame.child++];
+			stack.push_back(Frame { child, 0, 0 });
+			entering = true;
+			continue;
+		}
+
+		while (log.size() > frame.logSize) {
+			current[log.back()].pop_back();
+			log.pop_back();
+		}
+		stack.pop_back();
+		entering = false;
+	}
+}
+
+unsigned SSAForm::destruct() {
+	// temporaries go after every slot in use
+	auto record = [this](Instruction *operand) {
+		if (operand->getInstructionID() == LOCALVARIABLE)
+			nextSlot = max(nextSlot, ((LocalVariable *) operand)->getSlotNumber() + 1);
+		return operand;
+	};
+	for (BasicBlock *block : cfg.getBlocks()) {
+		for (Instruction *i = block->getFirst(); i != 0; i = i->getNext()) {
+			if (i->getInstructionID() == MOVE)
+				record(((Move *) i)->getVariable());
+			rewriteOperands(i, record);
+		}
+	}
+
+	unsigned copies = 0;
+	for (BasicBlock *block : cfg.getBlocks()) {
+		const BasicBlock::BlockList &predecessors = block->getPredecessors();
+		for (Instruction *i = block->getFirst(); i != 0 && isPhi(i); i = i->getNext()) {
+			Move *move = (Move *) i;
+			Phi *phi = (Phi *) move->getRightValue();
+
+			// t <- operand at the end of each predecessor, v <- t in place of the phi
+			LocalVariable *temporary = cfg.create<LocalVariable>(nextSlot++);
+			for (size_t j = 0; j < predecessors.size(); j++) {
+				bool seen = false;
+				for (size_t k = 0; k < j; k++)
+					seen = seen || predecessors[k] == predecessors[j];
+				if (seen)
+					continue;
+				predecessors[j]->append(cfg.createListed<Move>(temporary, phi->getOperand(j)));
+				copies++;
+			}
+			move->setRightValue(temporary);
+		}
+	}
+	return copies;
+}
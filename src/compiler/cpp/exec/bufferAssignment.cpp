@@ -0,0 +1,168 @@
+#include "exec/bufferAssignment.h"
+#include "ir/dag.h"
+#include <iostream>
+
+using namespace std;
+
+const uint32_t BufferAssignment::NO_BUFFER;
+
+BufferAssignment::BufferAssignment(const DAG &dag, const FlatDAG &flatDAG,
+		const unordered_set<LocalVariable *> &liveOut, size_t elementSize, bool updateExternal) :
+		dag(flatDAG), buffers(flatDAG.getNumberOfNodes(), NO_BUFFER),
+		inPlaceOperands(flatDAG.getNumberOfNodes(), FlatDAG::INVALID_NODE),
+		peakBytesBefore(0), peakBytesAfter(0), inPlaceUpdates(0) {
+	FlatDAG::NodeId numberOfNodes = flatDAG.getNumberOfNodes();
+
+	// a value dies at its last user in the schedule; live out values never die
+	vector<FlatDAG::NodeId> lastUse(numberOfNodes);
+	for (FlatDAG::NodeId n = 0; n < numberOfNodes; n++) {
+		lastUse[n] = n;
+		for (const FlatDAG::NodeId *p = flatDAG.predecessorsBegin(n); p != flatDAG.predecessorsEnd(n); ++p) {
+			if (*p > lastUse[n])
+				lastUse[n] = *p;
+		}
+	}
+	for (LocalVariable *variable : liveOut) {
+		Node *node = dag.getNode(variable);
+		if (node)
+			lastUse[flatDAG.getNodeId(node)] = numberOfNodes;
+	}
+
+	assign(lastUse, elementSize, updateExternal);
+}
+
+bool BufferAssignment::isElementwise(FlatDAG::NodeId n) const {
+	switch (dag.getLabel(n)) {
+
+	case ADD:
+	case FUSED:
+		return true;
+
+	case MUL: {
+		// a matrix product reads whole rows and columns of its operands
+		const FlatDAG::NodeId *operands = dag.successorsBegin(n);
+		return !dag.getNode(operands[0])->getShape().isMatrix()
+				|| !dag.getNode(operands[1])->getShape().isMatrix();
+	}
+
+	default:
+		return false;
+	}
+}
+
+void BufferAssignment::addOrderingEdges(FlatDAG::NodeId previous, FlatDAG::NodeId n, FlatDAG::NodeId except) {
+	// the readers of the previous value, or its producer when it has none
+	if (dag.numberOfPredecessors(previous) == 0) {
+		orderingEdges.push_back(make_pair(previous, n));
+		return;
+	}
+	for (const FlatDAG::NodeId *p = dag.predecessorsBegin(previous); p != dag.predecessorsEnd(previous); ++p) {
+		if (*p != except)
+			orderingEdges.push_back(make_pair(*p, n));
+	}
+}
+
+void BufferAssignment::assign(const vector<FlatDAG::NodeId> &lastUse, size_t elementSize, bool updateExternal) {
+	vector<uint32_t> freeBuffers;
+	vector<FlatDAG::NodeId> occupants;  // last node written to each buffer
+	vector<bool> isFree;
+
+	for (FlatDAG::NodeId n = 0; n < dag.getNumberOfNodes(); n++) {
+		// sparse values (opt/densityAnalysis.h) have storage of their own
+		const Shape &shape = dag.getNode(n)->getShape();
+		if (!shape.isMatrix() || dag.getNode(n)->isSparse())
+			continue;
+
+		uint64_t bytes = (uint64_t) shape.getRows() * shape.getColumns() * elementSize;
+		peakBytesBefore += bytes;
+		uint32_t buffer = NO_BUFFER;
+
+		if (dag.isLeaf(n)) {
+			// the caller provides the matrix of a variable leaf
+			buffer = bufferBytes.size();
+			bufferBytes.push_back(bytes);
+			external.push_back(true);
+			occupants.push_back(n);
+			isFree.push_back(false);
+			buffers[n] = buffer;
+			peakBytesAfter += bytes;
+			continue;
+		}
+
+		// update an operand dying here in place, the matrices of the caller
+		// only when it allows it
+		if (isElementwise(n)) {
+			for (const FlatDAG::NodeId *o = dag.successorsBegin(n); o != dag.successorsEnd(n); ++o) {
+				if (buffers[*o] != NO_BUFFER && lastUse[*o] == n && bufferBytes[buffers[*o]] >= bytes
+						&& (updateExternal || !external[buffers[*o]])) {
+					buffer = buffers[*o];
+					inPlaceOperands[n] = *o;
+					addOrderingEdges(*o, n, n);
+					inPlaceUpdates++;
+					break;
+				}
+			}
+		}
+
+		// otherwise, the smallest free buffer large enough
+		if (buffer == NO_BUFFER) {
+			unsigned best = freeBuffers.size();
+			for (unsigned i = 0; i < freeBuffers.size(); i++) {
+				uint64_t available = bufferBytes[freeBuffers[i]];
+				if (available >= bytes && (best == freeBuffers.size() || available < bufferBytes[freeBuffers[best]]))
+					best = i;
+			}
+			if (best != freeBuffers.size()) {
+				buffer = freeBuffers[best];
+				freeBuffers[best] = freeBuffers.back();
+				freeBuffers.pop_back();
+				isFree[buffer] = false;
+				addOrderingEdges(occupants[buffer], n, FlatDAG::INVALID_NODE);
+			}
+		}
+
+		// or a new one
+		if (buffer == NO_BUFFER) {
+			buffer = bufferBytes.size();
+			bufferBytes.push_back(bytes);
+			external.push_back(false);
+			occupants.push_back(n);
+			isFree.push_back(false);
+			peakBytesAfter += bytes;
+		}
+
+		buffers[n] = buffer;
+		occupants[buffer] = n;
+
+		// the buffers of the values dying here can be reused by the next nodes
+		for (const FlatDAG::NodeId *o = dag.successorsBegin(n); o != dag.successorsEnd(n); ++o) {
+			uint32_t operandBuffer = buffers[*o];
+			// 'a + a' releases the buffer of 'a' once
+			if (operandBuffer == NO_BUFFER || lastUse[*o] != n || operandBuffer == buffer
+					|| external[operandBuffer] || isFree[operandBuffer])
+				continue;
+			isFree[operandBuffer] = true;
+			freeBuffers.push_back(operandBuffer);
+		}
+		// a value nobody reads
+		if (lastUse[n] == n && !external[buffer]) {
+			isFree[buffer] = true;
+			freeBuffers.push_back(buffer);
+		}
+	}
+}
+
+void BufferAssignment::print() const {
+	cout << "Buffers: " << bufferBytes.size() << ", in-place updates: " << inPlaceUpdates
+			<< ", peak bytes: " << peakBytesBefore << " -> " << peakBytesAfter << endl;
+	for (FlatDAG::NodeId n = 0; n < dag.getNumberOfNodes(); n++) {
+		if (buffers[n] == NO_BUFFER)
+			continue;
+		cout << n << ": buffer " << buffers[n];
+		if (external[buffers[n]])
+			cout << " (external)";
+		if (inPlaceOperands[n] != FlatDAG::INVALID_NODE)
+			cout << " in place of " << inPlaceOperands[n];
+		cout << endl;
+	}
+}
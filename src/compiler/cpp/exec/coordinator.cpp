@@ -0,0 +1,390 @@
+#include "exec/coordinator.h"
+#include "io/asyncLoader.h"
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+#include <deque>
+#include <condition_variable>
+#include <stdexcept>
+
+using namespace std;
+
+// Messages between the coordinator and the workers
+enum CoordinatorMessage {
+	VALUE_MESSAGE,    // value of a node: a scalar, a matrix or nothing (effects)
+	DONE_MESSAGE,     // the worker evaluated all its nodes
+	ERROR_MESSAGE     // the worker failed, with the error as text
+};
+
+struct Coordinator::Worker {
+	pid_t                     pid;
+	unique_ptr<Transport>     transport;   // to the worker process
+	thread                    receiver;
+	thread                    sender;
+
+	mutex                     lock;        // of the fields below
+	condition_variable        queued;
+	deque<TransportMessage>   outbox;      // values forwarded to the worker
+	bool                      closed;      // nothing more to forward
+	bool                      done;
+
+	Worker() : pid(-1), closed(false), done(false) {
+	}
+};
+
+static TransportMessage valueMessage(FlatDAG::NodeId n, const RuntimeValue &value) {
+	TransportMessage message(VALUE_MESSAGE, n);
+	message.hasScalar = value.isScalar();
+	message.scalar = value.getScalar();
+	// the transports carry dense matrices
+	message.matrix = value.isSparse() ? value.getSparse().toDense() : value.getMatrix();
+	return message;
+}
+
+static RuntimeValue messageValue(const TransportMessage &message) {
+	if (message.hasScalar)
+		return RuntimeValue(message.scalar);
+	if (message.matrix.isEmpty())
+		return RuntimeValue();
+	return RuntimeValue(message.matrix);
+}
+
+Coordinator::Coordinator(const DAGPartitioning &dagPartitioning, TransportKind transportKind) :
+		partitioning(dagPartitioning), dag(dagPartitioning.getFlatDAG()), kind(transportKind), evaluator(dag),
+		store(0), bytesTransferred(0), bytesShared(0) {
+}
+
+Coordinator::~Coordinator() {
+}
+
+void Coordinator::setError(const string &message) {
+	{
+		lock_guard<mutex> guard(errorLock);
+		if (!error.empty())
+			return;
+		error = message;
+	}
+	// the workers waiting for values get the end of the connection and stop
+	for (unique_ptr<Worker> &worker : workers)
+		worker->transport->shutdownSend();
+}
+
+void Coordinator::run() {
+	error.clear();
+	blocks.clear();
+	bytesTransferred = 0;
+	bytesShared = 0;
+	partials.resize(dag.getNumberOfNodes());
+	for (FlatDAG::NodeId n = 0; n < dag.getNumberOfNodes(); n++)
+		partials[n] = RowSplit::getIdentity(dag.getLabel(n));
+
+	bool rowBlocks = partitioning.getStrategy() == DAGPartitioning::ROW_BLOCKS;
+	if (rowBlocks)
+		evaluateBeforeSplit();
+
+	startWorkers();
+	stopWorkers();
+	if (!error.empty())
+		throw runtime_error(error);
+
+	if (rowBlocks) {
+		evaluateAfterSplit();
+	} else {
+		// the workers evaluate the replicated leaves for themselves only
+		for (FlatDAG::NodeId n = 0; n < dag.getNumberOfNodes(); n++) {
+			if (partitioning.isLiveOut(n) && partitioning.getWorker(n) == DAGPartitioning::ALL_WORKERS)
+				evaluator.evaluate(n);
+		}
+	}
+}
+
+void Coordinator::evaluateBeforeSplit() {
+	const RowSplit &split = partitioning.getRowSplit();
+	{
+		// the workers are forked without the I/O threads of the loader
+		unique_ptr<AsyncLoader> loader;
+		if (store != 0)
+			loader.reset(new AsyncLoader(*store));
+		evaluator.setLoader(loader.get());
+		try {
+			for (FlatDAG::NodeId n = 0; n < dag.getNumberOfNodes(); n++) {
+				if (split.getPhase(n) == RowSplit::BEFORE_SPLIT || partitioning.isSplitLeaf(n))
+					evaluator.evaluate(n);
+			}
+		} catch (...) {
+			evaluator.setLoader(0);
+			throw;
+		}
+		evaluator.setLoader(0);
+	}
+
+	split.checkWholeOperands(dag, evaluator);
+	for (FlatDAG::NodeId n = 0; n < dag.getNumberOfNodes(); n++) {
+		if (!partitioning.isSplitLeaf(n))
+			continue;
+		const RuntimeValue &value = evaluator.getValue(n);
+		if (!value.isMatrix() || value.getMatrix().getRows() != partitioning.getRows())
+			RowSplit::error(dag, n, "does not have the rows of the partitioning");
+	}
+}
+
+void Coordinator::evaluateAfterSplit() {
+	const RowSplit &split = partitioning.getRowSplit();
+	for (FlatDAG::NodeId n = 0; n < dag.getNumberOfNodes(); n++) {
+		if (split.getPhase(n) == RowSplit::PARTIAL) {
+			evaluator.setValue(n, RuntimeValue(partials[n]));
+		} else if (split.getPhase(n) == RowSplit::AFTER_SPLIT) {
+			evaluator.evaluate(n);
+		} else if (blocks.count(n)) {
+			blocks[n]->finish();
+			evaluator.setValue(n, RuntimeValue(blocks[n]->getMatrix()));
+		}
+	}
+}
+
+void Coordinator::startWorkers() {
+	// a worker would write the buffered output again
+	cout.flush();
+	fflush(stdout);
+
+	workers.clear();
+	for (unsigned w = 0; w < partitioning.getNumberOfWorkers(); w++) {
+		unique_ptr<Worker> worker(new Worker);
+		unique_ptr<Transport> workerEnd;
+		try {
+			createTransportPair(kind, worker->transport, workerEnd);
+		} catch (const exception &e) {
+			setError(e.what());
+			break;
+		}
+
+		pid_t pid = fork();
+		if (pid < 0) {
+			setError(string("cannot start worker: ") + strerror(errno));
+			break;
+		}
+		if (pid == 0) {
+			// the worker keeps its end of the connection only
+			for (unique_ptr<Worker> &other : workers)
+				other->transport.reset();
+			worker->transport.reset();
+			int status = runWorker(w, *workerEnd);
+			workerEnd.reset();
+			cout.flush();
+			fflush(stdout);
+			_exit(status);
+		}
+		worker->pid = pid;
+		workers.push_back(move(worker));
+	}
+
+	// threads only once every worker is forked
+	bool forwarding = partitioning.getStrategy() == DAGPartitioning::COMMUNICATION_AWARE;
+	for (unsigned w = 0; w < workers.size(); w++) {
+		workers[w]->receiver = thread(&Coordinator::receive, this, w);
+		if (forwarding)
+			workers[w]->sender = thread(&Coordinator::forward, this, w);
+	}
+}
+
+void Coordinator::stopWorkers() {
+	for (unique_ptr<Worker> &worker : workers) {
+		if (worker->receiver.joinable())
+			worker->receiver.join();
+	}
+	for (unique_ptr<Worker> &worker : workers) {
+		{
+			lock_guard<mutex> guard(worker->lock);
+			worker->closed = true;
+		}
+		worker->queued.notify_all();
+		if (worker->sender.joinable())
+			worker->sender.join();
+	}
+
+	for (unsigned w = 0; w < workers.size(); w++) {
+		bytesTransferred += workers[w]->transport->getBytesSent() + workers[w]->transport->getBytesReceived();
+		bytesShared += workers[w]->transport->getBytesShared();
+		if (!error.empty())
+			kill(workers[w]->pid, SIGKILL);
+		int status = 0;
+		while (waitpid(workers[w]->pid, &status, 0) < 0 && errno == EINTR)
+			;
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			setError("worker " + to_string(w) + " failed");
+	}
+	workers.clear();
+}
+
+int Coordinator::runWorker(unsigned w, Transport &transport) {
+	try {
+		if (partitioning.getStrategy() == DAGPartitioning::ROW_BLOCKS)
+			evaluateRows(w, transport);
+		else
+			evaluateNodes(w, transport);
+		transport.send(TransportMessage(DONE_MESSAGE));
+		return 0;
+	} catch (const exception &e) {
+		TransportMessage message(ERROR_MESSAGE);
+		message.text = e.what();
+		try {
+			transport.send(message);
+		} catch (const exception &) {
+			// the coordinator is gone
+		}
+		return 1;
+	}
+}
+
+void Coordinator::evaluateNodes(unsigned w, Transport &transport) {
+	unique_ptr<AsyncLoader> loader;
+	if (store != 0)
+		loader.reset(new AsyncLoader(*store));
+	evaluator.setLoader(loader.get());
+
+	vector<bool> available(dag.getNumberOfNodes(), false);
+	TransportMessage message;
+	for (FlatDAG::NodeId n = 0; n < dag.getNumberOfNodes(); n++) {
+		if (partitioning.getWorker(n) != w)
+			continue;
+
+		for (const FlatDAG::NodeId *operand = dag.successorsBegin(n); operand != dag.successorsEnd(n); operand++) {
+			if (available[*operand])
+				continue;
+			if (partitioning.getWorker(*operand) == DAGPartitioning::ALL_WORKERS) {
+				evaluator.evaluate(*operand);
+				available[*operand] = true;
+				continue;
+			}
+			// the values arrive in the order the other workers computed them
+			while (!available[*operand]) {
+				if (!transport.receive(message))
+					throw runtime_error("the coordinator closed the connection");
+				if (message.type != VALUE_MESSAGE || message.node >= dag.getNumberOfNodes())
+					throw runtime_error("unexpected message from the coordinator");
+				evaluator.setValue(message.node, messageValue(message));
+				available[message.node] = true;
+			}
+		}
+
+		evaluator.evaluate(n);
+		available[n] = true;
+		if (partitioning.isLiveOut(n) || !partitioning.getConsumers(n).empty())
+			transport.send(valueMessage(n, evaluator.getValue(n)));
+	}
+}
+
+void Coordinator::evaluateRows(unsigned w, Transport &transport) {
+	const RowSplit &split = partitioning.getRowSplit();
+	size_t firstRow = partitioning.getFirstRow(w);
+	size_t rows = partitioning.getFirstRow(w + 1) - firstRow;
+	if (rows == 0)
+		return;
+
+	// the split leaves were evaluated whole before the fork
+	for (FlatDAG::NodeId n = 0; n < dag.getNumberOfNodes(); n++) {
+		if (!partitioning.isSplitLeaf(n))
+			continue;
+		Matrix block;
+		MatrixTileSource(evaluator.getValue(n).getMatrix()).read(firstRow, rows, block);
+		evaluator.setValue(n, RuntimeValue(block));
+	}
+
+	for (FlatDAG::NodeId n = 0; n < dag.getNumberOfNodes(); n++) {
+		if ((split.getPhase(n) == RowSplit::SPLIT && !dag.isLeaf(n)) || split.getPhase(n) == RowSplit::PARTIAL)
+			evaluator.evaluate(n);
+	}
+
+	for (FlatDAG::NodeId n = 0; n < dag.getNumberOfNodes(); n++) {
+		if (split.getPhase(n) == RowSplit::PARTIAL) {
+			transport.send(valueMessage(n, evaluator.getValue(n)));
+		} else if (split.getPhase(n) == RowSplit::SPLIT && !dag.isLeaf(n) && partitioning.isLiveOut(n)) {
+			if (!evaluator.getValue(n).isMatrix())
+				RowSplit::error(dag, n, "the live out value of a split node is not a matrix");
+			transport.send(valueMessage(n, evaluator.getValue(n)));
+		}
+	}
+}
+
+void Coordinator::receive(unsigned w) {
+	Worker &worker = *workers[w];
+	TransportMessage message;
+	try {
+		while (worker.transport->receive(message)) {
+			if (message.type == DONE_MESSAGE) {
+				lock_guard<mutex> guard(worker.lock);
+				worker.done = true;
+			} else if (message.type == ERROR_MESSAGE) {
+				setError("worker " + to_string(w) + ": " + message.text);
+			} else if (message.type == VALUE_MESSAGE && message.node < dag.getNumberOfNodes()) {
+				receiveValue(w, message);
+			} else {
+				setError("unexpected message from worker " + to_string(w));
+			}
+		}
+	} catch (const exception &e) {
+		setError("worker " + to_string(w) + ": " + e.what());
+	}
+
+	lock_guard<mutex> guard(worker.lock);
+	if (!worker.done)
+		setError("worker " + to_string(w) + " stopped before finishing");
+}
+
+void Coordinator::receiveValue(unsigned w, const TransportMessage &message) {
+	FlatDAG::NodeId n = message.node;
+	if (partitioning.getStrategy() == DAGPartitioning::ROW_BLOCKS) {
+		lock_guard<mutex> guard(valuesLock);
+		if (message.hasScalar) {
+			partials[n] = RowSplit::combine(dag.getLabel(n), partials[n], message.scalar);
+			return;
+		}
+		unique_ptr<MatrixTileSink> &result = blocks[n];
+		if (!result)
+			result.reset(new MatrixTileSink(message.matrix.getType(), partitioning.getRows(), message.matrix.getColumns()));
+		result->write(partitioning.getFirstRow(w), message.matrix);
+		return;
+	}
+
+	if (partitioning.isLiveOut(n)) {
+		lock_guard<mutex> guard(valuesLock);
+		evaluator.setValue(n, messageValue(message));
+	}
+	for (unsigned consumer : partitioning.getConsumers(n)) {
+		Worker &target = *workers[consumer];
+		{
+			lock_guard<mutex> guard(target.lock);
+			target.outbox.push_back(message);
+		}
+		target.queued.notify_one();
+	}
+}
+
+void Coordinator::forward(unsigned w) {
+	Worker &worker = *workers[w];
+	for (;;) {
+		TransportMessage message;
+		{
+			unique_lock<mutex> guard(worker.lock);
+			worker.queued.wait(guard, [&worker]() {
+				return worker.closed || !worker.outbox.empty();
+			});
+			if (worker.outbox.empty())
+				return;
+			message = move(worker.outbox.front());
+			worker.outbox.pop_front();
+		}
+		try {
+			worker.transport->send(message);
+		} catch (const exception &e) {
+			setError("worker " + to_string(w) + ": " + e.what());
+			return;
+		}
+	}
+}
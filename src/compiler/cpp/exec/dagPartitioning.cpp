@@ -0,0 +1,261 @@
+#include "exec/dagPartitioning.h"
+#include "ir/dag.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <iostream>
+
+using namespace std;
+
+const unsigned DAGPartitioning::ALL_WORKERS;
+
+DAGPartitioning::DAGPartitioning(const DAG &dag, const FlatDAG &flatDAG, const unordered_set<LocalVariable *> &liveOut,
+		unsigned numberOfWorkers, Strategy partitionStrategy, const PartitionCosts &partitionCosts) :
+		dag(flatDAG), workers(numberOfWorkers), costs(partitionCosts), strategy(partitionStrategy),
+		liveOutNodes(flatDAG.getNumberOfNodes(), false), owners(flatDAG.getNumberOfNodes(), ALL_WORKERS),
+		consumers(flatDAG.getNumberOfNodes()), splitLeaves(flatDAG.getNumberOfNodes(), false), rows(0),
+		makespan(0), transferBytes(0), workerSeconds(numberOfWorkers, 0) {
+	if (workers == 0)
+		throw invalid_argument("a partitioning needs at least one worker");
+	for (LocalVariable *variable : liveOut) {
+		Node *node = dag.getNode(variable);
+		if (node)
+			liveOutNodes[flatDAG.getNodeId(node)] = true;
+	}
+
+	switch (strategy) {
+	case COMMUNICATION_AWARE:
+		assignNodes();
+		break;
+	case ROW_BLOCKS:
+		if (!splitRows())
+			throw runtime_error("the DAG cannot be split into blocks of rows");
+		break;
+	case AUTOMATIC: {
+		assignNodes();
+		double nodesMakespan = makespan;
+		uint64_t nodesBytes = transferBytes;
+		vector<double> nodesSeconds = workerSeconds;
+		if (splitRows() && makespan <= nodesMakespan) {
+			strategy = ROW_BLOCKS;
+		} else {
+			strategy = COMMUNICATION_AWARE;
+			makespan = nodesMakespan;
+			transferBytes = nodesBytes;
+			workerSeconds = nodesSeconds;
+		}
+		break;
+	}
+	}
+}
+
+uint64_t DAGPartitioning::getElements(FlatDAG::NodeId n) const {
+	const Shape &shape = dag.getNode(n)->getShape();
+	if (shape.isMatrix())
+		return (uint64_t) shape.getRows() * shape.getColumns();
+	return shape.isScalar() ? 1 : costs.unknownElements;
+}
+
+double DAGPartitioning::getComputeSeconds(FlatDAG::NodeId n) const {
+	if (dag.isLeaf(n)) {
+		if (dag.getLabel(n) == LOAD)
+			return getElements(n) * costs.elementSize / costs.loadBytesPerSecond;
+		return 0;
+	}
+
+	uint64_t elements = 0;
+	for (const FlatDAG::NodeId *operand = dag.successorsBegin(n); operand != dag.successorsEnd(n); operand++)
+		elements = max(elements, getElements(*operand));
+
+	double flops;
+	switch (dag.getLabel(n)) {
+	case MUL: {
+		const Shape &left = dag.getNode(dag.successorsBegin(n)[0])->getShape();
+		const Shape &right = dag.getNode(dag.successorsBegin(n)[1])->getShape();
+		if (left.isMatrix() && right.isMatrix())
+			flops = 2.0 * left.getRows() * left.getColumns() * right.getColumns();
+		else
+			flops = elements;
+		break;
+	}
+	case DOT:
+		flops = 2.0 * elements;
+		break;
+	case FUSED:
+		flops = (double) elements * ((FusedNode *) dag.getNode(n))->getProgram().size();
+		break;
+	case PRINT:
+	case CALL:
+		flops = 0;
+		break;
+	default:
+		flops = elements;
+		break;
+	}
+	return flops / costs.flopsPerSecond;
+}
+
+double DAGPartitioning::getTransferSeconds(FlatDAG::NodeId n) const {
+	return costs.latency + getElements(n) * costs.elementSize / costs.bytesPerSecond;
+}
+
+bool DAGPartitioning::isReplicated(FlatDAG::NodeId n) const {
+	// cheaper to evaluate again than to transfer
+	return dag.isLeaf(n) && dag.getLabel(n) != LOAD;
+}
+
+void DAGPartitioning::assignNodes() {
+	vector<double> finish(dag.getNumberOfNodes(), 0);
+	vector<double> ready(workers, 0);
+	makespan = 0;
+	transferBytes = 0;
+	fill(workerSeconds.begin(), workerSeconds.end(), 0);
+
+	for (FlatDAG::NodeId n = 0; n < dag.getNumberOfNodes(); n++) {
+		owners[n] = ALL_WORKERS;
+		consumers[n].clear();
+		if (isReplicated(n))
+			continue;
+
+		// the worker where n would finish first; the effects stay in order on worker 0
+		bool effect = dag.getLabel(n) == PRINT || dag.getLabel(n) == CALL;
+		double seconds = getComputeSeconds(n);
+		unsigned best = 0;
+		double bestFinish = numeric_limits<double>::infinity();
+		for (unsigned w = 0; w < (effect ? 1 : workers); w++) {
+			double start = ready[w];
+			for (const FlatDAG::NodeId *operand = dag.successorsBegin(n); operand != dag.successorsEnd(n); operand++) {
+				if (isReplicated(*operand))
+					continue;
+				double arrival = finish[*operand];
+				if (owners[*operand] != w)
+					arrival += getTransferSeconds(*operand);
+				start = max(start, arrival);
+			}
+			if (start + seconds < bestFinish) {
+				best = w;
+				bestFinish = start + seconds;
+			}
+		}
+
+		owners[n] = best;
+		finish[n] = bestFinish;
+		ready[best] = bestFinish;
+		workerSeconds[best] += seconds;
+		for (const FlatDAG::NodeId *operand = dag.successorsBegin(n); operand != dag.successorsEnd(n); operand++) {
+			vector<unsigned> &users = consumers[*operand];
+			if (isReplicated(*operand) || owners[*operand] == best || find(users.begin(), users.end(), best) != users.end())
+				continue;
+			users.push_back(best);
+			transferBytes += getElements(*operand) * costs.elementSize;
+		}
+	}
+
+	// the live out values go back to the coordinator
+	for (FlatDAG::NodeId n = 0; n < dag.getNumberOfNodes(); n++) {
+		makespan = max(makespan, finish[n]);
+		if (liveOutNodes[n] && !isReplicated(n)) {
+			makespan = max(makespan, finish[n] + getTransferSeconds(n));
+			transferBytes += getElements(n) * costs.elementSize;
+		}
+	}
+}
+
+bool DAGPartitioning::splitRows() {
+	// the matrix leaves used elementwise or as the left operand of a
+	// product, all with the same number of rows
+	fill(splitLeaves.begin(), splitLeaves.end(), false);
+	rows = 0;
+	bool found = false;
+	for (FlatDAG::NodeId n = 0; n < dag.getNumberOfNodes(); n++) {
+		Operator op = dag.getLabel(n);
+		if (op != ADD && op != MUL && op != FUSED && op != SUM && op != MIN && op != MAX && op != DOT)
+			continue;
+		const FlatDAG::NodeId *operands = dag.successorsBegin(n);
+		for (unsigned i = 0; i < dag.numberOfSuccessors(n); i++) {
+			if (!dag.isLeaf(operands[i]) || dag.getLabel(operands[i]) == CONSTANT)
+				continue;
+			const Shape &shape = dag.getNode(operands[i])->getShape();
+			if (!shape.isMatrix())
+				continue;
+			if (op == MUL && i == 1 && !dag.getNode(operands[0])->getShape().isScalar())
+				continue;
+			if (found && shape.getRows() != rows)
+				return false;
+			rows = shape.getRows();
+			found = true;
+			splitLeaves[operands[i]] = true;
+		}
+	}
+	if (!found)
+		return false;
+
+	try {
+		split = RowSplit(dag, splitLeaves);
+	} catch (const runtime_error &) {
+		return false;
+	}
+
+	// RowSplit::checkWholeOperands from the shapes: a whole matrix can only
+	// be the right operand of a product
+	double wholeSeconds = 0;
+	double splitSeconds = 0;
+	unsigned transfers = 0;
+	transferBytes = 0;
+	for (FlatDAG::NodeId n = 0; n < dag.getNumberOfNodes(); n++) {
+		RowSplit::Phase phase = split.getPhase(n);
+		if (phase == RowSplit::BEFORE_SPLIT || phase == RowSplit::AFTER_SPLIT) {
+			wholeSeconds += getComputeSeconds(n);
+			continue;
+		}
+		if (dag.isLeaf(n))
+			continue;
+
+		const FlatDAG::NodeId *operands = dag.successorsBegin(n);
+		for (unsigned i = 0; i < dag.numberOfSuccessors(n); i++) {
+			if (split.getPhase(operands[i]) == RowSplit::BEFORE_SPLIT && !dag.getNode(operands[i])->getShape().isScalar()
+					&& (dag.getLabel(n) != MUL || i != 1))
+				return false;
+		}
+		splitSeconds += getComputeSeconds(n);
+		if (phase == RowSplit::PARTIAL || liveOutNodes[n]) {
+			transfers++;
+			transferBytes += getElements(n) * costs.elementSize * (phase == RowSplit::PARTIAL ? workers : 1);
+		}
+	}
+
+	for (unsigned w = 0; w < workers; w++)
+		workerSeconds[w] = rows == 0 ? 0 : splitSeconds * (getFirstRow(w + 1) - getFirstRow(w)) / rows;
+	makespan = wholeSeconds + splitSeconds / workers + transfers * costs.latency
+			+ transferBytes / costs.bytesPerSecond;
+	return true;
+}
+
+void DAGPartitioning::print() const {
+	cout << "Partitioning: " << (strategy == ROW_BLOCKS ? "row blocks" : "communication aware") << " over "
+			<< workers << " workers, predicted " << makespan * 1e3 << " ms, " << transferBytes
+			<< " bytes transferred" << endl;
+	for (unsigned w = 0; w < workers; w++) {
+		cout << "worker " << w << ": ";
+		if (strategy == ROW_BLOCKS)
+			cout << "rows [" << getFirstRow(w) << ", " << getFirstRow(w + 1) << "), ";
+		cout << workerSeconds[w] * 1e3 << " ms" << endl;
+	}
+
+	static const char * const phaseNames[] = { "before split", "split", "partial", "after split" };
+	for (FlatDAG::NodeId n = 0; n < dag.getNumberOfNodes(); n++) {
+		cout << n << ": " << getOperatorName(dag.getLabel(n));
+		if (strategy == ROW_BLOCKS) {
+			cout << " " << phaseNames[split.getPhase(n)];
+		} else if (owners[n] == ALL_WORKERS) {
+			cout << " all workers";
+		} else {
+			cout << " worker " << owners[n];
+			for (unsigned i = 0; i < consumers[n].size(); i++)
+				cout << (i == 0 ? " -> " : ", ") << consumers[n][i];
+		}
+		if (liveOutNodes[n])
+			cout << " (live out)";
+		cout << endl;
+	}
+}
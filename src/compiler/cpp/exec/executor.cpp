@@ -0,0 +1,188 @@
+#include "exec/executor.h"
+#include "ir/dag.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+using namespace std;
+
+// Shared state of one DAG execution
+class Execution {
+public:
+	Execution(ThreadPool &threadPool, const FlatDAG &flatDAG, const Executor::NodeKernel &nodeKernel,
+			const Executor::OrderingEdges *ordering = 0, const Executor::AsyncKernel *startKernel = 0) :
+			pool(threadPool), dag(flatDAG), kernel(nodeKernel), asyncKernel(startKernel),
+			pendingOperands(new atomic<uint32_t>[flatDAG.getNumberOfNodes()]),
+			remaining(flatDAG.getNumberOfNodes()), failed(false), finished(false) {
+		for (FlatDAG::NodeId n = 0; n < dag.getNumberOfNodes(); n++)
+			pendingOperands[n] = dag.numberOfSuccessors(n);
+		if (ordering)
+			addOrdering(*ordering);
+	}
+
+	void run() {
+		if (dag.getNumberOfNodes() == 0)
+			return;
+
+		// collect the ready nodes first: the counts change once nodes run
+		vector<FlatDAG::NodeId> ready;
+		for (FlatDAG::NodeId n = 0; n < dag.getNumberOfNodes(); n++) {
+			if (pendingOperands[n] == 0)
+				ready.push_back(n);
+		}
+
+		// start the asynchronous nodes (e.g. loads) before any computation
+		if (asyncKernel) {
+			vector<FlatDAG::NodeId> compute;
+			for (FlatDAG::NodeId n : ready) {
+				if (!startAsync(n))
+					compute.push_back(n);
+			}
+			ready.swap(compute);
+		}
+		for (FlatDAG::NodeId n : ready)
+			dispatch(n);
+
+		unique_lock<mutex> guard(doneLock);
+		while (!finished)
+			done.wait(guard);
+
+		if (error)
+			rethrow_exception(error);
+	}
+
+private:
+	ThreadPool                       &pool;
+	const FlatDAG                    &dag;
+	const Executor::NodeKernel       &kernel;
+	const Executor::AsyncKernel      *asyncKernel;
+	unique_ptr<atomic<uint32_t>[]>   pendingOperands;
+	vector<uint32_t>                 orderingOffsets;  // CSR of the extra dependences, by 'before' node
+	vector<FlatDAG::NodeId>          orderingTargets;
+	atomic<unsigned>                 remaining;
+	atomic<bool>                     failed;
+	exception_ptr                    error;
+
+	mutex                            doneLock;
+	condition_variable               done;
+	bool                             finished;   // set with doneLock held, after the last node
+
+	void addOrdering(const Executor::OrderingEdges &ordering) {
+		orderingOffsets.assign(dag.getNumberOfNodes() + 1, 0);
+		for (const pair<FlatDAG::NodeId, FlatDAG::NodeId> &edge : ordering) {
+			orderingOffsets[edge.first + 1]++;
+			pendingOperands[edge.second]++;
+		}
+		for (FlatDAG::NodeId n = 0; n < dag.getNumberOfNodes(); n++)
+			orderingOffsets[n + 1] += orderingOffsets[n];
+
+		orderingTargets.resize(ordering.size());
+		vector<uint32_t> position(orderingOffsets.begin(), orderingOffsets.end() - 1);
+		for (const pair<FlatDAG::NodeId, FlatDAG::NodeId> &edge : ordering)
+			orderingTargets[position[edge.first]++] = edge.second;
+	}
+
+	// 'user' has one dependence less: the first user made ready is kept in
+	// 'next', the others are dispatched
+	void release(FlatDAG::NodeId user, FlatDAG::NodeId &next) {
+		if (--pendingOperands[user] == 0) {
+			if (next == FlatDAG::INVALID_NODE)
+				next = user;
+			else
+				dispatch(user);
+		}
+	}
+
+	void dispatch(FlatDAG::NodeId n) {
+		pool.submit([this, n]() { execute(n); });
+	}
+
+	void fail(exception_ptr exception) {
+		lock_guard<mutex> guard(doneLock);
+		if (!error)
+			error = exception;
+		failed = true;
+	}
+
+	// Starts node n with the asynchronous kernel, false if it runs as a normal node
+	bool startAsync(FlatDAG::NodeId n) {
+		if (failed)
+			return false;
+		try {
+			return (*asyncKernel)(n, [this, n](exception_ptr exception) {
+				if (exception)
+					fail(exception);
+				FlatDAG::NodeId next = complete(n);
+				if (next != FlatDAG::INVALID_NODE)
+					dispatch(next);
+			});
+		} catch (...) {
+			fail(current_exception());
+			return false;
+		}
+	}
+
+	// Releases the users of the finished node n, returns the first one made ready
+	FlatDAG::NodeId complete(FlatDAG::NodeId n) {
+		FlatDAG::NodeId next = FlatDAG::INVALID_NODE;
+		for (const FlatDAG::NodeId *p = dag.predecessorsBegin(n); p != dag.predecessorsEnd(n); ++p)
+			release(*p, next);
+		if (!orderingOffsets.empty()) {
+			for (uint32_t i = orderingOffsets[n]; i < orderingOffsets[n + 1]; i++)
+				release(orderingTargets[i], next);
+		}
+
+		if (--remaining == 0) {
+			// run() may return, and destroy this execution, as soon as the lock is released
+			lock_guard<mutex> guard(doneLock);
+			finished = true;
+			done.notify_all();
+		}
+		return next;
+	}
+
+	void execute(FlatDAG::NodeId n) {
+		while (true) {
+			if (asyncKernel && startAsync(n))
+				return;
+
+			if (!failed) {
+				try {
+					kernel(n);
+				} catch (...) {
+					fail(current_exception());
+				}
+			}
+
+			// the first user made ready continues on this thread
+			n = complete(n);
+			if (n == FlatDAG::INVALID_NODE)
+				return;
+		}
+	}
+};
+
+void Executor::execute(const FlatDAG &dag, const NodeKernel &kernel) {
+	Execution execution(pool, dag, kernel);
+	execution.run();
+}
+
+void Executor::execute(const FlatDAG &dag, const NodeKernel &kernel, const OrderingEdges &ordering) {
+	Execution execution(pool, dag, kernel, &ordering);
+	execution.run();
+}
+
+void Executor::execute(const FlatDAG &dag, const NodeKernel &kernel, const OrderingEdges &ordering,
+		const AsyncKernel &asyncKernel) {
+	Execution execution(pool, dag, kernel, &ordering, &asyncKernel);
+	execution.run();
+}
+
+void Executor::execute(const DAG &dag, const DAGKernel &kernel) {
+	FlatDAG flatDAG = dag.freeze();
+	execute(flatDAG, [&flatDAG, &kernel](FlatDAG::NodeId n) {
+		kernel(flatDAG.getNode(n));
+	});
+}
@@ -0,0 +1,444 @@
+#include "exec/matrixEvaluator.h"
+#include "matrix/elementwise.h"
+#include "matrix/fused.h"
+#include "matrix/gemm.h"
+#include "matrix/reduction.h"
+#include "matrix/sparse.h"
+#include "ir/dag.h"
+#include "trace/tracer.h"
+#include <stdexcept>
+#include <string.h>
+
+using namespace std;
+
+MatrixEvaluator::MatrixEvaluator(const FlatDAG &flatDAG) :
+		dag(flatDAG), values(flatDAG.getNumberOfNodes()), bufferAssignment(0), loader(0) {
+#ifdef DAG_TRACING
+	loadRequests.resize(flatDAG.getNumberOfNodes());
+#endif
+}
+
+void MatrixEvaluator::setBufferAssignment(const BufferAssignment *assignment) {
+	bufferAssignment = assignment;
+	buffers.clear();
+	if (assignment == 0)
+		return;
+
+	for (uint32_t b = 0; b < assignment->getNumberOfBuffers(); b++) {
+		if (assignment->isExternal(b))
+			buffers.push_back(shared_ptr<MatrixStorage>());
+		else
+			buffers.push_back(make_shared<MatrixStorage>(assignment->getBufferBytes(b)));
+	}
+}
+
+void MatrixEvaluator::prepareResult(FlatDAG::NodeId n) {
+	uint32_t buffer = bufferAssignment->getBuffer(n);
+	if (buffer == BufferAssignment::NO_BUFFER)
+		return;
+
+	FlatDAG::NodeId inPlace = bufferAssignment->getInPlaceOperand(n);
+	if (inPlace != FlatDAG::INVALID_NODE) {
+		// the kernels overwrite a result sharing the storage of an operand
+		values[n] = values[inPlace];
+		return;
+	}
+	if (!buffers[buffer])
+		return;
+
+	// the element type of the result is the type of its matrix operands
+	const RuntimeValue *operand = 0;
+	for (const FlatDAG::NodeId *o = dag.successorsBegin(n); o != dag.successorsEnd(n) && operand == 0; o++) {
+		if (values[*o].isMatrix() || values[*o].isSparse())
+			operand = &values[*o];
+	}
+	if (operand == 0)
+		return;
+	ElementType type = operand->isMatrix() ? operand->getMatrix().getType() : operand->getSparse().getType();
+	const Shape &shape = dag.getNode(n)->getShape();
+	if ((uint64_t) shape.getRows() * shape.getColumns() * Matrix::elementSize(type) > buffers[buffer]->getBytes())
+		return;
+
+	values[n] = RuntimeValue(Matrix(type, shape.getRows(), shape.getColumns(), buffers[buffer]));
+}
+
+// Compresses the dense value of a leaf marked sparse
+static void compressLeaf(const FlatDAG &dag, FlatDAG::NodeId n, RuntimeValue &value) {
+	if (dag.getNode(n)->isSparse() && value.isMatrix())
+		value = RuntimeValue(SparseMatrix(value.getMatrix()));
+}
+
+void MatrixEvaluator::evaluateLeaf(FlatDAG::NodeId n) {
+	Instruction *leaf = dag.getLeaf(n);
+
+	switch (leaf->getInstructionID()) {
+
+	case CONSTANT:
+		values[n] = RuntimeValue((double) ((Constant *) leaf)->valueNumber());
+		break;
+
+	case LOCALVARIABLE: {
+		// variables without a binding stay empty: using them is an error
+		unordered_map<LocalVariable *, RuntimeValue>::const_iterator binding =
+				bindings.find((LocalVariable *) leaf);
+		if (binding != bindings.end())
+			values[n] = binding->second;
+		compressLeaf(dag, n, values[n]);
+	}
+		break;
+
+	case LOAD:
+		// loaded synchronously when the node was not started with startLoad
+		if (values[n].isEmpty()) {
+			if (loader == 0)
+				throw runtime_error("LOAD without a loader");
+			values[n] = loader->loadAndWait(((Load *) leaf)->getObjectName());
+		}
+		compressLeaf(dag, n, values[n]);
+		break;
+
+	default:
+		break;
+	}
+}
+
+bool MatrixEvaluator::startLoad(FlatDAG::NodeId n, const Executor::Completion &done) {
+	if (loader == 0 || dag.getLabel(n) != LOAD)
+		return false;
+
+#ifdef DAG_TRACING
+	// the span of the load goes from the request to the arrival of the object
+	loadRequests[n] = Tracer::now();
+#endif
+	loader->load(((Load *) dag.getLeaf(n))->getObjectName(),
+			[this, n, done](const Matrix &object, exception_ptr error) {
+		if (!error) {
+			values[n] = RuntimeValue(object);
+			compressLeaf(dag, n, values[n]);
+		}
+#ifdef DAG_TRACING
+		TraceEvent event;
+		if (Tracer::begin(event, "LOAD", "load", n, false)) {
+			event.start = loadRequests[n];
+			event.bytes = object.getBytes();
+			strncpy(event.detail, ((Load *) dag.getLeaf(n))->getObjectName().c_str(), sizeof(event.detail) - 1);
+			event.detail[sizeof(event.detail) - 1] = 0;
+			Tracer::end(event);
+		}
+#endif
+		done(error);
+	});
+	return true;
+}
+
+void MatrixEvaluator::evaluateAdd(const RuntimeValue &left, const RuntimeValue &right, RuntimeValue &result,
+		bool sparse) {
+	if (left.isSparse() || right.isSparse()) {
+		evaluateSparseAdd(left, right, result, sparse);
+	} else if (left.isScalar() && right.isScalar()) {
+		result = RuntimeValue(left.getScalar() + right.getScalar());
+	} else if (left.isMatrix() && right.isMatrix()) {
+		add(left.getMatrix(), right.getMatrix(), result.getMatrix());
+	} else if (left.isMatrix() && right.isScalar()) {
+		add(left.getMatrix(), right.getScalar(), result.getMatrix());
+	} else if (left.isScalar() && right.isMatrix()) {
+		add(right.getMatrix(), left.getScalar(), result.getMatrix());
+	} else {
+		throw runtime_error("ADD of a variable without a value");
+	}
+}
+
+void MatrixEvaluator::evaluateMultiply(const RuntimeValue &left, const RuntimeValue &right, RuntimeValue &result) {
+	if (left.isSparse() || right.isSparse()) {
+		evaluateSparseMultiply(left, right, result);
+	} else if (left.isScalar() && right.isScalar()) {
+		result = RuntimeValue(left.getScalar() * right.getScalar());
+	} else if (left.isMatrix() && right.isScalar()) {
+		multiply(left.getMatrix(), right.getScalar(), result.getMatrix());
+	} else if (left.isScalar() && right.isMatrix()) {
+		multiply(right.getMatrix(), left.getScalar(), result.getMatrix());
+	} else if (left.isMatrix() && right.isMatrix()) {
+		matrixProduct(left.getMatrix(), right.getMatrix(), result.getMatrix());
+	} else {
+		throw runtime_error("MUL of a variable without a value");
+	}
+}
+
+void MatrixEvaluator::evaluateSparseAdd(const RuntimeValue &left, const RuntimeValue &right, RuntimeValue &result,
+		bool sparse) {
+	if (left.isSparse() && right.isSparse() && sparse) {
+		SparseMatrix sparseResult;
+		add(left.getSparse(), right.getSparse(), sparseResult);
+		result = RuntimeValue(sparseResult);
+	} else if (left.isSparse() && right.isSparse()) {
+		// a sum too dense to be sparse is scattered into the buffer of the node
+		add(left.getSparse(), right.getSparse(), result.getMatrix());
+	} else if (left.isSparse() && right.isMatrix()) {
+		add(left.getSparse(), right.getMatrix(), result.getMatrix());
+	} else if (left.isMatrix() && right.isSparse()) {
+		add(right.getSparse(), left.getMatrix(), result.getMatrix());
+	} else if (left.isSparse() && right.isScalar()) {
+		// every element changes: the result is dense
+		add(left.getSparse().toDense(), right.getScalar(), result.getMatrix());
+	} else if (left.isScalar() && right.isSparse()) {
+		add(right.getSparse().toDense(), left.getScalar(), result.getMatrix());
+	} else {
+		throw runtime_error("ADD of a variable without a value");
+	}
+}
+
+void MatrixEvaluator::evaluateSparseMultiply(const RuntimeValue &left, const RuntimeValue &right, RuntimeValue &result) {
+	SparseMatrix sparseResult;
+	if (left.isSparse() && right.isScalar()) {
+		multiply(left.getSparse(), right.getScalar(), sparseResult);
+		result = RuntimeValue(sparseResult);
+	} else if (left.isScalar() && right.isSparse()) {
+		multiply(right.getSparse(), left.getScalar(), sparseResult);
+		result = RuntimeValue(sparseResult);
+	} else if (left.isSparse() && right.isSparse()) {
+		matrixProduct(left.getSparse(), right.getSparse(), result.getMatrix());
+	} else if (left.isSparse() && right.isMatrix()) {
+		matrixProduct(left.getSparse(), right.getMatrix(), result.getMatrix());
+	} else if (left.isMatrix() && right.isSparse()) {
+		matrixProduct(left.getMatrix(), right.getSparse(), result.getMatrix());
+	} else {
+		throw runtime_error("MUL of a variable without a value");
+	}
+}
+
+void MatrixEvaluator::evaluateFusedNode(FlatDAG::NodeId n) {
+	const FusedNode::Program &program = ((FusedNode *) dag.getNode(n))->getProgram();
+
+	vector<FusedStep> steps(program.size());
+	for (unsigned i = 0; i < program.size(); i++) {
+		steps[i].op = program[i].op == MUL ? FUSED_MULTIPLY : FUSED_ADD;
+		steps[i].operand0 = program[i].operand0;
+		steps[i].operand1 = program[i].operand1;
+	}
+
+	bool scalar = true;
+	vector<FusedInput> inputs;
+	// the fused kernels expand the tiles of sparse inputs in CSR
+	vector<SparseMatrix> rowMajor(dag.numberOfSuccessors(n));
+	for (const FlatDAG::NodeId *operand = dag.successorsBegin(n); operand != dag.successorsEnd(n); operand++) {
+		const RuntimeValue &value = values[*operand];
+		if (value.isEmpty())
+			throw runtime_error("FUSED operation on a variable without a value");
+		FusedInput input;
+		input.matrix = value.isMatrix() ? &value.getMatrix() : 0;
+		input.sparse = 0;
+		if (value.isSparse()) {
+			rowMajor[operand - dag.successorsBegin(n)] = value.getSparse().toFormat(SparseMatrix::CSR);
+			input.sparse = &rowMajor[operand - dag.successorsBegin(n)];
+		}
+		input.scalar = value.getScalar();
+		inputs.push_back(input);
+		scalar = scalar && value.isScalar();
+	}
+
+	if (scalar)
+		values[n] = RuntimeValue(evaluateFusedScalar(steps, inputs));
+	else
+		evaluateFused(steps, inputs, values[n].getMatrix());
+}
+
+void MatrixEvaluator::evaluateReduction(Operator op, const RuntimeValue &operand, RuntimeValue &result) {
+	if (operand.isScalar()) {
+		result = RuntimeValue(operand.getScalar());
+	} else if (operand.isSparse()) {
+		const SparseMatrix &matrix = operand.getSparse();
+		result = RuntimeValue(op == SUM ? sum(matrix) : op == MIN ? minimum(matrix) : maximum(matrix));
+	} else if (operand.isMatrix()) {
+		const Matrix &matrix = operand.getMatrix();
+		result = RuntimeValue(op == SUM ? sum(matrix) : op == MIN ? minimum(matrix) : maximum(matrix));
+	} else {
+		throw runtime_error(string(getOperatorName(op)) + " of a variable without a value");
+	}
+}
+
+void MatrixEvaluator::evaluateDot(const RuntimeValue &left, const RuntimeValue &right, RuntimeValue &result) {
+	if (left.isScalar() && right.isScalar()) {
+		result = RuntimeValue(left.getScalar() * right.getScalar());
+	} else if (left.isSparse() && right.isSparse()) {
+		result = RuntimeValue(dot(left.getSparse(), right.getSparse()));
+	} else if (left.isSparse() && right.isMatrix()) {
+		result = RuntimeValue(dot(left.getSparse(), right.getMatrix()));
+	} else if (left.isMatrix() && right.isSparse()) {
+		result = RuntimeValue(dot(right.getSparse(), left.getMatrix()));
+	} else if (left.isSparse() && right.isScalar()) {
+		result = RuntimeValue(sum(left.getSparse()) * right.getScalar());
+	} else if (left.isScalar() && right.isSparse()) {
+		result = RuntimeValue(left.getScalar() * sum(right.getSparse()));
+	} else if (left.isMatrix() && right.isMatrix()) {
+		result = RuntimeValue(dot(left.getMatrix(), right.getMatrix()));
+	} else if (left.isMatrix() && right.isScalar()) {
+		result = RuntimeValue(sum(left.getMatrix()) * right.getScalar());
+	} else if (left.isScalar() && right.isMatrix()) {
+		result = RuntimeValue(left.getScalar() * sum(right.getMatrix()));
+	} else {
+		throw runtime_error("DOT of a variable without a value");
+	}
+}
+
+void MatrixEvaluator::evaluateEffect(FlatDAG::NodeId n) {
+	EffectNode *node = (EffectNode *) dag.getNode(n);
+	const FlatDAG::NodeId *operands = dag.successorsBegin(n);
+
+	if (node->getLabel() == PRINT) {
+		const RuntimeValue &value = values[operands[0]];
+		if (value.isScalar())
+			cout << value.getScalar() << endl;
+		else if (value.isMatrix())
+			value.getMatrix().print();
+		else if (value.isSparse())
+			value.getSparse().print();
+		else
+			throw runtime_error("PRINT of a variable without a value");
+		return;
+	}
+
+	Call *call = (Call *) node->getInstruction();
+	unordered_map<string, Function>::const_iterator function = functions.find(call->getFunction());
+	if (function == functions.end())
+		throw runtime_error("CALL of an undefined function " + call->getFunction());
+
+	vector<RuntimeValue> arguments;
+	// the functions take dense matrices
+	for (unsigned i = 0; i < node->getNumberOfOperands(); i++)
+		arguments.push_back(values[operands[i]].toDense());
+	values[n] = function->second(arguments);
+}
+
+#ifdef DAG_TRACING
+// Bytes read and written by the kernel of node n, and its floating point
+// operations, from the values of the node and its operands
+static void countWork(const FlatDAG &dag, const vector<RuntimeValue> &values, FlatDAG::NodeId n,
+		uint64_t &bytes, uint64_t &flops) {
+	uint64_t elements = 0;
+	bytes = 0;
+	for (const FlatDAG::NodeId *operand = dag.successorsBegin(n); operand != dag.successorsEnd(n); operand++) {
+		if (values[*operand].isMatrix()) {
+			bytes += values[*operand].getMatrix().getBytes();
+			elements = max<uint64_t>(elements, values[*operand].getMatrix().getSize());
+		} else if (values[*operand].isSparse()) {
+			// the kernels read the stored elements only
+			bytes += values[*operand].getSparse().getBytes();
+			elements = max<uint64_t>(elements, values[*operand].getSparse().getNonZeros());
+		}
+	}
+	if (values[n].isMatrix())
+		bytes += values[n].getMatrix().getBytes();
+	else if (values[n].isSparse())
+		bytes += values[n].getSparse().getBytes();
+
+	switch (dag.getLabel(n)) {
+	case MUL: {
+		const FlatDAG::NodeId *operands = dag.successorsBegin(n);
+		if (dag.numberOfSuccessors(n) == 2 && values[operands[0]].isMatrix() && values[operands[1]].isMatrix()) {
+			// matrix product, m x k times k x n
+			const Matrix &left = values[operands[0]].getMatrix();
+			flops = 2 * (uint64_t) left.getRows() * left.getColumns() * values[operands[1]].getMatrix().getColumns();
+		} else if (values[operands[0]].isSparse() && !values[operands[1]].isScalar()) {
+			// every stored element of the left operand multiplies a row of the right one
+			const RuntimeValue &right = values[operands[1]];
+			flops = 2 * (uint64_t) values[operands[0]].getSparse().getNonZeros()
+					* (right.isSparse() ? right.getSparse().getColumns() : right.getMatrix().getColumns());
+		} else if (values[operands[1]].isSparse() && values[operands[0]].isMatrix()) {
+			// and every stored element of a sparse right operand a column of the left one
+			flops = 2 * (uint64_t) values[operands[1]].getSparse().getNonZeros() * values[operands[0]].getMatrix().getRows();
+		} else {
+			flops = elements;
+		}
+		break;
+	}
+	case ADD:
+	case SUM:
+	case MIN:
+	case MAX:
+		flops = elements;
+		break;
+	case DOT:
+		flops = 2 * elements;
+		break;
+	case FUSED:
+		flops = elements * ((FusedNode *) dag.getNode(n))->getProgram().size();
+		break;
+	default:
+		flops = 0;
+		break;
+	}
+}
+#endif
+
+void MatrixEvaluator::evaluate(FlatDAG::NodeId n) {
+	if (dag.isLeaf(n)) {
+		if (dag.getLabel(n) == LOAD) {
+			TRACE_SPAN(span, "LOAD", "load", n);
+			evaluateLeaf(n);
+			TRACE_WORK(span, values[n].isMatrix() ? values[n].getMatrix().getBytes() : 0, 0);
+			TRACE_DETAIL(span, ((Load *) dag.getLeaf(n))->getObjectName());
+		} else {
+			evaluateLeaf(n);
+		}
+		return;
+	}
+
+	TRACE_SPAN(span, getOperatorName(dag.getLabel(n)), "kernel", n);
+	// a sparse value of a previous execution is not a buffer to write to
+	if (values[n].isSparse())
+		values[n] = RuntimeValue();
+	if (bufferAssignment)
+		prepareResult(n);
+
+	const FlatDAG::NodeId *operands = dag.successorsBegin(n);
+
+	switch (dag.getLabel(n)) {
+
+	case ADD:
+		evaluateAdd(values[operands[0]], values[operands[1]], values[n], dag.getNode(n)->isSparse());
+		break;
+
+	case MUL:
+		evaluateMultiply(values[operands[0]], values[operands[1]], values[n]);
+		break;
+
+	case FUSED:
+		evaluateFusedNode(n);
+		break;
+
+	case SUM:
+	case MIN:
+	case MAX:
+		evaluateReduction(dag.getLabel(n), values[operands[0]], values[n]);
+		break;
+
+	case DOT:
+		evaluateDot(values[operands[0]], values[operands[1]], values[n]);
+		break;
+
+	case PRINT:
+	case CALL:
+		evaluateEffect(n);
+		break;
+
+	case MOVE:
+		// variable <- constant: operands are the variable leaf and the constant
+		values[n] = values[operands[1]];
+		break;
+
+	default:
+		throw runtime_error(string("no kernel for operator ") + getOperatorName(dag.getLabel(n)));
+	}
+
+	// the users of a node not marked sparse expect a dense value
+	if (values[n].isSparse() && !dag.getNode(n)->isSparse())
+		values[n] = values[n].toDense();
+
+#ifdef DAG_TRACING
+	if (span.isActive()) {
+		uint64_t bytes, flops;
+		countWork(dag, values, n, bytes, flops);
+		span.setWork(bytes, flops);
+	}
+#endif
+}
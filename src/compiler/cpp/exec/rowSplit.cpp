@@ -0,0 +1,93 @@
+#include "exec/rowSplit.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+void RowSplit::error(const FlatDAG &flatDAG, FlatDAG::NodeId n, const string &message) {
+	throw runtime_error(string(getOperatorName(flatDAG.getLabel(n))) + " node " + to_string(n) + ": " + message);
+}
+
+RowSplit::RowSplit(const FlatDAG &flatDAG, const vector<bool> &splitLeaves) :
+		phases(flatDAG.getNumberOfNodes(), BEFORE_SPLIT) {
+	for (FlatDAG::NodeId n = 0; n < flatDAG.getNumberOfNodes(); n++) {
+		if (flatDAG.isLeaf(n)) {
+			if (splitLeaves[n])
+				phases[n] = SPLIT;
+			continue;
+		}
+
+		bool split = false;
+		bool reduced = false;
+		for (const FlatDAG::NodeId *operand = flatDAG.successorsBegin(n); operand != flatDAG.successorsEnd(n); operand++) {
+			split = split || phases[*operand] == SPLIT;
+			reduced = reduced || phases[*operand] == PARTIAL || phases[*operand] == AFTER_SPLIT;
+		}
+		if (split && reduced)
+			error(flatDAG, n, "uses both a block of rows and a reduction over all the rows");
+		if (reduced) {
+			phases[n] = AFTER_SPLIT;
+			continue;
+		}
+		if (!split)
+			continue;
+
+		switch (flatDAG.getLabel(n)) {
+		case SUM:
+		case MIN:
+		case MAX:
+		case DOT:
+			phases[n] = PARTIAL;
+			break;
+		case MUL:
+			if (phases[flatDAG.successorsBegin(n)[0]] == SPLIT && phases[flatDAG.successorsBegin(n)[1]] == SPLIT)
+				error(flatDAG, n, "product of two matrices split by rows");
+			phases[n] = SPLIT;
+			break;
+		case ADD:
+		case FUSED:
+			phases[n] = SPLIT;
+			break;
+		default:
+			error(flatDAG, n, "cannot be evaluated one block of rows at a time");
+		}
+	}
+}
+
+void RowSplit::checkWholeOperands(const FlatDAG &flatDAG, const MatrixEvaluator &evaluator) const {
+	for (FlatDAG::NodeId n = 0; n < flatDAG.getNumberOfNodes(); n++) {
+		if ((phases[n] != SPLIT && phases[n] != PARTIAL) || flatDAG.isLeaf(n))
+			continue;
+		const FlatDAG::NodeId *operands = flatDAG.successorsBegin(n);
+		for (unsigned i = 0; i < flatDAG.numberOfSuccessors(n); i++) {
+			if (phases[operands[i]] != BEFORE_SPLIT || !evaluator.getValue(operands[i]).isMatrix())
+				continue;
+			if (flatDAG.getLabel(n) != MUL || i != 1)
+				error(flatDAG, n, "combines a block of rows with a whole matrix");
+		}
+	}
+}
+
+double RowSplit::getIdentity(Operator op) {
+	switch (op) {
+	case MIN:
+		return numeric_limits<double>::infinity();
+	case MAX:
+		return -numeric_limits<double>::infinity();
+	default:
+		return 0;
+	}
+}
+
+double RowSplit::combine(Operator op, double partial, double value) {
+	switch (op) {
+	case MIN:
+		return min(partial, value);
+	case MAX:
+		return max(partial, value);
+	default:
+		// SUM and DOT: sums over the elements of the blocks
+		return partial + value;
+	}
+}
@@ -0,0 +1,102 @@
+#include "exec/threadPool.h"
+#include <stdlib.h>
+
+using namespace std;
+
+thread_local ThreadPool *ThreadPool::currentPool = 0;
+thread_local unsigned ThreadPool::currentQueue = 0;
+
+unsigned ThreadPool::defaultNumberOfThreads() {
+	unsigned numberOfThreads = thread::hardware_concurrency();
+	if (numberOfThreads == 0)
+		numberOfThreads = 1;
+
+	const char *limit = getenv("DAG_NUM_THREADS");
+	if (limit && atoi(limit) > 0 && (unsigned) atoi(limit) < numberOfThreads)
+		numberOfThreads = atoi(limit);
+	return numberOfThreads;
+}
+
+ThreadPool::ThreadPool(unsigned numberOfThreads) :
+		queuedTasks(0), nextQueue(0), stopping(false) {
+	if (numberOfThreads == 0)
+		numberOfThreads = defaultNumberOfThreads();
+
+	for (unsigned i = 0; i < numberOfThreads; i++)
+		queues.push_back(unique_ptr<WorkQueue>(new WorkQueue()));
+	for (unsigned i = 0; i < numberOfThreads; i++)
+		workers.push_back(thread(&ThreadPool::workerLoop, this, i));
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		lock_guard<mutex> guard(sleepLock);
+		stopping = true;
+	}
+	wakeUp.notify_all();
+	for (thread &worker : workers)
+		worker.join();
+}
+
+void ThreadPool::submit(Task task) {
+	unsigned index;
+	if (currentPool == this)
+		index = currentQueue;
+	else
+		index = nextQueue++ % queues.size();
+
+	{
+		lock_guard<mutex> guard(queues[index]->lock);
+		queues[index]->tasks.push_back(std::move(task));
+	}
+	queuedTasks++;
+
+	// taking the lock orders the notification after a worker checked queuedTasks
+	lock_guard<mutex> guard(sleepLock);
+	wakeUp.notify_one();
+}
+
+bool ThreadPool::popTask(unsigned index, Task &task) {
+	WorkQueue &queue = *queues[index];
+	lock_guard<mutex> guard(queue.lock);
+	if (queue.tasks.empty())
+		return false;
+	task = std::move(queue.tasks.back());
+	queue.tasks.pop_back();
+	queuedTasks--;
+	return true;
+}
+
+bool ThreadPool::stealTask(unsigned index, Task &task) {
+	for (unsigned i = 1; i < queues.size(); i++) {
+		WorkQueue &victim = *queues[(index + i) % queues.size()];
+		lock_guard<mutex> guard(victim.lock);
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			queuedTasks--;
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::workerLoop(unsigned index) {
+	currentPool = this;
+	currentQueue = index;
+
+	Task task;
+	while (true) {
+		if (popTask(index, task) || stealTask(index, task)) {
+			task();
+			task = Task();
+			continue;
+		}
+
+		unique_lock<mutex> guard(sleepLock);
+		if (stopping && queuedTasks == 0)
+			return;
+		if (queuedTasks == 0)
+			wakeUp.wait(guard);
+	}
+}
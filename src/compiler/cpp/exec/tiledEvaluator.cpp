@@ -0,0 +1,201 @@
+#include "exec/tiledEvaluator.h"
+#include "trace/tracer.h"
+#include <algorithm>
+#include <thread>
+#include <exception>
+#include <stdexcept>
+
+using namespace std;
+
+TiledEvaluator::TiledEvaluator(const FlatDAG &flatDAG, size_t workingSetBytes) :
+		dag(flatDAG), workingSet(workingSetBytes), evaluator(flatDAG), loader(0), tileRows(0), numberOfTiles(0) {
+}
+
+void TiledEvaluator::classifyNodes() {
+	streamed.clear();
+	nodeSources.clear();
+	nodeSinks.clear();
+
+	vector<bool> splitLeaves(dag.getNumberOfNodes(), false);
+	for (FlatDAG::NodeId n = 0; n < dag.getNumberOfNodes(); n++) {
+		if (!dag.isLeaf(n))
+			continue;
+		Instruction *leaf = dag.getLeaf(n);
+		TileSource *source = 0;
+		if (leaf->getInstructionID() == LOCALVARIABLE) {
+			unordered_map<LocalVariable *, TileSource *>::const_iterator position =
+					sources.find((LocalVariable *) leaf);
+			if (position == sources.end())
+				continue;
+			source = position->second;
+		} else if (leaf->getInstructionID() != LOAD || wholeObjects.count(((Load *) leaf)->getObjectName())) {
+			continue;
+		}
+		// the source of a LOAD is opened once the loader got its object
+		splitLeaves[n] = true;
+		streamed.push_back(n);
+		nodeSources.push_back(source);
+	}
+	split = RowSplit(dag, splitLeaves);
+
+	// the node of every variable with a sink
+	for (FlatDAG::NodeId n = 0; n < dag.getNumberOfNodes(); n++) {
+		for (LocalVariable * const *identifier = dag.identifiersBegin(n); identifier != dag.identifiersEnd(n); identifier++) {
+			unordered_map<LocalVariable *, TileSink *>::const_iterator sink = sinks.find(*identifier);
+			if (sink == sinks.end())
+				continue;
+			if (split.getPhase(n) != RowSplit::SPLIT)
+				RowSplit::error(dag, n, "the value of a sink does not depend on streamed matrices");
+			nodeSinks.push_back(make_pair(n, sink->second));
+		}
+	}
+}
+
+void TiledEvaluator::openSources() {
+	loadedSources.clear();
+	for (unsigned i = 0; i < streamed.size(); i++) {
+		if (nodeSources[i] != 0)
+			continue;
+		if (loader == 0)
+			RowSplit::error(dag, streamed[i], "LOAD without a loader");
+		// a binary matrix file is mapped, its tiles are read on demand
+		loadedSources.push_back(unique_ptr<TileSource>(new MatrixTileSource(
+				loader->loadAndWait(((Load *) dag.getLeaf(streamed[i]))->getObjectName()))));
+		nodeSources[i] = loadedSources.back().get();
+	}
+
+	for (unsigned i = 1; i < streamed.size(); i++) {
+		if (nodeSources[i]->getRows() != nodeSources[0]->getRows())
+			RowSplit::error(dag, streamed[i], "streamed matrices with different numbers of rows");
+	}
+}
+
+size_t TiledEvaluator::computeTileRows(size_t rows) {
+	// bytes of one row of every tiled value, and of every streamed input
+	// twice (the tile being read)
+	vector<size_t> columns(dag.getNumberOfNodes(), 0);
+	vector<size_t> elementSizes(dag.getNumberOfNodes(), 0);
+	size_t rowBytes = 0;
+	for (unsigned i = 0; i < streamed.size(); i++) {
+		columns[streamed[i]] = nodeSources[i]->getColumns();
+		elementSizes[streamed[i]] = Matrix::elementSize(nodeSources[i]->getType());
+		rowBytes += columns[streamed[i]] * elementSizes[streamed[i]];
+	}
+	for (FlatDAG::NodeId n = 0; n < dag.getNumberOfNodes(); n++) {
+		if (split.getPhase(n) != RowSplit::SPLIT)
+			continue;
+		const FlatDAG::NodeId *operands = dag.successorsBegin(n);
+		if (!dag.isLeaf(n)) {
+			// the columns and element type of a tiled operand
+			for (unsigned i = 0; i < dag.numberOfSuccessors(n) && columns[n] == 0; i++) {
+				columns[n] = columns[operands[i]];
+				elementSizes[n] = elementSizes[operands[i]];
+			}
+			if (dag.getLabel(n) == MUL && split.getPhase(operands[1]) == RowSplit::BEFORE_SPLIT
+					&& evaluator.getValue(operands[1]).isMatrix())
+				columns[n] = evaluator.getValue(operands[1]).getMatrix().getColumns();
+		}
+		rowBytes += columns[n] * elementSizes[n];
+	}
+
+	if (rowBytes == 0 || rows == 0)
+		return max<size_t>(rows, 1);
+	return min(rows, max<size_t>(workingSet / rowBytes, 1));
+}
+
+void TiledEvaluator::readTiles(size_t firstRow, size_t rows, vector<Matrix> &tiles) {
+	for (unsigned i = 0; i < streamed.size(); i++) {
+		TRACE_SPAN(span, "TILE", "load", streamed[i]);
+		nodeSources[i]->read(firstRow, rows, tiles[i]);
+		TRACE_WORK(span, tiles[i].getBytes(), 0);
+	}
+}
+
+void TiledEvaluator::evaluateTile(size_t firstRow, vector<double> &partials) {
+	for (FlatDAG::NodeId n = 0; n < dag.getNumberOfNodes(); n++) {
+		if (split.getPhase(n) == RowSplit::SPLIT && !dag.isLeaf(n)) {
+			evaluator.evaluate(n);
+		} else if (split.getPhase(n) == RowSplit::PARTIAL) {
+			evaluator.evaluate(n);
+			partials[n] = RowSplit::combine(dag.getLabel(n), partials[n], evaluator.getValue(n).getScalar());
+		}
+	}
+
+	for (const pair<FlatDAG::NodeId, TileSink *> &sink : nodeSinks) {
+		const RuntimeValue &value = evaluator.getValue(sink.first);
+		if (!value.isMatrix())
+			RowSplit::error(dag, sink.first, "the value of a sink is not a matrix");
+		sink.second->write(firstRow, value.getMatrix());
+	}
+}
+
+void TiledEvaluator::run() {
+	classifyNodes();
+
+	for (FlatDAG::NodeId n = 0; n < dag.getNumberOfNodes(); n++) {
+		if (split.getPhase(n) == RowSplit::BEFORE_SPLIT)
+			evaluator.evaluate(n);
+	}
+
+	openSources();
+	split.checkWholeOperands(dag, evaluator);
+	size_t rows = streamed.empty() ? 0 : nodeSources[0]->getRows();
+	tileRows = computeTileRows(rows);
+	numberOfTiles = (rows + tileRows - 1) / tileRows;
+
+	vector<double> partials(dag.getNumberOfNodes());
+	for (FlatDAG::NodeId n = 0; n < dag.getNumberOfNodes(); n++)
+		partials[n] = RowSplit::getIdentity(dag.getLabel(n));
+
+	// the next tiles are read while the current ones are evaluated
+	vector<Matrix> current(streamed.size());
+	vector<Matrix> next(streamed.size());
+	if (numberOfTiles > 0)
+		readTiles(0, min(tileRows, rows), current);
+	for (size_t tile = 0; tile < numberOfTiles; tile++) {
+		size_t firstRow = tile * tileRows;
+		size_t nextRow = firstRow + tileRows;
+		// the leaves hold the current tiles only, the next ones are read
+		// into the unused tiles of the previous step
+		for (unsigned i = 0; i < streamed.size(); i++)
+			evaluator.setValue(streamed[i], RuntimeValue(current[i]));
+
+		thread reader;
+		exception_ptr readError;
+		if (nextRow < rows) {
+			reader = thread([this, nextRow, rows, &next, &readError]() {
+				try {
+					readTiles(nextRow, min(tileRows, rows - nextRow), next);
+				} catch (...) {
+					readError = current_exception();
+				}
+			});
+		}
+
+		try {
+			evaluateTile(firstRow, partials);
+		} catch (...) {
+			if (reader.joinable())
+				reader.join();
+			throw;
+		}
+		if (reader.joinable())
+			reader.join();
+		if (readError)
+			rethrow_exception(readError);
+
+		for (TileSource *source : nodeSources)
+			source->release(firstRow, min(tileRows, rows - firstRow));
+		current.swap(next);
+	}
+
+	for (FlatDAG::NodeId n = 0; n < dag.getNumberOfNodes(); n++) {
+		if (split.getPhase(n) == RowSplit::PARTIAL)
+			evaluator.setValue(n, RuntimeValue(partials[n]));
+		else if (split.getPhase(n) == RowSplit::AFTER_SPLIT)
+			evaluator.evaluate(n);
+	}
+
+	for (const pair<FlatDAG::NodeId, TileSink *> &sink : nodeSinks)
+		sink.second->finish();
+}
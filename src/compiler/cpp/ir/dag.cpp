@@ -1,31 +1,45 @@
 #include "ir/dag.h"
+#include "ir/flatDag.h"
 #include <string.h>
 #include <iostream>
+#include <deque>
+#include <functional>
+#include <stdexcept>
 #include <assert.h>
 
 using namespace std;
 
 void Node::printLabel() const {
-	switch (label) {
-	case CONSTANT:
-		cout << "CONSTANT";
-		break;
-	case LOCALVARIABLE:
-		cout << "LOCALVARIABLE";
-		break;
-	case MUL:
-		cout << "MUL";
-		break;
-	case ADD:
-		cout << "ADD";
-		break;
-	case MOVE:
-		cout << "MOVE";
-		break;
-	default:
-		cout << "INVALID";
-		break;
+	cout << getOperatorName(label);
+}
+
+namespace {
+
+// the hashCode() and print() of each class, called by dispatch()
+struct HashCodeFunction {
+	template<typename T>
+	int operator()(const T &node) {
+		return node.hashCode();
 	}
+};
+
+struct PrintFunction {
+	template<typename T>
+	void operator()(const T &node) {
+		node.print();
+	}
+};
+
+}
+
+int Node::hashCode() const {
+	HashCodeFunction function;
+	return dispatch<int>(const_cast<Node *>(this), function);
+}
+
+void Node::print() const {
+	PrintFunction function;
+	dispatch<void>(const_cast<Node *>(this), function);
 }
 
 int OperatorNode::hashCode() const {
@@ -41,8 +55,10 @@ void OperatorNode::print() const{
 	cout << "@"<< successors[0];//->print();
 	cout << " ";
 	printLabel();
-	cout << " ";
-	cout << "@" << successors[1]; //->print();
+	if (successors.size() > 1) {
+		cout << " ";
+		cout << "@" << successors[1]; //->print();
+	}
 	cout << " identifiers: ";
 	for (unsigned i = 0; i < identifierList.size(); i++) {
 		identifierList[i]->print();
@@ -79,16 +95,139 @@ bool OperatorNode::operator==(const OperatorNode &other) const {
 }
 
 void OperatorNode::removeIdentifier (LocalVariable *localVariable) {
-	vector<LocalVariable *>::iterator position = std::find(identifierList.begin(), identifierList.end(), localVariable);
+	auto position = std::find(identifierList.begin(), identifierList.end(), localVariable);
 	if (position != identifierList.end())
 		identifierList.erase(position);
 }
 
 
+void FusedNode::print() const {
+	cout << "FusedNode @" << this << ": inputs:";
+	for (Node *input : successors) {
+		cout << " @" << input;
+	}
+	cout << " program:";
+	for (unsigned i = 0; i < program.size(); i++) {
+		cout << " r" << successors.size() + i << "=" << getOperatorName(program[i].op)
+				<< "(r" << program[i].operand0 << ",r" << program[i].operand1 << ")";
+	}
+	cout << " identifiers: ";
+	for (LocalVariable *identifier : getIdentifiers()) {
+		identifier->print();
+		cout << " ";
+	}
+}
+
+void EffectNode::print() const {
+	cout << "EffectNode @" << this << ": ";
+	printLabel();
+	for (unsigned i = 0; i < numberOfOperands; i++) {
+		cout << " @" << successors[i];
+	}
+	if (getPreviousEffect())
+		cout << " after @" << getPreviousEffect();
+	cout << " identifiers: ";
+	for (LocalVariable *identifier : getIdentifiers()) {
+		identifier->print();
+		cout << " ";
+	}
+}
+
 int LeafNode::hashCode() const {
 	return leaf->hashCode();
 }
 
+// Incremental maintenance. Each instruction added to the DAG gets a
+// record with an order label, spaced so that instructions can be inserted
+// between two others without relabeling the block; the records of the
+// assignments and of the reads of each variable are kept sorted by order.
+// An edit evaluates the edited instruction again, and then the
+// instructions that read a variable whose value changed, in program
+// order, the way the constructor adds them; nodes are found again in the
+// value number table. The nodes that are no longer the value of any
+// instruction, nor used by another node, are removed. What the edits need
+// to know about each node is kept in an array indexed by the node id.
+
+// the orders leave room for 32 insertions at the same place, and at least
+// 10 once the instructions around it are relabeled
+static const uint64_t ORDER_GAP = uint64_t(1) << 32;
+static const uint64_t MIN_SPACING = 1 << 10;
+
+struct DAG::InstructionRecord {
+	Instruction       *instruction;
+	Node              *node;        // value of the instruction, 0 for none
+	uint64_t          order;        // position in the block
+	LocalVariable     *variable;    // assigned by the instruction, 0 for none
+	InstructionRecord *previous;    // in program order
+	InstructionRecord *next;
+	bool              invalid;      // waiting to be evaluated again
+};
+
+struct DAG::EditIndex {
+	typedef vector<InstructionRecord *> Records;  // sorted by order
+
+	struct Variable {
+		Records definitions;   // the assignments of the variable
+		Records readers;       // the instructions reading it
+		Node    *initialLeaf;  // its value on entry to the block
+		bool    changed;       // its latest value may have changed
+
+		Variable() : initialLeaf(0), changed(false) {
+		}
+	};
+
+	struct NodeEntry {
+		uint32_t vertexPosition;  // in vertices
+		uint32_t labelPosition;   // in the list of its label in operatorArray
+		uint32_t references;      // instructions whose value is the node
+		uint32_t count;           // scratch: users found dead, operands left to order
+		bool     dirty;
+		bool     removed;
+		bool     marked;          // scratch: in the dirty region
+	};
+
+	typedef unordered_map<Instruction *, InstructionRecord *, hash<Instruction *>, equal_to<Instruction *>,
+			ArenaAllocator<pair<Instruction * const, InstructionRecord *> > > RecordMap;
+
+	deque<InstructionRecord, ArenaAllocator<InstructionRecord> >  records;
+	vector<InstructionRecord *>                                   freeRecords;    // of removed instructions
+	RecordMap                                                     instructions;
+	InstructionRecord                                             *first;
+	InstructionRecord                                             *last;
+	unordered_map<LocalVariable *, Variable>                      variables;
+	vector<NodeEntry>                                             nodes;          // by node id
+	unordered_map<Node *, InstructionRecord *>                    effectRecords;  // of the PRINT and CALL nodes
+
+	// work of the current edit
+	bool                                          editing;
+	vector<pair<uint64_t, InstructionRecord *> >  invalid;   // heap, smallest order first
+	vector<LocalVariable *>                       changed;   // variables whose value may have changed
+	vector<Node *>                                garbage;   // nodes that may have no user left
+	vector<LocalVariable *>                       reads;     // scratch
+
+	// the records and their table live in the arena of the DAG, if any,
+	// the table sized for the 'size' instructions of the block
+	EditIndex(Arena *arena, size_t size) :
+			records(ArenaAllocator<InstructionRecord>(arena)),
+			instructions(size, hash<Instruction *>(), equal_to<Instruction *>(),
+					ArenaAllocator<pair<Instruction * const, InstructionRecord *> >(arena)),
+			first(0), last(0), editing(false) {
+		// blocks have about one node per instruction, and some leaves
+		nodes.reserve(size + size / 2);
+	}
+};
+
+// Assign the next node id and add the node to the DAG vertices
+Node * DAG::registerNode(Node *node) {
+	// ids are never reused, even after nodes are removed
+	node->setId(nextId++);
+	if (editIndex)
+		indexNode(node);
+	vertices.push_back(node);
+	operatorArray[node->getLabel()].push_back(node);
+	return node;
+}
+
 // Add edge u->v to the DAG
 void DAG::addEdge(Node* u, Node* v) {
 	vertices.push_back(v);
@@ -112,10 +251,41 @@ DAG::NodeMap<int> DAG::indegrees() const {
 
 // DAG: Constructor that builds a DAG for the
 // basic block passed as parameter
-DAG::DAG(BasicBlock *basicBlock) {
+DAG::DAG(BasicBlock *basicBlock) :
+		DAG(basicBlock, basicBlock ? basicBlock->getContext() : 0) {
+}
+
+DAG::DAG(BasicBlock *basicBlock, CompilationContext *context, bool edits) :
+		arena(context ? &context->getArena() : 0),
+		identifierMapper(0, hash<LocalVariable*>(), equal_to<LocalVariable*>(),
+				ArenaAllocator<pair<LocalVariable* const, Node *> >(arena)),
+		constantMapper(0, hash<int>(), equal_to<int>(),
+				ArenaAllocator<pair<const int, Node *> >(arena)),
+		valueNumbers(arena), nextId(0), editable(edits) {
 
 	operatorArray = (DAGNodes *) new DAGNodes[NUMBER_OF_OPERATORS];
 
+	if (basicBlock && basicBlock->getFlatBlock()) {
+		FlatBlock *flatBlock = basicBlock->getFlatBlock();
+		// the flat form does not keep the instructions to edit
+		editable = false;
+
+		for (const FlatInstruction &instruction : *flatBlock) {
+			addFlatInstruction(flatBlock, instruction);
+		}
+		return;
+	}
+
+	// the instructions are indexed as they are added, for the edits
+	if (editable) {
+		size_t size = 0;
+		if (basicBlock) {
+			for (Instruction *instruction = basicBlock->getFirst(); instruction != 0; instruction = instruction->getNext())
+				size++;
+		}
+		editIndex.reset(new EditIndex(arena, size));
+	}
+
 	if (basicBlock) {
 		Instruction *instruction = basicBlock->getFirst();
 
@@ -131,14 +301,31 @@ void DAG::addThreeAddressInstruction(Instruction *instruction) {
 		return;
 	}
 
+	// the instruction goes at the end of the block, where the latest
+	// values of the variables are the ones it reads
+	InstructionRecord *record = 0;
+	if (editIndex)
+		record = addRecord(instruction, editIndex->last ? editIndex->last->order + ORDER_GAP : ORDER_GAP, 0);
+
+	Node *node = 0;
+
 	switch (instruction->getInstructionID()) {
 
 	case LOCALVARIABLE:
-		addNode((LocalVariable *) instruction);
+		node = addNode((LocalVariable *) instruction);
 		break;
 
 	case MOVE:
-		addNode((Move *) instruction);
+		node = addNode((Move *) instruction);
+		break;
+
+	case PRINT:
+		node = addNode((Print *) instruction);
+		break;
+
+	case CALL:
+		// a call whose result is unused
+		node = addNode((Call *) instruction);
 		break;
 
 	// binary instructions should always produce a value
@@ -154,6 +341,9 @@ void DAG::addThreeAddressInstruction(Instruction *instruction) {
 		;
 		// do nothing for the other cases
 	}
+
+	if (record)
+		setValue(record, node);
 }
 
 Node * DAG::addOperatorNode(Instruction *instruction) {
@@ -212,81 +402,80 @@ Node * DAG::addNode(BinaryInstruction *i) {
 }
 
 Node * DAG::addNode(Operator op, Instruction *left, Instruction *right) {
-	Node *leftNode = addLeafNode(left);
-	Node *rightNode = addLeafNode(right);
+	return addOperation(op, addLeafNode(left), addLeafNode(right));
+}
 
+Node * DAG::addOperation(Operator op, Node *leftNode, Node *rightNode) {
 	// Search for an exiting inner node for operation  'left op right'
-	Node * operatorNode = searchNode(op, leftNode, rightNode);
+	Node * operatorNode = valueNumbers.lookup(op, leftNode, rightNode);
 
 	if (operatorNode == 0){
 		// if a operator node does not exit, create one and set the childs
-		operatorNode = new OperatorNode(op, leftNode, rightNode);
-		vertices.push_back(operatorNode);
-		operatorArray[op].push_back(operatorNode);
+		operatorNode = registerNode(createNode<OperatorNode>(op, leftNode, rightNode));
+		valueNumbers.insert(op, leftNode, rightNode, operatorNode);
 	}
 
 	return operatorNode;
 }
 
-Node * DAG::searchNode(Operator op, Node *left, Node *right) {
-	// get  predecessor nodes for left Node;
-	vector<Node *>  lpredecessors = left->getPredecessors();
-
-	// get  predecessor nodes for right Node;
-	vector<Node *>  rpredecessors = right->getPredecessors();
-
-	// search a common predecessor node
-	for (unsigned i = 0; i < lpredecessors.size(); i++) {
-		Node * lpredecessor = lpredecessors[i];
-		if (lpredecessor->getLabel() == op) {
-			for (unsigned j = 0; j < rpredecessors.size(); j++) {
-				Node *rpredecessor = rpredecessors[i];
-				if (lpredecessor == rpredecessor &&
-						(op == MUL || op == ADD || // for add and multiply does not matter the order
-					    (i == 0 && j == 1))) {
-					// node (left op right) already exists, return it
-					return lpredecessor;
-				}
-			}
+Node * DAG::addNode(Move *i) {
+	Instruction * rightValue = i->getRightValue();
+
+	switch (rightValue->getInstructionID()) {
+
+		case MUL:
+		case ADD:
+		case DOT: {
+			BinaryInstruction *expression = (BinaryInstruction *) rightValue;
+			return addMove(i->getVariable(), expression->getInstructionID(),
+					expression->getFirstOperand(), expression->getSecondOperand());
 		}
-	}
-	return 0;
-}
 
-template<typename Base, typename T>
-inline bool instanceof(const T *ptr)
-{
-    return dynamic_cast<const Base*>(ptr) != nullptr;
+		case SUM:
+		case MIN:
+		case MAX:
+			return addMove(i->getVariable(), rightValue->getInstructionID(),
+					((Reduction *) rightValue)->getOperand(), 0);
+
+		default:
+			return addMove(i->getVariable(), rightValue->getInstructionID(), rightValue, 0);
+	}
 }
 
-Node * DAG::addNode(Move *i) {
-	Instruction * rightValue = i->getRightValue();
+// Assign 'left op right' to variable. For plain copies 'op' is the
+// id of the right value (LOCALVARIABLE, CONSTANT, LOAD or CALL) and 'right'
+// is 0; the reductions have the single operand 'left'.
+Node * DAG::addMove(LocalVariable *variable, Operator op, Instruction *left, Instruction *right) {
 	Node *resultNode = 0;
 
 	// clear Move destination variable (localVariable) from previous DAG operator node
-	Node *previousIdMapping = identifierMapper[i->getVariable()];
-	if ( (previousIdMapping != 0) && instanceof<OperatorNode>(previousIdMapping)) {
-		((OperatorNode *) previousIdMapping)->removeIdentifier(i->getVariable());
+	IdentifierMap::iterator previousIdMapping = identifierMapper.find(variable);
+	if ( (previousIdMapping != identifierMapper.end()) && !previousIdMapping->second->isLeaf()) {
+		((OperatorNode *) previousIdMapping->second)->removeIdentifier(variable);
 	}
 
-	switch (rightValue->getInstructionID()) {
+	switch (op) {
 
 		case LOCALVARIABLE:
-			resultNode = addNode((LocalVariable *) rightValue);
-			identifierMapper[i->getVariable()] = resultNode;
+			resultNode = addNode((LocalVariable *) left);
+			identifierMapper[variable] = resultNode;
+			if (!resultNode->isLeaf())
+				((OperatorNode *) resultNode)->addIdentifier(variable);
 			break;
 
 		case CONSTANT: {
-			Node *rightValueNode = addNode((Constant *) rightValue);
-			Node *idNode = new LeafNode(i->getVariable());
-			identifierMapper[i->getVariable()] = idNode;
-			resultNode = new OperatorNode(i->getInstructionID(), idNode, rightValueNode);
-			identifierMapper[i->getVariable()] = resultNode;
-			operatorArray[i->getInstructionID()].push_back(resultNode);
-			vertices.push_back(resultNode);
+			Node *rightValueNode = addNode((Constant *) left);
+			Node *idNode = registerNode(createNode<LeafNode>(variable));
+			resultNode = registerNode(createNode<OperatorNode>(MOVE, idNode, rightValueNode));
+			identifierMapper[variable] = resultNode;
 		}
 			break;
 
+		case LOAD:
+			resultNode = addNode((Load *) left);
+			identifierMapper[variable] = resultNode;
+			break;
+
 		case MOVE:
 			assert(false && "Invalid right value for Move instruction");
 			break;
@@ -296,9 +485,24 @@ Node * DAG::addNode(Move *i) {
 	    // in a valid state
 		case MUL:
 		case ADD:
-			resultNode = addNode((BinaryInstruction *) rightValue);
-			identifierMapper[i->getVariable()] = resultNode;
-			((OperatorNode *) resultNode)->addIdentifier(i->getVariable());
+		case DOT:
+			resultNode = addNode(op, left, right);
+			identifierMapper[variable] = resultNode;
+			((OperatorNode *) resultNode)->addIdentifier(variable);
+			break;
+
+		case SUM:
+		case MIN:
+		case MAX:
+			resultNode = addReduction(op, addLeafNode(left));
+			identifierMapper[variable] = resultNode;
+			((OperatorNode *) resultNode)->addIdentifier(variable);
+			break;
+
+		case CALL:
+			resultNode = addNode((Call *) left);
+			identifierMapper[variable] = resultNode;
+			((OperatorNode *) resultNode)->addIdentifier(variable);
 			break;
 
 		default:
@@ -308,39 +512,288 @@ Node * DAG::addNode(Move *i) {
 	return resultNode;
 }
 
+// Add a flat three-address instruction to the DAG
+void DAG::addFlatInstruction(FlatBlock *flatBlock, const FlatInstruction &instruction) {
+	// statements without a destination
+	if (instruction.destination == FlatBlock::NO_DESTINATION) {
+		addThreeAddressInstruction(flatBlock->getEffect(instruction.operand0));
+		return;
+	}
+
+	LocalVariable *variable = flatBlock->getVariable(instruction.destination);
+
+	switch (instruction.opcode) {
+
+	case LOCALVARIABLE:
+		addNode(variable);
+		break;
+
+	case MOVE: {
+		Instruction *rightValue = flatBlock->getOperand(instruction.operand0);
+		addMove(variable, rightValue->getInstructionID(), rightValue, 0);
+	}
+		break;
+
+	case LOAD:
+		addMove(variable, LOAD, flatBlock->getLoad(instruction.operand0), 0);
+		break;
+
+	case CALL:
+		addMove(variable, CALL, flatBlock->getEffect(instruction.operand0), 0);
+		break;
+
+	case MUL:
+	case ADD:
+	case DOT:
+		addMove(variable, (Operator) instruction.opcode,
+				flatBlock->getOperand(instruction.operand0),
+				flatBlock->getOperand(instruction.operand1));
+		break;
+
+	case SUM:
+	case MIN:
+	case MAX:
+		addMove(variable, (Operator) instruction.opcode,
+				flatBlock->getOperand(instruction.operand0), 0);
+		break;
+
+	default:
+		;
+		// do nothing for the other cases
+	}
+}
+
 Node * DAG::addNode(Constant *c) {
-	DAGNodes constantNodes = operatorArray[c->getInstructionID()];
-	for (unsigned i = 0; i < constantNodes.size(); ++i) {
-		Constant *constantI = (Constant*) (((LeafNode *)constantNodes[i])->getLeaf());
-		if (c == constantI) {
-			return constantNodes[i];
-		}
+	// equal literals share one leaf
+	ConstantMap::iterator position = constantMapper.find(c->valueNumber());
+	if (position != constantMapper.end()) {
+		return position->second;
 	}
-	Node *leafNode = new LeafNode(c);
-	operatorArray[c->getInstructionID()].push_back(leafNode);
-	vertices.push_back(leafNode);
+	Node *leafNode = registerNode(createNode<LeafNode>(c));
+	constantMapper[c->valueNumber()] = leafNode;
 	return leafNode;
 }
 
-Node * DAG::addNode(LocalVariable *variable) {
-	Node *leafNode = identifierMapper[variable];
+Node * DAG::addNode(Load *load) {
+	// loads of the same object read the same value
+	LoadMap::iterator position = loadMapper.find(load->getObjectName());
+	if (position != loadMapper.end()) {
+		return position->second;
+	}
+	Node *leafNode = registerNode(createNode<LeafNode>(load));
+	loadMapper[load->getObjectName()] = leafNode;
+	return leafNode;
+}
+
+Node * DAG::addNode(Print *print) {
+	vector<Node *> operands(1, addLeafNode(print->getOperand()));
+	Node *previousEffect = effects.empty() ? 0 : effects.back();
+	Node *node = registerNode(createNode<EffectNode>(print, operands, previousEffect));
+	effects.push_back(node);
+	return node;
+}
 
-	if (leafNode == 0) {
-		leafNode = new LeafNode(variable);
-		operatorArray[variable->getInstructionID()].push_back(leafNode);
-		vertices.push_back(leafNode);
+Node * DAG::addNode(Call *call) {
+	vector<Node *> operands;
+	for (Instruction *argument : call->getArguments())
+		operands.push_back(addLeafNode(argument->resolve()));
+	Node *previousEffect = effects.empty() ? 0 : effects.back();
+	Node *node = registerNode(createNode<EffectNode>(call, operands, previousEffect));
+	effects.push_back(node);
+	return node;
+}
+
+Node * DAG::addNode(LocalVariable *variable) {
+	IdentifierMap::iterator position = identifierMapper.find(variable);
+	if (position != identifierMapper.end()) {
+		return position->second;
 	}
+
+	// first use of the variable in the block: its initial value is a leaf
+	Node *leafNode = registerNode(createNode<LeafNode>(variable));
+	identifierMapper[variable] = leafNode;
+	if (editIndex)
+		editIndex->variables[variable].initialLeaf = leafNode;
 	return leafNode;
 }
 
+bool DAG::holdsVariable(Node *node) const {
+	if (!node->isLeaf() && !((OperatorNode *) node)->getIdentifiers().empty())
+		return true;
+
+	// leaves, and nodes assigned by a MOVE, are not listed in identifiers
+	for (const IdentifierMap::value_type &mapping : identifierMapper) {
+		if (mapping.second == node)
+			return true;
+	}
+	return false;
+}
+
+// Operands of the value number of 'node', false if it is not numbered
+bool DAG::getNumberedOperands(Node *node, Node *&left, Node *&right) const {
+	const Node::NodeList &operands = node->getSuccessors();
+	if (!ValueNumberTable::isNumbered(node->getLabel()) || operands.empty() || operands.size() > 2)
+		return false;
+	left = operands[0];
+	right = operands.back();
+	return true;
+}
+
+void DAG::replaceAllUses(Node *from, Node *to) {
+	if (from == to)
+		return;
+	disableEdits();
+
+	for (Node *user : from->getPredecessors()) {
+		// keep the value number of the user keyed by its current operands
+		Node *left, *right;
+		bool numbered = getNumberedOperands(user, left, right)
+				&& valueNumbers.lookup(user->getLabel(), left, right) == user;
+		if (numbered)
+			valueNumbers.erase(user->getLabel(), left, right, user);
+
+		user->replaceSuccessor(from, to);
+		to->addPredecessor(user);
+
+		if (numbered && getNumberedOperands(user, left, right)
+				&& valueNumbers.lookup(user->getLabel(), left, right) == 0)
+			valueNumbers.insert(user->getLabel(), left, right, user);
+	}
+	from->clearPredecessors();
+
+	// variables holding the value of 'from' now hold the value of 'to'
+	OperatorNode *fromOperator = from->isLeaf() ? 0 : (OperatorNode *) from;
+	OperatorNode *toOperator = to->isLeaf() ? 0 : (OperatorNode *) to;
+	if (fromOperator) {
+		for (LocalVariable *identifier : fromOperator->getIdentifiers()) {
+			identifierMapper[identifier] = to;
+			if (toOperator && !toOperator->hasIdentifier(identifier))
+				toOperator->addIdentifier(identifier);
+		}
+		fromOperator->clearIdentifiers();
+	} else {
+		for (IdentifierMap::value_type &mapping : identifierMapper) {
+			if (mapping.second == from) {
+				mapping.second = to;
+				if (toOperator && !toOperator->hasIdentifier(mapping.first))
+					toOperator->addIdentifier(mapping.first);
+			}
+		}
+	}
+}
+
+void DAG::removeNodes(const unordered_set<Node *> &nodes) {
+	if (nodes.empty())
+		return;
+	disableEdits();
+
+	// one pass over the users of each operand: shared leaves have long lists
+	unordered_set<Node *> operands;
+	for (Node *node : nodes) {
+		Node *left, *right;
+		if (getNumberedOperands(node, left, right))
+			valueNumbers.erase(node->getLabel(), left, right, node);
+		operands.insert(node->getSuccessors().begin(), node->getSuccessors().end());
+	}
+	for (Node *operand : operands)
+		operand->removePredecessors(nodes);
+
+	for (IdentifierMap::iterator i = identifierMapper.begin(); i != identifierMapper.end();) {
+		if (nodes.count(i->second))
+			i = identifierMapper.erase(i);
+		else
+			++i;
+	}
+	for (ConstantMap::iterator i = constantMapper.begin(); i != constantMapper.end();) {
+		if (nodes.count(i->second))
+			i = constantMapper.erase(i);
+		else
+			++i;
+	}
+	for (LoadMap::iterator i = loadMapper.begin(); i != loadMapper.end();) {
+		if (nodes.count(i->second))
+			i = loadMapper.erase(i);
+		else
+			++i;
+	}
+	effects.erase(remove_if(effects.begin(), effects.end(),
+			[&nodes](Node *node) { return nodes.count(node) != 0; }), effects.end());
+
+	for (unsigned op = 0; op < NUMBER_OF_OPERATORS; op++) {
+		DAGNodes &list = operatorArray[op];
+		list.erase(remove_if(list.begin(), list.end(),
+				[&nodes](Node *node) { return nodes.count(node) != 0; }), list.end());
+	}
+	vertices.erase(remove_if(vertices.begin(), vertices.end(),
+			[&nodes](Node *node) { return nodes.count(node) != 0; }), vertices.end());
+
+	if (arena == 0) {
+		for (Node *node : nodes)
+			delete node;
+	}
+}
+
+Node * DAG::addReduction(Operator op, Node *operand) {
+	Node *reductionNode = valueNumbers.lookup(op, operand, operand);
+
+	if (reductionNode == 0) {
+		reductionNode = registerNode(createNode<OperatorNode>(op, operand));
+		valueNumbers.insert(op, operand, operand, reductionNode);
+	}
+	return reductionNode;
+}
+
+Node * DAG::addConstant(int value) {
+	ConstantMap::iterator position = constantMapper.find(value);
+	if (position != constantMapper.end())
+		return position->second;
+
+	Constant *constant;
+	if (arena) {
+		constant = arena->create<Constant>(arena->create<Integer>(value));
+	} else {
+		Integer *integer = new Integer(value);
+		constant = new Constant(integer);
+		ownedValues.push_back(integer);
+		ownedInstructions.push_back(constant);
+	}
+	return addNode(constant);
+}
+
+FusedNode * DAG::addFusedNode(const vector<Node *> &inputs, const vector<FusedOperation> &program) {
+	disableEdits();
+	FusedNode *node = createNode<FusedNode>(inputs, program);
+	registerNode(node);
+	return node;
+}
+
+FlatDAG DAG::freeze() const {
+	return FlatDAG(*this);
+}
+
+Node * DAG::getNode(LocalVariable *variable) const {
+	IdentifierMap::const_iterator position = identifierMapper.find(variable);
+	if (position == identifierMapper.end())
+		return 0;
+	return position->second;
+}
+
 const DAG::DAGNodes& DAG::getDAGNodes() const {
 	return vertices;
 }
 
 DAG::~DAG() {
-	for (auto *node : vertices) {
-		delete node;
+	// arena nodes are released all at once with their context
+	if (arena == 0) {
+		for (auto *node : vertices) {
+			delete node;
+		}
 	}
+	for (Instruction *instruction : ownedInstructions)
+		delete instruction;
+	for (Value *value : ownedValues)
+		delete value;
+	delete [] operatorArray;
 }
 
 void DAG::print() const {
@@ -350,3 +803,736 @@ void DAG::print() const {
 			cout << "\n \n";
 	}
 }
+
+static void addRead(Instruction *operand, vector<LocalVariable *> &reads) {
+	if (operand != 0 && operand->getInstructionID() == LOCALVARIABLE
+			&& find(reads.begin(), reads.end(), operand) == reads.end())
+		reads.push_back((LocalVariable *) operand);
+}
+
+static void addArgumentReads(Call *call, vector<LocalVariable *> &reads) {
+	for (Instruction *argument : call->getArguments())
+		addRead(argument->resolve(), reads);
+}
+
+// The variables read by the instruction, each one once
+static void collectReads(Instruction *instruction, vector<LocalVariable *> &reads) {
+	reads.clear();
+
+	switch (instruction->getInstructionID()) {
+
+	case LOCALVARIABLE:
+		addRead(instruction, reads);
+		break;
+
+	case PRINT:
+		addRead(((Print *) instruction)->getOperand(), reads);
+		break;
+
+	case CALL:
+		addArgumentReads((Call *) instruction, reads);
+		break;
+
+	case MOVE: {
+		Instruction *rightValue = ((Move *) instruction)->getRightValue();
+
+		switch (rightValue->getInstructionID()) {
+		case MUL:
+		case ADD:
+		case DOT:
+			addRead(((BinaryInstruction *) rightValue)->getFirstOperand(), reads);
+			addRead(((BinaryInstruction *) rightValue)->getSecondOperand(), reads);
+			break;
+		case SUM:
+		case MIN:
+		case MAX:
+			addRead(((Reduction *) rightValue)->getOperand(), reads);
+			break;
+		case CALL:
+			addArgumentReads((Call *) rightValue, reads);
+			break;
+		default:
+			// a copy of a variable, nothing for constants and loads
+			addRead(rightValue, reads);
+		}
+	}
+		break;
+
+	default:
+		;
+	}
+}
+
+// True when the instruction adds a PRINT or CALL node
+static bool hasEffect(Instruction *instruction) {
+	switch (instruction->getInstructionID()) {
+	case PRINT:
+	case CALL:
+		return true;
+	case MOVE:
+		return ((Move *) instruction)->getRightValue()->getInstructionID() == CALL;
+	default:
+		return false;
+	}
+}
+
+// True when the variable of the instruction is an identifier of its value
+// 'node', as addMove does it
+static bool namesValue(Instruction *instruction, Node *node) {
+	if (node == 0 || node->isLeaf() || instruction->getInstructionID() != MOVE)
+		return false;
+	Operator op = ((Move *) instruction)->getRightValue()->getInstructionID();
+	return op != CONSTANT && op != LOAD;
+}
+
+// The first record at or after 'order' in a list sorted by order
+template<typename Records>
+static typename Records::iterator findOrder(Records &records, uint64_t order) {
+	return lower_bound(records.begin(), records.end(), order,
+			[](typename Records::value_type record, uint64_t order) { return record->order < order; });
+}
+
+template<typename Records>
+static void insertRecord(Records &records, typename Records::value_type record) {
+	// the instructions of the block are mostly added at its end
+	if (records.empty() || records.back()->order < record->order)
+		records.push_back(record);
+	else
+		records.insert(findOrder(records, record->order), record);
+}
+
+template<typename Records>
+static void eraseRecord(Records &records, typename Records::value_type record) {
+	typename Records::iterator position = findOrder(records, record->order);
+	assert(position != records.end() && *position == record);
+	records.erase(position);
+}
+
+// The passes rewriting the DAG do not keep the instructions up to date,
+// nor the dirty nodes: the analyses run again on the whole DAG
+void DAG::disableEdits() {
+	editable = false;
+	editIndex.reset();
+	dirtyNodes.clear();
+}
+
+// Record the position of a new node, for its removal, and mark it dirty
+// when an edit adds it
+void DAG::indexNode(Node *node) {
+	EditIndex &index = *editIndex;
+	assert(node->getId() == index.nodes.size());
+	EditIndex::NodeEntry entry = EditIndex::NodeEntry();
+	entry.vertexPosition = vertices.size();
+	entry.labelPosition = operatorArray[node->getLabel()].size();
+	index.nodes.push_back(entry);
+	if (index.editing)
+		markDirty(node);
+}
+
+void DAG::markDirty(Node *node) {
+	EditIndex::NodeEntry &entry = editIndex->nodes[node->getId()];
+	if (!entry.dirty) {
+		entry.dirty = true;
+		dirtyNodes.push_back(node);
+	}
+}
+
+bool DAG::isDirty(Node *node) const {
+	return editIndex && editIndex->nodes[node->getId()].dirty;
+}
+
+void DAG::clearDirtyNodes() {
+	if (editIndex) {
+		for (Node *node : dirtyNodes)
+			editIndex->nodes[node->getId()].dirty = false;
+	}
+	dirtyNodes.clear();
+}
+
+DAG::EditIndex &DAG::getEditIndex() {
+	if (!editable)
+		throw logic_error("the DAG cannot be edited: it was built without edits, from a flat block, or rewritten by a pass");
+	return *editIndex;
+}
+
+// Index the instruction with 'order', before 'next' (at the end when 0)
+DAG::InstructionRecord * DAG::addRecord(Instruction *instruction, uint64_t order, InstructionRecord *next) {
+	EditIndex &index = *editIndex;
+	InstructionRecord *&position = index.instructions[instruction];
+	if (position)
+		throw invalid_argument("the instruction is already in the DAG");
+
+	InstructionRecord *record;
+	if (index.freeRecords.empty()) {
+		index.records.push_back(InstructionRecord());
+		record = &index.records.back();
+	} else {
+		record = index.freeRecords.back();
+		index.freeRecords.pop_back();
+	}
+	position = record;
+	record->instruction = instruction;
+	record->node = 0;
+	record->order = order;
+	record->variable = instruction->getInstructionID() == MOVE ? ((Move *) instruction)->getVariable() : 0;
+	record->invalid = false;
+
+	record->next = next;
+	record->previous = next ? next->previous : index.last;
+	(record->previous ? record->previous->next : index.first) = record;
+	(next ? next->previous : index.last) = record;
+
+	indexRecord(record, true);
+	return record;
+}
+
+// Add the record to the assignments and reads of its variables, or take
+// it out of them
+void DAG::indexRecord(InstructionRecord *record, bool add) {
+	EditIndex &index = *editIndex;
+	if (record->variable) {
+		EditIndex::Records &definitions = index.variables[record->variable].definitions;
+		if (add)
+			insertRecord(definitions, record);
+		else
+			eraseRecord(definitions, record);
+	}
+
+	collectReads(record->instruction, index.reads);
+	for (LocalVariable *variable : index.reads) {
+		EditIndex::Records &readers = index.variables[variable].readers;
+		if (add)
+			insertRecord(readers, record);
+		else
+			eraseRecord(readers, record);
+	}
+}
+
+// 'node' is now the value of the instruction of 'record'
+void DAG::setValue(InstructionRecord *record, Node *node) {
+	record->node = node;
+	if (node) {
+		editIndex->nodes[node->getId()].references++;
+		if (hasEffect(record->instruction))
+			editIndex->effectRecords[node] = record;
+	}
+}
+
+DAG::InstructionRecord * DAG::findRecord(Instruction *instruction) {
+	EditIndex::RecordMap::iterator record = editIndex->instructions.find(instruction);
+	if (record == editIndex->instructions.end())
+		throw invalid_argument("the instruction is not in the DAG");
+	return record->second;
+}
+
+// Order of an instruction added before 'next' (at the end when 0)
+uint64_t DAG::newOrder(InstructionRecord *next) {
+	InstructionRecord *previous = next ? next->previous : editIndex->last;
+	uint64_t after = previous ? previous->order : 0;
+	uint64_t before = next ? next->order : after + 2 * ORDER_GAP;
+	if (before < after + 2) {
+		relabel(next);
+		return newOrder(next);
+	}
+	return after + (before - after) / 2;
+}
+
+// Spread again the orders of the instructions around 'next', when there
+// is no room left before it: the smallest window of instructions, doubled
+// until it is found, whose orders leave room for MIN_SPACING insertions
+// at the same place afterwards. The instructions keep their relative
+// order, so do the lists sorted by order.
+void DAG::relabel(InstructionRecord *next) {
+	EditIndex &index = *editIndex;
+	// the window goes from 'first' up to 'last' excluded, 0 is the end
+	InstructionRecord *first = next;
+	InstructionRecord *last = next;
+	size_t count = 0;
+	uint64_t low, high;
+	for (size_t width = 1;; width *= 2) {
+		for (size_t i = 0; i < width && (first ? first->previous : index.last) != 0; i++, count++)
+			first = first ? first->previous : index.last;
+		for (size_t i = 0; i < width && last != 0; i++, count++)
+			last = last->next;
+		InstructionRecord *before = first ? first->previous : index.last;
+		low = before ? before->order : 0;
+		high = last ? last->order : UINT64_MAX;
+		if ((high - low) / (count + 2) >= MIN_SPACING)
+			break;
+	}
+	uint64_t spacing = min((high - low) / (count + 2), ORDER_GAP);
+
+	// a free place is left before 'next', for the new instruction
+	uint64_t order = low;
+	for (InstructionRecord *record = first; record != last; record = record->next) {
+		order += spacing;
+		if (record == next)
+			order += spacing;
+		record->order = order;
+	}
+}
+
+// Value of 'variable' when 'record' reads it: the value of its previous
+// assignment, or the leaf of its value on entry to the block
+Node * DAG::readVariable(LocalVariable *variable, InstructionRecord *record) {
+	EditIndex::Variable &entry = editIndex->variables[variable];
+	EditIndex::Records::iterator definition = findOrder(entry.definitions, record->order);
+	while (definition != entry.definitions.begin()) {
+		--definition;
+		if ((*definition)->node)
+			return (*definition)->node;
+	}
+
+	if (entry.initialLeaf == 0) {
+		entry.initialLeaf = registerNode(createNode<LeafNode>(variable));
+		variableChanged(variable);
+	}
+	return entry.initialLeaf;
+}
+
+Node * DAG::readOperand(Instruction *operand, InstructionRecord *record) {
+	if (operand->getInstructionID() == LOCALVARIABLE)
+		return readVariable((LocalVariable *) operand, record);
+	return addLeafNode(operand);
+}
+
+vector<Node *> DAG::readArguments(Call *call, InstructionRecord *record) {
+	vector<Node *> operands;
+	for (Instruction *argument : call->getArguments())
+		operands.push_back(readOperand(argument->resolve(), record));
+	return operands;
+}
+
+// The node of the value of 'record', as the constructor adds it
+Node * DAG::evaluateRecord(InstructionRecord *record) {
+	Instruction *instruction = record->instruction;
+
+	switch (instruction->getInstructionID()) {
+
+	case LOCALVARIABLE:
+		return readVariable((LocalVariable *) instruction, record);
+
+	case PRINT:
+		return evaluateEffect(record, instruction,
+				vector<Node *>(1, readOperand(((Print *) instruction)->getOperand(), record)));
+
+	case CALL:
+		return evaluateEffect(record, instruction, readArguments((Call *) instruction, record));
+
+	case MOVE:
+		break;
+
+	default:
+		return 0;
+	}
+
+	Instruction *rightValue = ((Move *) instruction)->getRightValue();
+
+	switch (rightValue->getInstructionID()) {
+
+	case MUL:
+	case ADD:
+	case DOT: {
+		BinaryInstruction *expression = (BinaryInstruction *) rightValue;
+		Node *left = readOperand(expression->getFirstOperand(), record);
+		Node *right = readOperand(expression->getSecondOperand(), record);
+		return addOperation(expression->getInstructionID(), left, right);
+	}
+
+	case SUM:
+	case MIN:
+	case MAX:
+		return addReduction(rightValue->getInstructionID(),
+				readOperand(((Reduction *) rightValue)->getOperand(), record));
+
+	case LOCALVARIABLE:
+		return readVariable((LocalVariable *) rightValue, record);
+
+	case CONSTANT: {
+		// each assignment of a constant has its own MOVE node, which reads
+		// no variable: it does not change once created
+		if (record->node)
+			return record->node;
+		Node *rightValueNode = addNode((Constant *) rightValue);
+		Node *idNode = registerNode(createNode<LeafNode>(((Move *) instruction)->getVariable()));
+		return registerNode(createNode<OperatorNode>(MOVE, idNode, rightValueNode));
+	}
+
+	case LOAD:
+		return addNode((Load *) rightValue);
+
+	case CALL:
+		return evaluateEffect(record, rightValue, readArguments((Call *) rightValue, record));
+
+	default:
+		return 0;
+	}
+}
+
+// The PRINT or CALL node of 'record'. A new node is linked among the
+// effects in program order; an existing one gets its operands in place,
+// so the users of a call keep their node.
+Node * DAG::evaluateEffect(InstructionRecord *record, Instruction *instruction, const vector<Node *> &operands) {
+	EditIndex &index = *editIndex;
+	EffectNode *node = (EffectNode *) record->node;
+
+	if (node) {
+		for (unsigned i = 0; i < operands.size(); i++) {
+			Node *operand = node->getSuccessors()[i];
+			if (operand == operands[i])
+				continue;
+			node->setSuccessor(i, operands[i]);
+			operand->removePredecessor(node);
+			operands[i]->addPredecessor(node);
+			index.garbage.push_back(operand);
+			markDirty(node);
+		}
+		return node;
+	}
+
+	// the first effect after the instruction is linked to the new node
+	DAGNodes::iterator next = lower_bound(effects.begin(), effects.end(), record->order,
+			[&index](Node *effect, uint64_t order) { return index.effectRecords[effect]->order < order; });
+	Node *previous = next == effects.begin() ? 0 : *(next - 1);
+	node = createNode<EffectNode>(instruction, operands, previous);
+	registerNode(node);
+	index.effectRecords[node] = record;
+
+	if (next != effects.end()) {
+		EffectNode *following = (EffectNode *) *next;
+		if (previous) {
+			following->setSuccessor(following->getNumberOfOperands(), node);
+			previous->removePredecessor(following);
+		} else {
+			following->addSuccessor(node);
+		}
+		node->addPredecessor(following);
+		markDirty(following);
+	}
+	effects.insert(next, node);
+	return node;
+}
+
+// Link the effects around the PRINT or CALL node of a removed instruction
+void DAG::unlinkEffect(EffectNode *node) {
+	EditIndex &index = *editIndex;
+	unordered_map<Node *, InstructionRecord *>::iterator record = index.effectRecords.find(node);
+	DAGNodes::iterator position = lower_bound(effects.begin(), effects.end(), record->second->order,
+			[&index](Node *effect, uint64_t order) { return index.effectRecords[effect]->order < order; });
+	assert(*position == node);
+	Node *previous = node->getPreviousEffect();
+
+	if (position + 1 != effects.end()) {
+		EffectNode *following = (EffectNode *) *(position + 1);
+		if (previous) {
+			following->setSuccessor(following->getNumberOfOperands(), previous);
+			previous->addPredecessor(following);
+		} else {
+			following->removeSuccessor(following->getNumberOfOperands());
+		}
+		node->removePredecessor(following);
+		markDirty(following);
+	}
+	effects.erase(position);
+	index.effectRecords.erase(record);
+}
+
+// Evaluate the instruction again, in program order with the others
+void DAG::invalidate(InstructionRecord *record) {
+	EditIndex &index = *editIndex;
+	if (record->invalid)
+		return;
+	record->invalid = true;
+	index.invalid.push_back(make_pair(record->order, record));
+	push_heap(index.invalid.begin(), index.invalid.end(), greater<pair<uint64_t, InstructionRecord *> >());
+}
+
+// The value of the variable assigned by 'record' changed: evaluate again
+// the instructions reading it, up to its next assignment (included, since
+// it may read the variable too)
+void DAG::invalidateReaders(InstructionRecord *record) {
+	variableChanged(record->variable);
+	EditIndex::Variable &variable = editIndex->variables[record->variable];
+
+	EditIndex::Records::iterator next = findOrder(variable.definitions, record->order + 1);
+	while (next != variable.definitions.end() && (*next)->node == 0)
+		++next;
+	uint64_t end = next == variable.definitions.end() ? UINT64_MAX : (*next)->order;
+
+	for (EditIndex::Records::iterator reader = findOrder(variable.readers, record->order + 1);
+			reader != variable.readers.end() && (*reader)->order <= end; ++reader)
+		invalidate(*reader);
+}
+
+// The latest value of the variable may have changed
+void DAG::variableChanged(LocalVariable *variable) {
+	EditIndex::Variable &entry = editIndex->variables[variable];
+	if (!entry.changed) {
+		entry.changed = true;
+		editIndex->changed.push_back(variable);
+	}
+}
+
+// One instruction less has the value of 'node'
+void DAG::release(Node *node) {
+	editIndex->nodes[node->getId()].references--;
+	editIndex->garbage.push_back(node);
+}
+
+void DAG::insertInstruction(Instruction *instruction, Instruction *position) {
+	if (instruction == 0)
+		return;
+	EditIndex &index = getEditIndex();
+	InstructionRecord *next = position ? findRecord(position) : 0;
+	if (index.instructions.count(instruction))
+		throw invalid_argument("the instruction is already in the DAG");
+
+	index.editing = true;
+	invalidate(addRecord(instruction, newOrder(next), next));
+	update();
+}
+
+void DAG::removeInstruction(Instruction *instruction) {
+	getEditIndex();
+	InstructionRecord *record = findRecord(instruction);
+	editIndex->editing = true;
+	detachRecord(record);
+	update();
+}
+
+void DAG::replaceInstruction(Instruction *instruction, Instruction *replacement) {
+	EditIndex &index = getEditIndex();
+	InstructionRecord *record = findRecord(instruction);
+	if (replacement == 0 || index.instructions.count(replacement))
+		throw invalid_argument("the replacement is already in the DAG");
+
+	// the replacement takes the place and the order of the instruction
+	index.editing = true;
+	InstructionRecord *next = record->next;
+	uint64_t order = detachRecord(record);
+	invalidate(addRecord(replacement, order, next));
+	update();
+}
+
+// Take the instruction of 'record' out of the index, returns its order
+uint64_t DAG::detachRecord(InstructionRecord *record) {
+	EditIndex &index = *editIndex;
+	index.instructions.erase(record->instruction);
+	indexRecord(record, false);
+	(record->previous ? record->previous->next : index.first) = record->next;
+	(record->next ? record->next->previous : index.last) = record->previous;
+
+	if (record->node) {
+		if (hasEffect(record->instruction))
+			unlinkEffect((EffectNode *) record->node);
+		release(record->node);
+	}
+	if (record->variable)
+		invalidateReaders(record);
+	index.freeRecords.push_back(record);
+	return record->order;
+}
+
+// Evaluate the invalid instructions in program order, then update the
+// variables and remove the nodes left without users
+void DAG::update() {
+	EditIndex &index = *editIndex;
+	while (!index.invalid.empty()) {
+		pop_heap(index.invalid.begin(), index.invalid.end(), greater<pair<uint64_t, InstructionRecord *> >());
+		InstructionRecord *record = index.invalid.back().second;
+		index.invalid.pop_back();
+		record->invalid = false;
+
+		Node *node = evaluateRecord(record);
+		Node *previous = record->node;
+		if (node == previous)
+			continue;
+		setValue(record, node);
+		if (previous)
+			release(previous);
+		if (record->variable)
+			invalidateReaders(record);
+	}
+	updateVariables();
+	collectGarbage();
+	index.editing = false;
+}
+
+// Map the variables whose value changed to the value of their last
+// assignment, and move their identifier to it
+void DAG::updateVariables() {
+	EditIndex &index = *editIndex;
+	for (LocalVariable *variable : index.changed) {
+		EditIndex::Variable &entry = index.variables[variable];
+		entry.changed = false;
+
+		InstructionRecord *last = 0;
+		for (EditIndex::Records::reverse_iterator definition = entry.definitions.rbegin();
+				last == 0 && definition != entry.definitions.rend(); ++definition) {
+			if ((*definition)->node)
+				last = *definition;
+		}
+
+		Node *node = last ? last->node : entry.initialLeaf;
+		bool named = last != 0 && namesValue(last->instruction, node);
+
+		IdentifierMap::iterator mapping = identifierMapper.find(variable);
+		Node *previous = mapping == identifierMapper.end() ? 0 : mapping->second;
+		if (previous && !previous->isLeaf() && (previous != node || !named))
+			((OperatorNode *) previous)->removeIdentifier(variable);
+
+		if (node)
+			identifierMapper[variable] = node;
+		else if (mapping != identifierMapper.end())
+			identifierMapper.erase(mapping);
+		if (named && !((OperatorNode *) node)->hasIdentifier(variable))
+			((OperatorNode *) node)->addIdentifier(variable);
+	}
+	index.changed.clear();
+}
+
+// Remove the nodes of the garbage list that no instruction nor node uses,
+// and then their operands
+void DAG::collectGarbage() {
+	EditIndex &index = *editIndex;
+	vector<Node *> removed;
+	// the operands of the removed nodes, with the number of their users
+	// found dead in 'count'
+	vector<Node *> operands;
+	bool dirtyRemoved = false;
+
+	while (!index.garbage.empty()) {
+		Node *node = index.garbage.back();
+		index.garbage.pop_back();
+		EditIndex::NodeEntry &entry = index.nodes[node->getId()];
+		if (entry.removed || entry.references != 0 || node->getPredecessors().size() != entry.count)
+			continue;
+
+		entry.removed = true;
+		dirtyRemoved = dirtyRemoved || entry.dirty;
+		removed.push_back(node);
+		for (Node *operand : node->getSuccessors()) {
+			if (index.nodes[operand->getId()].count++ == 0)
+				operands.push_back(operand);
+			index.garbage.push_back(operand);
+		}
+	}
+
+	// one pass over the end of the users of each operand: shared leaves
+	// have long lists, and the users of the latest instructions come last
+	for (Node *operand : operands) {
+		EditIndex::NodeEntry &entry = index.nodes[operand->getId()];
+		if (!entry.removed)
+			operand->removeLatestPredecessors(
+					[&index](Node *user) { return index.nodes[user->getId()].removed; }, entry.count);
+		entry.count = 0;
+	}
+	for (Node *node : removed) {
+		// the value number is keyed by the operands
+		Node *left, *right;
+		if (getNumberedOperands(node, left, right))
+			valueNumbers.erase(node->getLabel(), left, right, node);
+		forgetNode(node);
+	}
+	if (dirtyRemoved) {
+		dirtyNodes.erase(remove_if(dirtyNodes.begin(), dirtyNodes.end(),
+				[&index](Node *node) { return index.nodes[node->getId()].removed; }), dirtyNodes.end());
+	}
+
+	if (arena == 0) {
+		for (Node *node : removed)
+			delete node;
+	}
+}
+
+void DAG::forgetNode(Node *node) {
+	EditIndex &index = *editIndex;
+
+	switch (node->getLabel()) {
+
+	case CONSTANT: {
+		ConstantMap::iterator position = constantMapper.find(((Constant *) ((LeafNode *) node)->getLeaf())->valueNumber());
+		if (position != constantMapper.end() && position->second == node)
+			constantMapper.erase(position);
+	}
+		break;
+
+	case LOAD: {
+		LoadMap::iterator position = loadMapper.find(((Load *) ((LeafNode *) node)->getLeaf())->getObjectName());
+		if (position != loadMapper.end() && position->second == node)
+			loadMapper.erase(position);
+	}
+		break;
+
+	case LOCALVARIABLE: {
+		LocalVariable *variable = (LocalVariable *) ((LeafNode *) node)->getLeaf();
+		unordered_map<LocalVariable *, EditIndex::Variable>::iterator entry = index.variables.find(variable);
+		if (entry != index.variables.end() && entry->second.initialLeaf == node)
+			entry->second.initialLeaf = 0;
+		IdentifierMap::iterator mapping = identifierMapper.find(variable);
+		if (mapping != identifierMapper.end() && mapping->second == node)
+			identifierMapper.erase(mapping);
+	}
+		break;
+
+	default:
+		;
+	}
+
+	// swap the node with the last one of its lists, and drop it
+	EditIndex::NodeEntry &entry = index.nodes[node->getId()];
+	Node *last = vertices.back();
+	vertices[entry.vertexPosition] = last;
+	index.nodes[last->getId()].vertexPosition = entry.vertexPosition;
+	vertices.pop_back();
+
+	DAGNodes &list = operatorArray[node->getLabel()];
+	last = list.back();
+	list[entry.labelPosition] = last;
+	index.nodes[last->getId()].labelPosition = entry.labelPosition;
+	list.pop_back();
+}
+
+vector<Node *> DAG::getDirtyRegion() const {
+	vector<Node *> ordered;
+	if (!editIndex)
+		return ordered;
+	vector<EditIndex::NodeEntry> &nodes = editIndex->nodes;
+
+	// the dirty nodes and their users, with the number of their operands
+	// in the region not ordered yet
+	vector<Node *> region(dirtyNodes.begin(), dirtyNodes.end());
+	for (Node *node : region)
+		nodes[node->getId()].marked = true;
+	for (size_t i = 0; i < region.size(); i++) {
+		for (Node *user : region[i]->getPredecessors()) {
+			EditIndex::NodeEntry &entry = nodes[user->getId()];
+			if (!entry.marked) {
+				entry.marked = true;
+				region.push_back(user);
+			}
+		}
+	}
+	for (Node *node : region) {
+		for (Node *operand : node->getSuccessors()) {
+			if (nodes[operand->getId()].marked)
+				nodes[node->getId()].count++;
+		}
+	}
+
+	for (Node *node : region) {
+		if (nodes[node->getId()].count == 0)
+			ordered.push_back(node);
+	}
+	for (size_t i = 0; i < ordered.size(); i++) {
+		for (Node *user : ordered[i]->getPredecessors()) {
+			if (--nodes[user->getId()].count == 0)
+				ordered.push_back(user);
+		}
+	}
+	for (Node *node : region) {
+		nodes[node->getId()].marked = false;
+		nodes[node->getId()].count = 0;
+	}
+	return ordered;
+}
@@ -0,0 +1,233 @@
+#include "ir/flatBlock.h"
+#include "cfg/basicBlock.h"
+#include <iostream>
+#include <assert.h>
+
+using namespace std;
+
+const uint32_t FlatBlock::CONSTANT_OPERAND;
+const uint32_t FlatBlock::NO_DESTINATION;
+
+FlatBlock::FlatBlock(CompilationContext *ctx) :
+		context(ctx),
+		instructions(ArenaAllocator<FlatInstruction>(ctx ? &ctx->getArena() : 0)),
+		constants(ArenaAllocator<Constant *>(ctx ? &ctx->getArena() : 0)),
+		constantIndex(0, hash<int>(), equal_to<int>(),
+				ArenaAllocator<pair<const int, uint32_t> >(ctx ? &ctx->getArena() : 0)),
+		variables(ArenaAllocator<LocalVariable *>(ctx ? &ctx->getArena() : 0)),
+		loads(ArenaAllocator<Load *>(ctx ? &ctx->getArena() : 0)),
+		effects(ArenaAllocator<Instruction *>(ctx ? &ctx->getArena() : 0)) {
+}
+
+FlatBlock::~FlatBlock() {
+	for (Instruction *instruction : ownedInstructions)
+		delete instruction;
+	for (Value *value : ownedValues)
+		delete value;
+}
+
+uint32_t FlatBlock::addConstant(int value) {
+	auto position = constantIndex.find(value);
+	if (position != constantIndex.end())
+		return position->second | CONSTANT_OPERAND;
+
+	Constant *constant;
+	if (context) {
+		constant = context->create<Constant>(context->create<Integer>(value));
+	} else {
+		Integer *integer = new Integer(value);
+		constant = new Constant(integer);
+		ownedValues.push_back(integer);
+		ownedInstructions.push_back(constant);
+	}
+	return addConstant(constant);
+}
+
+uint32_t FlatBlock::addConstant(Constant *constant) {
+	int value = constant->valueNumber();
+	auto position = constantIndex.find(value);
+	if (position != constantIndex.end())
+		return position->second | CONSTANT_OPERAND;
+
+	uint32_t index = constants.size();
+	constants.push_back(constant);
+	constantIndex[value] = index;
+	return index | CONSTANT_OPERAND;
+}
+
+LocalVariable * FlatBlock::getVariable(uint32_t slot) {
+	if (slot >= variables.size())
+		variables.resize(slot + 1, 0);
+
+	if (variables[slot] == 0) {
+		if (context) {
+			variables[slot] = context->create<LocalVariable>(slot);
+		} else {
+			variables[slot] = new LocalVariable(slot);
+			ownedInstructions.push_back(variables[slot]);
+		}
+	}
+	return variables[slot];
+}
+
+void FlatBlock::addVariable(LocalVariable *variable) {
+	uint32_t slot = variable->getSlotNumber();
+	if (slot >= variables.size())
+		variables.resize(slot + 1, 0);
+
+	// the first variable seen for a slot represents it
+	if (variables[slot] == 0)
+		variables[slot] = variable;
+}
+
+uint32_t FlatBlock::lowerOperand(Instruction *operand) {
+	switch (operand->getInstructionID()) {
+
+	case LOCALVARIABLE:
+		addVariable((LocalVariable *) operand);
+		return ((LocalVariable *) operand)->getSlotNumber();
+
+	case CONSTANT:
+		return addConstant((Constant *) operand);
+
+	default:
+		// three-address operands are always variables or constants
+		assert(false && "Invalid operand for a three-address instruction");
+		return 0;
+	}
+}
+
+uint32_t FlatBlock::lowerEffect(Instruction *effect) {
+	// the operands stay in the instruction; record their variables and constants
+	if (effect->getInstructionID() == PRINT) {
+		lowerOperand(((Print *) effect)->getOperand());
+	} else {
+		for (Instruction *argument : ((Call *) effect)->getArguments())
+			lowerOperand(argument->resolve());
+	}
+	return addEffect(effect);
+}
+
+FlatBlock * FlatBlock::lower(BasicBlock *basicBlock) {
+	CompilationContext *context = basicBlock->getContext();
+	FlatBlock *flatBlock = context ? context->create<FlatBlock>(context) : new FlatBlock();
+
+	unsigned size = 0;
+	for (Instruction *i = basicBlock->getFirst(); i != 0; i = i->getNext())
+		size++;
+	flatBlock->reserve(size);
+
+	for (Instruction *i = basicBlock->getFirst(); i != 0; i = i->getNext()) {
+		switch (i->getInstructionID()) {
+
+		case LOCALVARIABLE: {
+			LocalVariable *variable = (LocalVariable *) i;
+			flatBlock->addVariable(variable);
+			flatBlock->append(LOCALVARIABLE, variable->getSlotNumber());
+		}
+			break;
+
+		case MOVE: {
+			Move *move = (Move *) i;
+			LocalVariable *variable = move->getVariable();
+			Instruction *rightValue = move->getRightValue();
+			flatBlock->addVariable(variable);
+
+			switch (rightValue->getInstructionID()) {
+
+			case ADD:
+			case MUL:
+			case DOT: {
+				BinaryInstruction *expression = (BinaryInstruction *) rightValue;
+				uint32_t operand0 = flatBlock->lowerOperand(expression->getFirstOperand());
+				uint32_t operand1 = flatBlock->lowerOperand(expression->getSecondOperand());
+				flatBlock->append(rightValue->getInstructionID(), variable->getSlotNumber(),
+						operand0, operand1);
+			}
+				break;
+
+			case SUM:
+			case MIN:
+			case MAX:
+				flatBlock->append(rightValue->getInstructionID(), variable->getSlotNumber(),
+						flatBlock->lowerOperand(((Reduction *) rightValue)->getOperand()));
+				break;
+
+			case LOAD:
+				flatBlock->append(LOAD, variable->getSlotNumber(), flatBlock->addLoad((Load *) rightValue));
+				break;
+
+			case CALL:
+				flatBlock->append(CALL, variable->getSlotNumber(), flatBlock->lowerEffect(rightValue));
+				break;
+
+			default:
+				flatBlock->append(MOVE, variable->getSlotNumber(), flatBlock->lowerOperand(rightValue));
+				break;
+			}
+		}
+			break;
+
+		case PRINT:
+		case CALL:
+			flatBlock->append(i->getInstructionID(), NO_DESTINATION, flatBlock->lowerEffect(i));
+			break;
+
+		default:
+			// only declarations, assignments and effects appear at the top level of a block
+			assert(false && "Invalid three-address instruction");
+			break;
+		}
+	}
+	return flatBlock;
+}
+
+void FlatBlock::print() {
+	for (const FlatInstruction &i : instructions) {
+		switch (i.opcode) {
+
+		case LOCALVARIABLE:
+			getVariable(i.destination)->print();
+			break;
+
+		case MOVE:
+			getVariable(i.destination)->print();
+			cout << " <- ";
+			getOperand(i.operand0)->print();
+			break;
+
+		case LOAD:
+			getVariable(i.destination)->print();
+			cout << " <- ";
+			getLoad(i.operand0)->print();
+			break;
+
+		case PRINT:
+		case CALL:
+			if (i.destination != NO_DESTINATION) {
+				getVariable(i.destination)->print();
+				cout << " <- ";
+			}
+			getEffect(i.operand0)->print();
+			break;
+
+		case SUM:
+		case MIN:
+		case MAX:
+			getVariable(i.destination)->print();
+			cout << " <- ";
+			cout << " " << getOperatorName((Operator) i.opcode) << " ";
+			getOperand(i.operand0)->print();
+			break;
+
+		default:
+			getVariable(i.destination)->print();
+			cout << " <- ";
+			cout << " " << getOperatorName((Operator) i.opcode) << " ";
+			getOperand(i.operand0)->print();
+			getOperand(i.operand1)->print();
+			break;
+		}
+		cout << "\n";
+	}
+}
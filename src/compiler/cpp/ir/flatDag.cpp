@@ -0,0 +1,149 @@
+#include "ir/flatDag.h"
+#include "ir/dag.h"
+#include <iostream>
+
+using namespace std;
+
+const FlatDAG::NodeId FlatDAG::INVALID_NODE;
+
+FlatDAG::FlatDAG(const DAG &dag) {
+	const DAG::DAGNodes &vertices = dag.getDAGNodes();
+	unsigned numberOfNodes = vertices.size();
+
+	// DAG node ids may have gaps once passes rewrite the DAG: map them to vertex positions
+	unsigned maxId = 0;
+	for (Node *node : vertices) {
+		if (node->getId() > maxId)
+			maxId = node->getId();
+	}
+	vector<uint32_t> position(maxId + 1, INVALID_NODE);
+	for (unsigned v = 0; v < numberOfNodes; v++) {
+		position[vertices[v]->getId()] = v;
+	}
+
+	// number the nodes in evaluation order (Kahn's algorithm on the operand counts),
+	// so any pass walking ids 0..n-1 sees operands before their users
+	vector<uint32_t> pendingOperands(numberOfNodes);
+	nodes.reserve(numberOfNodes);
+	for (unsigned v = 0; v < numberOfNodes; v++) {
+		pendingOperands[v] = vertices[v]->getSuccessors().size();
+		if (pendingOperands[v] == 0)
+			nodes.push_back(vertices[v]);
+	}
+	for (unsigned next = 0; next < nodes.size(); next++) {
+		for (Node *predecessor : nodes[next]->getPredecessors()) {
+			if (--pendingOperands[position[predecessor->getId()]] == 0)
+				nodes.push_back(predecessor);
+		}
+	}
+
+	flatId.assign(maxId + 1, INVALID_NODE);
+	for (unsigned n = 0; n < numberOfNodes; n++) {
+		flatId[nodes[n]->getId()] = n;
+	}
+
+	labels.resize(numberOfNodes);
+	leaves.resize(numberOfNodes);
+	successorOffsets.resize(numberOfNodes + 1);
+	identifierOffsets.resize(numberOfNodes + 1);
+
+	successorOffsets[0] = 0;
+	identifierOffsets[0] = 0;
+	for (unsigned n = 0; n < numberOfNodes; n++) {
+		Node *node = nodes[n];
+		labels[n] = node->getLabel();
+
+		leaves[n] = node->isLeaf() ? ((LeafNode *) node)->getLeaf() : 0;
+
+		for (Node *successor : node->getSuccessors()) {
+			successors.push_back(flatId[successor->getId()]);
+		}
+		successorOffsets[n + 1] = successors.size();
+
+		if (!node->isLeaf()) {
+			for (LocalVariable *identifier : ((OperatorNode *) node)->getIdentifiers()) {
+				identifiers.push_back(identifier);
+			}
+		}
+		identifierOffsets[n + 1] = identifiers.size();
+	}
+
+	// predecessors are the transposed successor arrays
+	predecessorOffsets.assign(numberOfNodes + 1, 0);
+	for (NodeId successor : successors) {
+		predecessorOffsets[successor + 1]++;
+	}
+	for (unsigned n = 0; n < numberOfNodes; n++) {
+		predecessorOffsets[n + 1] += predecessorOffsets[n];
+	}
+	predecessors.resize(successors.size());
+	vector<uint32_t> fill(predecessorOffsets.begin(), predecessorOffsets.end() - 1);
+	for (NodeId n = 0; n < numberOfNodes; n++) {
+		for (uint32_t e = successorOffsets[n]; e < successorOffsets[n + 1]; e++) {
+			predecessors[fill[successors[e]]++] = n;
+		}
+	}
+}
+
+FlatDAG::NodeId FlatDAG::getNodeId(const Node *node) const {
+	if (node == 0 || node->getId() >= flatId.size())
+		return INVALID_NODE;
+	NodeId n = flatId[node->getId()];
+	if (n == INVALID_NODE || nodes[n] != node)
+		return INVALID_NODE;
+	return n;
+}
+
+vector<uint32_t> FlatDAG::indegrees() const {
+	unsigned numberOfNodes = getNumberOfNodes();
+	vector<uint32_t> indegrees(numberOfNodes);
+
+	for (NodeId n = 0; n < numberOfNodes; n++) {
+		indegrees[n] = predecessorOffsets[n + 1] - predecessorOffsets[n];
+	}
+	return indegrees;
+}
+
+vector<FlatDAG::NodeId> FlatDAG::evaluationOrder() const {
+	// node ids are assigned in evaluation order
+	vector<NodeId> order(getNumberOfNodes());
+	for (NodeId n = 0; n < order.size(); n++)
+		order[n] = n;
+	return order;
+}
+
+vector<uint32_t> FlatDAG::levels() const {
+	unsigned numberOfNodes = getNumberOfNodes();
+	vector<uint32_t> level(numberOfNodes);
+
+	// single sweep: operands always have smaller ids than their users
+	for (NodeId n = 0; n < numberOfNodes; n++) {
+		uint32_t l = 0;
+		for (uint32_t e = successorOffsets[n]; e < successorOffsets[n + 1]; e++) {
+			if (level[successors[e]] + 1 > l)
+				l = level[successors[e]] + 1;
+		}
+		level[n] = l;
+	}
+	return level;
+}
+
+void FlatDAG::print() const {
+	cout << endl << endl << "Flat DAG: " << endl;
+	for (NodeId n = 0; n < getNumberOfNodes(); n++) {
+		cout << n << ": ";
+		if (isLeaf(n)) {
+			cout << "leaf [";
+			leaves[n]->print();
+			cout << "]";
+		} else {
+			cout << getOperatorName(getLabel(n)) << " (";
+			for (const NodeId *s = successorsBegin(n); s != successorsEnd(n); ++s)
+				cout << " " << *s;
+			cout << " ) identifiers:";
+			for (LocalVariable * const *i = identifiersBegin(n); i != identifiersEnd(n); ++i)
+				(*i)->print();
+		}
+		cout << endl;
+	}
+}
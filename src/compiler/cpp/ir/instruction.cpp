@@ -4,6 +4,70 @@
 
 using namespace std;
 
+const char * getOperatorName(Operator op) {
+	switch (op) {
+	case CONSTANT:
+		return "CONSTANT";
+	case LOCALVARIABLE:
+		return "LOCALVARIABLE";
+	case MUL:
+		return "MUL";
+	case ADD:
+		return "ADD";
+	case MOVE:
+		return "MOVE";
+	case LOAD:
+		return "LOAD";
+	case FUSED:
+		return "FUSED";
+	case SUM:
+		return "SUM";
+	case MIN:
+		return "MIN";
+	case MAX:
+		return "MAX";
+	case DOT:
+		return "DOT";
+	case PRINT:
+		return "PRINT";
+	case CALL:
+		return "CALL";
+	case PHI:
+		return "PHI";
+	default:
+		return "INVALID";
+	}
+}
+
+namespace {
+
+// the print() and hashCode() of each class, called by dispatch()
+struct PrintFunction {
+	template<typename T>
+	void operator()(T &instruction) {
+		instruction.print();
+	}
+};
+
+struct HashCodeFunction {
+	template<typename T>
+	int operator()(T &instruction) {
+		return instruction.hashCode();
+	}
+};
+
+}
+
+void Instruction::print() {
+	PrintFunction function;
+	dispatch<void>(this, function);
+}
+
+int Instruction::hashCode() const {
+	HashCodeFunction function;
+	return dispatch<int>(const_cast<Instruction *>(this), function);
+}
+
 Instruction * Instruction::resolve() {
 	Instruction *p = this;
 
@@ -16,56 +80,44 @@ BinaryInstruction::~BinaryInstruction() {
 	// operands are deleted from the basic block instruction list
 }
 
-void BinaryInstruction::visitOperands(OperandVisitor &v) {
-	v.visitOperand(*operand0);
-	v.visitOperand(*operand1);
-}
-
 int BinaryInstruction::hashCode() const {
-	return ((op << 4) ^ (operand0->hashCode() >> 16) ^ (operand1->hashCode() << 16));
+	return ((id << 4) ^ (operand0->hashCode() >> 16) ^ (operand1->hashCode() << 16));
 }
 
-void Add::accept(InstructionVisitor &v) {
-	v.visit(*this);
-}
-
-void Mul::accept(InstructionVisitor &v) {
-	v.visit(*this);
-}
-
-void Constant::visitOperands(OperandVisitor &v) {
-	v.visitOperand(*this);
+int Reduction::hashCode() const {
+	return (id << 4) ^ (operand->hashCode() << 16);
 }
 
 int Constant::hashCode() const {
 	return value->valueNumber();
 }
 
-void Constant::accept(InstructionVisitor &v) {
-	v.visit(*this);
-}
-
-void LocalVariable::accept(InstructionVisitor &v) {
-	v.visit(*this);
+int LocalVariable::hashCode() const {
+	return slotNumber;
 }
 
-void LocalVariable::visitOperands(OperandVisitor &v) {
-	v.visitOperand(*this);
+int Load::hashCode() const {
+	return (int) hash<string>()(getObjectName());
 }
 
-int LocalVariable::hashCode() const {
-	return slotNumber;
+int Move::hashCode() const {
+	return (rightValue->hashCode() >> 16) ^ (variable->hashCode() << 16) ;
 }
 
-void Move::visitOperands(OperandVisitor &v) {
-	v.visitOperand(*rightValue);
-	v.visitOperand(*variable);
+int Print::hashCode() const {
+	return (PRINT << 4) ^ (operand->hashCode() << 16);
 }
 
-void Move::accept(InstructionVisitor &v) {
-	v.visit(*this);
+int Call::hashCode() const {
+	int hash = (int) std::hash<string>()(getFunction());
+	for (Instruction *argument : arguments)
+		hash ^= (hash >> 4) ^ (argument->hashCode() << 8);
+	return hash;
 }
 
-int Move::hashCode() const {
-	return (rightValue->hashCode() >> 16) ^ (variable->hashCode() << 16) ;
+int Phi::hashCode() const {
+	int hash = PHI << 4;
+	for (Instruction *operand : operands)
+		hash ^= (hash >> 4) ^ (operand->hashCode() << 8);
+	return hash;
 }
@@ -0,0 +1,582 @@
+#include "ir/irParser.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdexcept>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+
+using namespace std;
+
+// slots above this one are rejected rather than allocated
+static const unsigned MAX_SLOT = 1 << 24;
+
+// letters, digits, '_' and '.'
+static inline bool isWordCharacter(char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '.';
+}
+
+size_t IRParser::TokenHash::operator()(const Token &token) const {
+	// FNV-1a
+	size_t hash = (size_t) 0xCBF29CE484222325ULL;
+	for (size_t i = 0; i < token.length; i++)
+		hash = (hash ^ (unsigned char) token.text[i]) * (size_t) 0x100000001B3ULL;
+	return hash;
+}
+
+// Instructions parsed on the parser thread, handed to the consumer in
+// batches so that the two threads rarely meet on the lock. The parser
+// waits when MAX_BATCHES are pending, so it stays close to the consumer.
+struct IRParser::BatchQueue {
+	typedef vector<pair<BasicBlock *, Instruction *> > Batch;
+
+	static const size_t BATCH_SIZE = 4096;
+	static const size_t MAX_BATCHES = 8;
+
+	// thrown on the parser thread when the consumer gave up
+	struct Cancelled {
+	};
+
+	mutex              lock;
+	condition_variable changed;
+	deque<Batch>       batches;
+	Batch              current;    // filled by the parser thread
+	bool               done;
+	bool               cancelled;
+
+	BatchQueue() : done(false), cancelled(false) {
+		current.reserve(BATCH_SIZE);
+	}
+
+	void push(BasicBlock *block, Instruction *instruction) {
+		current.push_back(make_pair(block, instruction));
+		if (current.size() == BATCH_SIZE)
+			publish();
+	}
+
+	void publish() {
+		unique_lock<mutex> guard(lock);
+		changed.wait(guard, [this]() { return batches.size() < MAX_BATCHES || cancelled; });
+		if (cancelled)
+			throw Cancelled();
+		batches.push_back(Batch());
+		batches.back().swap(current);
+		current.reserve(BATCH_SIZE);
+		changed.notify_all();
+	}
+
+	// the parser thread is done, after publishing what it parsed
+	void close() {
+		lock_guard<mutex> guard(lock);
+		done = true;
+		changed.notify_all();
+	}
+
+	void cancel() {
+		lock_guard<mutex> guard(lock);
+		cancelled = true;
+		changed.notify_all();
+	}
+
+	// false when the parser is done and every batch was taken
+	bool pop(Batch &batch) {
+		unique_lock<mutex> guard(lock);
+		changed.wait(guard, [this]() { return !batches.empty() || done; });
+		if (batches.empty())
+			return false;
+		batch.swap(batches.front());
+		batches.pop_front();
+		changed.notify_all();
+		return true;
+	}
+};
+
+IRParser::IRParser(const string &path, CompilationContext &ctx) :
+		context(ctx), name(path), begin(0), end(0), cursor(0), line(1), mapping(0), mappingLength(0),
+		terminated(false), finished(false), numberOfInstructions(0), queue(0) {
+	int fileDescriptor = open(path.c_str(), O_RDONLY);
+	if (fileDescriptor < 0)
+		throw runtime_error("cannot open IR file " + path + ": " + strerror(errno));
+
+	struct stat status;
+	if (fstat(fileDescriptor, &status) != 0) {
+		close(fileDescriptor);
+		throw runtime_error("cannot read IR file " + path + ": " + strerror(errno));
+	}
+	mappingLength = status.st_size;
+	if (mappingLength != 0) {
+		mapping = mmap(0, mappingLength, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+		if (mapping == MAP_FAILED) {
+			close(fileDescriptor);
+			throw runtime_error("cannot map IR file " + path + ": " + strerror(errno));
+		}
+		// read once, front to back
+		madvise(mapping, mappingLength, MADV_SEQUENTIAL);
+	}
+	// the mapping stays valid without the descriptor
+	close(fileDescriptor);
+
+	begin = cursor = (const char *) mapping;
+	end = begin + mappingLength;
+}
+
+IRParser::IRParser(const char *text, size_t length, CompilationContext &ctx, const string &n) :
+		context(ctx), name(n), begin(text), end(text + length), cursor(text), line(1), mapping(0),
+		mappingLength(0), terminated(false), finished(false), numberOfInstructions(0), queue(0) {
+}
+
+IRParser::~IRParser() {
+	if (mapping != 0)
+		munmap(mapping, mappingLength);
+}
+
+BasicBlock * IRParser::parse() {
+	while (parseBlock() != 0)
+		;
+	return blocks.empty() ? 0 : blocks[0];
+}
+
+BasicBlock * IRParser::parseBlock() {
+	BasicBlock *block = 0;
+	while (skipBlankLines()) {
+		const char *start = cursor;
+		Token word = readWord();
+		skipSpaces();
+		if (word.length != 0 && cursor < end && *cursor == ':') {
+			// the next block starts: it is parsed by the next call
+			if (block != 0) {
+				cursor = start;
+				return block;
+			}
+			cursor++;
+			block = startBlock(word);
+			parseLabelLine(block);
+			continue;
+		}
+		// statements before the first label are the entry block
+		if (block == 0)
+			block = startBlock(Token { 0, 0 });
+		parseStatement(block, word);
+	}
+	if (block == 0)
+		finish();
+	return block;
+}
+
+void IRParser::parseConcurrently(const function<void(BasicBlock *, Instruction *)> &consume) {
+	BatchQueue batches;
+	exception_ptr failure;
+	queue = &batches;
+
+	thread parser([this, &batches, &failure]() {
+		try {
+			while (parseBlock() != 0)
+				;
+			if (!batches.current.empty())
+				batches.publish();
+		} catch (const BatchQueue::Cancelled &) {
+		} catch (...) {
+			failure = current_exception();
+		}
+		batches.close();
+	});
+
+	try {
+		BatchQueue::Batch batch;
+		while (batches.pop(batch)) {
+			for (const pair<BasicBlock *, Instruction *> &parsed : batch)
+				consume(parsed.first, parsed.second);
+		}
+	} catch (...) {
+		batches.cancel();
+		parser.join();
+		queue = 0;
+		throw;
+	}
+	parser.join();
+	queue = 0;
+	if (failure)
+		rethrow_exception(failure);
+}
+
+BasicBlock * IRParser::startBlock(const Token &label) {
+	BasicBlock *block;
+	if (label.length == 0) {
+		block = context.create<BasicBlock>((Instruction *) 0, (Instruction *) 0, &context);
+	} else {
+		block = getBlock(label);
+		Label &entry = labels[label];
+		if (entry.defined)
+			error("block " + string(label.text, label.length) + " is defined twice");
+		entry.defined = true;
+	}
+	blocks.push_back(block);
+	terminated = false;
+	return block;
+}
+
+void IRParser::parseLabelLine(BasicBlock *block) {
+	// e.g. "idom B0  loop B1 depth 1  preds B0 B2"
+	while (!atEndOfLine()) {
+		Token word = readWord();
+		if (word.length == 0)
+			error("unexpected " + found() + " after the label");
+		if (!word.is("preds"))
+			continue;
+		PredecessorOrder predecessors;
+		predecessors.block = block;
+		predecessors.line = line;
+		while (!atEndOfLine())
+			predecessors.order.push_back(getBlock(expectWord("a block label")));
+		predecessorOrders.push_back(predecessors);
+	}
+	expectEndOfLine();
+}
+
+void IRParser::parseStatement(BasicBlock *block, const Token &word) {
+	if (word.length == 0)
+		error("expected a statement, found " + found());
+	if (terminated)
+		error("statement after the end of the block");
+
+	if (word.is("goto")) {
+		block->setJump(getBlock(expectWord("a block label")));
+		terminated = true;
+	} else if (word.is("exit")) {
+		block->setExit();
+		terminated = true;
+	} else if (word.is("if")) {
+		parseBranch(block);
+	} else if (word.is("PRINT")) {
+		append(block, context.create<Print>(parseOperand()));
+	} else if (word.is("CALL")) {
+		// a call whose result is unused
+		append(block, parseCall());
+	} else {
+		LocalVariable *variable = getVariable(word);
+		skipSpaces();
+		if (cursor + 1 < end && cursor[0] == '<' && cursor[1] == '-') {
+			cursor += 2;
+			append(block, context.create<Move>(variable, parseRightValue()));
+		} else {
+			// a declaration links the variable itself into the block
+			int slot = variable->getSlotNumber();
+			if (declared[slot])
+				error("variable " + string(word.text, word.length) + " is declared twice");
+			declared[slot] = true;
+			append(block, variable);
+		}
+	}
+	expectEndOfLine();
+}
+
+void IRParser::parseBranch(BasicBlock *block) {
+	Instruction *left = parseOperand();
+	BranchCondition condition;
+	skipSpaces();
+	if (accept('<'))
+		condition = accept('=') ? BRANCH_LESS_EQUAL : BRANCH_LESS;
+	else if (accept('!') && accept('='))
+		condition = BRANCH_NOT_EQUAL;
+	else
+		error("expected <, <= or !=, found " + found());
+	Instruction *right = parseOperand();
+
+	expectKeyword("goto");
+	BasicBlock *taken = getBlock(expectWord("a block label"));
+	expectKeyword("else");
+	BasicBlock *notTaken = getBlock(expectWord("a block label"));
+	block->setBranch(condition, left, right, taken, notTaken);
+	terminated = true;
+}
+
+Instruction * IRParser::parseRightValue() {
+	Token word = expectWord("a right value");
+	if (word.is("ADD")) {
+		Instruction *left = parseOperand();
+		return context.create<Add>(left, parseOperand());
+	}
+	if (word.is("MUL")) {
+		Instruction *left = parseOperand();
+		return context.create<Mul>(left, parseOperand());
+	}
+	if (word.is("DOT")) {
+		Instruction *left = parseOperand();
+		return context.create<Dot>(left, parseOperand());
+	}
+	if (word.is("SUM"))
+		return context.create<Reduction>(SUM, parseOperand());
+	if (word.is("MIN"))
+		return context.create<Reduction>(MIN, parseOperand());
+	if (word.is("MAX"))
+		return context.create<Reduction>(MAX, parseOperand());
+	if (word.is("CALL"))
+		return parseCall();
+	if (word.is("PHI"))
+		return parsePhi();
+	return parseOperand(word);
+}
+
+Instruction * IRParser::parseOperand() {
+	return parseOperand(expectWord("an operand"));
+}
+
+Instruction * IRParser::parseOperand(const Token &word) {
+	if (word.is("CONSTANT")) {
+		expect('(');
+		int value = readInteger();
+		expect(')');
+		return getConstant(value);
+	}
+	if (word.is("LOAD"))
+		return parseLoad();
+	return getVariable(word);
+}
+
+Load * IRParser::parseLoad() {
+	expect('(');
+	Token object = readString();
+	expect(')');
+	return context.create<Load>(string(object.text, object.length), &context.getArena());
+}
+
+Call * IRParser::parseCall() {
+	Token function = expectWord("a function name");
+	expect('(');
+	vector<Instruction *> arguments;
+	while (!accept(')')) {
+		if (atEndOfLine())
+			error("expected ) at the end of the arguments");
+		arguments.push_back(parseOperand());
+	}
+	return context.create<Call>(string(function.text, function.length), arguments, &context.getArena());
+}
+
+Phi * IRParser::parsePhi() {
+	expect('(');
+	operands.clear();
+	while (!accept(')')) {
+		if (atEndOfLine())
+			error("expected ) at the end of the phi operands");
+		operands.push_back(parseOperand());
+	}
+	Phi *phi = context.create<Phi>(operands.size(), (Instruction *) 0, &context.getArena());
+	for (size_t i = 0; i < operands.size(); i++)
+		phi->setOperand(i, operands[i]);
+	return phi;
+}
+
+void IRParser::append(BasicBlock *block, Instruction *instruction) {
+	block->append(instruction);
+	numberOfInstructions++;
+	if (queue != 0)
+		queue->push(block, instruction);
+}
+
+void IRParser::finish() {
+	if (finished)
+		return;
+	finished = true;
+	for (const pair<const Token, Label> &label : labels) {
+		if (!label.second.defined) {
+			line = label.second.line;
+			error("block " + string(label.first.text, label.first.length) + " is not defined");
+		}
+	}
+	for (const PredecessorOrder &predecessors : predecessorOrders) {
+		if (!predecessors.block->setPredecessorOrder(predecessors.order)) {
+			line = predecessors.line;
+			error("the preds are not the predecessors of the block");
+		}
+	}
+}
+
+BasicBlock * IRParser::getBlock(const Token &label) {
+	auto found = labels.find(label);
+	if (found != labels.end())
+		return found->second.block;
+	BasicBlock *block = context.create<BasicBlock>((Instruction *) 0, (Instruction *) 0, &context);
+	labels[label] = Label { block, false, line };
+	return block;
+}
+
+LocalVariable * IRParser::getVariable(const Token &word) {
+	// vN, without leading zeros
+	if (word.text[0] == 'v' && word.length > 1 && word.length <= 9 && (word.length == 2 || word.text[1] != '0')) {
+		unsigned slot = 0;
+		size_t i = 1;
+		for (; i < word.length && word.text[i] >= '0' && word.text[i] <= '9'; i++)
+			slot = slot * 10 + (word.text[i] - '0');
+		if (i == word.length)
+			return getVariable(slot, false, word);
+	}
+
+	if (isKeyword(word) || !(isalpha((unsigned char) word.text[0]) || word.text[0] == '_'))
+		error("expected a variable, found " + string(word.text, word.length));
+
+	auto found = names.find(word);
+	if (found != names.end())
+		return found->second;
+	LocalVariable *variable = getVariable(variables.size(), true, word);
+	names[word] = variable;
+	return variable;
+}
+
+LocalVariable * IRParser::getVariable(unsigned slot, bool isNamed, const Token &word) {
+	if (slot > MAX_SLOT)
+		error("slot of " + string(word.text, word.length) + " too large");
+	if (slot >= variables.size()) {
+		variables.resize(slot + 1, 0);
+		declared.resize(slot + 1, false);
+		named.resize(slot + 1, false);
+	}
+	LocalVariable *variable = variables[slot];
+	if (variable == 0) {
+		variable = context.create<LocalVariable>(slot);
+		variables[slot] = variable;
+		named[slot] = isNamed;
+	} else if (named[slot] != isNamed) {
+		error(string(word.text, word.length) + " is in the slot of a named variable:"
+				" number all the variables (vN) or name them");
+	}
+	return variable;
+}
+
+Constant * IRParser::getConstant(int value) {
+	Constant *&constant = constants[value];
+	if (constant == 0)
+		constant = context.create<Constant>(context.create<Integer>(value));
+	return constant;
+}
+
+bool IRParser::isKeyword(const Token &word) {
+	return word.is("ADD") || word.is("MUL") || word.is("DOT") || word.is("SUM") || word.is("MIN")
+			|| word.is("MAX") || word.is("CONSTANT") || word.is("LOAD") || word.is("PRINT") || word.is("CALL")
+			|| word.is("PHI") || word.is("goto") || word.is("if") || word.is("else") || word.is("exit");
+}
+
+void IRParser::skipSpaces() {
+	while (cursor < end) {
+		char c = *cursor;
+		if (c == ' ' || c == '\t' || c == '\r') {
+			cursor++;
+		} else if (c == '#') {
+			// a comment, up to the end of the line
+			const char *newline = (const char *) memchr(cursor, '\n', end - cursor);
+			cursor = newline ? newline : end;
+		} else {
+			return;
+		}
+	}
+}
+
+bool IRParser::skipBlankLines() {
+	while (true) {
+		skipSpaces();
+		if (cursor == end || *cursor != '\n')
+			return cursor != end;
+		cursor++;
+		line++;
+	}
+}
+
+bool IRParser::atEndOfLine() {
+	skipSpaces();
+	return cursor == end || *cursor == '\n';
+}
+
+void IRParser::expectEndOfLine() {
+	if (!atEndOfLine())
+		error("unexpected " + found() + " at the end of the statement");
+	if (cursor != end) {
+		cursor++;
+		line++;
+	}
+}
+
+IRParser::Token IRParser::readWord() {
+	skipSpaces();
+	const char *start = cursor;
+	while (cursor < end && isWordCharacter(*cursor))
+		cursor++;
+	return Token { start, (size_t) (cursor - start) };
+}
+
+IRParser::Token IRParser::expectWord(const char *what) {
+	Token word = readWord();
+	if (word.length == 0)
+		error(string("expected ") + what + ", found " + found());
+	return word;
+}
+
+void IRParser::expectKeyword(const char *keyword) {
+	Token word = readWord();
+	if (word.length != strlen(keyword) || memcmp(word.text, keyword, word.length) != 0)
+		error(string("expected ") + keyword);
+}
+
+void IRParser::expect(char c) {
+	if (!accept(c))
+		error(string("expected ") + c + ", found " + found());
+}
+
+bool IRParser::accept(char c) {
+	skipSpaces();
+	if (cursor == end || *cursor != c)
+		return false;
+	cursor++;
+	return true;
+}
+
+int IRParser::readInteger() {
+	skipSpaces();
+	bool negative = accept('-');
+	const char *start = cursor;
+	long long value = 0;
+	while (cursor < end && *cursor >= '0' && *cursor <= '9') {
+		value = value * 10 + (*cursor++ - '0');
+		if (value > (long long) INT_MAX + 1)
+			error("integer out of range");
+	}
+	if (cursor == start)
+		error("expected an integer, found " + found());
+	value = negative ? -value : value;
+	if (value > INT_MAX)
+		error("integer out of range");
+	return (int) value;
+}
+
+IRParser::Token IRParser::readString() {
+	expect('"');
+	const char *start = cursor;
+	while (cursor < end && *cursor != '"' && *cursor != '\n')
+		cursor++;
+	if (cursor == end || *cursor != '"')
+		error("unterminated string");
+	Token text = { start, (size_t) (cursor - start) };
+	cursor++;
+	return text;
+}
+
+string IRParser::found() const {
+	if (cursor == end)
+		return "the end of the input";
+	if (*cursor == '\n')
+		return "the end of the line";
+	const char *stop = cursor;
+	while (stop < end && stop - cursor < 24 && *stop != '\n' && *stop != ' ' && *stop != '\t')
+		stop++;
+	return "'" + string(cursor, stop == cursor ? cursor + 1 : stop) + "'";
+}
+
+void IRParser::error(const string &message) const {
+	throw runtime_error(name + ":" + to_string(line) + ": " + message);
+}
@@ -0,0 +1,55 @@
+#include "ir/valueNumberTable.h"
+#include "ir/dag.h"
+#include <stdint.h>
+
+using namespace std;
+
+size_t ValueNumberKeyHash::operator()(const ValueNumberKey &key) const {
+	// mix both operand ids and the operator into 64 bits (splitmix64 finalizer)
+	uint64_t h = ((uint64_t) key.left << 32) | key.right;
+	h ^= (uint64_t) key.op * 0x9E3779B97F4A7C15ULL;
+	h ^= h >> 30;
+	h *= 0xBF58476D1CE4E5B9ULL;
+	h ^= h >> 27;
+	h *= 0x94D049BB133111EBULL;
+	h ^= h >> 31;
+	return (size_t) h;
+}
+
+bool ValueNumberTable::isCommutative(Operator op, const Node *left, const Node *right) {
+	if (op == ADD || op == DOT)
+		return true;
+	return op == MUL && (left->getLabel() == CONSTANT || right->getLabel() == CONSTANT);
+}
+
+ValueNumberKey ValueNumberTable::makeKey(Operator op, Node *left, Node *right) {
+	ValueNumberKey key;
+	key.op = op;
+	key.left = left->getId();
+	key.right = right->getId();
+
+	// canonical operand order: 'a + b' and 'b + a' share the same key
+	if (key.left > key.right && isCommutative(op, left, right)) {
+		unsigned temp = key.left;
+		key.left = key.right;
+		key.right = temp;
+	}
+	return key;
+}
+
+Node * ValueNumberTable::lookup(Operator op, Node *left, Node *right) const {
+	Table::const_iterator position = table.find(makeKey(op, left, right));
+	if (position == table.end())
+		return 0;
+	return position->second;
+}
+
+void ValueNumberTable::erase(Operator op, Node *left, Node *right, Node *node) {
+	Table::iterator position = table.find(makeKey(op, left, right));
+	if (position != table.end() && position->second == node)
+		table.erase(position);
+}
+
+void ValueNumberTable::insert(Operator op, Node *left, Node *right, Node *node) {
+	table[makeKey(op, left, right)] = node;
+}
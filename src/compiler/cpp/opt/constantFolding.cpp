@@ -0,0 +1,115 @@
+#include "opt/constantFolding.h"
+#include "opt/shapeInference.h"
+#include "ir/flatDag.h"
+#include <limits>
+
+using namespace std;
+
+bool ConstantFolding::getConstant(Node *node, int &value) {
+	// variable <- constant: the operands are the variable leaf and the constant
+	if (node->getLabel() == MOVE)
+		node = node->getSuccessors()[1];
+	if (node->getLabel() != CONSTANT)
+		return false;
+	value = ((Constant *) ((LeafNode *) node)->getLeaf())->valueNumber();
+	return true;
+}
+
+// Value of 'left op right', false when it does not fit in an int
+static bool fold(Operator op, int left, int right, int &result) {
+	long long value = op == ADD ? (long long) left + right : (long long) left * right;
+	if (value < numeric_limits<int>::min() || value > numeric_limits<int>::max())
+		return false;
+	result = (int) value;
+	return true;
+}
+
+// The node replacing 'node', or 'node' itself when it cannot be simplified
+Node * ConstantFolding::simplify(DAG &dag, Node *node) {
+	Operator op = node->getLabel();
+	Node *left = node->getSuccessors()[0];
+	Node *right = node->getSuccessors()[1];
+	int leftValue, rightValue, value;
+	bool leftConstant = getConstant(left, leftValue);
+	bool rightConstant = getConstant(right, rightValue);
+
+	if (leftConstant && rightConstant) {
+		if (!fold(op, leftValue, rightValue, value))
+			return node;
+		foldedNodes++;
+		Node *constant = dag.addConstant(value);
+		constant->setShape(Shape::scalar());
+		return constant;
+	}
+	if (!leftConstant && !rightConstant)
+		return node;
+
+	// 'operand op constant'
+	Node *operand = leftConstant ? right : left;
+	int constant = leftConstant ? leftValue : rightValue;
+
+	if ((op == ADD && constant == 0) || (op == MUL && constant == 1)) {
+		simplifiedNodes++;
+		return operand;
+	}
+	if (op == MUL && constant == 0 && operand->getShape().isScalar()) {
+		simplifiedNodes++;
+		return leftConstant ? left : right;
+	}
+	if (op == MUL && constant == 2) {
+		strengthReducedNodes++;
+		Node *sum = dag.addOperation(ADD, operand, operand);
+		sum->setShape(node->getShape());
+		return sum;
+	}
+	return node;
+}
+
+unsigned ConstantFolding::run(DAG &dag) {
+	ShapeInference().run(dag);
+
+	// operands first, so the users see the simplified operands; the
+	// replaced nodes are removed at the end
+	FlatDAG flatDAG = dag.freeze();
+	vector<Node *> replaced;
+
+	for (FlatDAG::NodeId n = 0; n < flatDAG.getNumberOfNodes(); n++) {
+		Node *node = flatDAG.getNode(n);
+		if (node->getLabel() != ADD && node->getLabel() != MUL)
+			continue;
+
+		Node *replacement = simplify(dag, node);
+		if (replacement == node)
+			continue;
+		dag.replaceAllUses(node, replacement);
+		replaced.push_back(node);
+	}
+
+	// the replaced nodes that no rewrite reused, then the constants they
+	// were the last users of
+	unordered_set<Node *> dead;
+	for (Node *node : replaced) {
+		if (node->getPredecessors().empty())
+			dead.insert(node);
+	}
+	unordered_set<Node *> constants;
+	for (Node *node : dead) {
+		for (Node *operand : node->getSuccessors()) {
+			if (operand->getLabel() == CONSTANT)
+				constants.insert(operand);
+		}
+	}
+	for (Node *constant : constants) {
+		bool used = dag.holdsVariable(constant);
+		for (Node *user : constant->getPredecessors()) {
+			if (!dead.count(user))
+				used = true;
+		}
+		if (!used)
+			dead.insert(constant);
+	}
+	dag.removeNodes(dead);
+
+	removedNodes += dead.size();
+	return dead.size();
+}
@@ -0,0 +1,53 @@
+#include "opt/deadCodeElimination.h"
+#include <vector>
+
+using namespace std;
+
+unsigned DeadCodeElimination::run(DAG &dag) {
+	const DAG::DAGNodes &vertices = dag.getDAGNodes();
+	unsigned maxId = 0;
+	for (Node *node : vertices) {
+		if (node->getId() > maxId)
+			maxId = node->getId();
+	}
+
+	// mark backwards from the live out values and the effects
+	vector<bool> live(maxId + 1, false);
+	vector<Node *> stack;
+	for (LocalVariable *variable : liveOut) {
+		Node *node = dag.getNode(variable);
+		if (node)
+			stack.push_back(node);
+	}
+	stack.insert(stack.end(), dag.getEffects().begin(), dag.getEffects().end());
+
+	while (!stack.empty()) {
+		Node *node = stack.back();
+		stack.pop_back();
+		if (live[node->getId()])
+			continue;
+		live[node->getId()] = true;
+		for (Node *operand : node->getSuccessors()) {
+			if (!live[operand->getId()])
+				stack.push_back(operand);
+		}
+	}
+
+	// all users of a dead node are dead, so they are removed together
+	unordered_set<Node *> dead;
+	for (Node *node : vertices) {
+		if (live[node->getId()])
+			continue;
+		dead.insert(node);
+		if (node->isLeaf())
+			continue;
+		removedOperators++;
+		const Shape &shape = node->getShape();
+		if (shape.isMatrix())
+			removedElements += (uint64_t) shape.getRows() * shape.getColumns();
+	}
+	dag.removeNodes(dead);
+
+	removedNodes += dead.size();
+	return dead.size();
+}
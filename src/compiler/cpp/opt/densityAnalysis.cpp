@@ -0,0 +1,122 @@
+#include "opt/densityAnalysis.h"
+#include "ir/flatDag.h"
+#include <cmath>
+
+using namespace std;
+
+double DensityAnalysis::add(double a, double b) {
+	return a + b - a * b;
+}
+
+double DensityAnalysis::product(double a, double b, uint32_t k) {
+	// an element is zero when none of its k terms is
+	if (k == 0)
+		return 1;
+	return 1 - pow(1 - a * b, (double) k);
+}
+
+static bool isScalar(Node *node) {
+	return node->getLabel() == CONSTANT || node->getShape().isScalar();
+}
+
+double DensityAnalysis::inferFused(FusedNode *node) {
+	// registers: the inputs, then the results of the operations
+	vector<double> densities;
+	vector<bool> scalars;
+	for (Node *input : node->getSuccessors()) {
+		densities.push_back(input->getDensity());
+		scalars.push_back(isScalar(input));
+	}
+
+	// fused operations are all elementwise
+	for (const FusedOperation &operation : node->getProgram()) {
+		double a = densities[operation.operand0];
+		double b = densities[operation.operand1];
+		bool scalarA = scalars[operation.operand0];
+		bool scalarB = scalars[operation.operand1];
+		if (scalarA && scalarB)
+			densities.push_back(1);
+		else if (operation.op == MUL)
+			densities.push_back(scalarA ? b : scalarB ? a : a * b);
+		else
+			densities.push_back(scalarA || scalarB ? 1 : add(a, b));
+		scalars.push_back(scalarA && scalarB);
+	}
+	return densities.back();
+}
+
+void DensityAnalysis::infer(Node *node) {
+	const Node::NodeList &operands = node->getSuccessors();
+	double density = 1;
+	bool sparse = false;
+
+	switch (node->getLabel()) {
+
+	case LOCALVARIABLE:
+		density = ((LocalVariable *) ((LeafNode *) node)->getLeaf())->getDensity();
+		sparse = !isScalar(node) && density <= threshold;
+		break;
+
+	case LOAD:
+		density = ((Load *) ((LeafNode *) node)->getLeaf())->getDensity();
+		sparse = !isScalar(node) && density <= threshold;
+		break;
+
+	case ADD:
+		if (!isScalar(operands[0]) && !isScalar(operands[1])) {
+			density = add(operands[0]->getDensity(), operands[1]->getDensity());
+			sparse = operands[0]->isSparse() && operands[1]->isSparse() && density <= threshold;
+		}
+		break;
+
+	case MUL:
+		if (isScalar(operands[0]) && !isScalar(operands[1])) {
+			density = operands[1]->getDensity();
+			sparse = operands[1]->isSparse();
+		} else if (isScalar(operands[1]) && !isScalar(operands[0])) {
+			density = operands[0]->getDensity();
+			sparse = operands[0]->isSparse();
+		} else if (!isScalar(operands[0])) {
+			const Shape &left = operands[0]->getShape();
+			density = product(operands[0]->getDensity(), operands[1]->getDensity(),
+					left.isMatrix() ? left.getColumns() : 0);
+		}
+		break;
+
+	case MOVE:
+		// variable <- constant
+		density = operands[1]->getDensity();
+		sparse = operands[1]->isSparse();
+		break;
+
+	case FUSED:
+		density = inferFused((FusedNode *) node);
+		break;
+
+	default:
+		break;
+	}
+
+	node->setDensity(density);
+	node->setSparse(sparse);
+}
+
+unsigned DensityAnalysis::run(DAG &dag) {
+	FlatDAG flatDAG = dag.freeze();
+	unsigned sparseNodes = 0;
+
+	for (FlatDAG::NodeId n = 0; n < flatDAG.getNumberOfNodes(); n++) {
+		Node *node = flatDAG.getNode(n);
+		infer(node);
+		if (node->isSparse())
+			sparseNodes++;
+	}
+	return sparseNodes;
+}
+
+unsigned DensityAnalysis::update(DAG &dag) {
+	vector<Node *> region = dag.getDirtyRegion();
+	for (Node *node : region)
+		infer(node);
+	return region.size();
+}
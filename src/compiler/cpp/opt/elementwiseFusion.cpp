@@ -0,0 +1,159 @@
+#include "opt/elementwiseFusion.h"
+#include "ir/flatDag.h"
+#include <unordered_map>
+
+using namespace std;
+
+bool ElementwiseFusion::isElementwise(Node *node) {
+	// sparse values have kernels of their own (opt/densityAnalysis.h); the
+	// sparse operands of a dense node are expanded as inputs of the region
+	if (node->isSparse())
+		return false;
+
+	switch (node->getLabel()) {
+
+	case ADD:
+		return true;
+
+	case MUL: {
+		// matrix products are not elementwise, products by a scalar are
+		const Node::NodeList &operands = node->getSuccessors();
+		return operands[0]->getLabel() == CONSTANT || operands[1]->getLabel() == CONSTANT;
+	}
+
+	default:
+		return false;
+	}
+}
+
+bool ElementwiseFusion::isLiveOut(Node *node) const {
+	if (node->isLeaf())
+		return false;
+	for (LocalVariable *identifier : ((OperatorNode *) node)->getIdentifiers()) {
+		if (liveOut.count(identifier))
+			return true;
+	}
+	return false;
+}
+
+void ElementwiseFusion::growRegion(Node *root, unordered_set<Node *> &region,
+		const unordered_set<Node *> &absorbed) const {
+	vector<Node *> worklist;
+	region.insert(root);
+	worklist.push_back(root);
+
+	while (!worklist.empty()) {
+		Node *node = worklist.back();
+		worklist.pop_back();
+
+		for (Node *operand : node->getSuccessors()) {
+			if (region.count(operand) || absorbed.count(operand) || !isElementwise(operand)
+					|| isLiveOut(operand))
+				continue;
+
+			// an operand used outside of the region must stay materialized;
+			// users absorbed by a previous region are dead
+			bool usedOutside = false;
+			for (Node *user : operand->getPredecessors()) {
+				if (!region.count(user) && !absorbed.count(user)) {
+					usedOutside = true;
+					break;
+				}
+			}
+			if (usedOutside)
+				continue;
+
+			region.insert(operand);
+			worklist.push_back(operand);
+		}
+	}
+}
+
+void ElementwiseFusion::buildProgram(Node *root, const unordered_set<Node *> &region,
+		vector<Node *> &inputs, vector<FusedOperation> &program) const {
+	// registers are numbered as: input i -> i, operation j -> number of inputs + j.
+	// The number of inputs is only known at the end, so operations first
+	// refer to inputs with INPUT tagged indices.
+	static const uint32_t INPUT = 0x80000000;
+	unordered_map<Node *, uint32_t> registers;
+
+	// iterative post order walk: the operands of an operation are emitted first
+	vector<pair<Node *, bool> > stack;
+	stack.push_back(make_pair(root, false));
+
+	while (!stack.empty()) {
+		Node *node = stack.back().first;
+		bool expanded = stack.back().second;
+		stack.pop_back();
+
+		if (registers.count(node))
+			continue;
+
+		if (!region.count(node)) {
+			registers[node] = inputs.size() | INPUT;
+			inputs.push_back(node);
+			continue;
+		}
+
+		const Node::NodeList &operands = node->getSuccessors();
+		if (!expanded) {
+			stack.push_back(make_pair(node, true));
+			stack.push_back(make_pair(operands[1], false));
+			stack.push_back(make_pair(operands[0], false));
+			continue;
+		}
+
+		FusedOperation operation;
+		operation.op = node->getLabel();
+		operation.operand0 = registers[operands[0]];
+		operation.operand1 = registers[operands[1]];
+		registers[node] = program.size();
+		program.push_back(operation);
+	}
+
+	uint32_t numberOfInputs = inputs.size();
+	for (FusedOperation &operation : program) {
+		operation.operand0 = (operation.operand0 & INPUT) ? operation.operand0 & ~INPUT
+				: operation.operand0 + numberOfInputs;
+		operation.operand1 = (operation.operand1 & INPUT) ? operation.operand1 & ~INPUT
+				: operation.operand1 + numberOfInputs;
+	}
+}
+
+unsigned ElementwiseFusion::run(DAG &dag) {
+	unsigned fused = 0;
+
+	// visit users before their operands, so every region is grown from its
+	// top-most operator and an absorbed node is never a root
+	FlatDAG flatDAG = dag.freeze();
+	unordered_set<Node *> absorbed;
+
+	for (FlatDAG::NodeId n = flatDAG.getNumberOfNodes(); n-- > 0;) {
+		Node *root = flatDAG.getNode(n);
+		if (absorbed.count(root) || !isElementwise(root))
+			continue;
+
+		unordered_set<Node *> region;
+		growRegion(root, region, absorbed);
+
+		// a single operator is evaluated as well by its own kernel
+		if (region.size() < 2)
+			continue;
+
+		vector<Node *> inputs;
+		vector<FusedOperation> program;
+		buildProgram(root, region, inputs, program);
+
+		FusedNode *fusedNode = dag.addFusedNode(inputs, program);
+		dag.replaceAllUses(root, fusedNode);
+		absorbed.insert(region.begin(), region.end());
+		fused++;
+	}
+
+	// the absorbed nodes only use each other now
+	dag.removeNodes(absorbed);
+	removedNodes += absorbed.size();
+
+	fusedNodes += fused;
+	return fused;
+}
@@ -0,0 +1,177 @@
+#include "opt/globalValueNumbering.h"
+#include "cfg/ssaForm.h"
+#include "ir/valueNumberTable.h"
+#include <stdint.h>
+
+using namespace std;
+
+size_t GlobalValueNumbering::KeyHash::operator()(const Key &key) const {
+	uint64_t h = (uint64_t) (uintptr_t) key.left * 0x9E3779B97F4A7C15ULL;
+	h ^= (uint64_t) (uintptr_t) key.right + 0xBF58476D1CE4E5B9ULL + (h << 6) + (h >> 2);
+	h ^= (uint64_t) key.op * 0x94D049BB133111EBULL;
+	h ^= h >> 31;
+	return (size_t) h;
+}
+
+Instruction * GlobalValueNumbering::getLeader(Instruction *operand) {
+	operand = operand->resolve();
+	if (operand->getInstructionID() == CONSTANT) {
+		// equal constants are the same value
+		Constant *&constant = constants[((Constant *) operand)->valueNumber()];
+		if (constant == 0)
+			constant = (Constant *) operand;
+		return constant;
+	}
+
+	auto position = leaders.find(operand);
+	while (position != leaders.end()) {
+		operand = position->second;
+		position = leaders.find(operand);
+	}
+	return operand;
+}
+
+bool GlobalValueNumbering::numberPhi(Move *move, vector<Move *> &phis) {
+	Phi *phi = (Phi *) move->getRightValue();
+	LocalVariable *variable = move->getVariable();
+
+	// the operands other than the phi itself (a loop carrying the value)
+	Instruction *value = 0;
+	bool same = true;
+	for (size_t i = 0; i < phi->getNumberOfOperands(); i++) {
+		Instruction *operand = getLeader(phi->getOperand(i));
+		phi->setOperand(i, operand);
+		if (operand == variable)
+			continue;
+		if (value != 0 && operand != value)
+			same = false;
+		value = operand;
+	}
+	if (same && value != 0) {
+		leaders[variable] = value;
+		return true;
+	}
+
+	for (Move *other : phis) {
+		Phi *otherPhi = (Phi *) other->getRightValue();
+		bool equal = true;
+		for (size_t i = 0; i < phi->getNumberOfOperands() && equal; i++)
+			equal = phi->getOperand(i) == otherPhi->getOperand(i);
+		if (equal) {
+			leaders[variable] = other->getVariable();
+			return true;
+		}
+	}
+	phis.push_back(move);
+	return false;
+}
+
+bool GlobalValueNumbering::numberExpression(Move *move, vector<Key> &inserted) {
+	Instruction *rightValue = move->getRightValue();
+	Operator op = rightValue->getInstructionID();
+
+	if (op == LOCALVARIABLE || op == CONSTANT) {
+		leaders[move->getVariable()] = rightValue;
+		propagatedCopies++;
+		return true;
+	}
+	if (!ValueNumberTable::isNumbered(op))
+		return false;
+
+	Key key;
+	key.op = op;
+	if (op == SUM || op == MIN || op == MAX) {
+		key.left = key.right = ((Reduction *) rightValue)->getOperand();
+	} else {
+		key.left = ((BinaryInstruction *) rightValue)->getOperand0();
+		key.right = ((BinaryInstruction *) rightValue)->getOperand1();
+
+		// the operand order of 'a + b', 'dot(a, b)' and 'k * a' does not matter
+		bool commutative = op == ADD || op == DOT
+				|| (op == MUL && (key.left->getInstructionID() == CONSTANT || key.right->getInstructionID() == CONSTANT));
+		if (commutative && key.left > key.right) {
+			Instruction *temp = key.left;
+			key.left = key.right;
+			key.right = temp;
+		}
+	}
+
+	auto position = available.find(key);
+	if (position != available.end()) {
+		leaders[move->getVariable()] = position->second;
+		removedExpressions++;
+		return true;
+	}
+	available[key] = move->getVariable();
+	inserted.push_back(key);
+	return false;
+}
+
+unsigned GlobalValueNumbering::run(ControlFlowGraph &cfg) {
+	unsigned before = getNumberOfRemovedInstructions();
+	available.clear();
+	leaders.clear();
+	constants.clear();
+	auto leader = [this](Instruction *operand) {
+		return getLeader(operand);
+	};
+
+	// walk the dominator tree: the expressions of a block are available
+	// in the blocks it dominates, and forgotten when leaving it
+	struct Frame {
+		BasicBlock *block;
+		size_t child;
+		vector<Key> inserted;
+	};
+	vector<Frame> stack;
+	stack.push_back(Frame { cfg.getEntry(), 0, vector<Key>() });
+	bool entering = true;
+	while (!stack.empty()) {
+		BasicBlock *block = stack.back().block;
+
+		if (entering) {
+			vector<Move *> phis;
+			Instruction *next;
+			for (Instruction *i = block->getFirst(); i != 0; i = next) {
+				next = i->getNext();
+				bool redundant;
+				if (SSAForm::isPhi(i)) {
+					redundant = numberPhi((Move *) i, phis);
+					if (redundant)
+						removedPhis++;
+				} else {
+					SSAForm::rewriteOperands(i, leader);
+					redundant = i->getInstructionID() == MOVE && numberExpression((Move *) i, stack.back().inserted);
+				}
+				if (redundant) {
+					block->remove(i);
+					if (cfg.getContext() == 0)
+						delete i;
+				}
+			}
+			if (block->isConditional())
+				block->setConditionOperands(leader(block->getConditionLeft()), leader(block->getConditionRight()));
+		}
+
+		const vector<BasicBlock *> &children = cfg.getDominatorChildren(block);
+		if (stack.back().child < children.size()) {
+			BasicBlock *child = children[stack.back().child++];
+			stack.push_back(Frame { child, 0, vector<Key>() });
+			entering = true;
+			continue;
+		}
+
+		for (const Key &key : stack.back().inserted)
+			available.erase(key);
+		stack.pop_back();
+		entering = false;
+	}
+
+	// phi operands are read on the incoming edges, which the removed
+	// assignments need not dominate (e.g. the edge closing a loop)
+	for (BasicBlock *block : cfg.getBlocks()) {
+		for (Instruction *i = block->getFirst(); i != 0 && SSAForm::isPhi(i); i = i->getNext())
+			SSAForm::rewriteOperands(i, leader);
+	}
+	return getNumberOfRemovedInstructions() - before;
+}
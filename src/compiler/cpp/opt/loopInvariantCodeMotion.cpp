@@ -0,0 +1,194 @@
+#include "opt/loopInvariantCodeMotion.h"
+#include "cfg/inductionVariables.h"
+#include <unordered_map>
+
+using namespace std;
+
+void LoopInvariantCodeMotion::getOperands(Instruction *instruction, vector<Instruction *> &operands) {
+	operands.clear();
+	Instruction *expression = instruction;
+	if (instruction->getInstructionID() == MOVE)
+		expression = ((Move *) instruction)->getRightValue();
+
+	switch (expression->getInstructionID()) {
+
+	case ADD:
+	case MUL:
+	case DOT:
+		operands.push_back(((BinaryInstruction *) expression)->getOperand0());
+		operands.push_back(((BinaryInstruction *) expression)->getOperand1());
+		break;
+
+	case SUM:
+	case MIN:
+	case MAX:
+		operands.push_back(((Reduction *) expression)->getOperand());
+		break;
+
+	case PRINT:
+		operands.push_back(((Print *) expression)->getOperand());
+		break;
+
+	case CALL:
+		for (Instruction *argument : ((Call *) expression)->getArguments())
+			operands.push_back(argument->resolve());
+		break;
+
+	case PHI:
+		for (size_t i = 0; i < ((Phi *) expression)->getNumberOfOperands(); i++)
+			operands.push_back(((Phi *) expression)->getOperand(i));
+		break;
+
+	case LOCALVARIABLE:
+	case CONSTANT:
+		// a copy; a declaration at the top level reads nothing
+		if (expression != instruction)
+			operands.push_back(expression);
+		break;
+
+	default:
+		break;
+	}
+}
+
+unsigned LoopInvariantCodeMotion::run(ControlFlowGraph &cfg) {
+	insertedPreheaders += cfg.insertPreheaders();
+
+	// the preheader of an inner loop is in the outer loop, which is
+	// processed later and can hoist the same assignments further
+	unsigned hoisted = 0;
+	for (Loop *loop : cfg.getLoops())
+		hoisted += hoist(cfg, loop);
+
+	hoistedInstructions += hoisted;
+	return hoisted;
+}
+
+namespace {
+
+// a read of a variable in a loop; the branch condition reads after the
+// instructions of its block
+struct Use {
+	BasicBlock *block;
+	unsigned    position;
+};
+
+const unsigned CONDITION_POSITION = (unsigned) -1;
+
+}
+
+unsigned LoopInvariantCodeMotion::hoist(ControlFlowGraph &cfg, const Loop *loop) {
+	BasicBlock *preheader = cfg.getPreheader(loop);
+	if (preheader == 0)
+		return 0;
+
+	vector<unsigned> definitions;
+	InductionVariables::countDefinitions(loop, definitions);
+	long long tripCount = InductionVariables(cfg, loop).getTripCount();
+
+	// the uses of each slot, and the position of each instruction in its block
+	unordered_map<Instruction *, unsigned> positions;
+	vector<vector<Use> > uses(definitions.size());
+	vector<Instruction *> operands;
+	auto addUse = [&uses](Instruction *operand, BasicBlock *block, unsigned position) {
+		if (operand->getInstructionID() != LOCALVARIABLE)
+			return;
+		size_t slot = ((LocalVariable *) operand)->getSlotNumber();
+		if (slot < uses.size())
+			uses[slot].push_back(Use { block, position });
+	};
+	for (BasicBlock *block : loop->blocks) {
+		unsigned position = 0;
+		for (Instruction *i = block->getFirst(); i != 0; i = i->getNext(), position++) {
+			positions[i] = position;
+			getOperands(i, operands);
+			for (Instruction *operand : operands)
+				addUse(operand, block, position);
+		}
+		if (block->isConditional()) {
+			addUse(block->getConditionLeft()->resolve(), block, CONDITION_POSITION);
+			addUse(block->getConditionRight()->resolve(), block, CONDITION_POSITION);
+		}
+	}
+
+	auto isInvariant = [&definitions](Instruction *operand) {
+		if (operand->getInstructionID() != LOCALVARIABLE)
+			return true;
+		size_t slot = ((LocalVariable *) operand)->getSlotNumber();
+		return slot >= definitions.size() || definitions[slot] == 0;
+	};
+
+	// a hoisted assignment must not be visible after a loop that would
+	// not have executed it
+	auto runsBeforeExit = [&cfg, loop, tripCount](BasicBlock *block) {
+		bool dominatesExits = true;
+		for (BasicBlock *exiting : loop->exiting)
+			dominatesExits = dominatesExits && cfg.dominates(block, exiting);
+		if (dominatesExits)
+			return true;
+		if (tripCount < 1)
+			return false;
+		for (BasicBlock *latch : loop->latches) {
+			if (!cfg.dominates(block, latch))
+				return false;
+		}
+		return true;
+	};
+
+	unsigned hoisted = 0;
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (BasicBlock *block : loop->blocks) {
+			if (!runsBeforeExit(block))
+				continue;
+
+			Instruction *next;
+			for (Instruction *i = block->getFirst(); i != 0; i = next) {
+				next = i->getNext();
+				if (i->getInstructionID() != MOVE)
+					continue;
+				Operator op = ((Move *) i)->getRightValue()->getInstructionID();
+				if (op == CALL || op == PHI)
+					continue;
+				int slot = ((Move *) i)->getVariable()->getSlotNumber();
+				if (definitions[slot] != 1)
+					continue;
+
+				getOperands(i, operands);
+				bool invariant = true;
+				for (Instruction *operand : operands)
+					invariant = invariant && isInvariant(operand);
+				if (!invariant)
+					continue;
+
+				// every use in the loop must read this assignment
+				bool dominatesUses = true;
+				for (const Use &use : uses[slot]) {
+					if (use.block == block)
+						dominatesUses = dominatesUses && use.position > positions[i];
+					else
+						dominatesUses = dominatesUses && cfg.dominates(block, use.block);
+				}
+				if (!dominatesUses)
+					continue;
+
+				// the declaration of the variable moves with its assignment
+				LocalVariable *variable = ((Move *) i)->getVariable();
+				for (Instruction *j = block->getFirst(); j != i; j = j->getNext()) {
+					if (j == variable) {
+						block->remove(j);
+						preheader->append(j);
+						break;
+					}
+				}
+				block->remove(i);
+				preheader->append(i);
+				definitions[slot] = 0;
+				hoisted++;
+				changed = true;
+			}
+		}
+	}
+	return hoisted;
+}
@@ -0,0 +1,187 @@
+#include "opt/loopUnrolling.h"
+#include <unordered_set>
+
+using namespace std;
+
+unsigned LoopUnrolling::run(ControlFlowGraph &cfg) {
+	// The loops of a round that share no block are unrolled together, then
+	// the graph is merged and reanalyzed once; an enclosing loop may unroll
+	// in the next round
+	unsigned unrolled = 0;
+	while (true) {
+		unordered_set<BasicBlock *> changed;
+		for (Loop *loop : cfg.getLoops()) {
+			bool untouched = true;
+			for (BasicBlock *block : loop->blocks)
+				untouched = untouched && changed.count(block) == 0;
+			if (untouched && unroll(cfg, loop)) {
+				changed.insert(loop->blocks.begin(), loop->blocks.end());
+				unrolled++;
+			}
+		}
+		if (changed.empty())
+			break;
+		cfg.analyze();
+		cfg.mergeBlocks();
+	}
+	unrolledLoops += unrolled;
+	return unrolled;
+}
+
+Instruction * LoopUnrolling::substitute(Instruction *operand, int slot, Constant *value) {
+	operand = operand->resolve();
+	if (operand->getInstructionID() == LOCALVARIABLE && ((LocalVariable *) operand)->getSlotNumber() == slot)
+		return value;
+	return operand;
+}
+
+Instruction * LoopUnrolling::copyExpression(ControlFlowGraph &cfg, Instruction *expression, int slot,
+		Constant *value) {
+	switch (expression->getInstructionID()) {
+
+	case ADD:
+		return cfg.create<Add>(substitute(((Add *) expression)->getOperand0(), slot, value),
+				substitute(((Add *) expression)->getOperand1(), slot, value));
+
+	case MUL:
+		return cfg.create<Mul>(substitute(((Mul *) expression)->getOperand0(), slot, value),
+				substitute(((Mul *) expression)->getOperand1(), slot, value));
+
+	case DOT:
+		return cfg.create<Dot>(substitute(((Dot *) expression)->getOperand0(), slot, value),
+				substitute(((Dot *) expression)->getOperand1(), slot, value));
+
+	case SUM:
+	case MIN:
+	case MAX:
+		return cfg.create<Reduction>(expression->getInstructionID(),
+				substitute(((Reduction *) expression)->getOperand(), slot, value));
+
+	case LOAD: {
+		Arena *arena = cfg.getContext() ? &cfg.getContext()->getArena() : 0;
+		Load *load = cfg.create<Load>(((Load *) expression)->getObjectName(), arena);
+		load->setShape(((Load *) expression)->getShape());
+		return load;
+	}
+
+	case CALL: {
+		vector<Instruction *> arguments;
+		for (Instruction *argument : ((Call *) expression)->getArguments())
+			arguments.push_back(substitute(argument, slot, value));
+		Arena *arena = cfg.getContext() ? &cfg.getContext()->getArena() : 0;
+		return cfg.create<Call>(((Call *) expression)->getFunction(), arguments, arena);
+	}
+
+	default:
+		return substitute(expression, slot, value);
+	}
+}
+
+Instruction * LoopUnrolling::copy(ControlFlowGraph &cfg, Instruction *instruction, int slot, Constant *value) {
+	switch (instruction->getInstructionID()) {
+
+	case MOVE:
+		return cfg.createListed<Move>(((Move *) instruction)->getVariable(),
+				copyExpression(cfg, ((Move *) instruction)->getRightValue(), slot, value));
+
+	case PRINT:
+		return cfg.createListed<Print>(substitute(((Print *) instruction)->getOperand(), slot, value));
+
+	case CALL: {
+		vector<Instruction *> arguments;
+		for (Instruction *argument : ((Call *) instruction)->getArguments())
+			arguments.push_back(substitute(argument, slot, value));
+		Arena *arena = cfg.getContext() ? &cfg.getContext()->getArena() : 0;
+		return cfg.createListed<Call>(((Call *) instruction)->getFunction(), arguments, arena);
+	}
+
+	default:
+		// declarations are not copied
+		return 0;
+	}
+}
+
+bool LoopUnrolling::unroll(ControlFlowGraph &cfg, const Loop *loop) {
+	// a header testing the exit and a body block jumping back to it
+	if (loop->blocks.size() != 2)
+		return false;
+	BasicBlock *header = loop->header;
+	BasicBlock *body = loop->blocks[1];
+	if (body->isConditional() || body->getSuccessors().size() != 1 || body->getPredecessors().size() != 1)
+		return false;
+	for (Instruction *i = header->getFirst(); i != 0; i = i->getNext()) {
+		if (i->getInstructionID() != LOCALVARIABLE)
+			return false;
+	}
+
+	InductionVariables inductionVariables(cfg, loop);
+	long long tripCount = inductionVariables.getTripCount();
+	if (tripCount < 0)
+		return false;
+	const InductionVariable *control = inductionVariables.getControlVariable();
+
+	vector<Instruction *> original;
+	unsigned size = 0;
+	for (Instruction *i = body->getFirst(); i != 0; i = i->getNext()) {
+		original.push_back(i);
+		if (i->getInstructionID() != LOCALVARIABLE && i != control->update)
+			size++;
+	}
+	if (tripCount * size > maxInstructions)
+		return false;
+
+	// the header declarations, then one copy of the body per iteration
+	BasicBlock *exit = header->getSuccessors()[1];
+	for (Instruction *i : original)
+		body->remove(i);
+	Instruction *next;
+	for (Instruction *i = header->getFirst(); i != 0; i = next) {
+		next = i->getNext();
+		header->remove(i);
+		body->append(i);
+	}
+	for (Instruction *i : original) {
+		if (i->getInstructionID() == LOCALVARIABLE)
+			body->append(i);
+	}
+
+	// the instructions after the update read the value of the next iteration
+	long long initial = control->initialValue;
+	for (long long k = 0; k < tripCount; k++) {
+		Constant *value = cfg.create<Constant>(cfg.create<Integer>((int) (initial + k * control->step)));
+		for (Instruction *i : original) {
+			if (i == control->update)
+				value = cfg.create<Constant>(cfg.create<Integer>((int) (initial + (k + 1) * control->step)));
+			if (i->getInstructionID() == LOCALVARIABLE || i == control->update)
+				continue;
+			body->append(copy(cfg, i, control->slot, value));
+			copiedInstructions++;
+		}
+	}
+
+	// the variable holds its final value after the loop
+	Constant *last = cfg.create<Constant>(cfg.create<Integer>((int) (initial + tripCount * control->step)));
+	body->append(cfg.createListed<Move>(control->update->getVariable(), last));
+
+	// heap instructions of the original body are owned by nobody now
+	if (cfg.getContext() == 0) {
+		for (Instruction *i : original) {
+			if (i->getInstructionID() != LOCALVARIABLE)
+				delete i;
+		}
+	}
+
+	// the body replaces the loop
+	vector<BasicBlock *> outside;
+	for (BasicBlock *predecessor : header->getPredecessors()) {
+		if (!loop->contains(predecessor))
+			outside.push_back(predecessor);
+	}
+	for (BasicBlock *predecessor : outside)
+		predecessor->replaceSuccessor(header, body);
+	if (cfg.getEntry() == header)
+		cfg.setEntry(body);
+	header->setExit();
+	body->setJump(exit);
+	return true;
+}
@@ -0,0 +1,174 @@
+#include "opt/matrixChainOrder.h"
+#include "opt/shapeInference.h"
+#include "ir/flatDag.h"
+#include <limits>
+
+using namespace std;
+
+bool MatrixChainOrder::isMatrixProduct(Node *node) {
+	if (node->getLabel() != MUL)
+		return false;
+	const Node::NodeList &operands = node->getSuccessors();
+	return operands[0]->getShape().isMatrix() && operands[1]->getShape().isMatrix();
+}
+
+bool MatrixChainOrder::isLiveOut(Node *node) const {
+	for (LocalVariable *identifier : ((OperatorNode *) node)->getIdentifiers()) {
+		if (liveOut.count(identifier))
+			return true;
+	}
+	return false;
+}
+
+uint64_t MatrixChainOrder::order(const vector<uint64_t> &dimensions, vector<unsigned> &split) {
+	unsigned n = dimensions.size() - 1;
+	vector<uint64_t> cost(n * n, 0);
+	split.assign(n * n, 0);
+
+	// cost[i * n + j]: cheapest product of the matrices i..j
+	for (unsigned length = 2; length <= n; length++) {
+		for (unsigned i = 0; i + length <= n; i++) {
+			unsigned j = i + length - 1;
+			uint64_t best = numeric_limits<uint64_t>::max();
+			for (unsigned k = i; k < j; k++) {
+				uint64_t c = cost[i * n + k] + cost[(k + 1) * n + j]
+						+ dimensions[i] * dimensions[k + 1] * dimensions[j + 1];
+				if (c < best) {
+					best = c;
+					split[i * n + j] = k;
+				}
+			}
+			cost[i * n + j] = best;
+		}
+	}
+	return cost[n - 1];
+}
+
+void MatrixChainOrder::collectChain(Node *root, const unordered_set<Node *> &claimed, Chain &chain) const {
+	chain.root = root;
+	chain.cost = 0;
+	chain.shared = false;
+	unordered_set<Node *> products;
+
+	// in order walk: the factors are found from left to right
+	vector<Node *> stack;
+	stack.push_back(root);
+	while (!stack.empty()) {
+		Node *node = stack.back();
+		stack.pop_back();
+
+		if (products.count(node)) {
+			// a product used twice by the chain (e.g. X * X) is computed once,
+			// the chain dimensions do not describe its cost
+			chain.shared = true;
+			chain.factors.push_back(node);
+			continue;
+		}
+
+		bool inChain = node == root;
+		if (!inChain && isMatrixProduct(node) && !claimed.count(node) && !isLiveOut(node)) {
+			// the only users of an intermediate product are in the chain
+			inChain = true;
+			for (Node *user : node->getPredecessors()) {
+				if (!products.count(user)) {
+					inChain = false;
+					break;
+				}
+			}
+		}
+
+		if (!inChain) {
+			chain.factors.push_back(node);
+			continue;
+		}
+
+		const Node::NodeList &operands = node->getSuccessors();
+		const Shape &left = operands[0]->getShape();
+		const Shape &right = operands[1]->getShape();
+		chain.cost += (uint64_t) left.getRows() * left.getColumns() * right.getColumns();
+		chain.products.push_back(node);
+		products.insert(node);
+		stack.push_back(operands[1]);
+		stack.push_back(operands[0]);
+	}
+}
+
+Node * MatrixChainOrder::build(DAG &dag, const Chain &chain, const vector<unsigned> &split,
+		unsigned i, unsigned j, unordered_set<Node *> &reused) const {
+	if (i == j)
+		return chain.factors[i];
+
+	unsigned n = chain.factors.size();
+	unsigned k = split[i * n + j];
+	Node *left = build(dag, chain, split, i, k, reused);
+	Node *right = build(dag, chain, split, k + 1, j, reused);
+
+	Node *product = dag.addOperation(MUL, left, right);
+	product->setShape(Shape(left->getShape().getRows(), right->getShape().getColumns()));
+	reused.insert(product);
+	return product;
+}
+
+unsigned MatrixChainOrder::run(DAG &dag) {
+	ShapeInference().run(dag);
+
+	// find the chains first, from the users down, so every chain is rooted
+	// at its top-most product; the DAG is rewritten afterwards
+	FlatDAG flatDAG = dag.freeze();
+	unordered_set<Node *> claimed;
+	vector<Chain> chains;
+
+	for (FlatDAG::NodeId n = flatDAG.getNumberOfNodes(); n-- > 0;) {
+		Node *root = flatDAG.getNode(n);
+		if (claimed.count(root) || !isMatrixProduct(root))
+			continue;
+
+		Chain chain;
+		collectChain(root, claimed, chain);
+		claimed.insert(chain.products.begin(), chain.products.end());
+		costBefore += chain.cost;
+		costAfter += chain.cost;
+
+		// two factors have a single order
+		if (chain.factors.size() > 2 && !chain.shared)
+			chains.push_back(chain);
+	}
+
+	unsigned reordered = 0;
+	for (const Chain &chain : chains) {
+		vector<uint64_t> dimensions;
+		dimensions.push_back(chain.factors[0]->getShape().getRows());
+		for (Node *factor : chain.factors)
+			dimensions.push_back(factor->getShape().getColumns());
+
+		vector<unsigned> split;
+		uint64_t cost = order(dimensions, split);
+		if (cost >= chain.cost)
+			continue;
+
+		unordered_set<Node *> reused;
+		Node *root = build(dag, chain, split, 0, chain.factors.size() - 1, reused);
+		dag.replaceAllUses(chain.root, root);
+
+		// products of the old order left without users. Value numbering may
+		// have handed one to another chain (or to this one), so a product is
+		// dead only when all its users are: the products come users first.
+		unordered_set<Node *> dead;
+		for (Node *product : chain.products) {
+			if (reused.count(product))
+				continue;
+			bool used = false;
+			for (Node *user : product->getPredecessors())
+				used = used || !dead.count(user);
+			if (!used)
+				dead.insert(product);
+		}
+		dag.removeNodes(dead);
+
+		costAfter -= chain.cost - cost;
+		reordered++;
+	}
+
+	reorderedChains += reordered;
+	return reordered;
+}
@@ -0,0 +1,187 @@
+#include "opt/reductionPushDown.h"
+#include "opt/shapeInference.h"
+#include "ir/flatDag.h"
+#include <limits>
+
+using namespace std;
+
+// The operands of 'node' when exactly one of them is a scalar
+static bool splitScalar(Node *node, Node *&scalar, Node *&matrix) {
+	const Node::NodeList &operands = node->getSuccessors();
+	if (operands[0]->getShape().isScalar() && operands[1]->getShape().isMatrix()) {
+		scalar = operands[0];
+		matrix = operands[1];
+		return true;
+	}
+	if (operands[0]->getShape().isMatrix() && operands[1]->getShape().isScalar()) {
+		scalar = operands[1];
+		matrix = operands[0];
+		return true;
+	}
+	return false;
+}
+
+static bool isConstant(Node *node) {
+	return node->getLabel() == CONSTANT;
+}
+
+static int constantValue(Node *node) {
+	return ((Constant *) ((LeafNode *) node)->getLeaf())->valueNumber();
+}
+
+bool ReductionPushDown::isLiveOut(Node *node) const {
+	for (LocalVariable *identifier : ((OperatorNode *) node)->getIdentifiers()) {
+		if (liveOut.count(identifier))
+			return true;
+	}
+	return false;
+}
+
+bool ReductionPushDown::canPushDown(Operator op, Node *node, const unordered_set<Node *> &consumed) const {
+	if (node->getLabel() != ADD && node->getLabel() != MUL)
+		return false;
+	if (!node->getShape().isMatrix() || isLiveOut(node))
+		return false;
+
+	// the value is not needed once the reduction is pushed down
+	for (Node *user : node->getPredecessors()) {
+		if (!consumed.count(user))
+			return false;
+	}
+
+	Node *scalar, *matrix;
+	bool scaled = splitScalar(node, scalar, matrix);
+	bool add = node->getLabel() == ADD;
+
+	switch (op) {
+
+	case SUM:
+	case DOT:
+		if (add && !scaled)
+			return node->getSuccessors()[0]->getShape().isMatrix();
+		// sum(x + k) needs the number of elements as a constant
+		if (add && op == SUM)
+			return (uint64_t) matrix->getShape().getRows() * matrix->getShape().getColumns()
+					<= (uint64_t) numeric_limits<int>::max();
+		return scaled;
+
+	case MIN:
+	case MAX:
+		// scaling by a negative number swaps the minimum and the maximum
+		return scaled && (add || isConstant(scalar));
+
+	default:
+		return false;
+	}
+}
+
+Node * ReductionPushDown::reduce(DAG &dag, Operator op, Node *node, Node *partner,
+		unordered_set<Node *> &created) {
+	Node *reduction = op == DOT ? dag.addOperation(DOT, node, partner) : dag.addReduction(op, node);
+	reduction->setShape(Shape::scalar());
+	created.insert(reduction);
+	return reduction;
+}
+
+Node * ReductionPushDown::combine(DAG &dag, Operator op, Node *left, Node *right,
+		unordered_set<Node *> &created) {
+	Node *result = dag.addOperation(op, left, right);
+	result->setShape(Shape::scalar());
+	created.insert(result);
+	return result;
+}
+
+// Reduction 'op' of the value of 'node' (dot with 'partner' for DOT), built
+// from reductions of its operands where 'node' can be pushed down
+Node * ReductionPushDown::pushDown(DAG &dag, Operator op, Node *node, Node *partner,
+		unordered_set<Node *> &consumed, unordered_set<Node *> &created) {
+	// dot(x, x) is not linear in x
+	if (node == partner || !canPushDown(op, node, consumed))
+		return reduce(dag, op, node, partner, created);
+	consumed.insert(node);
+
+	Node *left = node->getSuccessors()[0];
+	Node *right = node->getSuccessors()[1];
+	Node *scalar, *matrix;
+
+	if (!splitScalar(node, scalar, matrix)) {
+		// x + y
+		Node *leftReduction = pushDown(dag, op, left, partner, consumed, created);
+		Node *rightReduction = pushDown(dag, op, right, partner, consumed, created);
+		return combine(dag, ADD, leftReduction, rightReduction, created);
+	}
+
+	if (node->getLabel() == MUL) {
+		// k * x
+		Operator reduced = op;
+		if (op != SUM && op != DOT && constantValue(scalar) < 0)
+			reduced = op == MIN ? MAX : MIN;
+		return combine(dag, MUL, scalar, pushDown(dag, reduced, matrix, partner, consumed, created), created);
+	}
+
+	// x + k
+	Node *offset = scalar;
+	if (op == SUM) {
+		const Shape &shape = matrix->getShape();
+		Node *count = dag.addConstant(shape.getRows() * shape.getColumns());
+		count->setShape(Shape::scalar());
+		offset = combine(dag, MUL, scalar, count, created);
+	} else if (op == DOT) {
+		offset = combine(dag, MUL, scalar, reduce(dag, SUM, partner, 0, created), created);
+	}
+	return combine(dag, ADD, pushDown(dag, op, matrix, partner, consumed, created), offset, created);
+}
+
+unsigned ReductionPushDown::rewrite(DAG &dag) {
+	// from the users down; nodes removed by a rewrite are not visited again
+	FlatDAG flatDAG = dag.freeze();
+	unordered_set<Node *> removed;
+	unsigned rewritten = 0;
+
+	for (FlatDAG::NodeId n = flatDAG.getNumberOfNodes(); n-- > 0;) {
+		Node *root = flatDAG.getNode(n);
+		if (removed.count(root) || !isReduction(root->getLabel()))
+			continue;
+
+		Operator op = root->getLabel();
+		Node *argument = root->getSuccessors()[0];
+		Node *partner = op == DOT ? root->getSuccessors()[1] : 0;
+		unordered_set<Node *> consumed;
+		consumed.insert(root);
+
+		// a dot product is pushed down one of its operands
+		if (argument == partner || !canPushDown(op, argument, consumed)) {
+			if (partner == 0 || argument == partner || !canPushDown(op, partner, consumed))
+				continue;
+			swap(argument, partner);
+		}
+
+		unordered_set<Node *> created;
+		Node *result = pushDown(dag, op, argument, partner, consumed, created);
+		dag.replaceAllUses(root, result);
+
+		unordered_set<Node *> dead;
+		for (Node *node : consumed) {
+			if (!created.count(node))
+				dead.insert(node);
+		}
+		removedNodes += consumed.size() - 1;
+		removed.insert(dead.begin(), dead.end());
+		dag.removeNodes(dead);
+		rewritten++;
+	}
+	return rewritten;
+}
+
+unsigned ReductionPushDown::run(DAG &dag) {
+	ShapeInference().run(dag);
+
+	// an operand shared by two rewritten operators is reduced as it is
+	// when it is reached first; the next round pushes that reduction down
+	unsigned rewritten = 0;
+	for (unsigned round = rewrite(dag); round > 0; round = rewrite(dag))
+		rewritten += round;
+
+	rewrittenReductions += rewritten;
+	return rewritten;
+}
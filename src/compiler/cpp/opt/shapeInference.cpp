@@ -0,0 +1,109 @@
+#include "opt/shapeInference.h"
+#include "ir/flatDag.h"
+#include <stdexcept>
+#include <sstream>
+
+using namespace std;
+
+static string shapeMismatch(const char *operation, const Shape &a, const Shape &b) {
+	ostringstream message;
+	message << operation << " of " << a.getRows() << "x" << a.getColumns()
+			<< " and " << b.getRows() << "x" << b.getColumns() << " matrices";
+	return message.str();
+}
+
+Shape ShapeInference::elementwise(const Shape &a, const Shape &b) {
+	if (!a.isKnown() || !b.isKnown())
+		return Shape();
+	if (a.isScalar())
+		return b;
+	if (b.isScalar())
+		return a;
+	if (a != b)
+		throw invalid_argument(shapeMismatch("elementwise operation", a, b));
+	return a;
+}
+
+Shape ShapeInference::product(const Shape &a, const Shape &b) {
+	if (a.isScalar() || b.isScalar())
+		return elementwise(a, b);
+	if (!a.isKnown() || !b.isKnown())
+		return Shape();
+	if (a.getColumns() != b.getRows())
+		throw invalid_argument(shapeMismatch("product", a, b));
+	return Shape(a.getRows(), b.getColumns());
+}
+
+Shape ShapeInference::inferFused(FusedNode *node) {
+	// registers: the inputs, then the results of the operations
+	vector<Shape> registers;
+	for (Node *input : node->getSuccessors())
+		registers.push_back(input->getShape());
+
+	// fused operations are all elementwise
+	for (const FusedOperation &operation : node->getProgram())
+		registers.push_back(elementwise(registers[operation.operand0], registers[operation.operand1]));
+	return registers.back();
+}
+
+Shape ShapeInference::infer(Node *node) {
+	const Node::NodeList &operands = node->getSuccessors();
+
+	switch (node->getLabel()) {
+
+	case CONSTANT:
+		return Shape::scalar();
+
+	case LOCALVARIABLE:
+		return ((LocalVariable *) ((LeafNode *) node)->getLeaf())->getShape();
+
+	case LOAD:
+		return ((Load *) ((LeafNode *) node)->getLeaf())->getShape();
+
+	case ADD:
+		return elementwise(operands[0]->getShape(), operands[1]->getShape());
+
+	case MUL:
+		return product(operands[0]->getShape(), operands[1]->getShape());
+
+	case SUM:
+	case MIN:
+	case MAX:
+		return Shape::scalar();
+
+	case DOT:
+		// the operands are multiplied elementwise
+		elementwise(operands[0]->getShape(), operands[1]->getShape());
+		return Shape::scalar();
+
+	case MOVE:
+		// variable <- constant
+		return operands[1]->getShape();
+
+	case FUSED:
+		return inferFused((FusedNode *) node);
+
+	default:
+		return Shape();
+	}
+}
+
+unsigned ShapeInference::run(DAG &dag) {
+	FlatDAG flatDAG = dag.freeze();
+	unsigned known = 0;
+
+	for (FlatDAG::NodeId n = 0; n < flatDAG.getNumberOfNodes(); n++) {
+		Node *node = flatDAG.getNode(n);
+		node->setShape(infer(node));
+		if (node->getShape().isKnown())
+			known++;
+	}
+	return known;
+}
+
+unsigned ShapeInference::update(DAG &dag) {
+	vector<Node *> region = dag.getDirtyRegion();
+	for (Node *node : region)
+		node->setShape(infer(node));
+	return region.size();
+}
@@ -0,0 +1,62 @@
+#include "support/arena.h"
+#include <stdlib.h>
+
+using namespace std;
+
+const size_t Arena::DEFAULT_CHUNK_SIZE;
+
+Arena::Arena(size_t size) :
+		chunks(0), cursor(0), limit(0), chunkSize(size), bytesAllocated(0), bytesReserved(0) {
+}
+
+Arena::~Arena() {
+	reset();
+}
+
+Arena::Chunk * Arena::newChunk(size_t size) {
+	Chunk *chunk = (Chunk *) malloc(sizeof(Chunk) + size);
+	if (chunk == 0)
+		throw bad_alloc();
+	chunk->size = size;
+	bytesReserved += size;
+	return chunk;
+}
+
+void * Arena::allocateSlow(size_t size, size_t alignment) {
+	size_t required = size + alignment;
+
+	// big requests get a chunk of their own, so the current chunk
+	// keeps serving the small ones
+	if (required > chunkSize / 4) {
+		Chunk *chunk = newChunk(required);
+		if (chunks) {
+			chunk->next = chunks->next;
+			chunks->next = chunk;
+		} else {
+			chunk->next = 0;
+			chunks = chunk;
+			cursor = limit = (char *) (chunk + 1) + required;
+		}
+		uintptr_t aligned = ((uintptr_t) (chunk + 1) + alignment - 1) & ~(uintptr_t) (alignment - 1);
+		bytesAllocated += size;
+		return (void *) aligned;
+	}
+
+	Chunk *chunk = newChunk(chunkSize);
+	chunk->next = chunks;
+	chunks = chunk;
+	cursor = (char *) (chunk + 1);
+	limit = cursor + chunkSize;
+	return allocate(size, alignment);
+}
+
+void Arena::reset() {
+	while (chunks) {
+		Chunk *next = chunks->next;
+		free(chunks);
+		chunks = next;
+	}
+	cursor = limit = 0;
+	bytesAllocated = 0;
+	bytesReserved = 0;
+}
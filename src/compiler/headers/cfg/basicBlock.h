@@ -2,25 +2,79 @@
 #define BASIC_BLOCK_H
 
 #include "ir/instruction.h"
+#include "ir/flatBlock.h"
+#include "support/compilationContext.h"
 #include <vector>
+#include <algorithm>
 
+using namespace std;
+
+// Comparison tested by a conditional branch: 'left condition right'
+typedef enum {
+	BRANCH_LESS, BRANCH_LESS_EQUAL, BRANCH_NOT_EQUAL
+} BranchCondition;
+
+// A basic block ends in a terminator, kept in the block rather than in the
+// instruction list: no successor (the block exits), a jump to its single
+// successor, or a conditional branch to the first successor when
+// 'left condition right' holds and to the second one otherwise.
 class BasicBlock {
 private:
 	Instruction *firstInstruction;
 	Instruction *lastInstruction;
 
-	// add more fields like vectors for edges flowing in / out etc.
-	// I will leave that out since the code exercise is not building a CFG
+public:
+	using BlockList = vector<BasicBlock *, ArenaAllocator<BasicBlock *> >;
+
+private:
+	// control flow edges, kept symmetric by the terminator setters; they
+	// are allocated from the context arena like the instructions
+	BlockList successors;
+	BlockList predecessors;
+
+	bool            conditional;
+	BranchCondition condition;
+	Instruction    *conditionLeft;   // variable or constant
+	Instruction    *conditionRight;
 
-	BasicBlock *previous;
-	BasicBlock *next;
+	// when set, the instructions live in the context arena
+	CompilationContext *context;
+
+	// contiguous form of the instructions, 0 until the block is lowered
+	FlatBlock *flatBlock;
 
 public:
 	BasicBlock(Instruction *first, Instruction *last) :
-			firstInstruction(first), lastInstruction(last) {
+			firstInstruction(first), lastInstruction(last), conditional(false),
+			condition(BRANCH_LESS), conditionLeft(0), conditionRight(0),
+			context(0), flatBlock(0) {
+	}
+
+	// Basic block whose instructions were created through 'ctx'
+	BasicBlock(Instruction *first, Instruction *last, CompilationContext *ctx) :
+			firstInstruction(first), lastInstruction(last),
+			successors(ArenaAllocator<BasicBlock *>(ctx ? &ctx->getArena() : 0)),
+			predecessors(ArenaAllocator<BasicBlock *>(ctx ? &ctx->getArena() : 0)),
+			conditional(false), condition(BRANCH_LESS), conditionLeft(0), conditionRight(0),
+			context(ctx), flatBlock(0) {
+	}
+
+	// Basic block holding only flat instructions
+	BasicBlock(FlatBlock *flat) :
+			firstInstruction(0), lastInstruction(0),
+			successors(ArenaAllocator<BasicBlock *>(flat->getContext() ? &flat->getContext()->getArena() : 0)),
+			predecessors(ArenaAllocator<BasicBlock *>(flat->getContext() ? &flat->getContext()->getArena() : 0)),
+			conditional(false), condition(BRANCH_LESS), conditionLeft(0), conditionRight(0),
+			context(flat->getContext()), flatBlock(flat) {
 	}
 
 	~BasicBlock() {
+		// arena instructions are released all at once with the context
+		if (context)
+			return;
+
+		delete flatBlock;
+
 		auto *instructionIter = firstInstruction;
 		while (instructionIter) {
 			auto *next = instructionIter->getNext();
@@ -41,6 +95,180 @@ public:
 	Instruction * getLast() {
 		return lastInstruction;
 	}
+	CompilationContext * getContext() {
+		return context;
+	}
+
+	bool isEmpty() {
+		return firstInstruction == 0;
+	}
+
+	// Appends 'instruction' to the end of the block
+	void append(Instruction *instruction) {
+		instruction->setNext(0);
+		if (lastInstruction == 0) {
+			instruction->setPrevious(0);
+			firstInstruction = instruction;
+		} else {
+			lastInstruction->link(instruction);
+		}
+		lastInstruction = instruction;
+		invalidate();
+	}
+
+	// Inserts 'instruction' at the start of the block
+	void prepend(Instruction *instruction) {
+		instruction->setPrevious(0);
+		if (firstInstruction == 0) {
+			instruction->setNext(0);
+			lastInstruction = instruction;
+		} else {
+			instruction->link(firstInstruction);
+		}
+		firstInstruction = instruction;
+		invalidate();
+	}
+
+	// Unlinks 'instruction' from the block, without deleting it
+	void remove(Instruction *instruction) {
+		Instruction *previousInstruction = instruction->getPrevious();
+		Instruction *nextInstruction = instruction->getNext();
+		if (previousInstruction)
+			previousInstruction->setNext(nextInstruction);
+		else
+			firstInstruction = nextInstruction;
+		if (nextInstruction)
+			nextInstruction->setPrevious(previousInstruction);
+		else
+			lastInstruction = previousInstruction;
+		instruction->setPrevious(0);
+		instruction->setNext(0);
+		invalidate();
+	}
+
+	// Moves all the instructions of 'other' to the end of this block
+	void splice(BasicBlock *other) {
+		if (other->firstInstruction == 0)
+			return;
+		if (lastInstruction == 0)
+			firstInstruction = other->firstInstruction;
+		else
+			lastInstruction->link(other->firstInstruction);
+		lastInstruction = other->lastInstruction;
+		other->firstInstruction = 0;
+		other->lastInstruction = 0;
+		invalidate();
+		other->invalidate();
+	}
+
+	const BlockList &getSuccessors() const {
+		return successors;
+	}
+	const BlockList &getPredecessors() const {
+		return predecessors;
+	}
+
+	// Terminators: each one replaces the outgoing edges of the block
+	void setExit() {
+		clearSuccessors();
+	}
+
+	void setJump(BasicBlock *target) {
+		clearSuccessors();
+		addSuccessor(target);
+	}
+
+	void setBranch(BranchCondition c, Instruction *left, Instruction *right,
+			BasicBlock *taken, BasicBlock *notTaken) {
+		clearSuccessors();
+		conditional = true;
+		condition = c;
+		conditionLeft = left;
+		conditionRight = right;
+		addSuccessor(taken);
+		addSuccessor(notTaken);
+	}
+
+	bool isConditional() const {
+		return conditional;
+	}
+	BranchCondition getCondition() const {
+		return condition;
+	}
+	Instruction * getConditionLeft() {
+		return conditionLeft;
+	}
+	Instruction * getConditionRight() {
+		return conditionRight;
+	}
+	void setConditionOperands(Instruction *left, Instruction *right) {
+		conditionLeft = left;
+		conditionRight = right;
+	}
+
+	// Replaces the edge to 'from' by an edge to 'to', keeping the branch
+	void replaceSuccessor(BasicBlock *from, BasicBlock *to) {
+		for (BasicBlock *&successor : successors) {
+			if (successor != from)
+				continue;
+			successor = to;
+			from->removePredecessor(this);
+			to->predecessors.push_back(this);
+		}
+	}
+
+	// Puts the predecessors in the order of 'order', which must hold the
+	// same edges: the operands of the phis of the block follow this order
+	bool setPredecessorOrder(const vector<BasicBlock *> &order) {
+		if (order.size() != predecessors.size()
+				|| !is_permutation(order.begin(), order.end(), predecessors.begin()))
+			return false;
+		copy(order.begin(), order.end(), predecessors.begin());
+		return true;
+	}
+
+	FlatBlock * getFlatBlock() {
+		return flatBlock;
+	}
+
+	// Builds (once) the flat form of the instruction list
+	FlatBlock * lower() {
+		if (flatBlock == 0)
+			flatBlock = FlatBlock::lower(this);
+		return flatBlock;
+	}
+
+private:
+	// the flat form is rebuilt after the instruction list is edited
+	void invalidate() {
+		if (context == 0)
+			delete flatBlock;
+		flatBlock = 0;
+	}
+
+	void addSuccessor(BasicBlock *target) {
+		successors.push_back(target);
+		target->predecessors.push_back(this);
+	}
+
+	void clearSuccessors() {
+		for (BasicBlock *successor : successors)
+			successor->removePredecessor(this);
+		successors.clear();
+		conditional = false;
+		conditionLeft = 0;
+		conditionRight = 0;
+	}
+
+	// removes one edge from 'block'
+	void removePredecessor(BasicBlock *block) {
+		for (size_t i = 0; i < predecessors.size(); i++) {
+			if (predecessors[i] == block) {
+				predecessors.erase(predecessors.begin() + i);
+				return;
+			}
+		}
+	}
 };
 
 #endif
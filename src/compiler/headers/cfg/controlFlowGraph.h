@@ -0,0 +1,163 @@
+#ifndef CONTROL_FLOW_GRAPH_H
+#define CONTROL_FLOW_GRAPH_H
+
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include "cfg/basicBlock.h"
+#include "support/compilationContext.h"
+
+using namespace std;
+
+// A natural loop: the header and the blocks that reach one of its back
+// edges without going through the header. Loops sharing a header are
+// merged into one.
+struct Loop {
+	BasicBlock *header;
+	vector<BasicBlock *> latches;    // sources of the back edges
+	vector<BasicBlock *> blocks;     // in reverse post order, header first
+	vector<BasicBlock *> exiting;    // blocks of the loop with a successor outside it
+	vector<BasicBlock *> exits;      // blocks outside the loop reached from it
+	Loop *parent;                    // innermost enclosing loop, or 0
+	unsigned depth;                  // 1 for outermost loops
+	unordered_set<BasicBlock *> members;
+
+	bool contains(BasicBlock *block) const {
+		return members.count(block) != 0;
+	}
+};
+
+// Control flow graph of the blocks reachable from an entry block, with
+// its dominator tree and natural loops. The edges live in the blocks;
+// call analyze() again after changing them.
+class ControlFlowGraph {
+public:
+	// Blocks and instructions created by the transformations come from
+	// 'context', or are owned by the graph when it is 0
+	ControlFlowGraph(BasicBlock *entry, CompilationContext *context = 0);
+	~ControlFlowGraph();
+
+	ControlFlowGraph(const ControlFlowGraph &) = delete;
+	ControlFlowGraph &operator=(const ControlFlowGraph &) = delete;
+
+	// Recomputes the block order, the dominators and the loops
+	void analyze();
+
+	BasicBlock * getEntry() const {
+		return entry;
+	}
+	void setEntry(BasicBlock *block) {
+		entry = block;
+	}
+
+	// reachable blocks in reverse post order
+	const vector<BasicBlock *> &getBlocks() const {
+		return blocks;
+	}
+
+	bool isReachable(BasicBlock *block) const {
+		return index.count(block) != 0;
+	}
+
+	// position of a reachable block in reverse post order
+	unsigned getIndex(BasicBlock *block) const {
+		return index.at(block);
+	}
+
+	// 0 for the entry block
+	BasicBlock * getImmediateDominator(BasicBlock *block) const;
+
+	const vector<BasicBlock *> &getDominatorChildren(BasicBlock *block) const {
+		return dominatorChildren[getIndex(block)];
+	}
+
+	// true when every path from the entry to 'b' goes through 'a'
+	bool dominates(BasicBlock *a, BasicBlock *b) const;
+
+	// innermost loops first
+	const vector<Loop *> &getLoops() const {
+		return loops;
+	}
+
+	// innermost loop containing 'block', or 0
+	Loop * getLoopFor(BasicBlock *block) const;
+
+	// The single predecessor outside 'loop' of its header, when that block
+	// only jumps to the header; 0 otherwise
+	BasicBlock * getPreheader(const Loop *loop) const;
+
+	// Gives every loop a preheader, returns the number of blocks inserted.
+	// Reanalyzes the graph when it changes.
+	unsigned insertPreheaders();
+
+	// Merges each block into its predecessor when the predecessor only
+	// jumps to it and it has no other predecessor. Returns the number of
+	// blocks merged and reanalyzes the graph when it changes.
+	unsigned mergeBlocks();
+
+	// Splits the edges from blocks with several successors to blocks with
+	// several predecessors with an empty block, so code can be placed on
+	// an edge. Returns the number of blocks inserted and reanalyzes the
+	// graph when it changes.
+	unsigned splitCriticalEdges();
+
+	// New empty block with no edges
+	BasicBlock * createBlock();
+
+	// Allocates an instruction or value for the graph: from the context,
+	// or owned by the graph. Instructions appended to a block list are
+	// owned by the block and must be allocated with createListed instead.
+	template<typename T, typename... Args>
+	T * create(Args&&... args) {
+		if (context)
+			return context->create<T>(std::forward<Args>(args)...);
+		T *object = new T(std::forward<Args>(args)...);
+		own(object);
+		return object;
+	}
+
+	template<typename T, typename... Args>
+	T * createListed(Args&&... args) {
+		if (context)
+			return context->create<T>(std::forward<Args>(args)...);
+		return new T(std::forward<Args>(args)...);
+	}
+
+	CompilationContext * getContext() const {
+		return context;
+	}
+
+	void print();
+
+private:
+	BasicBlock         *entry;
+	CompilationContext *context;
+
+	vector<BasicBlock *>            blocks;
+	unordered_map<BasicBlock *, unsigned> index;
+	vector<unsigned>                immediateDominator;    // by block index
+	vector<vector<BasicBlock *> >   dominatorChildren;     // by block index
+	vector<unsigned>                preorder;              // dominator tree numbering
+	vector<unsigned>                postorder;
+	vector<Loop *>                  loops;
+	unordered_map<BasicBlock *, Loop *> innermostLoop;
+
+	// heap objects created by the graph when there is no context
+	vector<BasicBlock *>  ownedBlocks;
+	vector<Instruction *> ownedInstructions;
+	vector<Value *>       ownedValues;
+
+	void own(Instruction *instruction) {
+		ownedInstructions.push_back(instruction);
+	}
+	void own(Value *value) {
+		ownedValues.push_back(value);
+	}
+
+	void computeOrder();
+	void computeDominators();
+	void computeLoops();
+	void clearLoops();
+};
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef INDUCTION_VARIABLES_H
+#define INDUCTION_VARIABLES_H
+
+#include <vector>
+#include "cfg/controlFlowGraph.h"
+
+using namespace std;
+
+// A basic induction variable of a loop: assigned once in the loop, by
+// 'variable <- variable + step' with a constant step
+struct InductionVariable {
+	int   slot;              // slot number of the variable
+	int   step;
+	Move *update;
+	BasicBlock *updateBlock;
+	bool  hasInitialValue;   // a constant is assigned before the loop
+	int   initialValue;
+};
+
+// Finds the basic induction variables of a loop and, when the loop is
+// controlled by one of them, its constant trip count. Variables are
+// identified by slot number.
+class InductionVariables {
+public:
+	InductionVariables(ControlFlowGraph &cfg, const Loop *loop);
+
+	const vector<InductionVariable> &getVariables() const {
+		return variables;
+	}
+
+	// the induction variable of 'slot', or 0
+	const InductionVariable * find(int slot) const;
+
+	// The number of times the loop body runs, or -1 when it is not a
+	// constant: the loop must exit only from its header, on a comparison
+	// of an induction variable with a constant initial value against a
+	// constant bound, and the update must run exactly once per iteration
+	long long getTripCount() const {
+		return tripCount;
+	}
+
+	// the induction variable tested by the header, when the trip count is known
+	const InductionVariable * getControlVariable() const {
+		return control;
+	}
+
+	// Number of assignments to each slot in the blocks of 'loop'
+	static void countDefinitions(const Loop *loop, vector<unsigned> &definitions);
+
+	// the slot a top level instruction assigns, or -1
+	static int getDefinedSlot(Instruction *instruction);
+
+	// true when 'operand' is a Constant, stores its value in 'value'
+	static bool getConstant(Instruction *operand, int &value);
+
+private:
+	vector<InductionVariable> variables;
+	const InductionVariable  *control;
+	long long                 tripCount;
+
+	bool findInitialValue(ControlFlowGraph &cfg, const Loop *loop, InductionVariable &variable);
+	void computeTripCount(ControlFlowGraph &cfg, const Loop *loop);
+};
+
+#endif
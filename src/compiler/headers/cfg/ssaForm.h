@@ -0,0 +1,123 @@
+#ifndef SSA_FORM_H
+#define SSA_FORM_H
+
+#include <vector>
+#include "cfg/controlFlowGraph.h"
+
+using namespace std;
+
+// Static single assignment form of the blocks of a control flow graph.
+//
+// construct() gives every assignment its own version of the variable (a
+// LocalVariable in a fresh slot whose origin is the source variable) and
+// places 'v <- PHI(...)' at the start of the blocks where versions of v
+// merge: the iterated dominance frontiers of its assignments, for the
+// variables read in a block before being assigned there (semi-pruned).
+// Reads with no assignment on the way from the entry keep the source
+// variable, which stands for its value on entry to the function.
+//
+// destruct() replaces each phi by copies on the incoming edges, through a
+// temporary per phi, so the blocks can go back to the DAG. Critical
+// edges are split by construct(), which gives each copy a block of its own.
+class SSAForm {
+public:
+	SSAForm(ControlFlowGraph &cfg) :
+			cfg(cfg), nextSlot(0), phis(0), versions(0) {
+	}
+
+	// Renames the variables of the blocks of the graph, returns the number of phis
+	unsigned construct();
+
+	// Replaces the phis by copies, returns the number of copies inserted
+	unsigned destruct();
+
+	unsigned getNumberOfPhis() const {
+		return phis;
+	}
+
+	unsigned getNumberOfVersions() const {
+		return versions;
+	}
+
+	// Dominance frontier of each block, by block index
+	static void computeDominanceFrontiers(const ControlFlowGraph &cfg,
+			vector<vector<BasicBlock *> > &frontiers);
+
+	// Replaces each variable or constant read by a top level instruction
+	// of a block by 'rewrite(operand)'. Phi operands are rewritten too.
+	// A template, so that the rewrite function of each pass is inlined.
+	template<typename Rewrite>
+	static void rewriteOperands(Instruction *instruction, Rewrite &rewrite);
+
+	// true when 'instruction' is an assignment of a phi
+	static bool isPhi(Instruction *instruction) {
+		return instruction->getInstructionID() == MOVE
+				&& ((Move *) instruction)->getRightValue()->getInstructionID() == PHI;
+	}
+
+private:
+	ControlFlowGraph &cfg;
+	int      nextSlot;    // first slot not used by the function
+	unsigned phis;
+	unsigned versions;
+
+	void placePhis(vector<LocalVariable *> &variables);
+	void rename(const vector<LocalVariable *> &variables);
+	LocalVariable * newVersion(LocalVariable *origin, unsigned version);
+};
+
+template<typename Rewrite>
+void SSAForm::rewriteOperands(Instruction *instruction, Rewrite &rewrite) {
+	switch (instruction->getInstructionID()) {
+
+	case MOVE: {
+		Move *move = (Move *) instruction;
+		Instruction *rightValue = move->getRightValue();
+		Operator op = rightValue->getInstructionID();
+		if (op == LOCALVARIABLE || op == CONSTANT)
+			move->setRightValue(rewrite(rightValue));
+		else
+			rewriteOperands(rightValue, rewrite);
+	}
+		break;
+
+	case ADD:
+	case MUL:
+	case DOT: {
+		BinaryInstruction *expression = (BinaryInstruction *) instruction;
+		expression->setOperand0(rewrite(expression->getOperand0()));
+		expression->setOperand1(rewrite(expression->getOperand1()));
+	}
+		break;
+
+	case SUM:
+	case MIN:
+	case MAX:
+		((Reduction *) instruction)->setOperand(rewrite(((Reduction *) instruction)->getOperand()));
+		break;
+
+	case PHI: {
+		Phi *phi = (Phi *) instruction;
+		for (size_t i = 0; i < phi->getNumberOfOperands(); i++)
+			phi->setOperand(i, rewrite(phi->getOperand(i)));
+	}
+		break;
+
+	case PRINT:
+		((Print *) instruction)->setOperand(rewrite(((Print *) instruction)->getOperand()));
+		break;
+
+	case CALL: {
+		Call *call = (Call *) instruction;
+		for (size_t i = 0; i < call->getArguments().size(); i++)
+			call->setArgument(i, rewrite(call->getArguments()[i]->resolve()));
+	}
+		break;
+
+	default:
+		// loads and declarations read no variable
+		break;
+	}
+}
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef BUFFER_ASSIGNMENT_H
+#define BUFFER_ASSIGNMENT_H
+
+#include <vector>
+#include <unordered_set>
+#include <utility>
+#include <stdint.h>
+#include "ir/flatDag.h"
+
+using namespace std;
+
+// Assigns the matrix results of a frozen DAG to a small set of reusable
+// buffers, like a register allocator does for values. Nodes are scheduled
+// in evaluation order; a value lives from its node to its last user, or
+// to the end of the block when a live out variable holds it. A buffer is
+// reused as soon as its value is dead, and an elementwise operator
+// overwrites an operand whose value dies with it (in-place update, e.g.
+// 'a += 10' when the old 'a' is not needed anymore).
+//
+// Shapes come from the DAG nodes (opt/shapeInference.h); values without a
+// known matrix shape are not planned. The matrices of the leaves are
+// external buffers, provided by the caller (MatrixEvaluator::bind, or the
+// loader): they are never handed to other values, and are updated in place
+// only when the caller allows it, since that overwrites its matrices.
+class DAG;
+
+class BufferAssignment {
+public:
+	static const uint32_t NO_BUFFER = 0xFFFFFFFF;
+
+	// 'flatDAG' is the frozen form of 'dag'; the DAG maps the live out
+	// variables to the nodes holding their values. 'updateExternal' lets
+	// the nodes overwrite the matrices of the leaves whose value dies.
+	BufferAssignment(const DAG &dag, const FlatDAG &flatDAG, const unordered_set<LocalVariable *> &liveOut,
+			size_t elementSize = sizeof(double), bool updateExternal = false);
+
+	// buffer holding the value of node n, NO_BUFFER if it is not planned
+	uint32_t getBuffer(FlatDAG::NodeId n) const {
+		return buffers[n];
+	}
+
+	// operand overwritten by node n, INVALID_NODE when n has a buffer of its own
+	FlatDAG::NodeId getInPlaceOperand(FlatDAG::NodeId n) const {
+		return inPlaceOperands[n];
+	}
+
+	unsigned getNumberOfBuffers() const {
+		return bufferBytes.size();
+	}
+	uint64_t getBufferBytes(uint32_t buffer) const {
+		return bufferBytes[buffer];
+	}
+	// buffers of the variable leaves, provided by the caller
+	bool isExternal(uint32_t buffer) const {
+		return external[buffer];
+	}
+
+	// Buffer reuse adds write after read dependences: a node reusing a
+	// buffer must wait for the readers of its previous value. Pairs are
+	// (before, after); pass them to the Executor for parallel execution.
+	const vector<pair<FlatDAG::NodeId, FlatDAG::NodeId> > &getOrderingEdges() const {
+		return orderingEdges;
+	}
+
+	// memory for the matrices without reuse (each value in its own matrix)
+	uint64_t getPeakBytesBefore() const {
+		return peakBytesBefore;
+	}
+	// memory for the matrices with the assigned buffers
+	uint64_t getPeakBytesAfter() const {
+		return peakBytesAfter;
+	}
+
+	unsigned getNumberOfInPlaceUpdates() const {
+		return inPlaceUpdates;
+	}
+
+	void print() const;
+
+private:
+	const FlatDAG                                   &dag;
+	vector<uint32_t>                                buffers;         // indexed by node
+	vector<FlatDAG::NodeId>                         inPlaceOperands; // indexed by node
+	vector<uint64_t>                                bufferBytes;     // indexed by buffer
+	vector<bool>                                    external;        // indexed by buffer
+	vector<pair<FlatDAG::NodeId, FlatDAG::NodeId> > orderingEdges;
+	uint64_t                                        peakBytesBefore;
+	uint64_t                                        peakBytesAfter;
+	unsigned                                        inPlaceUpdates;
+
+	void assign(const vector<FlatDAG::NodeId> &lastUse, size_t elementSize, bool updateExternal);
+	void addOrderingEdges(FlatDAG::NodeId previous, FlatDAG::NodeId n, FlatDAG::NodeId except);
+	bool isElementwise(FlatDAG::NodeId n) const;
+};
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef COORDINATOR_H
+#define COORDINATOR_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <stdint.h>
+#include "exec/dagPartitioning.h"
+#include "exec/matrixEvaluator.h"
+#include "io/objectStore.h"
+#include "io/tileStream.h"
+#include "io/transport.h"
+
+using namespace std;
+
+// Runs the partitions of a DAGPartitioning in worker processes on this
+// machine. run() forks one worker per partition, connected to the
+// coordinator by a transport of the given kind (io/transport.h). The
+// workers are copies of the coordinator process: they start with the
+// bindings and functions set here, and fetch the objects of their LOAD
+// nodes from the store with a loader of their own.
+//
+// COMMUNICATION_AWARE: every worker evaluates its nodes in evaluation
+// order, and waits for the operands computed by the others. The values go
+// through the coordinator (a star): it forwards them to the workers using
+// them, and keeps the live out ones. A worker only waits for nodes of
+// smaller ids than the node it evaluates, and all of those are evaluated
+// first, so the workers cannot deadlock.
+//
+// ROW_BLOCKS: the coordinator evaluates the nodes before the split and the
+// split leaves (their LOADs included) before forking. Every worker takes
+// its block of rows of the split leaves, evaluates the split nodes and the
+// partial reductions, and sends back the partials and its blocks of the
+// live out split values; the coordinator combines them and evaluates the
+// nodes after the split.
+class Coordinator {
+public:
+	// 'partitioning' must outlive the coordinator
+	Coordinator(const DAGPartitioning &partitioning, TransportKind transportKind = SHARED_MEMORY_TRANSPORT);
+
+	~Coordinator();
+
+	Coordinator(const Coordinator &) = delete;
+	Coordinator &operator=(const Coordinator &) = delete;
+
+	void bind(LocalVariable *variable, const RuntimeValue &value) {
+		evaluator.bind(variable, value);
+	}
+
+	// Store of the objects of the LOAD nodes
+	void setStore(ObjectStore *objectStore) {
+		store = objectStore;
+	}
+
+	void defineFunction(const string &name, const MatrixEvaluator::Function &function) {
+		evaluator.defineFunction(name, function);
+	}
+
+	// Evaluates the DAG in the workers and waits for them. Throws
+	// runtime_error with the first error of a worker.
+	void run();
+
+	// Value of a live out node after run()
+	const RuntimeValue &getValue(FlatDAG::NodeId n) const {
+		return evaluator.getValue(n);
+	}
+
+	// bytes through the transports of the coordinator, both ways, and the
+	// part of the matrices passed in shared memory
+	uint64_t getBytesTransferred() const {
+		return bytesTransferred;
+	}
+	uint64_t getBytesShared() const {
+		return bytesShared;
+	}
+
+private:
+	struct Worker;
+
+	const DAGPartitioning      &partitioning;
+	const FlatDAG              &dag;
+	TransportKind              kind;
+	MatrixEvaluator            evaluator;
+	ObjectStore                *store;
+	vector<unique_ptr<Worker> > workers;
+
+	mutex                      valuesLock;   // of the values below, and of the evaluator
+	vector<double>             partials;     // by node
+	unordered_map<FlatDAG::NodeId, unique_ptr<MatrixTileSink> > blocks;   // of the live out split values
+	mutex                      errorLock;
+	string                     error;        // first error of a worker
+
+	uint64_t                   bytesTransferred;
+	uint64_t                   bytesShared;
+
+	void evaluateBeforeSplit();
+	void evaluateAfterSplit();
+	void startWorkers();
+	void stopWorkers();
+	int runWorker(unsigned w, Transport &transport);
+	void evaluateNodes(unsigned w, Transport &transport);
+	void evaluateRows(unsigned w, Transport &transport);
+	void receive(unsigned w);
+	void forward(unsigned w);
+	void receiveValue(unsigned w, const TransportMessage &message);
+	void setError(const string &message);
+};
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef DAG_PARTITIONING_H
+#define DAG_PARTITIONING_H
+
+#include <vector>
+#include <unordered_set>
+#include <stdint.h>
+#include "ir/flatDag.h"
+#include "exec/rowSplit.h"
+
+using namespace std;
+
+// Machine model of a partitioning: speed of one worker, and of the
+// transfers between two workers
+struct PartitionCosts {
+	double   flopsPerSecond;       // kernels of one worker
+	double   bytesPerSecond;       // transfer of a value to another worker
+	double   latency;              // seconds per transferred value
+	double   loadBytesPerSecond;   // objects of the LOAD nodes
+	uint64_t unknownElements;      // assumed for matrices of unknown shape
+	size_t   elementSize;
+
+	PartitionCosts() : flopsPerSecond(4e9), bytesPerSecond(4e9), latency(20e-6), loadBytesPerSecond(1e9),
+			unknownElements(1 << 20), elementSize(sizeof(double)) {
+	}
+};
+
+// Splits a frozen DAG across N worker processes (exec/coordinator.h runs
+// the partitions), with one of two strategies:
+//
+// COMMUNICATION_AWARE assigns every node to one worker, in evaluation
+// order: the worker where it would finish first, given the compute cost
+// of the node (from the shapes of the DAG nodes, opt/shapeInference.h)
+// and the time to bring its operands from other workers (bytes /
+// bandwidth + latency). A chain stays on one worker unless another one
+// is idle long enough to pay for the transfer. Constants and variables
+// are replicated in every worker; the effects (PRINT, CALL) run in
+// worker 0, in program order.
+//
+// ROW_BLOCKS splits the elementwise regions by rows (exec/rowSplit.h): the
+// matrix leaves used elementwise, or as the left operand of a product,
+// are split into one block of rows per worker; every worker computes its
+// block of the split nodes and its partial reductions, and the
+// coordinator evaluates the nodes before and after the split. Only the
+// live out blocks and the partial reductions are transferred.
+//
+// AUTOMATIC takes the row blocks when the DAG can be split by rows and
+// their predicted time is not worse, the communication-aware assignment
+// otherwise.
+class DAG;
+
+class DAGPartitioning {
+public:
+	enum Strategy {
+		AUTOMATIC, COMMUNICATION_AWARE, ROW_BLOCKS
+	};
+
+	// worker of the nodes evaluated by every worker that uses them
+	static const unsigned ALL_WORKERS = 0xFFFFFFFF;
+
+	// 'flatDAG' is the frozen form of 'dag'; the DAG maps the live out
+	// variables to their nodes, whose values go back to the coordinator
+	DAGPartitioning(const DAG &dag, const FlatDAG &flatDAG, const unordered_set<LocalVariable *> &liveOut,
+			unsigned numberOfWorkers, Strategy strategy = AUTOMATIC, const PartitionCosts &costs = PartitionCosts());
+
+	// COMMUNICATION_AWARE or ROW_BLOCKS
+	Strategy getStrategy() const {
+		return strategy;
+	}
+
+	unsigned getNumberOfWorkers() const {
+		return workers;
+	}
+
+	const FlatDAG &getFlatDAG() const {
+		return dag;
+	}
+
+	bool isLiveOut(FlatDAG::NodeId n) const {
+		return liveOutNodes[n];
+	}
+
+	// COMMUNICATION_AWARE: worker evaluating node n, or ALL_WORKERS
+	unsigned getWorker(FlatDAG::NodeId n) const {
+		return owners[n];
+	}
+
+	// COMMUNICATION_AWARE: workers other than the owner using node n
+	const vector<unsigned> &getConsumers(FlatDAG::NodeId n) const {
+		return consumers[n];
+	}
+
+	// ROW_BLOCKS: phases of the nodes, and the split leaves
+	const RowSplit &getRowSplit() const {
+		return split;
+	}
+	bool isSplitLeaf(FlatDAG::NodeId n) const {
+		return splitLeaves[n];
+	}
+
+	// ROW_BLOCKS: rows of the split leaves; worker w gets the rows
+	// [getFirstRow(w), getFirstRow(w + 1))
+	size_t getRows() const {
+		return rows;
+	}
+	size_t getFirstRow(unsigned worker) const {
+		return rows * worker / workers;
+	}
+
+	// predicted time of the evaluation, and bytes moved between processes
+	double getMakespan() const {
+		return makespan;
+	}
+	uint64_t getTransferBytes() const {
+		return transferBytes;
+	}
+	// predicted busy time of worker w
+	double getWorkerSeconds(unsigned worker) const {
+		return workerSeconds[worker];
+	}
+
+	void print() const;
+
+private:
+	const FlatDAG               &dag;
+	unsigned                    workers;
+	PartitionCosts              costs;
+	Strategy                    strategy;
+	vector<bool>                liveOutNodes;   // by node
+	vector<unsigned>            owners;         // by node
+	vector<vector<unsigned> >   consumers;      // by node
+	RowSplit                    split;
+	vector<bool>                splitLeaves;    // by node
+	size_t                      rows;
+	double                      makespan;
+	uint64_t                    transferBytes;
+	vector<double>              workerSeconds;
+
+	uint64_t getElements(FlatDAG::NodeId n) const;
+	double getComputeSeconds(FlatDAG::NodeId n) const;
+	double getTransferSeconds(FlatDAG::NodeId n) const;
+	bool isReplicated(FlatDAG::NodeId n) const;
+	void assignNodes();
+	bool splitRows();
+};
+
+#endif
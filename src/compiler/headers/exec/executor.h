@@ -0,0 +1,66 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include <functional>
+#include <vector>
+#include <utility>
+#include <exception>
+#include "ir/flatDag.h"
+#include "exec/threadPool.h"
+
+using namespace std;
+
+class DAG;
+class Node;
+
+// Runs the nodes of a DAG on a thread pool, respecting the data dependences.
+// A node becomes ready when all its operands were executed: the ready set
+// starts with the leaves (no operands) and every finished node decrements
+// the pending operand count of its users, dispatching the ones reaching 0.
+// Independent nodes, e.g. all the nodes of a DAG level, run in parallel.
+class Executor {
+public:
+	using NodeKernel = function<void(FlatDAG::NodeId)>;
+	using DAGKernel = function<void(Node *)>;
+	using OrderingEdges = vector<pair<FlatDAG::NodeId, FlatDAG::NodeId> >;
+
+	// Called when an asynchronous node finished, with its error if any
+	using Completion = function<void(exception_ptr)>;
+
+	// Starts node n without waiting for it and returns true, or returns
+	// false to run n with the NodeKernel. 'done' must be called once when
+	// the node finished, from any thread (e.g. an I/O thread).
+	using AsyncKernel = function<bool(FlatDAG::NodeId, const Completion &done)>;
+
+	Executor(ThreadPool &threadPool) : pool(threadPool) {
+	}
+
+	// Calls kernel once for every node of 'dag', operands first, and waits
+	// for all of them. An exception thrown by a kernel is rethrown here,
+	// after the nodes already running finished; the remaining kernels are skipped.
+	// Must not be called from a task running in the same pool.
+	void execute(const FlatDAG &dag, const NodeKernel &kernel);
+
+	// Same, where node 'after' of every (before, after) pair of 'ordering'
+	// also waits for node 'before' (e.g. buffer reuse, exec/bufferAssignment.h).
+	// Every pair must have before < after.
+	void execute(const FlatDAG &dag, const NodeKernel &kernel, const OrderingEdges &ordering);
+
+	// Same, starting the nodes accepted by 'asyncKernel' asynchronously. The
+	// ready asynchronous nodes (e.g. the loads of the block) are all started
+	// first, so they overlap with the computation on the available values.
+	void execute(const FlatDAG &dag, const NodeKernel &kernel, const OrderingEdges &ordering,
+			const AsyncKernel &asyncKernel);
+
+	// Same, on the flat form of 'dag'
+	void execute(const DAG &dag, const DAGKernel &kernel);
+
+	ThreadPool &getThreadPool() {
+		return pool;
+	}
+
+private:
+	ThreadPool &pool;
+};
+
+#endif
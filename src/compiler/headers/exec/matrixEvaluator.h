@@ -0,0 +1,159 @@
+#ifndef MATRIX_EVALUATOR_H
+#define MATRIX_EVALUATOR_H
+
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <string>
+#include <functional>
+#include "ir/flatDag.h"
+#include "exec/bufferAssignment.h"
+#include "exec/executor.h"
+#include "io/asyncLoader.h"
+#include "matrix/matrix.h"
+#include "matrix/sparse.h"
+
+using namespace std;
+
+// Value of a DAG node at run time: a dense or a sparse matrix, or a scalar
+// for constants and expressions over constants only
+class RuntimeValue {
+public:
+	RuntimeValue() : scalar(false), scalarValue(0) {
+	}
+
+	RuntimeValue(double value) : scalar(true), scalarValue(value) {
+	}
+
+	RuntimeValue(const Matrix &value) : scalar(false), scalarValue(0), matrix(value) {
+	}
+
+	RuntimeValue(const SparseMatrix &value) : scalar(false), scalarValue(0), sparseMatrix(value) {
+	}
+
+	bool isScalar() const {
+		return scalar;
+	}
+	// a dense matrix
+	bool isMatrix() const {
+		return !scalar && !matrix.isEmpty();
+	}
+	bool isSparse() const {
+		return !scalar && !sparseMatrix.isEmpty();
+	}
+	bool isEmpty() const {
+		return !scalar && matrix.isEmpty() && sparseMatrix.isEmpty();
+	}
+
+	double getScalar() const {
+		return scalarValue;
+	}
+	const Matrix &getMatrix() const {
+		return matrix;
+	}
+	Matrix &getMatrix() {
+		return matrix;
+	}
+	const SparseMatrix &getSparse() const {
+		return sparseMatrix;
+	}
+
+	// the value with a sparse matrix in dense storage
+	RuntimeValue toDense() const {
+		return isSparse() ? RuntimeValue(sparseMatrix.toDense()) : *this;
+	}
+
+private:
+	bool         scalar;
+	double       scalarValue;
+	Matrix       matrix;
+	SparseMatrix sparseMatrix;
+};
+
+// Lowers the operator nodes of a frozen DAG to the Matrix runtime kernels.
+// Variables read by the block are bound to matrices before the execution;
+// evaluate() is the Executor kernel. Every node writes only its own value,
+// so nodes can be evaluated concurrently once their operands are ready.
+//
+// The kernel of a node is chosen from the storage of its operands: sparse
+// operands use the kernels of matrix/sparse.h. Variable and load leaves
+// marked sparse (opt/densityAnalysis.h) are compressed to CSR when they
+// arrive dense. A sum of sparse operands is computed sparse only when its
+// node is marked sparse, otherwise it is scattered into the dense result.
+// Fused nodes read their sparse inputs tile by tile, and operations
+// without a sparse kernel expand their operands.
+class MatrixEvaluator {
+public:
+	// External function called by the CALL nodes
+	using Function = function<RuntimeValue(const vector<RuntimeValue> &)>;
+
+	MatrixEvaluator(const FlatDAG &flatDAG);
+
+	// Initial value of 'variable' in the block. The matrix shares its
+	// storage with the caller's: a BufferAssignment made with
+	// 'updateExternal' may overwrite it.
+	void bind(LocalVariable *variable, const RuntimeValue &value) {
+		bindings[variable] = value;
+	}
+
+	// Writes the results to the buffers of 'assignment' (planned for this
+	// DAG) instead of a new matrix per node. The internal buffers are
+	// allocated here; run the Executor with the ordering edges of the plan.
+	// Only the values of the live out nodes stay valid after the execution.
+	void setBufferAssignment(const BufferAssignment *assignment);
+
+	// Function called by the CALL nodes of 'name'
+	void defineFunction(const string &name, const Function &function) {
+		functions[name] = function;
+	}
+
+	// Loader for the LOAD nodes
+	void setLoader(AsyncLoader *asyncLoader) {
+		loader = asyncLoader;
+	}
+
+	// Executor async kernel: requests the object of a LOAD node and returns
+	// true, 'done' is called when it arrived. False for the other nodes.
+	bool startLoad(FlatDAG::NodeId n, const Executor::Completion &done);
+
+	// Computes the value of node n from the values of its operands
+	void evaluate(FlatDAG::NodeId n);
+
+	const RuntimeValue &getValue(FlatDAG::NodeId n) const {
+		return values[n];
+	}
+
+	// Sets the value of node n, computed elsewhere (e.g. a tile of a leaf)
+	void setValue(FlatDAG::NodeId n, const RuntimeValue &value) {
+		values[n] = value;
+	}
+
+	// Releases the value of node n (e.g. an intermediate that is no longer needed)
+	void release(FlatDAG::NodeId n) {
+		values[n] = RuntimeValue();
+	}
+
+private:
+	const FlatDAG                                  &dag;
+	vector<RuntimeValue>                           values;     // indexed by flat node id
+	unordered_map<LocalVariable *, RuntimeValue>   bindings;
+	const BufferAssignment                         *bufferAssignment;
+	AsyncLoader                                    *loader;
+	vector<shared_ptr<MatrixStorage> >             buffers;    // indexed by buffer, 0 for external ones
+	unordered_map<string, Function>                functions;
+	vector<uint64_t>                               loadRequests;   // request times of the traced loads
+
+	void evaluateLeaf(FlatDAG::NodeId n);
+	void prepareResult(FlatDAG::NodeId n);
+	// 'sparse' when density analysis marked the result sparse
+	void evaluateAdd(const RuntimeValue &left, const RuntimeValue &right, RuntimeValue &result, bool sparse);
+	void evaluateMultiply(const RuntimeValue &left, const RuntimeValue &right, RuntimeValue &result);
+	void evaluateSparseAdd(const RuntimeValue &left, const RuntimeValue &right, RuntimeValue &result, bool sparse);
+	void evaluateSparseMultiply(const RuntimeValue &left, const RuntimeValue &right, RuntimeValue &result);
+	void evaluateFusedNode(FlatDAG::NodeId n);
+	void evaluateReduction(Operator op, const RuntimeValue &operand, RuntimeValue &result);
+	void evaluateDot(const RuntimeValue &left, const RuntimeValue &right, RuntimeValue &result);
+	void evaluateEffect(FlatDAG::NodeId n);
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef ROW_SPLIT_H
+#define ROW_SPLIT_H
+
+#include <vector>
+#include <string>
+#include "ir/flatDag.h"
+#include "exec/matrixEvaluator.h"
+
+using namespace std;
+
+// Evaluation of a frozen DAG whose large leaves are split into blocks of
+// rows: the tiles of a TiledEvaluator, or the row blocks of the workers
+// of a row partitioned DAG (exec/dagPartitioning.h). Every node falls in
+// one of four phases: the nodes not depending on split leaves are
+// evaluated whole, before the blocks; the nodes computed block by block
+// are split too; the reductions (SUM, MIN, MAX, DOT) of split values give
+// one partial value per block, combined afterwards; and the nodes using a
+// reduction are evaluated whole, after all the blocks.
+//
+// A split node may combine blocks elementwise with other blocks and
+// scalars, or multiply a block by a whole matrix (the right operand of a
+// product). Anything else (a whole matrix plus a block, a block used after
+// a reduction, PRINT of a block...) needs more than one pass over the rows
+// and throws runtime_error.
+class RowSplit {
+public:
+	enum Phase {
+		BEFORE_SPLIT,   // does not depend on split leaves
+		SPLIT,          // one block of rows of the value per block
+		PARTIAL,        // reduction of split values, combined over the blocks
+		AFTER_SPLIT     // depends on a reduction
+	};
+
+	RowSplit() {
+	}
+
+	// 'splitLeaves' flags the split leaves, by node
+	RowSplit(const FlatDAG &flatDAG, const vector<bool> &splitLeaves);
+
+	Phase getPhase(FlatDAG::NodeId n) const {
+		return phases[n];
+	}
+
+	// Once the whole nodes were evaluated: their values used by split
+	// nodes must be scalars, or the right operands of products
+	void checkWholeOperands(const FlatDAG &flatDAG, const MatrixEvaluator &evaluator) const;
+
+	// value of a reduction 'op' before the first block, and after one more
+	// block whose reduction is 'value'
+	static double getIdentity(Operator op);
+	static double combine(Operator op, double partial, double value);
+
+	// runtime_error naming node n
+	static void error(const FlatDAG &flatDAG, FlatDAG::NodeId n, const string &message);
+
+private:
+	vector<Phase> phases;   // by node
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <functional>
+
+using namespace std;
+
+// Persistent pool of worker threads with work stealing.
+// Every worker owns a task queue: it pushes and pops its own tasks at the
+// back (LIFO, good locality for tasks made ready by the task it just ran)
+// and idle workers steal from the front of the other queues (FIFO).
+class ThreadPool {
+public:
+	using Task = function<void()>;
+
+	// numberOfThreads == 0 uses defaultNumberOfThreads()
+	explicit ThreadPool(unsigned numberOfThreads = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+
+	// Queues a task. Tasks submitted from a worker go to its own queue.
+	void submit(Task task);
+
+	unsigned getNumberOfThreads() const {
+		return workers.size();
+	}
+
+	// Number of hardware threads, capped by the DAG_NUM_THREADS environment variable
+	static unsigned defaultNumberOfThreads();
+
+private:
+	struct WorkQueue {
+		mutex       lock;
+		deque<Task> tasks;
+	};
+
+	vector<thread>                workers;
+	vector<unique_ptr<WorkQueue> > queues;
+
+	mutex                sleepLock;
+	condition_variable   wakeUp;
+	atomic<unsigned>     queuedTasks;
+	atomic<unsigned>     nextQueue;
+	atomic<bool>         stopping;
+
+	// pool and queue of the worker running on the current thread
+	static thread_local ThreadPool *currentPool;
+	static thread_local unsigned    currentQueue;
+
+	void workerLoop(unsigned index);
+	bool popTask(unsigned index, Task &task);
+	bool stealTask(unsigned index, Task &task);
+};
+
+#endif
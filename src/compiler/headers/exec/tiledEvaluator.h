@@ -0,0 +1,107 @@
+#ifndef TILED_EVALUATOR_H
+#define TILED_EVALUATOR_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include "ir/flatDag.h"
+#include "exec/matrixEvaluator.h"
+#include "exec/rowSplit.h"
+#include "io/asyncLoader.h"
+#include "io/tileStream.h"
+
+using namespace std;
+
+// Out-of-core evaluation of a frozen DAG, for inputs larger than memory.
+// The streamed matrices (variables bound to a TileSource, and the objects
+// of the LOAD nodes) are split into tiles of rows, and every tile goes
+// through all the nodes that depend on them before the next one is read:
+// for 'e = a + b + c + d' only one tile of each matrix is resident, plus
+// the tiles of the next step, read meanwhile on another thread.
+//
+// The nodes are evaluated with a MatrixEvaluator in the phases of a
+// RowSplit over the streamed leaves (exec/rowSplit.h): the whole nodes once
+// before the tiles, the split nodes and partial reductions once per tile,
+// and the nodes using the reductions after the last tile. The rows of a
+// split result go to its TileSink.
+class TiledEvaluator {
+public:
+	// 'workingSetBytes' bounds the tiles resident at once: the tiles of
+	// all the tiled nodes, and the tiles of the streamed inputs being read
+	TiledEvaluator(const FlatDAG &flatDAG, size_t workingSetBytes);
+
+	// Value of a variable that is not streamed
+	void bind(LocalVariable *variable, const RuntimeValue &value) {
+		evaluator.bind(variable, value);
+	}
+
+	// Streams 'variable' from 'source', which must outlive the evaluation
+	void bindTiles(LocalVariable *variable, TileSource *source) {
+		sources[variable] = source;
+	}
+
+	// Loader for the objects of the LOAD nodes. They are streamed as views
+	// of the loaded matrix (a mapping for binary matrix files), except the
+	// ones marked with loadWhole.
+	void setLoader(AsyncLoader *asyncLoader) {
+		loader = asyncLoader;
+		evaluator.setLoader(asyncLoader);
+	}
+
+	// Loads object 'name' as a whole value, e.g. the right operand of a product
+	void loadWhole(const string &name) {
+		wholeObjects.insert(name);
+	}
+
+	// Receives the rows of the value of 'variable', which must be tiled
+	void setSink(LocalVariable *variable, TileSink *sink) {
+		sinks[variable] = sink;
+	}
+
+	void defineFunction(const string &name, const MatrixEvaluator::Function &function) {
+		evaluator.defineFunction(name, function);
+	}
+
+	// Evaluates the DAG over all the tiles; finishes the sinks
+	void run();
+
+	// Value of node n after run(); for a tiled node, its last tile
+	const RuntimeValue &getValue(FlatDAG::NodeId n) const {
+		return evaluator.getValue(n);
+	}
+
+	// rows per tile and number of tiles of the last run
+	size_t getTileRows() const {
+		return tileRows;
+	}
+	size_t getNumberOfTiles() const {
+		return numberOfTiles;
+	}
+
+private:
+	const FlatDAG                                  &dag;
+	size_t                                         workingSet;
+	MatrixEvaluator                                evaluator;
+	AsyncLoader                                    *loader;
+	unordered_map<LocalVariable *, TileSource *>   sources;
+	unordered_map<LocalVariable *, TileSink *>     sinks;
+	unordered_set<string>                          wholeObjects;
+
+	RowSplit                                       split;
+	vector<FlatDAG::NodeId>                        streamed;        // tiled leaves
+	vector<TileSource *>                           nodeSources;     // by streamed leaf
+	vector<unique_ptr<TileSource> >                loadedSources;   // of the LOADs
+	vector<pair<FlatDAG::NodeId, TileSink *> >     nodeSinks;
+	size_t                                         tileRows;
+	size_t                                         numberOfTiles;
+
+	void classifyNodes();
+	void openSources();
+	size_t computeTileRows(size_t rows);
+	void readTiles(size_t firstRow, size_t rows, vector<Matrix> &tiles);
+	void evaluateTile(size_t firstRow, vector<double> &partials);
+};
+
+#endif
@@ -2,23 +2,40 @@
 #define DAG_H
 
 #include <vector>
+#include <memory>
+#include <stdint.h>
 #include <unordered_map>
+#include <unordered_set>
 #include <iostream>
 #include <algorithm>
 #include "ir/instruction.h"
+#include "ir/shape.h"
+#include "ir/valueNumberTable.h"
 #include "cfg/basicBlock.h"
+#include "support/arena.h"
+#include "support/compilationContext.h"
 
 using namespace std;
 
+class FlatDAG;
+
 // Define the information to be stored at each node
 class Node {
 public:
-	Node(Operator lbl) : label(lbl) { }
+	using NodeList = vector<Node *, ArenaAllocator<Node *> >;
+
+	// edge lists are allocated from 'arena' when one is given
+	Node(Operator lbl, Arena *arena = 0) :
+			predecessors(ArenaAllocator<Node *>(arena)),
+			successors(ArenaAllocator<Node *>(arena)),
+			label(lbl), id(0), density(1), sparse(false) { }
 
-	vector<Node *> getPredecessors() {
+	virtual ~Node() { }
+
+	const NodeList &getPredecessors() const {
 		return predecessors;
 	}
-	vector<Node *> getSuccessors() {
+	const NodeList &getSuccessors() const {
 		return successors;
 	}
 	void addPredecessor(Node * pred) {
@@ -28,21 +45,96 @@ public:
 		successors.push_back(succ);
 	}
 
-	virtual int hashCode () const = 0;
+	// Replace every edge to 'from' with an edge to 'to'
+	void replaceSuccessor(Node *from, Node *to) {
+		for (unsigned i = 0; i < successors.size(); i++) {
+			if (successors[i] == from)
+				successors[i] = to;
+		}
+	}
+
+	// Make the edge at 'position' an edge to 'to'
+	void setSuccessor(unsigned position, Node *to) {
+		successors[position] = to;
+	}
+
+	// Remove the edge at 'position'
+	void removeSuccessor(unsigned position) {
+		successors.erase(successors.begin() + position);
+	}
+
+	// Remove one edge coming from 'pred'
+	void removePredecessor(Node *pred) {
+		NodeList::iterator position = std::find(predecessors.begin(), predecessors.end(), pred);
+		if (position != predecessors.end())
+			predecessors.erase(position);
+	}
+
+	// Remove every edge coming from one of 'preds'
+	void removePredecessors(const unordered_set<Node *> &preds) {
+		predecessors.erase(std::remove_if(predecessors.begin(), predecessors.end(),
+				[&preds](Node *pred) { return preds.count(pred) != 0; }), predecessors.end());
+	}
+
+	// Remove the 'count' edges coming from nodes for which isRemoved(pred)
+	// holds, all among the latest ones: only the end of the list is scanned
+	template<typename Predicate>
+	void removeLatestPredecessors(Predicate isRemoved, size_t count) {
+		NodeList::iterator first = predecessors.end();
+		for (size_t found = 0; found < count && first != predecessors.begin();) {
+			--first;
+			if (isRemoved(*first))
+				found++;
+		}
+		predecessors.erase(std::remove_if(first, predecessors.end(), isRemoved), predecessors.end());
+	}
+
+	void clearPredecessors() {
+		predecessors.clear();
+	}
+
+	// The class of a node follows from its label: LeafNode for constants,
+	// variables and loads, FusedNode for FUSED, EffectNode for PRINT and
+	// CALL, OperatorNode otherwise. dispatch() below switches on it.
+	bool isLeaf() const {
+		return label == CONSTANT || label == LOCALVARIABLE || label == LOAD;
+	}
+
+	// hashCode() and print() of the class of the node
+	int hashCode() const;
 
 	// get the DAG label: constant/localVariable for leaf nodes
 	//                    operator for interior nodes
-    Operator getLabel () { return label; }
+    Operator getLabel () const { return label; }
+
+	// unique id of the node inside its DAG, assigned on insertion
+	unsigned getId() const { return id; }
+	void setId(unsigned i) { id = i; }
+
+	// shape of the value, set by shape inference (opt/shapeInference.h)
+	const Shape &getShape() const { return shape; }
+	void setShape(const Shape &s) { shape = s; }
 
-	virtual void print() const = 0;
+	// estimated fraction of nonzero elements, and whether the value is kept
+	// in sparse storage, set by density analysis (opt/densityAnalysis.h)
+	double getDensity() const { return density; }
+	void setDensity(double d) { density = d; }
+	bool isSparse() const { return sparse; }
+	void setSparse(bool s) { sparse = s; }
+
+	void print() const;
 
 protected:
-	vector<Node *>  predecessors;
-	vector<Node *>  successors;
+	NodeList        predecessors;
+	NodeList        successors;
 
 	// A DAG label is: a constant/localVariable for leaf nodes
 	//                 an operator for interior nodes
 	Operator          label;
+	unsigned          id;
+	Shape             shape;
+	double            density;
+	bool              sparse;
 
 	void printLabel() const;
 };
@@ -50,27 +142,125 @@ protected:
 // Defines a DAG non-leaf Node
 class OperatorNode: public Node {
 private:
-	vector<LocalVariable *> identifierList;
+	vector<LocalVariable *, ArenaAllocator<LocalVariable *> > identifierList;
 
 public:
-	OperatorNode(Operator lbl, Node *left, Node *right): Node(lbl) {
+	OperatorNode(Operator lbl, Node *left, Node *right, Arena *arena = 0):
+			Node(lbl, arena), identifierList(ArenaAllocator<LocalVariable *>(arena)) {
 		addSuccessor(left);
 		addSuccessor(right);
 		left->addPredecessor(this);
 		right->addPredecessor(this);
 	}
 
-	virtual void print() const;
+	// for the reductions (SUM, MIN, MAX) of a single operand
+	OperatorNode(Operator lbl, Node *operand, Arena *arena = 0):
+			Node(lbl, arena), identifierList(ArenaAllocator<LocalVariable *>(arena)) {
+		addSuccessor(operand);
+		operand->addPredecessor(this);
+	}
+
+	void print() const;
 
-	virtual int hashCode() const;
+	int hashCode() const;
 
 	bool operator==(const OperatorNode &other) const;
 
+	const vector<LocalVariable *, ArenaAllocator<LocalVariable *> > &getIdentifiers() const {
+		return identifierList;
+	}
+
+	bool hasIdentifier(LocalVariable *localVariable) const {
+		return std::find(identifierList.begin(), identifierList.end(), localVariable) != identifierList.end();
+	}
+
+	void clearIdentifiers() {
+		identifierList.clear();
+	}
+
 	void addIdentifier(LocalVariable *localVariable) {
 		identifierList.push_back(localVariable);
 	}
 
 	void removeIdentifier (LocalVariable *localVariable);
+
+protected:
+	// for operator nodes with other than two operands
+	OperatorNode(Operator lbl, Arena *arena):
+			Node(lbl, arena), identifierList(ArenaAllocator<LocalVariable *>(arena)) {
+	}
+};
+
+// One operation of a fused node. Operands are registers: the inputs of
+// the node (its successors) come first, then the results of the previous
+// operations. The last operation produces the value of the node.
+struct FusedOperation {
+	Operator op;
+	uint32_t operand0;
+	uint32_t operand1;
+};
+
+// Defines a DAG node evaluating a whole region of elementwise operations
+class FusedNode: public OperatorNode {
+public:
+	using Program = vector<FusedOperation, ArenaAllocator<FusedOperation> >;
+
+	FusedNode(const vector<Node *> &inputs, const vector<FusedOperation> &operations, Arena *arena = 0):
+			OperatorNode(FUSED, arena), program(operations.begin(), operations.end(),
+					ArenaAllocator<FusedOperation>(arena)) {
+		for (Node *input : inputs) {
+			addSuccessor(input);
+			input->addPredecessor(this);
+		}
+	}
+
+	const Program &getProgram() const {
+		return program;
+	}
+
+	void print() const;
+
+private:
+	Program program;
+};
+
+// Defines a DAG node with a side effect: PRINT, or CALL (whose result may
+// also be used). Effect nodes are never merged. The successors are the
+// operands, then the previous effect node of the block, if any, so that
+// the effects happen in program order.
+class EffectNode: public OperatorNode {
+public:
+	EffectNode(Instruction *instr, const vector<Node *> &operands, Node *previousEffect, Arena *arena = 0):
+			OperatorNode(instr->getInstructionID(), arena), instruction(instr),
+			numberOfOperands(operands.size()) {
+		for (Node *operand : operands) {
+			addSuccessor(operand);
+			operand->addPredecessor(this);
+		}
+		if (previousEffect) {
+			addSuccessor(previousEffect);
+			previousEffect->addPredecessor(this);
+		}
+	}
+
+	// the Print or Call instruction
+	Instruction * getInstruction() const {
+		return instruction;
+	}
+
+	unsigned getNumberOfOperands() const {
+		return numberOfOperands;
+	}
+
+	Node * getPreviousEffect() const {
+		return successors.size() > numberOfOperands ? successors.back() : 0;
+	}
+
+	void print() const;
+
+private:
+	Instruction *instruction;
+	unsigned     numberOfOperands;
 };
 
 // Defines a DAG leaf Node
@@ -79,20 +269,20 @@ private:
 	Instruction *leaf;
 
 public:
-	LeafNode(Instruction *lf): Node(lf->getInstructionID()), leaf(lf) {
+	LeafNode(Instruction *lf, Arena *arena = 0): Node(lf->getInstructionID(), arena), leaf(lf) {
 	}
 
-	LeafNode(Node *parent, Instruction *lf): Node(lf->getInstructionID()), leaf(lf) {
+	LeafNode(Node *parent, Instruction *lf, Arena *arena = 0): Node(lf->getInstructionID(), arena), leaf(lf) {
 		addPredecessor(parent);
 	}
 
-	virtual void print() const{
+	void print() const{
 		cout << "Leaf Node @" << this << "[";
 		leaf->print();
 		cout << "]";
 	}
 
-	virtual int hashCode () const;
+	int hashCode () const;
 
 	bool operator==(const LeafNode &other) const {
 		return (leaf == other.leaf);
@@ -101,15 +291,92 @@ public:
 	Instruction * getLeaf() { return leaf; }
 };
 
+// Static dispatch over the classes of the nodes, from their label (see
+// Node::isLeaf): 'function' is called with the node cast to its class.
+template<typename Result, typename Function>
+inline Result dispatch(Node *node, Function &function) {
+	switch (node->getLabel()) {
+	case CONSTANT:
+	case LOCALVARIABLE:
+	case LOAD:
+		return function(*static_cast<LeafNode *>(node));
+	case FUSED:
+		return function(*static_cast<FusedNode *>(node));
+	case PRINT:
+	case CALL:
+		return function(*static_cast<EffectNode *>(node));
+	default:
+		return function(*static_cast<OperatorNode *>(node));
+	}
+}
+
+// Node visitor with static (CRTP) dispatch, like InstructionVisitor: the
+// methods a pass does not define delegate to the base class of the node,
+// visitFusedNode and visitEffectNode to visitOperatorNode, and then to
+// visitNode, which does nothing.
+template<typename Derived, typename Result = void>
+class NodeVisitor {
+public:
+	// Calls the visit method of the class of 'node'
+	Result visit(Node *node) {
+		Caller caller = { derived() };
+		return dispatch<Result>(node, caller);
+	}
+
+	Result visitNode(Node &node) {
+		return Result();
+	}
+
+	Result visitLeafNode(LeafNode &node) {
+		return derived().visitNode(node);
+	}
+
+	Result visitOperatorNode(OperatorNode &node) {
+		return derived().visitNode(node);
+	}
+
+	Result visitFusedNode(FusedNode &node) {
+		return derived().visitOperatorNode(node);
+	}
+
+	Result visitEffectNode(EffectNode &node) {
+		return derived().visitOperatorNode(node);
+	}
+
+private:
+	Derived &derived() {
+		return static_cast<Derived &>(*this);
+	}
+
+	struct Caller {
+		Derived &visitor;
+
+		Result operator()(LeafNode &node) { return visitor.visitLeafNode(node); }
+		Result operator()(OperatorNode &node) { return visitor.visitOperatorNode(node); }
+		Result operator()(FusedNode &node) { return visitor.visitFusedNode(node); }
+		Result operator()(EffectNode &node) { return visitor.visitEffectNode(node); }
+	};
+};
+
 // Defines a Direct Acyclic Graph (DAG)
 class DAG {
 public:
 	template<typename T>
 	using NodeMap = unordered_map<Node*, T>;
 	using DAGNodes = vector<Node*>;
-	using IdentifierMap = unordered_map<LocalVariable*, Node *>;
-
+	using IdentifierMap = unordered_map<LocalVariable*, Node *, hash<LocalVariable*>,
+			equal_to<LocalVariable*>, ArenaAllocator<pair<LocalVariable* const, Node *> > >;
+	using ConstantMap = unordered_map<int, Node *, hash<int>,
+			equal_to<int>, ArenaAllocator<pair<const int, Node *> > >;
+	using LoadMap = unordered_map<string, Node *>;
+
+	// Nodes are allocated from the context arena of the basic block, if any.
+	// A lowered basic block is read from its flat instructions.
 	DAG (BasicBlock *basicBlock);
+	// Nodes are allocated from the arena of 'context', or from the heap if null.
+	// With 'edits', the instructions are indexed as they are added, for the
+	// incremental maintenance below; the other DAGs do not pay for the index.
+	DAG (BasicBlock *basicBlock, CompilationContext *context, bool edits = false);
 	DAG (): DAG(0) { }
 
 	~DAG();
@@ -120,24 +387,146 @@ public:
 	// Get the vector containing the DAG nodes
 	const vector<Node*>& getDAGNodes() const;
 
+	// Get the node holding the latest value of variable, 0 if the block never uses it
+	Node * getNode(LocalVariable *variable) const;
+
+	// Rewriting support for optimization passes
+
+	// True if the latest value of some variable is the value of 'node'
+	bool holdsVariable(Node *node) const;
+
+	// Redirect every user of 'from', and every variable it holds, to 'to'
+	void replaceAllUses(Node *from, Node *to);
+
+	// Remove nodes that have no users left (all users must be in 'nodes' too)
+	void removeNodes(const unordered_set<Node *> &nodes);
+
+	// Get the node computing 'left op right', creating it if it does not exist
+	Node * addOperation(Operator op, Node *left, Node *right);
+
+	// Get the node computing the reduction 'op operand' (SUM, MIN or MAX)
+	Node * addReduction(Operator op, Node *operand);
+
+	// Get the leaf of an integer constant, creating it if it does not exist
+	Node * addConstant(int value);
+
+	// The PRINT and CALL nodes, in program order
+	const DAGNodes &getEffects() const {
+		return effects;
+	}
+
+	// Incremental maintenance, for blocks edited after their DAG is built.
+	// The DAG is updated as if it was built again from the edited block:
+	// only the nodes of the edited instruction, and of the instructions
+	// reading the variables it assigns, transitively, are evaluated again;
+	// the nodes no instruction needs any more are removed. The caller edits
+	// the basic block itself. Needs a DAG built with 'edits' from the linked
+	// instructions and not rewritten by a pass since (logic_error otherwise);
+	// throws invalid_argument for instructions not in (or already in) the DAG.
+
+	// Add 'instruction' before 'position', at the end of the block when 0
+	void insertInstruction(Instruction *instruction, Instruction *position = 0);
+
+	void removeInstruction(Instruction *instruction);
+
+	// Put 'replacement' in the place of 'instruction'
+	void replaceInstruction(Instruction *instruction, Instruction *replacement);
+
+	// Nodes created or changed by the edits since the last clearDirtyNodes()
+	const DAGNodes &getDirtyNodes() const {
+		return dirtyNodes;
+	}
+	bool isDirty(Node *node) const;
+	void clearDirtyNodes();
+
+	// The dirty nodes and their users, transitively, operands before users:
+	// the nodes whose annotations (shape, density) may have to change
+	vector<Node *> getDirtyRegion() const;
+
+	// Create a fused node computing 'program' over 'inputs'
+	FusedNode * addFusedNode(const vector<Node *> &inputs, const vector<FusedOperation> &program);
+
+	// Build the compact, index based form of the DAG (see ir/flatDag.h)
+	FlatDAG freeze() const;
+
 	void print() const;
 
 private:
+	Arena          *arena;           // node storage, 0 when nodes are heap allocated
 	DAGNodes       *operatorArray;  // contains a list of DAG nodes where the operator occurs
 	IdentifierMap  identifierMapper; // maps an identifier (LocalVariable) to latest Node producing it
+	ConstantMap    constantMapper;   // maps a constant value to its leaf Node
+	LoadMap        loadMapper;       // maps a loaded object name to its leaf Node
+	ValueNumberTable valueNumbers;   // maps 'left op right' to the Node computing it
 	DAGNodes       vertices;         // contains all vertices of the DAG
+	unsigned       nextId;           // id of the next node added
+	DAGNodes       effects;          // PRINT and CALL nodes in program order
+
+	// instructions created by the DAG when there is no arena
+	vector<Instruction *> ownedInstructions;
+	vector<Value *>       ownedValues;
+
+	struct InstructionRecord;
+	struct EditIndex;
+
+	// the instructions the DAG is built from, indexed as they are added
+	// (see EditIndex in dag.cpp)
+	bool                     editable;    // built with 'edits', false once rewritten by a pass
+	unique_ptr<EditIndex>    editIndex;
+	DAGNodes                 dirtyNodes;
+
+	Node * registerNode(Node *node);
+
+	template<typename T, typename... Args>
+	T * createNode(Args&&... args) {
+		if (arena)
+			return arena->create<T>(std::forward<Args>(args)..., arena);
+		return new T(std::forward<Args>(args)...);
+	}
 
 	void addEdge(Node* u, Node* v);
 	NodeMap<int> indegrees() const;
 	int indegree(Node*) const;
 	Node * addNode(BinaryInstruction *i);
 	Node * addNode(Operator op, Instruction *left, Instruction *right);
-	Node * searchNode(Operator op, Node *left, Node *right);
 	Node * addNode(Move *i);
+	Node * addMove(LocalVariable *variable, Operator op, Instruction *left, Instruction *right);
+	void addFlatInstruction(FlatBlock *flatBlock, const FlatInstruction &instruction);
 	Node * addNode(Constant *c);
 	Node * addNode(LocalVariable *variable);
+	Node * addNode(Load *load);
+	Node * addNode(Print *print);
+	Node * addNode(Call *call);
+	bool getNumberedOperands(Node *node, Node *&left, Node *&right) const;
 	Node * addOperatorNode(Instruction *instruction);
 	Node * addLeafNode(Instruction *instruction);
+
+	// incremental maintenance
+	void disableEdits();
+	void indexNode(Node *node);
+	void markDirty(Node *node);
+	EditIndex &getEditIndex();
+	InstructionRecord * addRecord(Instruction *instruction, uint64_t order, InstructionRecord *next);
+	void setValue(InstructionRecord *record, Node *node);
+	void indexRecord(InstructionRecord *record, bool add);
+	InstructionRecord * findRecord(Instruction *instruction);
+	uint64_t newOrder(InstructionRecord *next);
+	void relabel(InstructionRecord *next);
+	Node * readVariable(LocalVariable *variable, InstructionRecord *record);
+	Node * readOperand(Instruction *operand, InstructionRecord *record);
+	vector<Node *> readArguments(Call *call, InstructionRecord *record);
+	Node * evaluateRecord(InstructionRecord *record);
+	Node * evaluateEffect(InstructionRecord *record, Instruction *instruction, const vector<Node *> &operands);
+	void unlinkEffect(EffectNode *node);
+	void invalidate(InstructionRecord *record);
+	void invalidateReaders(InstructionRecord *record);
+	void variableChanged(LocalVariable *variable);
+	uint64_t detachRecord(InstructionRecord *record);
+	void release(Node *node);
+	void update();
+	void updateVariables();
+	void collectGarbage();
+	void forgetNode(Node *node);
 };
 
 
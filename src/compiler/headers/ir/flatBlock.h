@@ -0,0 +1,167 @@
+#ifndef FLAT_BLOCK_H
+#define FLAT_BLOCK_H
+
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+#include "ir/instruction.h"
+#include "support/arena.h"
+#include "support/compilationContext.h"
+
+using namespace std;
+
+class BasicBlock;
+
+// Fixed size record for a three-address instruction:
+//   LOCALVARIABLE  destination                    (first use of a variable)
+//   MOVE           destination <- operand0
+//   ADD / MUL / DOT  destination <- operand0 op operand1
+//   SUM / MIN / MAX  destination <- op operand0
+//   LOAD           destination <- object operand0
+//   PRINT / CALL   destination <- effect operand0
+// Operands are variable slot numbers, or constant pool indices when
+// tagged with FlatBlock::CONSTANT_OPERAND. The operand of a LOAD is an
+// index in the table of loaded objects, and the operand of PRINT and CALL
+// an index in the table of effect instructions, which hold their operands.
+// PRINT, and CALL when its result is unused, have no destination
+// (FlatBlock::NO_DESTINATION).
+struct FlatInstruction {
+	uint8_t  opcode;       // Operator
+	uint8_t  type;         // Type of the destination
+	uint16_t flags;        // reserved
+	uint32_t destination;  // slot number of the destination variable
+	uint32_t operand0;
+	uint32_t operand1;
+};
+
+// Contiguous instruction container for a basic block: a vector of
+// FlatInstruction records plus side tables for the constants and for the
+// variables of the block. It is an alternative to the doubly linked
+// Instruction list; iterating it touches memory sequentially.
+class FlatBlock {
+public:
+	using InstructionList = vector<FlatInstruction, ArenaAllocator<FlatInstruction> >;
+	using const_iterator = InstructionList::const_iterator;
+
+	static const uint32_t CONSTANT_OPERAND = 0x80000000;
+	static const uint32_t NO_DESTINATION = 0xFFFFFFFF;
+
+	// Objects created by the block (variables, constants) are allocated
+	// from the context arena, or owned by the block when context is 0
+	FlatBlock(CompilationContext *context = 0);
+	~FlatBlock();
+
+	FlatBlock(const FlatBlock &) = delete;
+	FlatBlock &operator=(const FlatBlock &) = delete;
+
+	// Lowers the linked instructions of 'basicBlock'. The variables and
+	// constants of the block are reused as the flat block side tables.
+	static FlatBlock * lower(BasicBlock *basicBlock);
+
+	void append(Operator opcode, uint32_t destination, uint32_t operand0 = 0,
+			uint32_t operand1 = 0, Type type = UNKOWN) {
+		FlatInstruction instruction;
+		instruction.opcode = opcode;
+		instruction.type = type;
+		instruction.flags = 0;
+		instruction.destination = destination;
+		instruction.operand0 = operand0;
+		instruction.operand1 = operand1;
+		instructions.push_back(instruction);
+	}
+
+	void reserve(size_t size) {
+		instructions.reserve(size);
+	}
+
+	// Pools the constant by value and returns its operand encoding
+	uint32_t addConstant(int value);
+	uint32_t addConstant(Constant *constant);
+
+	// Adds a load to the table of loaded objects, returns its index
+	uint32_t addLoad(Load *load) {
+		loads.push_back(load);
+		return loads.size() - 1;
+	}
+
+	Load * getLoad(uint32_t index) const {
+		return loads[index];
+	}
+
+	// Adds a Print or Call to the table of effect instructions, returns its index
+	uint32_t addEffect(Instruction *effect) {
+		effects.push_back(effect);
+		return effects.size() - 1;
+	}
+
+	Instruction * getEffect(uint32_t index) const {
+		return effects[index];
+	}
+
+	// Variable for 'slot', created on first request
+	LocalVariable * getVariable(uint32_t slot);
+
+	// Uses 'variable' as the variable of its slot
+	void addVariable(LocalVariable *variable);
+
+	// Variable or Constant instruction for an operand encoding
+	Instruction * getOperand(uint32_t operand) {
+		if (isConstantOperand(operand))
+			return constants[operand & ~CONSTANT_OPERAND];
+		return getVariable(operand);
+	}
+
+	Constant * getConstant(uint32_t operand) const {
+		return constants[operand & ~CONSTANT_OPERAND];
+	}
+
+	static bool isConstantOperand(uint32_t operand) {
+		return (operand & CONSTANT_OPERAND) != 0;
+	}
+
+	size_t size() const {
+		return instructions.size();
+	}
+	const FlatInstruction &operator[](size_t i) const {
+		return instructions[i];
+	}
+	const_iterator begin() const {
+		return instructions.begin();
+	}
+	const_iterator end() const {
+		return instructions.end();
+	}
+
+	size_t getNumberOfConstants() const {
+		return constants.size();
+	}
+	size_t getNumberOfSlots() const {
+		return variables.size();
+	}
+
+	CompilationContext * getContext() const {
+		return context;
+	}
+
+	void print();
+
+private:
+	CompilationContext *context;
+	InstructionList     instructions;
+
+	vector<Constant *, ArenaAllocator<Constant *> >           constants;      // constant pool
+	unordered_map<int, uint32_t, hash<int>, equal_to<int>,
+			ArenaAllocator<pair<const int, uint32_t> > >      constantIndex;  // constant value -> pool index
+	vector<LocalVariable *, ArenaAllocator<LocalVariable *> > variables;      // indexed by slot number
+	vector<Load *, ArenaAllocator<Load *> >                   loads;          // loaded objects
+	vector<Instruction *, ArenaAllocator<Instruction *> >     effects;        // Print and Call instructions
+
+	// heap objects created by the block when there is no context
+	vector<Instruction *> ownedInstructions;
+	vector<Value *>       ownedValues;
+
+	uint32_t lowerOperand(Instruction *operand);
+	uint32_t lowerEffect(Instruction *effect);
+};
+
+#endif
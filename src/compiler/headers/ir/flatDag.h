@@ -0,0 +1,113 @@
+#ifndef FLAT_DAG_H
+#define FLAT_DAG_H
+
+#include <vector>
+#include <stdint.h>
+#include "ir/instruction.h"
+
+using namespace std;
+
+class DAG;
+class Node;
+
+// Frozen, index based form of a DAG for optimization and scheduling passes.
+// Nodes are numbered 0..n-1 in evaluation order (operands before users) and
+// every per node field lives in its own contiguous array (structure of arrays). Edges are stored in CSR form:
+// the successors of node n are successors[successorOffsets[n] .. successorOffsets[n+1]).
+// As in DAG, the successors of an operator node are its operands, in order.
+class FlatDAG {
+public:
+	using NodeId = uint32_t;
+
+	static const NodeId INVALID_NODE = 0xFFFFFFFF;
+
+	FlatDAG() { }
+
+	// Builds the flat form of 'dag'
+	FlatDAG(const DAG &dag);
+
+	unsigned getNumberOfNodes() const {
+		return labels.size();
+	}
+
+	unsigned getNumberOfEdges() const {
+		return successors.size();
+	}
+
+	Operator getLabel(NodeId n) const {
+		return (Operator) labels[n];
+	}
+
+	bool isLeaf(NodeId n) const {
+		return leaves[n] != 0;
+	}
+
+	// Constant/LocalVariable/Load of a leaf node, 0 for operator nodes
+	Instruction * getLeaf(NodeId n) const {
+		return leaves[n];
+	}
+
+	// DAG node the flat node was built from
+	Node * getNode(NodeId n) const {
+		return nodes[n];
+	}
+
+	// Flat id of a DAG node, INVALID_NODE if it is not part of the flat DAG
+	NodeId getNodeId(const Node *node) const;
+
+	const NodeId * successorsBegin(NodeId n) const {
+		return successors.data() + successorOffsets[n];
+	}
+	const NodeId * successorsEnd(NodeId n) const {
+		return successors.data() + successorOffsets[n + 1];
+	}
+	unsigned numberOfSuccessors(NodeId n) const {
+		return successorOffsets[n + 1] - successorOffsets[n];
+	}
+
+	const NodeId * predecessorsBegin(NodeId n) const {
+		return predecessors.data() + predecessorOffsets[n];
+	}
+	const NodeId * predecessorsEnd(NodeId n) const {
+		return predecessors.data() + predecessorOffsets[n + 1];
+	}
+	unsigned numberOfPredecessors(NodeId n) const {
+		return predecessorOffsets[n + 1] - predecessorOffsets[n];
+	}
+
+	// identifiers (variables) holding the value of node n
+	LocalVariable * const * identifiersBegin(NodeId n) const {
+		return identifiers.data() + identifierOffsets[n];
+	}
+	LocalVariable * const * identifiersEnd(NodeId n) const {
+		return identifiers.data() + identifierOffsets[n + 1];
+	}
+
+	// number of edges entering each node (its number of users)
+	vector<uint32_t> indegrees() const;
+
+	// Topological order where every node comes after its operands
+	vector<NodeId> evaluationOrder() const;
+
+	// Level of every node: 0 for leaves, 1 + the highest operand level otherwise.
+	// All nodes of a level are independent and can be evaluated in parallel.
+	vector<uint32_t> levels() const;
+
+	void print() const;
+
+private:
+	vector<uint8_t>         labels;
+	vector<Instruction *>   leaves;
+	vector<Node *>          nodes;
+	vector<NodeId>          flatId;       // indexed by DAG node id
+
+	vector<uint32_t>        successorOffsets;
+	vector<NodeId>          successors;
+	vector<uint32_t>        predecessorOffsets;
+	vector<NodeId>          predecessors;
+
+	vector<uint32_t>        identifierOffsets;
+	vector<LocalVariable *> identifiers;
+};
+
+#endif
@@ -3,15 +3,22 @@
 
 #include <vector>
 #include <iostream>
+#include <string>
+#include "ir/shape.h"
+#include "support/arena.h"
 
 using namespace std;
 
 // These are the operators for our instruction set
 // I'm only defining what I need for the code exercise
 typedef enum {
-	ADD, MUL, MOVE, PRINT, CALL, RETURN, CONSTANT, LOCALVARIABLE, NUMBER_OF_OPERATORS
+	ADD, MUL, MOVE, PRINT, CALL, RETURN, CONSTANT, LOCALVARIABLE, LOAD, FUSED,
+	SUM, MIN, MAX, DOT, PHI, NUMBER_OF_OPERATORS
 } Operator;
 
+// printable name of an operator
+const char * getOperatorName(Operator op);
+
 // define the data types
 typedef enum {
 	INT, FLOAT, DOUBLE, POINTER, UNKOWN
@@ -22,6 +29,9 @@ typedef enum {
 //  I'll leave it for now.
 class Value {
 public:
+	virtual ~Value() {
+	}
+
 	virtual int valueNumber() const = 0;
 
 };
@@ -44,20 +54,21 @@ private:
 	int value;
 };
 
-class InstructionVisitor;
-class OperandVisitor;
-
 // Instruction represents a three-address instruction
 class Instruction {
 protected:
+	Operator id;
 	Value *value;
 	Instruction *substitute;
 	Instruction *previous;
 	Instruction *next;
 
 public:
-	Instruction(Value *v, Instruction *p, Instruction *n) :
-			value(v), previous(p), next(n), substitute(0) {
+	Instruction(Operator kind, Value *v, Instruction *p, Instruction *n) :
+			id(kind), value(v), previous(p), next(n), substitute(0) {
+	}
+
+	virtual ~Instruction() {
 	}
 
 	Value *getValue() const{
@@ -92,23 +103,25 @@ public:
 		return b;
 	}
 
-	// virtual functions for instruction and operand visitors
-	virtual void print() = 0;
-	virtual void accept(InstructionVisitor &v) = 0;
-	virtual Operator getInstructionID() = 0;
-	virtual void visitOperands(OperandVisitor &v) = 0;
-	virtual int hashCode() const = 0 ;
+	// The kind of the instruction, which also tells its class: passes
+	// switch on it, and so does dispatch() below instead of virtual calls
+	Operator getInstructionID() const {
+		return id;
+	}
+
+	// print() and hashCode() of the class of the instruction
+	void print();
+	int hashCode() const;
 };
 
 class BinaryInstruction: public Instruction {
 protected:
-	Operator op;
 	Instruction *operand0;
 	Instruction *operand1;
 
 public:
 	BinaryInstruction(Operator opr, Value *value, Instruction *oper0, Instruction *oper1) :
-			op(opr), operand0(oper0), operand1(oper1), Instruction(value, 0, 0) {
+			Instruction(opr, value, 0, 0), operand0(oper0), operand1(oper1) {
 	}
 
 	~BinaryInstruction();
@@ -120,7 +133,7 @@ public:
 	bool operator==(const BinaryInstruction &other) const {
 		return operand0 == other.operand0 &&
 				operand1 == other.operand1 &&
-				op == other.op;
+				id == other.id;
 	}
 
 	void setOperand0(Instruction *operand) {
@@ -145,8 +158,7 @@ public:
 		operand1 = temp;
 	}
 
-	virtual void visitOperands(OperandVisitor &v);
-	virtual int hashCode() const;
+	int hashCode() const;
 };
 
 // Defining only the two Binary instructions used in the code snippet
@@ -162,10 +174,7 @@ public:
 			BinaryInstruction(ADD, 0, operand0, operand1) {
 	}
 
-	virtual Operator getInstructionID() { return ADD; }
-
-	virtual void accept(InstructionVisitor &v);
-	virtual void print() {
+	void print() {
 		cout << " ADD ";
 		operand0->print();
 		operand1->print();
@@ -173,8 +182,6 @@ public:
 };
 
 class Mul: public BinaryInstruction {
-private:
-	Operator op;
 public:
 	Mul(Value *value, Instruction *operand0, Instruction *operand1) :
 			BinaryInstruction(MUL, value, operand0, operand1) {
@@ -184,21 +191,58 @@ public:
 			BinaryInstruction(MUL, 0, operand0, operand1) {
 	}
 
-	virtual Operator getInstructionID() { return MUL; }
-
-	virtual void accept(InstructionVisitor &v);
-	virtual void print() {
+	void print() {
 		cout << " MUL ";
 		operand0->print();
 		operand1->print();
 	}
 };
 
+// dot(a, b): the sum of the elementwise products of a and b
+class Dot: public BinaryInstruction {
+public:
+	Dot(Instruction *operand0, Instruction *operand1) :
+			BinaryInstruction(DOT, 0, operand0, operand1) {
+	}
+
+	void print() {
+		cout << " DOT ";
+		operand0->print();
+		operand1->print();
+	}
+};
+
+// Defines the reductions of a matrix to a scalar: SUM, MIN or MAX of
+// all its elements. The reduction of a scalar is the scalar.
+class Reduction: public Instruction {
+private:
+	Instruction *operand;
+
+public:
+	Reduction(Operator opr, Instruction *oper) :
+			Instruction(opr, 0, 0, 0), operand(oper) {
+	}
+
+	Instruction *getOperand() {
+		return operand->resolve();
+	}
+
+	void setOperand(Instruction *oper) {
+		operand = oper;
+	}
+
+	int hashCode() const;
+	void print() {
+		cout << " " << getOperatorName(id) << " ";
+		operand->print();
+	}
+};
+
 // Defines a instruction to represent a constant
 class Constant: public Instruction {
 public:
 	Constant(Value *value) :
-			Instruction(value, 0, 0) {
+			Instruction(CONSTANT, value, 0, 0) {
 	}
 
 	int valueNumber() const {
@@ -209,12 +253,8 @@ public:
 		return valueNumber() == other.valueNumber();
 	}
 
-	virtual Operator getInstructionID() { return CONSTANT; }
-
-	virtual void visitOperands(OperandVisitor &v);
-	virtual void accept(InstructionVisitor &v);
-	virtual int hashCode() const;
-	virtual void print() {
+	int hashCode() const;
+	void print() {
 		cout << " CONSTANT(" << value->valueNumber() << ")";
 	}
 };
@@ -224,32 +264,109 @@ public:
 class LocalVariable: public Instruction {
 private:
 	int slotNumber;
+	Shape shape;
+	double density;
+
+	// in SSA form, the variable this one is a version of
+	LocalVariable *origin;
+	unsigned version;
 
 public:
 	LocalVariable(int slotNumber) :
-			Instruction(0, 0, 0) {
+			Instruction(LOCALVARIABLE, 0, 0, 0), density(1), origin(0), version(0) {
 		this->slotNumber = slotNumber;
 	}
 
 	LocalVariable(int slotNumber, Value *value) :
-			Instruction(value, 0, 0) {
+			Instruction(LOCALVARIABLE, value, 0, 0), density(1), origin(0), version(0) {
 		this->slotNumber = slotNumber;
 	}
 
+	// Version 'v' of 'original', held in its own slot
+	LocalVariable(int slotNumber, LocalVariable *original, unsigned v) :
+			Instruction(LOCALVARIABLE, 0, 0, 0), density(1), origin(original), version(v) {
+		this->slotNumber = slotNumber;
+	}
+
+	int getSlotNumber() const {
+		return slotNumber;
+	}
+
+	// the variable of the source program: itself, unless it is a version
+	LocalVariable *getOrigin() {
+		return origin ? origin : this;
+	}
+	unsigned getVersion() const {
+		return version;
+	}
+
+	// shape of the value the variable holds on entry to the block
+	const Shape &getShape() const {
+		return shape;
+	}
+	void setShape(const Shape &s) {
+		shape = s;
+	}
+
+	// expected fraction of nonzero elements of that value (1: dense)
+	double getDensity() const {
+		return density;
+	}
+	void setDensity(double d) {
+		density = d;
+	}
+
 	bool operator==(const LocalVariable &other) const {
 		return value == other.value;
 	}
 
-	virtual Operator getInstructionID() { return LOCALVARIABLE; }
-
-	virtual void accept(InstructionVisitor &v);
-	virtual void visitOperands(OperandVisitor &v);
-	virtual int hashCode() const;
-	virtual void print() {
+	int hashCode() const;
+	void print() {
 		cout << " v" << slotNumber << " ";
 	}
 };
 
+// Defines an instruction to represent loading a named object, e.g.
+// 'a = loadObj("faux-remote-0")' is a Move of a Load to 'a'
+class Load: public Instruction {
+private:
+	ArenaString objectName;
+	Shape shape;
+	double density;
+
+public:
+	// the name is copied into 'arena' when one is given
+	Load(const string &name, Arena *arena = 0) :
+			Instruction(LOAD, 0, 0, 0), objectName(name.data(), name.size(), ArenaAllocator<char>(arena)),
+			density(1) {
+	}
+
+	string getObjectName() const {
+		return string(objectName.data(), objectName.size());
+	}
+
+	// shape of the object, when it is known at compile time
+	const Shape &getShape() const {
+		return shape;
+	}
+	void setShape(const Shape &s) {
+		shape = s;
+	}
+
+	// expected fraction of nonzero elements of the object (1: dense)
+	double getDensity() const {
+		return density;
+	}
+	void setDensity(double d) {
+		density = d;
+	}
+
+	int hashCode() const;
+	void print() {
+		cout << " LOAD(\"" << objectName << "\")";
+	}
+};
+
 // Move: instruction to represent an assignment instruction
 class Move: public Instruction {
 private:
@@ -258,7 +375,7 @@ private:
 
 public:
 	Move(LocalVariable *var, Instruction *rValue) :
-			Instruction(0, 0, 0) {
+			Instruction(MOVE, 0, 0, 0) {
 		rightValue = rValue;
 		variable = var;
 	}
@@ -284,57 +401,294 @@ public:
 				variable == other.variable;
 	}
 
-	virtual Operator getInstructionID() { return MOVE; }
-
-	virtual void visitOperands(OperandVisitor &v);
-	virtual void accept(InstructionVisitor &v);
-	virtual int hashCode() const;
-	virtual void print() {
+	int hashCode() const;
+	void print() {
 		variable->print();
 		cout << " <- ";
 		rightValue->print();
 	}
 };
 
-// Definition of instruction and operand visitors
-// for the DAG construction
-class InstructionVisitor {
+// print(operand): writes the value of a variable or constant
+class Print: public Instruction {
+private:
+	Instruction *operand;
+
+public:
+	Print(Instruction *oper) :
+			Instruction(PRINT, 0, 0, 0), operand(oper) {
+	}
+
+	Instruction *getOperand() {
+		return operand->resolve();
+	}
+
+	void setOperand(Instruction *oper) {
+		operand = oper;
+	}
+
+	int hashCode() const;
+	void print() {
+		cout << " PRINT ";
+		operand->print();
+	}
+};
+
+// function(arguments...): a call of an external function. It is either
+// the right value of a Move, or a statement when the result is unused.
+// Calls may have side effects, so they are never merged or reordered.
+class Call: public Instruction {
+public:
+	using ArgumentList = vector<Instruction *, ArenaAllocator<Instruction *> >;
+
+private:
+	ArenaString function;
+	ArgumentList arguments;
+
+public:
+	// the name and the arguments are copied into 'arena' when one is given
+	Call(const string &name, const vector<Instruction *> &args, Arena *arena = 0) :
+			Instruction(CALL, 0, 0, 0), function(name.data(), name.size(), ArenaAllocator<char>(arena)),
+			arguments(args.begin(), args.end(), ArenaAllocator<Instruction *>(arena)) {
+	}
+
+	string getFunction() const {
+		return string(function.data(), function.size());
+	}
+
+	const ArgumentList &getArguments() const {
+		return arguments;
+	}
+
+	void setArgument(size_t index, Instruction *argument) {
+		arguments[index] = argument;
+	}
+
+	int hashCode() const;
+	void print() {
+		cout << " CALL " << function << "(";
+		for (Instruction *argument : arguments)
+			argument->print();
+		cout << ")";
+	}
+};
+
+// phi(operands...): the right value of a Move at the start of a block in
+// SSA form. Operand i is the value when control comes from predecessor i
+// of the block, so there is one operand per incoming edge.
+class Phi: public Instruction {
+public:
+	using OperandList = vector<Instruction *, ArenaAllocator<Instruction *> >;
+
+private:
+	OperandList operands;
 
 public:
+	// 'size' operands initialized to 'initial'; the list is allocated from
+	// 'arena' when one is given
+	Phi(size_t size, Instruction *initial, Arena *arena = 0) :
+			Instruction(PHI, 0, 0, 0), operands(size, initial, ArenaAllocator<Instruction *>(arena)) {
+	}
+
+	size_t getNumberOfOperands() const {
+		return operands.size();
+	}
+	Instruction *getOperand(size_t index) {
+		return operands[index]->resolve();
+	}
+	void setOperand(size_t index, Instruction *operand) {
+		operands[index] = operand;
+	}
+
+	int hashCode() const;
+	void print() {
+		cout << " PHI(";
+		for (Instruction *operand : operands)
+			operand->print();
+		cout << ")";
+	}
+};
+
+// Static dispatch over the classes of the instructions, resolved at
+// compile time from the instruction id: the calls inline, and there is
+// no virtual call. 'function' is called with the instruction cast to its
+// class, e.g. an Add or a Move, so it needs an overload (or a template
+// operator()) for each class.
+template<typename Result, typename Function>
+inline Result dispatch(Instruction *instruction, Function &function) {
+	switch (instruction->getInstructionID()) {
+	case ADD:
+		return function(*static_cast<Add *>(instruction));
+	case MUL:
+		return function(*static_cast<Mul *>(instruction));
+	case DOT:
+		return function(*static_cast<Dot *>(instruction));
+	case SUM:
+	case MIN:
+	case MAX:
+		return function(*static_cast<Reduction *>(instruction));
+	case CONSTANT:
+		return function(*static_cast<Constant *>(instruction));
+	case LOCALVARIABLE:
+		return function(*static_cast<LocalVariable *>(instruction));
+	case LOAD:
+		return function(*static_cast<Load *>(instruction));
+	case MOVE:
+		return function(*static_cast<Move *>(instruction));
+	case PRINT:
+		return function(*static_cast<Print *>(instruction));
+	case CALL:
+		return function(*static_cast<Call *>(instruction));
+	case PHI:
+		return function(*static_cast<Phi *>(instruction));
+	default:
+		// no instruction has the other ids
+		return Result();
+	}
+}
+
+// Instruction visitor, with static (CRTP) dispatch: a pass derives from
+// InstructionVisitor<Pass> and defines the visit methods it needs, e.g.
+//
+//   class CountAdds: public InstructionVisitor<CountAdds> {
+//   public:
+//       unsigned adds = 0;
+//       void visitAdd(Add &i) { adds++; }
+//   };
+//   CountAdds counter;
+//   counter.visit(instruction);
+//
+// The methods that are not defined delegate to the base class of the
+// instruction (visitBinaryInstruction for Add, Mul and Dot), and then to
+// visitInstruction, which does nothing.
+template<typename Derived, typename Result = void>
+class InstructionVisitor {
+public:
+	// Calls the visit method of the class of 'instruction'
+	Result visit(Instruction *instruction) {
+		Caller caller = { derived() };
+		return dispatch<Result>(instruction, caller);
+	}
+
+	Result visitInstruction(Instruction &i) {
+		return Result();
+	}
+
+	Result visitBinaryInstruction(BinaryInstruction &i) {
+		return derived().visitInstruction(i);
+	}
+
+	Result visitAdd(Add &i) {
+		return derived().visitBinaryInstruction(i);
+	}
+
+	Result visitMul(Mul &i) {
+		return derived().visitBinaryInstruction(i);
+	}
+
+	Result visitDot(Dot &i) {
+		return derived().visitBinaryInstruction(i);
+	}
+
+	Result visitReduction(Reduction &i) {
+		return derived().visitInstruction(i);
+	}
 
-	// Default visitor implementation always delegate
-	// to this generic call
-	void visit(Instruction &i) {
-		// do nothing
+	Result visitConstant(Constant &i) {
+		return derived().visitInstruction(i);
 	}
 
-	void visit(BinaryInstruction &i) {
-		visit(static_cast<Instruction &>(i));
+	Result visitLocalVariable(LocalVariable &i) {
+		return derived().visitInstruction(i);
 	}
 
-	void visit(Move &i) {
-		visit(static_cast<Instruction &>(i));
+	Result visitLoad(Load &i) {
+		return derived().visitInstruction(i);
 	}
 
-	void visit(Constant &i) {
-		visit(static_cast<Instruction &>(i));
+	Result visitMove(Move &i) {
+		return derived().visitInstruction(i);
 	}
 
-	void visit(Add &i) {
-		visit(static_cast<BinaryInstruction &>(i));
+	Result visitPrint(Print &i) {
+		return derived().visitInstruction(i);
 	}
 
-	void visit(Mul &i) {
-		visit(static_cast<BinaryInstruction &>(i));
+	Result visitCall(Call &i) {
+		return derived().visitInstruction(i);
 	}
 
-	void visit(LocalVariable &i) {
-		visit(static_cast<Instruction &>(i));
+	Result visitPhi(Phi &i) {
+		return derived().visitInstruction(i);
 	}
+
+private:
+	Derived &derived() {
+		return static_cast<Derived &>(*this);
+	}
+
+	// maps each class to its visit method
+	struct Caller {
+		Derived &visitor;
+
+		Result operator()(Add &i) { return visitor.visitAdd(i); }
+		Result operator()(Mul &i) { return visitor.visitMul(i); }
+		Result operator()(Dot &i) { return visitor.visitDot(i); }
+		Result operator()(Reduction &i) { return visitor.visitReduction(i); }
+		Result operator()(Constant &i) { return visitor.visitConstant(i); }
+		Result operator()(LocalVariable &i) { return visitor.visitLocalVariable(i); }
+		Result operator()(Load &i) { return visitor.visitLoad(i); }
+		Result operator()(Move &i) { return visitor.visitMove(i); }
+		Result operator()(Print &i) { return visitor.visitPrint(i); }
+		Result operator()(Call &i) { return visitor.visitCall(i); }
+		Result operator()(Phi &i) { return visitor.visitPhi(i); }
+	};
 };
 
+// Operand visitor, with static (CRTP) dispatch: visitOperands(i) calls
+// the visitOperand method of the derived class on every operand of i, in
+// order (the right value, then the variable of a Move). Variables,
+// constants and loads are their own operand.
+template<typename Derived>
 class OperandVisitor {
 public:
+	void visitOperands(Instruction *instruction) {
+		Derived &visitor = static_cast<Derived &>(*this);
+		switch (instruction->getInstructionID()) {
+		case ADD:
+		case MUL:
+		case DOT:
+			visitor.visitOperand(*static_cast<BinaryInstruction *>(instruction)->getFirstOperand());
+			visitor.visitOperand(*static_cast<BinaryInstruction *>(instruction)->getSecondOperand());
+			break;
+		case SUM:
+		case MIN:
+		case MAX:
+			visitor.visitOperand(*static_cast<Reduction *>(instruction)->getOperand());
+			break;
+		case MOVE:
+			visitor.visitOperand(*static_cast<Move *>(instruction)->getRightValue());
+			visitor.visitOperand(*static_cast<Move *>(instruction)->getVariable());
+			break;
+		case PRINT:
+			visitor.visitOperand(*static_cast<Print *>(instruction)->getOperand());
+			break;
+		case CALL:
+			for (Instruction *argument : static_cast<Call *>(instruction)->getArguments())
+				visitor.visitOperand(*argument);
+			break;
+		case PHI: {
+			Phi *phi = static_cast<Phi *>(instruction);
+			for (size_t i = 0; i < phi->getNumberOfOperands(); i++)
+				visitor.visitOperand(*phi->getOperand(i));
+		}
+			break;
+		default:
+			visitor.visitOperand(*instruction);
+			break;
+		}
+	}
+
 	void visitOperand(Instruction &operand) {
 	}
 };
@@ -357,5 +711,4 @@ namespace std {
 
 }
 
-
 #endif
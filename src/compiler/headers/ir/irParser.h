@@ -0,0 +1,188 @@
+#ifndef IR_PARSER_H
+#define IR_PARSER_H
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <unordered_map>
+#include <stdint.h>
+#include <string.h>
+#include "ir/instruction.h"
+#include "cfg/basicBlock.h"
+#include "support/compilationContext.h"
+
+using namespace std;
+
+// Parser of the text form of the three-address IR, the one written by
+// Instruction::print() and ControlFlowGraph::print():
+//
+//   B0:
+//   	 v0
+//   	 v0  <-  LOAD("faux-remote-0")
+//   	 v2  <-  ADD  v0  CONSTANT(5)
+//   	goto B1
+//   B1:  idom B0  loop B1 depth 1  preds B0 B2
+//   	 v3  <-  PHI( v2  v4 )
+//   	if v3  < CONSTANT(2) goto B2 else B3
+//   ...
+//
+// One statement per line; spaces are not significant and '#' starts a
+// comment. A line 'name:' starts a block, the first one is the entry; the
+// words after the colon are ignored, except 'preds', which lists the
+// predecessors in the order of the phi operands. A block ends with
+// 'goto', 'if ... goto ... else ...' or 'exit' (the default), and input
+// without labels is a single block. A variable vN is held in slot N; other
+// names are given the next free slots. SSA versions are read back as the
+// plain variables of their slots.
+//
+// The input is read in place (a mapping of the file): tokens point into
+// it, only the names of the loaded objects and called functions are
+// copied. Every variable is one LocalVariable, and equal constants share
+// one Constant. Errors throw runtime_error("name:line: message").
+class IRParser {
+public:
+	// Maps the file at 'path'. The instructions and blocks are allocated
+	// from 'context'.
+	IRParser(const string &path, CompilationContext &context);
+
+	// Parses 'length' bytes of 'text', which must outlive the parser
+	IRParser(const char *text, size_t length, CompilationContext &context, const string &name = "<input>");
+
+	~IRParser();
+
+	IRParser(const IRParser &) = delete;
+	IRParser &operator=(const IRParser &) = delete;
+
+	// Parses the next block, 0 at the end of the input. Jumps to blocks
+	// not parsed yet create them empty; they are filled when reached.
+	BasicBlock * parseBlock();
+
+	// Parses the rest of the input, returns the entry block (0 if empty)
+	BasicBlock * parse();
+
+	// Parses the rest of the input on another thread, and calls 'consume'
+	// on this thread with every instruction appended to a block, in order,
+	// as the batches of instructions are parsed: e.g. the DAG of the entry
+	// block is built while the next instructions are read. The context of
+	// the parser must not be used by the caller meanwhile.
+	void parseConcurrently(const function<void(BasicBlock *, Instruction *)> &consume);
+
+	// blocks in the order of their labels
+	const vector<BasicBlock *> &getBlocks() const {
+		return blocks;
+	}
+
+	// variable held in 'slot', 0 if it does not occur
+	LocalVariable * getVariable(unsigned slot) const {
+		return slot < variables.size() ? variables[slot] : 0;
+	}
+
+	size_t getNumberOfInstructions() const {
+		return numberOfInstructions;
+	}
+
+	size_t getNumberOfBytes() const {
+		return end - begin;
+	}
+
+private:
+	// Characters of the input, not copied
+	struct Token {
+		const char *text;
+		size_t      length;
+
+		bool operator==(const Token &other) const {
+			return length == other.length && memcmp(text, other.text, length) == 0;
+		}
+
+		// inline, with the length of the keyword known at compile time
+		template<size_t N>
+		bool is(const char (&keyword)[N]) const {
+			return length == N - 1 && memcmp(text, keyword, N - 1) == 0;
+		}
+	};
+
+	struct TokenHash {
+		size_t operator()(const Token &token) const;
+	};
+
+	// the block of a label, and whether its line was read
+	struct Label {
+		BasicBlock *block;
+		bool        defined;
+		unsigned    line;    // of the first reference
+	};
+
+	// a 'preds' annotation, applied once every edge is known
+	struct PredecessorOrder {
+		BasicBlock          *block;
+		vector<BasicBlock *> order;
+		unsigned             line;
+	};
+
+	struct BatchQueue;
+
+	CompilationContext &context;
+	string              name;
+	const char         *begin;
+	const char         *end;
+	const char         *cursor;
+	unsigned            line;
+	void               *mapping;
+	size_t              mappingLength;
+
+	vector<BasicBlock *>                       blocks;
+	unordered_map<Token, Label, TokenHash>     labels;
+	vector<PredecessorOrder>                   predecessorOrders;
+	bool                                       terminated;   // the current block has its terminator
+	bool                                       finished;     // the end of the input was checked
+
+	vector<LocalVariable *>                    variables;    // by slot
+	vector<bool>                               declared;     // by slot
+	vector<bool>                               named;        // by slot, not a vN
+	unordered_map<Token, LocalVariable *, TokenHash> names;
+	unordered_map<int, Constant *>             constants;
+	vector<Instruction *>                      operands;     // of the phi being parsed
+
+	size_t      numberOfInstructions;
+	BatchQueue *queue;          // set while parsing concurrently
+
+	// statements
+	BasicBlock * startBlock(const Token &label);
+	void parseLabelLine(BasicBlock *block);
+	void parseStatement(BasicBlock *block, const Token &word);
+	void parseBranch(BasicBlock *block);
+	Instruction * parseRightValue();
+	Instruction * parseOperand();
+	Instruction * parseOperand(const Token &word);
+	Load * parseLoad();
+	Call * parseCall();
+	Phi * parsePhi();
+	void append(BasicBlock *block, Instruction *instruction);
+	void finish();
+
+	// symbols
+	BasicBlock * getBlock(const Token &label);
+	LocalVariable * getVariable(const Token &word);
+	LocalVariable * getVariable(unsigned slot, bool isNamed, const Token &word);
+	Constant * getConstant(int value);
+
+	// characters
+	void skipSpaces();
+	bool skipBlankLines();
+	bool atEndOfLine();
+	void expectEndOfLine();
+	Token readWord();
+	Token expectWord(const char *what);
+	void expectKeyword(const char *keyword);
+	void expect(char c);
+	bool accept(char c);
+	int readInteger();
+	Token readString();
+	static bool isKeyword(const Token &word);
+	string found() const;
+	// throws, the statement after it is never reached
+	[[noreturn]] void error(const string &message) const;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef SHAPE_H
+#define SHAPE_H
+
+#include <iostream>
+#include <stdint.h>
+
+using namespace std;
+
+// Shape of a value: a scalar, a rows x columns matrix, or unknown when
+// nothing is known about the value at compile time
+class Shape {
+public:
+	Shape() : kind(UNKNOWN_SHAPE), rows(0), columns(0) {
+	}
+
+	Shape(uint32_t numberOfRows, uint32_t numberOfColumns) :
+			kind(MATRIX_SHAPE), rows(numberOfRows), columns(numberOfColumns) {
+	}
+
+	static Shape scalar() {
+		Shape shape;
+		shape.kind = SCALAR_SHAPE;
+		return shape;
+	}
+
+	bool isKnown() const {
+		return kind != UNKNOWN_SHAPE;
+	}
+	bool isScalar() const {
+		return kind == SCALAR_SHAPE;
+	}
+	bool isMatrix() const {
+		return kind == MATRIX_SHAPE;
+	}
+
+	uint32_t getRows() const {
+		return rows;
+	}
+	uint32_t getColumns() const {
+		return columns;
+	}
+
+	bool operator==(const Shape &other) const {
+		return kind == other.kind && rows == other.rows && columns == other.columns;
+	}
+	bool operator!=(const Shape &other) const {
+		return !(*this == other);
+	}
+
+	void print() const {
+		if (isMatrix())
+			cout << "[" << rows << "x" << columns << "]";
+		else if (isScalar())
+			cout << "[scalar]";
+		else
+			cout << "[?]";
+	}
+
+private:
+	enum {
+		UNKNOWN_SHAPE, SCALAR_SHAPE, MATRIX_SHAPE
+	} kind;
+	uint32_t rows;
+	uint32_t columns;
+};
+
+#endif
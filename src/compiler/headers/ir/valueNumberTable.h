@@ -0,0 +1,78 @@
+#ifndef VALUE_NUMBER_TABLE_H
+#define VALUE_NUMBER_TABLE_H
+
+#include <unordered_map>
+#include <cstddef>
+#include "ir/instruction.h"
+#include "support/arena.h"
+
+using namespace std;
+
+class Node;
+
+// Key used to value number an expression 'left op right'.
+// Operands are identified by their DAG node ids, so two expressions
+// get the same key only if they compute the same value. The reductions
+// (SUM, MIN, MAX) have one operand, used as both left and right.
+struct ValueNumberKey {
+	Operator op;
+	unsigned left;
+	unsigned right;
+
+	bool operator==(const ValueNumberKey &other) const {
+		return op == other.op && left == other.left && right == other.right;
+	}
+};
+
+struct ValueNumberKeyHash {
+	size_t operator()(const ValueNumberKey &key) const;
+};
+
+// Hash-consing table mapping (operator, operand node ids) to the DAG
+// node computing that expression. Lookups and inserts are O(1) on average,
+// independent of how many users the operand nodes have.
+class ValueNumberTable {
+public:
+	using Table = unordered_map<ValueNumberKey, Node *, ValueNumberKeyHash, equal_to<ValueNumberKey>,
+			ArenaAllocator<pair<const ValueNumberKey, Node *> > >;
+
+	// table entries are allocated from 'arena' when one is given
+	ValueNumberTable(Arena *arena = 0) :
+			table(0, ValueNumberKeyHash(), equal_to<ValueNumberKey>(),
+					ArenaAllocator<pair<const ValueNumberKey, Node *> >(arena)) {
+	}
+
+	// Returns the node computing 'left op right', or 0 if there is none
+	Node * lookup(Operator op, Node *left, Node *right) const;
+
+	// Records 'node' as the node computing 'left op right'
+	void insert(Operator op, Node *left, Node *right, Node *node);
+
+	// Forgets 'left op right' if it maps to 'node'
+	void erase(Operator op, Node *left, Node *right, Node *node);
+
+	void clear() {
+		table.clear();
+	}
+
+	size_t size() const {
+		return table.size();
+	}
+
+	// the operators whose expressions are value numbered
+	static bool isNumbered(Operator op) {
+		return op == ADD || op == MUL || op == SUM || op == MIN || op == MAX || op == DOT;
+	}
+
+	// ADD and DOT do not depend on the operand order; MUL only when one
+	// operand is a constant, since matrix products are not commutative
+	static bool isCommutative(Operator op, const Node *left, const Node *right);
+
+private:
+	Table table;
+
+	// Builds the key, ordering the operands of commutative operators
+	static ValueNumberKey makeKey(Operator op, Node *left, Node *right);
+};
+
+#endif
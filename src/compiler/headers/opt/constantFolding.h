@@ -0,0 +1,58 @@
+#ifndef CONSTANT_FOLDING_H
+#define CONSTANT_FOLDING_H
+
+#include <unordered_set>
+#include "ir/dag.h"
+
+using namespace std;
+
+// Simplifies the ADD and MUL nodes of a DAG, operands before users:
+//   k1 op k2      -> the constant (k1 op k2)
+//   x * 1, x + 0  -> x
+//   x * 0         -> 0, for a scalar x (a matrix keeps its shape)
+//   x * 2         -> x + x
+// An operand is a constant when it is a constant leaf, or a variable
+// assigned a constant in the block. Equal literals already share one leaf
+// (DAG::addNode(Constant *)). The replaced nodes, and the constants left
+// without users, are removed from the DAG.
+class ConstantFolding {
+public:
+	ConstantFolding() :
+			foldedNodes(0), simplifiedNodes(0), strengthReducedNodes(0), removedNodes(0) {
+	}
+
+	// Rewrites 'dag' in place, returns the number of nodes removed
+	unsigned run(DAG &dag);
+
+	// constant expressions replaced by their value
+	unsigned getNumberOfFoldedNodes() const {
+		return foldedNodes;
+	}
+
+	// identities and multiplications by zero
+	unsigned getNumberOfSimplifiedNodes() const {
+		return simplifiedNodes;
+	}
+
+	// multiplications by two replaced by additions
+	unsigned getNumberOfStrengthReducedNodes() const {
+		return strengthReducedNodes;
+	}
+
+	unsigned getNumberOfRemovedNodes() const {
+		return removedNodes;
+	}
+
+	// Value of 'node' if it is a constant
+	static bool getConstant(Node *node, int &value);
+
+private:
+	unsigned foldedNodes;
+	unsigned simplifiedNodes;
+	unsigned strengthReducedNodes;
+	unsigned removedNodes;
+
+	Node * simplify(DAG &dag, Node *node);
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef DEAD_CODE_ELIMINATION_H
+#define DEAD_CODE_ELIMINATION_H
+
+#include <unordered_set>
+#include "ir/dag.h"
+
+using namespace std;
+
+// Removes the nodes whose value is never used: everything that is not
+// reachable, through the operand edges, from the nodes holding the live
+// out variables of the block or from the nodes with side effects (PRINT,
+// CALL). Overwritten values, e.g. the first of two assignments to the same
+// variable, are dropped, and so are the leaves only they used.
+class DeadCodeElimination {
+public:
+	DeadCodeElimination(const unordered_set<LocalVariable *> &liveOutVariables) :
+			liveOut(liveOutVariables), removedNodes(0), removedOperators(0), removedElements(0) {
+	}
+
+	// Rewrites 'dag' in place, returns the number of nodes removed
+	unsigned run(DAG &dag);
+
+	unsigned getNumberOfRemovedNodes() const {
+		return removedNodes;
+	}
+
+	// removed nodes that were operations (not leaves)
+	unsigned getNumberOfRemovedOperators() const {
+		return removedOperators;
+	}
+
+	// matrix elements the removed operations would have computed, for the
+	// operations with a known shape
+	uint64_t getNumberOfRemovedElements() const {
+		return removedElements;
+	}
+
+private:
+	unordered_set<LocalVariable *> liveOut;
+	unsigned                       removedNodes;
+	unsigned                       removedOperators;
+	uint64_t                       removedElements;
+};
+
+#endif
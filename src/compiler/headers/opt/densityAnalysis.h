@@ -0,0 +1,50 @@
+#ifndef DENSITY_ANALYSIS_H
+#define DENSITY_ANALYSIS_H
+
+#include <stdint.h>
+#include "ir/dag.h"
+
+using namespace std;
+
+// Estimates the fraction of nonzero elements of every node, operands
+// before users, and marks the matrices sparse enough to be kept in sparse
+// storage (matrix/sparse.h): the evaluator then runs the sparse kernels
+// on them. Variable and load leaves take the density declared on their
+// LocalVariable or Load, constants and scalars are dense. Run it after
+// shape inference, which tells the scalars from the matrices, and before
+// elementwise fusion, which leaves the sparse nodes alone.
+//
+// The nonzeros are assumed to be independent and uniformly placed:
+//   a + b    da + db - da * db      sparse when a and b are
+//   a * s    da                     sparse when a is
+//   a + s    1                      every element changes
+//   a * b    1 - (1 - da * db)^k    a m x k times k x n product
+// Products, fused regions, reductions and calls produce dense values.
+class DensityAnalysis {
+public:
+	// matrices of at most this density are sparse
+	DensityAnalysis(double sparseThreshold = 0.05) : threshold(sparseThreshold) {
+	}
+
+	// Sets the density of every node, returns the number of sparse nodes
+	unsigned run(DAG &dag);
+
+	// Sets the densities of the dirty region of an edited DAG, after
+	// ShapeInference::update; returns the number of nodes updated
+	unsigned update(DAG &dag);
+
+	// density of the sum of two matrices of densities a and b
+	static double add(double a, double b);
+
+	// density of the product of a m x k matrix of density a and a k x n
+	// matrix of density b; 'k' 0 when it is not known
+	static double product(double a, double b, uint32_t k);
+
+private:
+	double threshold;
+
+	void infer(Node *node);
+	double inferFused(FusedNode *node);
+};
+
+#endif
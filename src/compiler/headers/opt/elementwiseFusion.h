@@ -0,0 +1,52 @@
+#ifndef ELEMENTWISE_FUSION_H
+#define ELEMENTWISE_FUSION_H
+
+#include <unordered_set>
+#include "ir/dag.h"
+
+using namespace std;
+
+// Fuses chains and trees of elementwise operators (ADD, and MUL by a
+// constant) into FusedNodes, so the runtime evaluates each region in one
+// pass over memory instead of materializing every intermediate matrix.
+//
+// An operand is absorbed into the region of its user when all of its users
+// are in the region and none of its variables is live out of the block;
+// values that are needed elsewhere stay materialized.
+class ElementwiseFusion {
+public:
+	ElementwiseFusion(const unordered_set<LocalVariable *> &liveOutVariables) :
+			liveOut(liveOutVariables), fusedNodes(0), removedNodes(0) {
+	}
+
+	// Rewrites 'dag' in place, returns the number of fused nodes created
+	unsigned run(DAG &dag);
+
+	unsigned getNumberOfFusedNodes() const {
+		return fusedNodes;
+	}
+
+	// operator nodes replaced by fused nodes
+	unsigned getNumberOfRemovedNodes() const {
+		return removedNodes;
+	}
+
+	// ADD, or MUL with a constant operand, over dense values
+	static bool isElementwise(Node *node);
+
+private:
+	unordered_set<LocalVariable *> liveOut;
+	unsigned                       fusedNodes;
+	unsigned                       removedNodes;
+
+	bool isLiveOut(Node *node) const;
+
+	// Region of the operators rooted at 'root' that can be evaluated together
+	void growRegion(Node *root, unordered_set<Node *> &region, const unordered_set<Node *> &absorbed) const;
+
+	// Inputs of the region and the operations computing 'root' from them
+	void buildProgram(Node *root, const unordered_set<Node *> &region,
+			vector<Node *> &inputs, vector<FusedOperation> &program) const;
+};
+
+#endif
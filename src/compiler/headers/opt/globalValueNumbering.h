@@ -0,0 +1,75 @@
+#ifndef GLOBAL_VALUE_NUMBERING_H
+#define GLOBAL_VALUE_NUMBERING_H
+
+#include <vector>
+#include <unordered_map>
+#include "cfg/controlFlowGraph.h"
+
+using namespace std;
+
+// Dominator based value numbering over a control flow graph in SSA form
+// (SSAForm::construct). The blocks are visited down the dominator tree
+// with a scoped table of the expressions computed by the dominating
+// blocks: an assignment recomputing one of them is removed and its
+// variable replaced by the variable holding the value, wherever it is
+// read. Copies are propagated the same way, and so are the phis whose
+// operands all have the same value, or that repeat another phi of their
+// block. Operands are compared by value number, so 'a + b' and 'b + a'
+// match, and so do two matrix expressions in different blocks; the
+// reductions and DOT are numbered like the DAG does within a block.
+class GlobalValueNumbering {
+public:
+	GlobalValueNumbering() :
+			removedExpressions(0), propagatedCopies(0), removedPhis(0) {
+	}
+
+	// Rewrites the blocks of 'cfg', returns the number of assignments removed
+	unsigned run(ControlFlowGraph &cfg);
+
+	// redundant expressions removed
+	unsigned getNumberOfRemovedExpressions() const {
+		return removedExpressions;
+	}
+
+	unsigned getNumberOfPropagatedCopies() const {
+		return propagatedCopies;
+	}
+
+	unsigned getNumberOfRemovedPhis() const {
+		return removedPhis;
+	}
+
+	unsigned getNumberOfRemovedInstructions() const {
+		return removedExpressions + propagatedCopies + removedPhis;
+	}
+
+private:
+	// an expression over the leaders of its operand values
+	struct Key {
+		Operator op;
+		Instruction *left;
+		Instruction *right;
+
+		bool operator==(const Key &other) const {
+			return op == other.op && left == other.left && right == other.right;
+		}
+	};
+
+	struct KeyHash {
+		size_t operator()(const Key &key) const;
+	};
+
+	unsigned removedExpressions;
+	unsigned propagatedCopies;
+	unsigned removedPhis;
+
+	unordered_map<Key, Instruction *, KeyHash> available;     // scoped by the dominator tree walk
+	unordered_map<Instruction *, Instruction *> leaders;      // removed variable -> its value
+	unordered_map<int, Constant *>              constants;    // first constant of each value
+
+	Instruction * getLeader(Instruction *operand);
+	bool numberPhi(Move *move, vector<Move *> &phis);
+	bool numberExpression(Move *move, vector<Key> &inserted);
+};
+
+#endif
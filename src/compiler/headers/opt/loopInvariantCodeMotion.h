@@ -0,0 +1,47 @@
+#ifndef LOOP_INVARIANT_CODE_MOTION_H
+#define LOOP_INVARIANT_CODE_MOTION_H
+
+#include <vector>
+#include "cfg/controlFlowGraph.h"
+
+using namespace std;
+
+// Hoists the loop invariant assignments of each loop to its preheader,
+// innermost loops first, e.g. 'a = b + 20' in a loop that does not
+// assign b. An assignment 'v <- expression' is moved when:
+//   - its operands are constants, or variables not assigned in the loop
+//     (or only by assignments already hoisted);
+//   - it is the only assignment to v in the loop, and every use of v in
+//     the loop comes after it;
+//   - it runs before the loop can exit: its block dominates the exiting
+//     blocks, or the loop runs at least once and the block dominates the
+//     latches.
+// Calls, prints and phis are never moved. Loads of named objects are.
+class LoopInvariantCodeMotion {
+public:
+	LoopInvariantCodeMotion() :
+			hoistedInstructions(0), insertedPreheaders(0) {
+	}
+
+	// Rewrites the blocks of 'cfg', returns the number of hoisted assignments
+	unsigned run(ControlFlowGraph &cfg);
+
+	unsigned getNumberOfHoistedInstructions() const {
+		return hoistedInstructions;
+	}
+
+	unsigned getNumberOfInsertedPreheaders() const {
+		return insertedPreheaders;
+	}
+
+	// The variables and constants read by a top level instruction of a block
+	static void getOperands(Instruction *instruction, vector<Instruction *> &operands);
+
+private:
+	unsigned hoistedInstructions;
+	unsigned insertedPreheaders;
+
+	unsigned hoist(ControlFlowGraph &cfg, const Loop *loop);
+};
+
+#endif
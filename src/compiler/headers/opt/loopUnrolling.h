@@ -0,0 +1,52 @@
+#ifndef LOOP_UNROLLING_H
+#define LOOP_UNROLLING_H
+
+#include "cfg/controlFlowGraph.h"
+#include "cfg/inductionVariables.h"
+
+using namespace std;
+
+// Fully unrolls the loops with a constant trip count, innermost first.
+// A loop is unrolled when it is a header holding only the exit test
+// (and declarations) and a single body block jumping back to it:
+//   for (i = k; i < n; i += s) body
+// The body is copied once per iteration with the induction variable
+// replaced by its constant value in that iteration (the next one after
+// the update, for the instructions that follow it), the update of the
+// variable is dropped and its final value is assigned after the copies.
+// The unrolled code is merged with the blocks around it, so a function
+// whose loops all unroll becomes a single basic block for the DAG.
+class LoopUnrolling {
+public:
+	// loops whose unrolled body would exceed 'maxInstructions' are kept
+	LoopUnrolling(unsigned maxInstructions = 4096) :
+			maxInstructions(maxInstructions), unrolledLoops(0), copiedInstructions(0) {
+	}
+
+	// Rewrites the blocks of 'cfg', returns the number of loops unrolled
+	unsigned run(ControlFlowGraph &cfg);
+
+	unsigned getNumberOfUnrolledLoops() const {
+		return unrolledLoops;
+	}
+
+	// instructions created by copying the loop bodies
+	unsigned getNumberOfCopiedInstructions() const {
+		return copiedInstructions;
+	}
+
+private:
+	unsigned maxInstructions;
+	unsigned unrolledLoops;
+	unsigned copiedInstructions;
+
+	bool unroll(ControlFlowGraph &cfg, const Loop *loop);
+
+	// Copies of a top level instruction and of an expression, with the
+	// variable of 'slot' replaced by 'value'
+	Instruction * copy(ControlFlowGraph &cfg, Instruction *instruction, int slot, Constant *value);
+	Instruction * copyExpression(ControlFlowGraph &cfg, Instruction *expression, int slot, Constant *value);
+	static Instruction * substitute(Instruction *operand, int slot, Constant *value);
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef MATRIX_CHAIN_ORDER_H
+#define MATRIX_CHAIN_ORDER_H
+
+#include <vector>
+#include <unordered_set>
+#include <stdint.h>
+#include "ir/dag.h"
+
+using namespace std;
+
+// Re-associates chains of matrix products 'A1 * A2 * ... * An' into the
+// order needing the fewest scalar multiplications, found with the classic
+// O(n^3) dynamic programming over the chain dimensions.
+//
+// A chain is a maximal tree of MUL nodes over matrices (shapes from
+// opt/shapeInference.h) whose intermediate products have no other user
+// and are not held by a live out variable.
+class MatrixChainOrder {
+public:
+	MatrixChainOrder(const unordered_set<LocalVariable *> &liveOutVariables) :
+			liveOut(liveOutVariables), reorderedChains(0), costBefore(0), costAfter(0) {
+	}
+
+	// Infers the shapes of 'dag' and reorders its chains, returns the
+	// number of chains that were rewritten
+	unsigned run(DAG &dag);
+
+	unsigned getNumberOfReorderedChains() const {
+		return reorderedChains;
+	}
+
+	// scalar multiplications of all the chains, before and after the pass
+	uint64_t getCostBefore() const {
+		return costBefore;
+	}
+	uint64_t getCostAfter() const {
+		return costAfter;
+	}
+
+	// MUL of two matrices
+	static bool isMatrixProduct(Node *node);
+
+	// Cheapest order for a chain of n matrices, the i-th having the shape
+	// dimensions[i] x dimensions[i + 1]. split[i * n + j] is where the
+	// product of matrices i..j is split. Returns the number of scalar
+	// multiplications of that order.
+	static uint64_t order(const vector<uint64_t> &dimensions, vector<unsigned> &split);
+
+private:
+	// A chain found in the DAG: its root, its intermediate products and
+	// its factors from left to right
+	struct Chain {
+		Node           *root;
+		vector<Node *> products;
+		vector<Node *> factors;
+		uint64_t       cost;
+		bool           shared;  // uses one of its products twice, left as is
+	};
+
+	unordered_set<LocalVariable *> liveOut;
+	unsigned                       reorderedChains;
+	uint64_t                       costBefore;
+	uint64_t                       costAfter;
+
+	bool isLiveOut(Node *node) const;
+	void collectChain(Node *root, const unordered_set<Node *> &claimed, Chain &chain) const;
+	Node * build(DAG &dag, const Chain &chain, const vector<unsigned> &split,
+			unsigned i, unsigned j, unordered_set<Node *> &reused) const;
+};
+
+#endif
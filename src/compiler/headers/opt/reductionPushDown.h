@@ -0,0 +1,61 @@
+#ifndef REDUCTION_PUSH_DOWN_H
+#define REDUCTION_PUSH_DOWN_H
+
+#include <unordered_set>
+#include "ir/dag.h"
+
+using namespace std;
+
+// Pushes the reductions (SUM, MIN, MAX, DOT) down through the elementwise
+// operators producing their argument, so the argument matrix is never
+// materialized:
+//   sum(x + y) = sum(x) + sum(y)      sum(k * x) = k * sum(x)
+//   sum(x + k) = sum(x) + k * n       (n elements, k a scalar)
+//   dot(x + y, z) = dot(x, z) + dot(y, z)
+//   dot(x + k, z) = dot(x, z) + k * sum(z)    dot(k * x, z) = k * dot(x, z)
+//   min(x + k) = min(x) + k           min(c * x) = c * min(x), c >= 0
+//                                     min(c * x) = c * max(x), c < 0
+// and the same for MAX. k is any scalar value, c a constant.
+//
+// An operator is rewritten when all of its users are rewritten too and
+// none of its variables is live out of the block; values that are needed
+// elsewhere stay materialized and are reduced as they are. Run it before
+// ElementwiseFusion, which would hide the operators in FusedNodes.
+class ReductionPushDown {
+public:
+	ReductionPushDown(const unordered_set<LocalVariable *> &liveOutVariables) :
+			liveOut(liveOutVariables), rewrittenReductions(0), removedNodes(0) {
+	}
+
+	// Infers the shapes of 'dag' and rewrites it in place, returns the
+	// number of reductions that were pushed down
+	unsigned run(DAG &dag);
+
+	unsigned getNumberOfRewrittenReductions() const {
+		return rewrittenReductions;
+	}
+
+	// matrix operators that are no longer computed
+	unsigned getNumberOfRemovedNodes() const {
+		return removedNodes;
+	}
+
+	static bool isReduction(Operator op) {
+		return op == SUM || op == MIN || op == MAX || op == DOT;
+	}
+
+private:
+	unordered_set<LocalVariable *> liveOut;
+	unsigned                       rewrittenReductions;
+	unsigned                       removedNodes;
+
+	bool isLiveOut(Node *node) const;
+	unsigned rewrite(DAG &dag);
+	bool canPushDown(Operator op, Node *node, const unordered_set<Node *> &consumed) const;
+	Node * pushDown(DAG &dag, Operator op, Node *node, Node *partner,
+			unordered_set<Node *> &consumed, unordered_set<Node *> &created);
+	Node * reduce(DAG &dag, Operator op, Node *node, Node *partner, unordered_set<Node *> &created);
+	Node * combine(DAG &dag, Operator op, Node *left, Node *right, unordered_set<Node *> &created);
+};
+
+#endif
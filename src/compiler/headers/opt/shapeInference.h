@@ -0,0 +1,34 @@
+#ifndef SHAPE_INFERENCE_H
+#define SHAPE_INFERENCE_H
+
+#include "ir/dag.h"
+#include "ir/shape.h"
+
+using namespace std;
+
+// Propagates shapes through a DAG, operands before users. Constants are
+// scalars and variable and load leaves take the shape declared on their
+// LocalVariable or Load. Reductions are scalars; other values computed
+// from an unknown shape stay unknown, and so do the results of calls.
+// Throws invalid_argument when the operand shapes do not match.
+class ShapeInference {
+public:
+	// Sets the shape of every node, returns the number of known shapes
+	unsigned run(DAG &dag);
+
+	// Sets the shapes of the dirty region of an edited DAG (see
+	// DAG::getDirtyRegion), returns the number of nodes updated
+	unsigned update(DAG &dag);
+
+	// a + b, and a * b when one of them is a scalar (elementwise)
+	static Shape elementwise(const Shape &a, const Shape &b);
+
+	// a * b, a matrix product when both are matrices
+	static Shape product(const Shape &a, const Shape &b);
+
+private:
+	Shape infer(Node *node);
+	Shape inferFused(FusedNode *node);
+};
+
+#endif
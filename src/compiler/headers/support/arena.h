@@ -0,0 +1,119 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <stdint.h>
+#include <new>
+#include <utility>
+#include <string>
+
+using namespace std;
+
+// Bump pointer allocator. Objects are carved out of large chunks and
+// are never freed individually: all the memory is released at once when
+// the arena is reset or destroyed. Destructors of objects created in
+// the arena are NOT run, so they must not own memory outside the arena.
+class Arena {
+public:
+	static const size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+	Arena(size_t chunkSize = DEFAULT_CHUNK_SIZE);
+	~Arena();
+
+	Arena(const Arena &) = delete;
+	Arena &operator=(const Arena &) = delete;
+
+	// Returns 'size' bytes aligned to 'alignment' (a power of 2)
+	void * allocate(size_t size, size_t alignment = alignof(max_align_t)) {
+		uintptr_t aligned = ((uintptr_t) cursor + alignment - 1) & ~(uintptr_t) (alignment - 1);
+		if (aligned + size > (uintptr_t) limit) {
+			return allocateSlow(size, alignment);
+		}
+		cursor = (char *) (aligned + size);
+		bytesAllocated += size;
+		return (void *) aligned;
+	}
+
+	// Constructs a T inside the arena
+	template<typename T, typename... Args>
+	T * create(Args&&... args) {
+		return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+	}
+
+	// Releases all the memory handed out by the arena
+	void reset();
+
+	size_t getBytesAllocated() const {
+		return bytesAllocated;
+	}
+
+	size_t getBytesReserved() const {
+		return bytesReserved;
+	}
+
+private:
+	struct Chunk {
+		Chunk *next;
+		size_t size;
+	};
+
+	Chunk  *chunks;         // list of chunks, most recent first
+	char   *cursor;         // next free byte in the current chunk
+	char   *limit;          // end of the current chunk
+	size_t chunkSize;
+	size_t bytesAllocated;  // bytes handed out to clients
+	size_t bytesReserved;   // bytes obtained from the system
+
+	void * allocateSlow(size_t size, size_t alignment);
+	Chunk * newChunk(size_t size);
+};
+
+// STL allocator drawing from an Arena. A null arena falls back to the
+// global heap, so containers can be used with or without an arena.
+template<typename T>
+class ArenaAllocator {
+public:
+	typedef T value_type;
+
+	ArenaAllocator(Arena *a = 0) : arena(a) {
+	}
+
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.getArena()) {
+	}
+
+	T * allocate(size_t n) {
+		if (arena)
+			return (T *) arena->allocate(n * sizeof(T), alignof(T));
+		return (T *) ::operator new(n * sizeof(T));
+	}
+
+	void deallocate(T *p, size_t) {
+		// memory from the arena is released with the arena
+		if (arena == 0)
+			::operator delete(p);
+	}
+
+	Arena * getArena() const {
+		return arena;
+	}
+
+	template<typename U>
+	bool operator==(const ArenaAllocator<U> &other) const {
+		return arena == other.getArena();
+	}
+
+	template<typename U>
+	bool operator!=(const ArenaAllocator<U> &other) const {
+		return arena != other.getArena();
+	}
+
+private:
+	Arena *arena;
+};
+
+// String whose characters are allocated like the containers above, so
+// that objects created in an arena can hold one
+typedef basic_string<char, char_traits<char>, ArenaAllocator<char> > ArenaString;
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef COMPILATION_CONTEXT_H
+#define COMPILATION_CONTEXT_H
+
+#include "support/arena.h"
+
+// Owns the memory of a compilation: instructions, values, basic blocks
+// and DAG nodes created through the context live in its arena and are
+// all released together when the context goes away.
+class CompilationContext {
+public:
+	CompilationContext() { }
+
+	CompilationContext(const CompilationContext &) = delete;
+	CompilationContext &operator=(const CompilationContext &) = delete;
+
+	Arena &getArena() {
+		return arena;
+	}
+
+	template<typename T, typename... Args>
+	T * create(Args&&... args) {
+		return arena.create<T>(std::forward<Args>(args)...);
+	}
+
+private:
+	Arena arena;
+};
+
+#endif
@@ -1,99 +1,233 @@
 #include <iostream>
 #include "ir/dag.h"
+#include "ir/flatDag.h"
+#include "exec/executor.h"
+#include "exec/matrixEvaluator.h"
+#include "opt/elementwiseFusion.h"
+#include "opt/densityAnalysis.h"
+#include "opt/shapeInference.h"
+#include "opt/reductionPushDown.h"
+#include "opt/constantFolding.h"
+#include "opt/deadCodeElimination.h"
+#include "exec/bufferAssignment.h"
+#include "io/objectStore.h"
+#include "io/asyncLoader.h"
 #include "ir/instruction.h"
 #include "cfg/basicBlock.h"
+#include "cfg/controlFlowGraph.h"
+#include "opt/loopInvariantCodeMotion.h"
+#include "opt/loopUnrolling.h"
+#include "opt/globalValueNumbering.h"
+#include "cfg/ssaForm.h"
+#include "support/compilationContext.h"
+#include "trace/tracer.h"
+#include <stdlib.h>
 
 using namespace std;
 
 int main(int argc, char** argv) {
 
+	// all instructions, values and DAG nodes are allocated from the context
+	CompilationContext context;
+
 	// i0: Matrix a = loadObj("faux-remote-0");
-	LocalVariable *a = new LocalVariable(0);
+	LocalVariable *a = context.create<LocalVariable>(0);
+	Load *load0 = context.create<Load>("faux-remote-0", &context.getArena());
+	Instruction *i0 = context.create<Move>(a, load0);
 
 	// i1: Matrix b = loadObj("faux-remote-1");
-	LocalVariable *b = new LocalVariable(1);
+	LocalVariable *b = context.create<LocalVariable>(1);
+	Load *load1 = context.create<Load>("faux-remote-1", &context.getArena());
+	Instruction *i1 = context.create<Move>(b, load1);
+
+	// the loaded objects are 2x2 matrices
+	load0->setShape(Shape(2, 2));
+	load1->setShape(Shape(2, 2));
 
-	a->link(b);
+	a->link(b)->link(i0)->link(i1);
 
 	// i2: Matrix c = a + 5;
-	LocalVariable *c = new LocalVariable(2);
-	Instruction *i2 = new Move(c, new Add(a, new Constant(new Integer(5))));
+	LocalVariable *c = context.create<LocalVariable>(2);
+	Instruction *i2 = context.create<Move>(c, context.create<Add>(a, context.create<Constant>(context.create<Integer>(5))));
 
-	b->link(i2);
+	i1->link(i2);
 
 	// i3: Matrix d = b + a;
-	LocalVariable *d = new LocalVariable(3);
-	Instruction *i3 = new Move(d, new Add(b, a));
+	LocalVariable *d = context.create<LocalVariable>(3);
+	Instruction *i3 = context.create<Move>(d, context.create<Add>(b, a));
 
 	i2->link(i3);
 
 	// i4: a += 10;
 
-	Instruction *i4 = new Move(a, new Add(a, new Constant(new Integer(10))));
+	Instruction *i4 = context.create<Move>(a, context.create<Add>(a, context.create<Constant>(context.create<Integer>(10))));
 	i3->link(i4);
 
 	// i5: b = a + a + d;
 
-	LocalVariable *t1 = new LocalVariable(4);
-	Instruction *i5a = new Move(t1, new Add(a, a));
+	LocalVariable *t1 = context.create<LocalVariable>(4);
+	Instruction *i5a = context.create<Move>(t1, context.create<Add>(a, a));
 
 	i4->link(t1)->link(i5a);
 
-	Instruction *i5b = new Move(b, new Add(t1, d));
+	Instruction *i5b = context.create<Move>(b, context.create<Add>(t1, d));
 	i5a->link(i5b);
 
-	// i6: a = b + 20;
-	Instruction *i6 = new Move(a, new Add(b, new Constant(new Integer(20))));
-	i5b->link(i6);
-
-	// i7: d = (b + c) * 1;
-	LocalVariable *t2 = new LocalVariable(5);
-	Instruction *i7a = new Move(t2, new Add(b, c));
+	// for (int i = 0; i < 2; i++) { a = b + 20; d = (b + c) * i; }
+	LocalVariable *i = context.create<LocalVariable>(6);
+	Instruction *iInit = context.create<Move>(i, context.create<Constant>(context.create<Integer>(0)));
+	i5b->link(i)->link(iInit);
 
-	i6->link(t2)->link(i7a);
-	Instruction *i7b = new Move(d, new Mul(t2, new Constant(new Integer(1))));
+	BasicBlock *entryBlock = context.create<BasicBlock>(a, iInit, &context);
 
-	i7a->link(i7b);
+	// the header only tests i < 2
+	BasicBlock *headerBlock = context.create<BasicBlock>((Instruction *) 0, (Instruction *) 0, &context);
 
-	// i8: a = b + 20;
-	Instruction *i8 = new Move(a, new Add(b, new Constant(new Integer(20))));
-	i7b->link(i8);
+	// i6: a = b + 20;
+	Instruction *i6 = context.create<Move>(a, context.create<Add>(b, context.create<Constant>(context.create<Integer>(20))));
 
-	// i9: d = (b + c) * 2;
-	LocalVariable *t3 = new LocalVariable(6);
-	Instruction *i9a = new Move(t3, new Add(b, c));
+	// i7: d = (b + c) * i;
+	LocalVariable *t2 = context.create<LocalVariable>(5);
+	Instruction *i7a = context.create<Move>(t2, context.create<Add>(b, c));
+	Instruction *i7b = context.create<Move>(d, context.create<Mul>(t2, i));
 
-	i8->link(t3)->link(i9a);
-	Instruction *i9b = new Move(d, new Mul(t3, new Constant(new Integer(2))));
+	// i++
+	Instruction *iIncrement = context.create<Move>(i, context.create<Add>(i, context.create<Constant>(context.create<Integer>(1))));
+	i6->link(t2)->link(i7a)->link(i7b)->link(iIncrement);
 
-	i9a->link(i9b);
+	BasicBlock *bodyBlock = context.create<BasicBlock>(i6, iIncrement, &context);
 
 	// i10: Matrix e = a + b + c + d
-	LocalVariable *e = new LocalVariable(9);
-	LocalVariable *t4 = new LocalVariable(7);
-	LocalVariable *t5 = new LocalVariable(8);
-	Instruction *i10a = new Move(t4, new Add(a, b));
-	i9b->link(e)->link(t4)->link(t5)->link(i10a);
-
-	Instruction *i10b = new Move(t5, new Add(t4, c));
-	Instruction *i10c = new Move(e, new Add(t5, d));
+	LocalVariable *e = context.create<LocalVariable>(9);
+	LocalVariable *t4 = context.create<LocalVariable>(7);
+	LocalVariable *t5 = context.create<LocalVariable>(8);
+	Instruction *i10a = context.create<Move>(t4, context.create<Add>(a, b));
+	e->link(t4)->link(t5)->link(i10a);
+
+	Instruction *i10b = context.create<Move>(t5, context.create<Add>(t4, c));
+	Instruction *i10c = context.create<Move>(e, context.create<Add>(t5, d));
 	i10a->link(i10b)->link(i10c);
 
-	BasicBlock *codeSnippetBasicBlock = new BasicBlock(a, i10c);
-
-	Instruction *instructionIter = codeSnippetBasicBlock->getFirst();
+	// i11: print(sum(e));
+	LocalVariable *t6 = context.create<LocalVariable>(10);
+	Instruction *i11a = context.create<Move>(t6, context.create<Reduction>(SUM, e));
+	Instruction *i11b = context.create<Print>(t6);
+	i10c->link(t6)->link(i11a)->link(i11b);
+
+	BasicBlock *exitBlock = context.create<BasicBlock>(e, i11b, &context);
+
+	entryBlock->setJump(headerBlock);
+	headerBlock->setBranch(BRANCH_LESS, i, context.create<Constant>(context.create<Integer>(2)), bodyBlock, exitBlock);
+	bodyBlock->setJump(headerBlock);
+
+	ControlFlowGraph cfg(entryBlock, &context);
+	cfg.print();
+
+	// a = b + 20 and b + c do not change in the loop
+	LoopInvariantCodeMotion invariantCodeMotion;
+	invariantCodeMotion.run(cfg);
+	cout << endl << "Hoisted " << invariantCodeMotion.getNumberOfHoistedInstructions()
+			<< " loop invariant assignments" << endl;
+
+	// the loop runs twice: after unrolling, the function is a single block
+	LoopUnrolling unrolling;
+	unrolling.run(cfg);
+	cout << endl << "Unrolled " << unrolling.getNumberOfUnrolledLoops() << " loops" << endl;
+	cfg.print();
+
+	// value number the function in SSA form, then go back to plain
+	// assignments for the DAG
+	SSAForm ssa(cfg);
+	ssa.construct();
+	GlobalValueNumbering valueNumbering;
+	valueNumbering.run(cfg);
+	ssa.destruct();
+	cout << endl << "Global value numbering removed " << valueNumbering.getNumberOfRemovedInstructions()
+			<< " assignments" << endl;
+	cfg.print();
+
+	BasicBlock *codeSnippetBasicBlock = cfg.getEntry();
+
+	// The DAG does common subexpression elimination as it is built
+	DAG * dag = new DAG(codeSnippetBasicBlock);
+	dag->print();
 
-	while (instructionIter != 0) {
-		instructionIter->print();
-		cout << "\n";
-		instructionIter = instructionIter->getNext();
-	}
+	// No variable is used after the block, only print(sum(e)) is: the
+	// overwritten values (e.g. d = (b + c) * 0) are dead
+	unordered_set<LocalVariable *> liveOut;
+	DeadCodeElimination deadCode(liveOut);
+	deadCode.run(*dag);
+	cout << endl << "Dead code elimination removed " << deadCode.getNumberOfRemovedNodes() << " nodes" << endl;
+
+	// Fold the constants: d = (b + c) * 1 is b + c
+	ConstantFolding folding;
+	folding.run(*dag);
+	cout << endl << "Constant folding removed " << folding.getNumberOfRemovedNodes() << " nodes" << endl;
+
+	// sum(e) is computed from the sums of the loaded objects, without building e
+	ReductionPushDown pushDown(liveOut);
+	pushDown.run(*dag);
+	cout << endl << "Pushed down " << pushDown.getNumberOfRewrittenReductions() << " reductions, removing "
+			<< pushDown.getNumberOfRemovedNodes() << " matrix operators" << endl;
+	dag->print();
 
-	DAG * dag = new DAG(codeSnippetBasicBlock);
-	// So far the DAG is only doing common subexpression elimination
-	// also, dead code elimination is done, just need to do a topological
-	// sorting and remove nodes with no identifiers & no references.
-	// TODO: Add code to determine the live in/ live out sets. Test more.
+	// Keep the matrices that are mostly zeros in sparse storage; the loaded
+	// objects are dense here
+	ShapeInference().run(*dag);
+	unsigned sparseNodes = DensityAnalysis().run(*dag);
+	cout << endl << "Density analysis found " << sparseNodes << " sparse nodes" << endl;
+
+	// Fuse the elementwise chains
+	ElementwiseFusion fusion(liveOut);
+	fusion.run(*dag);
+	cout << endl << "Fused " << fusion.getNumberOfRemovedNodes() << " operators into "
+			<< fusion.getNumberOfFusedNodes() << " fused nodes" << endl;
 	dag->print();
 
+	// Execute the DAG, loading the objects in the background and reusing
+	// the buffers of the values that are dead
+	ShapeInference().run(*dag);
+	FlatDAG flatDAG = dag->freeze();
+	BufferAssignment bufferAssignment(*dag, flatDAG, liveOut);
+	cout << endl;
+	bufferAssignment.print();
+
+	MatrixEvaluator evaluator(flatDAG);
+	evaluator.setBufferAssignment(&bufferAssignment);
+
+	// the remote endpoint is modeled by a store in memory answering after 10ms
+	Matrix matrixA(ELEMENT_DOUBLE, 2, 2);
+	Matrix matrixB(ELEMENT_DOUBLE, 2, 2);
+	matrixA.fill(1);
+	matrixB.fill(2);
+	MemoryStore remote;
+	remote.put("faux-remote-0", matrixA);
+	remote.put("faux-remote-1", matrixB);
+	DelayedStore delayedRemote(remote, chrono::milliseconds(10));
+	AsyncLoader loader(delayedRemote);
+	evaluator.setLoader(&loader);
+
+	// DAG_TRACE=file.json writes a Chrome trace of the execution (built
+	// with -DDAG_TRACING), DAG_TRACE_COUNTERS=1 adds the hardware counters
+	const char *tracePath = getenv("DAG_TRACE");
+	if (tracePath)
+		Tracer::enable(getenv("DAG_TRACE_COUNTERS") != 0);
+
+	cout << endl << "sum(e) = ";
+	ThreadPool pool;
+	Executor executor(pool);
+	executor.execute(flatDAG, [&evaluator](FlatDAG::NodeId n) {
+		evaluator.evaluate(n);
+	}, bufferAssignment.getOrderingEdges(), [&evaluator](FlatDAG::NodeId n, const Executor::Completion &done) {
+		return evaluator.startLoad(n, done);
+	});
+
+	if (tracePath) {
+		if (!isTracingCompiledIn())
+			cerr << "DAG_TRACE: built without -DDAG_TRACING, the trace is empty" << endl;
+		if (!Tracer::writeChromeTrace(tracePath))
+			cerr << "DAG_TRACE: cannot write " << tracePath << endl;
+	}
+
+	delete dag;
 }
@@ -0,0 +1,87 @@
+#include "io/asyncLoader.h"
+#include <future>
+
+using namespace std;
+
+AsyncLoader::AsyncLoader(ObjectStore &objectStore, unsigned maxInFlight) :
+		store(objectStore), inFlight(0), peakInFlight(0), stopping(false) {
+	if (maxInFlight == 0)
+		maxInFlight = 1;
+	for (unsigned i = 0; i < maxInFlight; i++)
+		ioThreads.push_back(thread(&AsyncLoader::ioLoop, this));
+}
+
+AsyncLoader::~AsyncLoader() {
+	{
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+	}
+	requestQueued.notify_all();
+	for (thread &ioThread : ioThreads)
+		ioThread.join();
+}
+
+void AsyncLoader::load(const string &name, const Callback &done) {
+	{
+		lock_guard<mutex> guard(lock);
+		vector<Callback> &callbacks = pending[name];
+		callbacks.push_back(done);
+		if (callbacks.size() > 1)
+			return;
+		queue.push_back(name);
+	}
+	requestQueued.notify_one();
+}
+
+Matrix AsyncLoader::loadAndWait(const string &name) {
+	promise<Matrix> result;
+	load(name, [&result](const Matrix &object, exception_ptr error) {
+		if (error)
+			result.set_exception(error);
+		else
+			result.set_value(object);
+	});
+	return result.get_future().get();
+}
+
+unsigned AsyncLoader::getPeakInFlight() {
+	lock_guard<mutex> guard(lock);
+	return peakInFlight;
+}
+
+void AsyncLoader::ioLoop() {
+	while (true) {
+		string name;
+		{
+			unique_lock<mutex> guard(lock);
+			while (queue.empty() && !stopping)
+				requestQueued.wait(guard);
+			if (queue.empty())
+				return;
+			name = queue.front();
+			queue.pop_front();
+			inFlight++;
+			if (inFlight > peakInFlight)
+				peakInFlight = inFlight;
+		}
+
+		Matrix object;
+		exception_ptr error;
+		try {
+			object = store.fetch(name);
+		} catch (...) {
+			error = current_exception();
+		}
+
+		// later requests for the object start a new fetch
+		vector<Callback> callbacks;
+		{
+			lock_guard<mutex> guard(lock);
+			inFlight--;
+			callbacks.swap(pending[name]);
+			pending.erase(name);
+		}
+		for (const Callback &callback : callbacks)
+			callback(object, error);
+	}
+}
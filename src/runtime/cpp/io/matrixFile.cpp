@@ -0,0 +1,323 @@
+#include "io/matrixFile.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fstream>
+#include <stdexcept>
+
+using namespace std;
+
+static const uint64_t FNV_OFFSET_BASIS = 0xCBF29CE484222325ULL;
+static const uint64_t FNV_PRIME = 0x100000001B3ULL;
+
+MatrixChecksum::MatrixChecksum() : hash(FNV_OFFSET_BASIS), pendingBytes(0) {
+}
+
+void MatrixChecksum::update(const void *data, size_t bytes) {
+	const unsigned char *p = (const unsigned char *) data;
+
+	// complete the word started by the previous piece
+	if (pendingBytes != 0) {
+		while (pendingBytes < sizeof(uint64_t) && bytes != 0) {
+			pending[pendingBytes++] = *p++;
+			bytes--;
+		}
+		if (pendingBytes < sizeof(uint64_t))
+			return;
+		uint64_t word;
+		memcpy(&word, pending, sizeof(word));
+		hash = (hash ^ word) * FNV_PRIME;
+		pendingBytes = 0;
+	}
+
+	size_t i = 0;
+	for (; i + sizeof(uint64_t) <= bytes; i += sizeof(uint64_t)) {
+		uint64_t word;
+		memcpy(&word, p + i, sizeof(word));
+		hash = (hash ^ word) * FNV_PRIME;
+	}
+	for (; i < bytes; i++)
+		pending[pendingBytes++] = p[i];
+}
+
+uint64_t MatrixChecksum::getValue() const {
+	// the bytes after the last complete word are hashed one by one
+	uint64_t h = hash;
+	for (size_t i = 0; i < pendingBytes; i++)
+		h = (h ^ pending[i]) * FNV_PRIME;
+	return h;
+}
+
+uint64_t matrixChecksum(const void *data, size_t bytes) {
+	MatrixChecksum checksum;
+	checksum.update(data, bytes);
+	return checksum.getValue();
+}
+
+MappedStorage::MappedStorage(int fileDescriptor, size_t length, size_t offset) :
+		MatrixStorage(0, length - offset), mapping(0), mappingLength(length) {
+	mapping = mmap(0, length, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	if (mapping == MAP_FAILED)
+		throw runtime_error(string("cannot map matrix file: ") + strerror(errno));
+	// start reading ahead, the kernels stream over the whole matrix
+	madvise(mapping, length, MADV_WILLNEED);
+	data = (char *) mapping + offset;
+}
+
+MappedStorage::~MappedStorage() {
+	munmap(mapping, mappingLength);
+	// the memory is not owned by the MatrixStorage allocator
+	data = 0;
+}
+
+// Header of a dense row-major matrix, without the checksum
+static void initializeHeader(MatrixFileHeader &header, ElementType type, size_t rows, size_t columns) {
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MATRIX_FILE_MAGIC, sizeof(header.magic));
+	header.version = MATRIX_FILE_VERSION;
+	header.elementType = type;
+	header.rows = rows;
+	header.columns = columns;
+	header.columnStride = Matrix::elementSize(type);
+	header.rowStride = header.columnStride * columns;
+	header.dataOffset = MATRIX_FILE_DATA_OFFSET;
+	header.dataBytes = header.rowStride * rows;
+}
+
+void writeMatrixFile(const string &path, const Matrix &matrix) {
+	MatrixFileHeader header;
+	initializeHeader(header, matrix.getType(), matrix.getRows(), matrix.getColumns());
+	header.checksum = matrixChecksum(matrix.getRawData(), matrix.getBytes());
+
+	ofstream output(path, ios::binary);
+	if (!output)
+		throw runtime_error("cannot create matrix file " + path);
+	char padding[MATRIX_FILE_DATA_OFFSET];
+	memset(padding, 0, sizeof(padding));
+	memcpy(padding, &header, sizeof(header));
+	output.write(padding, sizeof(padding));
+	output.write((const char *) matrix.getRawData(), matrix.getBytes());
+	if (!output)
+		throw runtime_error("cannot write matrix file " + path);
+}
+
+bool isMatrixFile(const string &path) {
+	char magic[sizeof(MATRIX_FILE_MAGIC)];
+	ifstream input(path, ios::binary);
+	return input.read(magic, sizeof(magic)) && memcmp(magic, MATRIX_FILE_MAGIC, sizeof(magic)) == 0;
+}
+
+// Checks that the header describes a matrix inside a file of 'fileBytes' bytes
+static void validateHeader(const MatrixFileHeader &header, uint64_t fileBytes, const string &path) {
+	if (memcmp(header.magic, MATRIX_FILE_MAGIC, sizeof(header.magic)) != 0)
+		throw runtime_error(path + " is not a matrix file");
+	if (header.version != MATRIX_FILE_VERSION)
+		throw runtime_error(path + ": unsupported matrix file version " + to_string(header.version));
+	if (header.elementType > ELEMENT_DOUBLE)
+		throw runtime_error(path + ": invalid element type");
+
+	uint64_t elementSize = Matrix::elementSize((ElementType) header.elementType);
+	if (header.dataOffset % MatrixStorage::ALIGNMENT != 0 || header.dataOffset < sizeof(MatrixFileHeader))
+		throw runtime_error(path + ": misaligned matrix data");
+	if (header.columnStride < elementSize || header.dataOffset > fileBytes
+			|| header.dataBytes > fileBytes - header.dataOffset)
+		throw runtime_error(path + ": truncated matrix file");
+
+	// the last element must be inside the data: each product and sum of
+	// its offset is checked against the room left, so none wraps around
+	if (header.rows != 0 && header.columns != 0) {
+		if (header.dataBytes < elementSize)
+			throw runtime_error(path + ": strides out of the matrix data");
+		uint64_t room = header.dataBytes - elementSize;
+		if (header.rows > 1 && header.rowStride > room / (header.rows - 1))
+			throw runtime_error(path + ": strides out of the matrix data");
+		room -= (header.rows - 1) * header.rowStride;
+		if (header.columns > 1 && header.columnStride > room / (header.columns - 1))
+			throw runtime_error(path + ": strides out of the matrix data");
+
+		// a strided file is gathered into a dense matrix of that many bytes
+		if (header.columns > SIZE_MAX / elementSize / header.rows)
+			throw runtime_error(path + ": matrix too large");
+	}
+}
+
+Matrix mapMatrixFile(const string &path, bool verifyChecksum) {
+	int fileDescriptor = open(path.c_str(), O_RDONLY);
+	if (fileDescriptor < 0)
+		throw runtime_error("cannot open matrix file " + path);
+
+	struct stat status;
+	MatrixFileHeader header;
+	if (fstat(fileDescriptor, &status) != 0 || (uint64_t) status.st_size < sizeof(header)
+			|| pread(fileDescriptor, &header, sizeof(header), 0) != (ssize_t) sizeof(header)) {
+		close(fileDescriptor);
+		throw runtime_error(path + " is not a matrix file");
+	}
+
+	shared_ptr<MatrixStorage> storage;
+	try {
+		validateHeader(header, status.st_size, path);
+		storage = make_shared<MappedStorage>(fileDescriptor, header.dataOffset + header.dataBytes,
+				header.dataOffset);
+	} catch (...) {
+		close(fileDescriptor);
+		throw;
+	}
+	// the mapping stays valid without the descriptor
+	close(fileDescriptor);
+
+	if (verifyChecksum && matrixChecksum(storage->getData(), header.dataBytes) != header.checksum)
+		throw runtime_error(path + ": checksum mismatch");
+
+	ElementType type = (ElementType) header.elementType;
+	size_t elementSize = Matrix::elementSize(type);
+	if (header.columnStride == elementSize && header.rowStride == elementSize * header.columns)
+		return Matrix(type, header.rows, header.columns, storage);
+
+	// strided file: gather the elements into a dense matrix
+	Matrix dense(type, header.rows, header.columns);
+	const char *source = (const char *) storage->getData();
+	char *destination = (char *) dense.getRawData();
+	for (uint64_t r = 0; r < header.rows; r++) {
+		for (uint64_t c = 0; c < header.columns; c++) {
+			memcpy(destination, source + r * header.rowStride + c * header.columnStride, elementSize);
+			destination += elementSize;
+		}
+	}
+	return dense;
+}
+
+// pread/pwrite of all 'bytes' bytes at 'offset'
+static void readFully(int fileDescriptor, void *buffer, size_t bytes, uint64_t offset, const string &path) {
+	char *p = (char *) buffer;
+	while (bytes > 0) {
+		ssize_t n = pread(fileDescriptor, p, bytes, offset);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			throw runtime_error(path + ": " + (n < 0 ? strerror(errno) : "unexpected end of file"));
+		p += n;
+		bytes -= n;
+		offset += n;
+	}
+}
+
+static void writeFully(int fileDescriptor, const void *buffer, size_t bytes, uint64_t offset, const string &path) {
+	const char *p = (const char *) buffer;
+	while (bytes > 0) {
+		ssize_t n = pwrite(fileDescriptor, p, bytes, offset);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			throw runtime_error("cannot write matrix file " + path + ": " + strerror(errno));
+		p += n;
+		bytes -= n;
+		offset += n;
+	}
+}
+
+MatrixFileReader::MatrixFileReader(const string &filePath) : path(filePath) {
+	fileDescriptor = open(path.c_str(), O_RDONLY);
+	if (fileDescriptor < 0)
+		throw runtime_error("cannot open matrix file " + path);
+
+	struct stat status;
+	if (fstat(fileDescriptor, &status) != 0 || (uint64_t) status.st_size < sizeof(header)
+			|| pread(fileDescriptor, &header, sizeof(header), 0) != (ssize_t) sizeof(header)) {
+		close(fileDescriptor);
+		throw runtime_error(path + " is not a matrix file");
+	}
+	try {
+		validateHeader(header, status.st_size, path);
+	} catch (...) {
+		close(fileDescriptor);
+		throw;
+	}
+	posix_fadvise(fileDescriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
+MatrixFileReader::~MatrixFileReader() {
+	close(fileDescriptor);
+}
+
+void MatrixFileReader::read(size_t firstRow, size_t rows, Matrix &tile) {
+	if (firstRow + rows > header.rows)
+		throw out_of_range(path + ": tile out of the rows of the matrix");
+
+	ElementType type = getType();
+	if (tile.isEmpty() || !tile.isUnique() || tile.isReadOnly() || tile.getType() != type
+			|| tile.getRows() != rows || tile.getColumns() != header.columns)
+		tile = Matrix(type, rows, header.columns);
+	if (rows == 0 || header.columns == 0)
+		return;
+
+	size_t elementSize = Matrix::elementSize(type);
+	size_t rowBytes = elementSize * header.columns;
+	if (header.columnStride == elementSize && header.rowStride == rowBytes) {
+		readFully(fileDescriptor, tile.getRawData(), rows * rowBytes, header.dataOffset + firstRow * rowBytes, path);
+		return;
+	}
+
+	// strided file: read the span of every row and gather its elements
+	row.resize((header.columns - 1) * header.columnStride + elementSize);
+	char *destination = (char *) tile.getRawData();
+	for (size_t r = firstRow; r < firstRow + rows; r++) {
+		readFully(fileDescriptor, row.data(), row.size(), header.dataOffset + r * header.rowStride, path);
+		for (uint64_t c = 0; c < header.columns; c++) {
+			memcpy(destination, row.data() + c * header.columnStride, elementSize);
+			destination += elementSize;
+		}
+	}
+}
+
+void MatrixFileReader::release(size_t firstRow, size_t rows) {
+	posix_fadvise(fileDescriptor, header.dataOffset + firstRow * header.rowStride, rows * header.rowStride,
+			POSIX_FADV_DONTNEED);
+}
+
+MatrixFileWriter::MatrixFileWriter(const string &filePath, ElementType type, size_t rows, size_t columns) :
+		path(filePath), rowsWritten(0) {
+	initializeHeader(header, type, rows, columns);
+	fileDescriptor = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fileDescriptor < 0)
+		throw runtime_error("cannot create matrix file " + path);
+}
+
+MatrixFileWriter::~MatrixFileWriter() {
+	if (fileDescriptor >= 0)
+		close(fileDescriptor);
+}
+
+void MatrixFileWriter::write(size_t firstRow, const Matrix &tile) {
+	if (fileDescriptor < 0)
+		throw runtime_error("matrix file " + path + " is already finished");
+	if (firstRow != rowsWritten || tile.getType() != (ElementType) header.elementType
+			|| tile.getColumns() != header.columns || firstRow + tile.getRows() > header.rows)
+		throw invalid_argument("tile does not continue matrix file " + path);
+
+	writeFully(fileDescriptor, tile.getRawData(), tile.getBytes(), header.dataOffset + firstRow * header.rowStride, path);
+	checksum.update(tile.getRawData(), tile.getBytes());
+	rowsWritten += tile.getRows();
+}
+
+void MatrixFileWriter::finish() {
+	if (fileDescriptor < 0)
+		return;
+	if (rowsWritten != header.rows)
+		throw runtime_error("matrix file " + path + ": " + to_string(rowsWritten) + " of "
+				+ to_string(header.rows) + " rows written");
+
+	// the header goes last: a file without it is not taken for a complete matrix
+	header.checksum = checksum.getValue();
+	char padding[MATRIX_FILE_DATA_OFFSET];
+	memset(padding, 0, sizeof(padding));
+	memcpy(padding, &header, sizeof(header));
+	writeFully(fileDescriptor, padding, sizeof(padding), 0, path);
+	int result = close(fileDescriptor);
+	fileDescriptor = -1;
+	if (result != 0)
+		throw runtime_error("cannot write matrix file " + path + ": " + strerror(errno));
+}
@@ -0,0 +1,90 @@
+#include "io/objectStore.h"
+#include "io/matrixFile.h"
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <thread>
+#include <stdexcept>
+
+using namespace std;
+
+void MemoryStore::put(const string &name, const Matrix &matrix) {
+	lock_guard<mutex> guard(lock);
+	objects[name] = matrix;
+}
+
+Matrix MemoryStore::fetch(const string &name) {
+	Matrix object;
+	{
+		lock_guard<mutex> guard(lock);
+		unordered_map<string, Matrix>::const_iterator position = objects.find(name);
+		if (position == objects.end())
+			throw runtime_error("no object '" + name + "'");
+		object = position->second;
+	}
+	return object.clone();
+}
+
+Matrix LocalDirectoryStore::fetch(const string &name) {
+	string path = directory + "/" + name;
+	if (isMatrixFile(path))
+		return mapMatrixFile(path);
+
+	ifstream input(path);
+	if (!input)
+		throw runtime_error("cannot open object '" + name + "' in " + directory);
+	return readMatrix(input);
+}
+
+void LocalDirectoryStore::store(const string &name, const Matrix &matrix) {
+	writeMatrixFile(directory + "/" + name, matrix);
+}
+
+Matrix DelayedStore::fetch(const string &name) {
+	chrono::microseconds delay = latency;
+	if (jitter.count() > 0) {
+		static thread_local minstd_rand random(hash<thread::id>()(this_thread::get_id()));
+		delay += chrono::microseconds(random() % jitter.count());
+	}
+	this_thread::sleep_for(delay);
+	return store.fetch(name);
+}
+
+Matrix readMatrix(istream &input) {
+	string magic, typeName;
+	size_t rows, columns;
+	if (!(input >> magic >> typeName >> rows >> columns) || magic != "MATRIX")
+		throw runtime_error("invalid matrix header");
+
+	ElementType type;
+	if (typeName == Matrix::elementTypeName(ELEMENT_INT))
+		type = ELEMENT_INT;
+	else if (typeName == Matrix::elementTypeName(ELEMENT_FLOAT))
+		type = ELEMENT_FLOAT;
+	else if (typeName == Matrix::elementTypeName(ELEMENT_DOUBLE))
+		type = ELEMENT_DOUBLE;
+	else
+		throw runtime_error("invalid matrix element type " + typeName);
+
+	Matrix matrix(type, rows, columns);
+	for (size_t i = 0; i < rows; i++) {
+		for (size_t j = 0; j < columns; j++) {
+			double value;
+			if (!(input >> value))
+				throw runtime_error("truncated matrix");
+			matrix.set(i, j, value);
+		}
+	}
+	return matrix;
+}
+
+void writeMatrix(ostream &output, const Matrix &matrix) {
+	output << "MATRIX " << Matrix::elementTypeName(matrix.getType()) << " "
+			<< matrix.getRows() << " " << matrix.getColumns() << "\n";
+	output.precision(17);
+	for (size_t i = 0; i < matrix.getRows(); i++) {
+		for (size_t j = 0; j < matrix.getColumns(); j++)
+			output << (j ? " " : "") << matrix.get(i, j);
+		output << "\n";
+	}
+}
@@ -0,0 +1,54 @@
+#include "io/tileStream.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdexcept>
+
+using namespace std;
+
+// madvise over the whole pages of the elements of 'tile': the pages at its
+// ends are shared with the neighbouring tiles
+static void adviseRows(const Matrix &tile, int advice) {
+	uintptr_t page = sysconf(_SC_PAGESIZE);
+	uintptr_t begin = ((uintptr_t) tile.getRawData() + page - 1) / page * page;
+	uintptr_t end = ((uintptr_t) tile.getRawData() + tile.getBytes()) / page * page;
+	if (begin < end)
+		madvise((void *) begin, end - begin, advice);
+}
+
+void MatrixTileSource::read(size_t firstRow, size_t rows, Matrix &tile) {
+	if (firstRow + rows > matrix.getRows())
+		throw out_of_range("tile out of the rows of the matrix");
+	if (rows == 0 || matrix.getColumns() == 0) {
+		tile = Matrix(matrix.getType(), rows, matrix.getColumns());
+		return;
+	}
+
+	size_t rowBytes = matrix.getColumns() * Matrix::elementSize(matrix.getType());
+	size_t offset = (char *) matrix.getRawData() - (char *) matrix.getStorage()->getData();
+	tile = Matrix(matrix.getType(), rows, matrix.getColumns(), matrix.getStorage(), offset + firstRow * rowBytes);
+	// a mapping is read when the tile is used: start reading it now
+	if (matrix.isReadOnly())
+		adviseRows(tile, MADV_WILLNEED);
+}
+
+void MatrixTileSource::release(size_t firstRow, size_t rows) {
+	// dropping the pages of heap storage would lose its contents, a
+	// read-only mapping reads them again from the file
+	if (!matrix.isReadOnly() || rows == 0 || matrix.getColumns() == 0)
+		return;
+
+	size_t rowBytes = matrix.getColumns() * Matrix::elementSize(matrix.getType());
+	size_t offset = (char *) matrix.getRawData() - (char *) matrix.getStorage()->getData();
+	adviseRows(Matrix(matrix.getType(), rows, matrix.getColumns(), matrix.getStorage(), offset + firstRow * rowBytes),
+			MADV_DONTNEED);
+}
+
+void MatrixTileSink::write(size_t firstRow, const Matrix &tile) {
+	if (tile.getType() != matrix.getType() || tile.getColumns() != matrix.getColumns()
+			|| firstRow + tile.getRows() > matrix.getRows())
+		throw invalid_argument("tile does not match the result matrix");
+
+	size_t rowBytes = matrix.getColumns() * Matrix::elementSize(matrix.getType());
+	memcpy((char *) matrix.getRawData() + firstRow * rowBytes, tile.getRawData(), tile.getBytes());
+}
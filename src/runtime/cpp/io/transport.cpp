@@ -0,0 +1,279 @@
+#include "io/transport.h"
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <stdexcept>
+
+using namespace std;
+
+// Linux flags, not available everywhere
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#ifndef MSG_CMSG_CLOEXEC
+#define MSG_CMSG_CLOEXEC 0
+#endif
+#ifndef SOCK_CLOEXEC
+#define SOCK_CLOEXEC 0
+#endif
+
+static const uint32_t HAS_SCALAR = 1;
+static const uint32_t HAS_MATRIX = 2;
+static const uint32_t SHARED_MATRIX = 4;
+
+// Fixed part of a message on the socket, followed by the text and, unless
+// the matrix is shared, its elements
+struct MessageHeader {
+	uint32_t type;
+	uint32_t node;
+	uint32_t flags;
+	uint32_t elementType;
+	double   scalar;
+	uint64_t rows;
+	uint64_t columns;
+	uint64_t offset;      // of a shared matrix in its memory file
+	uint64_t textBytes;
+};
+
+static void sendFully(int socket, const void *buffer, size_t bytes) {
+	const char *p = (const char *) buffer;
+	while (bytes > 0) {
+		// a closed connection fails with EPIPE instead of raising SIGPIPE
+		ssize_t n = ::send(socket, p, bytes, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			throw runtime_error(string("cannot send message: ") + strerror(errno));
+		p += n;
+		bytes -= n;
+	}
+}
+
+// false on end of stream before the first byte
+static bool receiveFully(int socket, void *buffer, size_t bytes) {
+	char *p = (char *) buffer;
+	size_t received = 0;
+	while (received < bytes) {
+		ssize_t n = recv(socket, p + received, bytes - received, 0);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			throw runtime_error(string("cannot receive message: ") + strerror(errno));
+		if (n == 0) {
+			if (received == 0)
+				return false;
+			throw runtime_error("connection closed in the middle of a message");
+		}
+		received += n;
+	}
+	return true;
+}
+
+SocketTransport::SocketTransport(int s) : socket(s) {
+}
+
+SocketTransport::~SocketTransport() {
+	close(socket);
+}
+
+void SocketTransport::send(const TransportMessage &message) {
+	MessageHeader header;
+	memset(&header, 0, sizeof(header));
+	header.type = message.type;
+	header.node = message.node;
+	header.scalar = message.scalar;
+	header.textBytes = message.text.size();
+	if (message.hasScalar)
+		header.flags |= HAS_SCALAR;
+
+	int descriptor = -1;
+	bool owned = false;
+	if (!message.matrix.isEmpty()) {
+		header.flags |= HAS_MATRIX;
+		header.elementType = message.matrix.getType();
+		header.rows = message.matrix.getRows();
+		header.columns = message.matrix.getColumns();
+		if (message.matrix.getBytes() != 0)
+			descriptor = shareMatrix(message.matrix, header.offset, owned);
+		if (descriptor >= 0)
+			header.flags |= SHARED_MATRIX;
+	}
+
+	// the descriptor goes with the first byte of the header
+	struct iovec part;
+	part.iov_base = &header;
+	part.iov_len = sizeof(header);
+	struct msghdr socketMessage;
+	memset(&socketMessage, 0, sizeof(socketMessage));
+	socketMessage.msg_iov = &part;
+	socketMessage.msg_iovlen = 1;
+	union {
+		char           buffer[CMSG_SPACE(sizeof(int))];
+		struct cmsghdr alignment;
+	} control;
+	if (descriptor >= 0) {
+		socketMessage.msg_control = control.buffer;
+		socketMessage.msg_controllen = sizeof(control.buffer);
+		struct cmsghdr *rights = CMSG_FIRSTHDR(&socketMessage);
+		rights->cmsg_level = SOL_SOCKET;
+		rights->cmsg_type = SCM_RIGHTS;
+		rights->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(rights), &descriptor, sizeof(int));
+	}
+
+	ssize_t n;
+	do {
+		n = sendmsg(socket, &socketMessage, MSG_NOSIGNAL);
+	} while (n < 0 && errno == EINTR);
+	int error = errno;
+	if (owned)
+		close(descriptor);
+	if (n < 0)
+		throw runtime_error(string("cannot send message: ") + strerror(error));
+	sendFully(socket, (char *) &header + n, sizeof(header) - n);
+
+	sendFully(socket, message.text.data(), message.text.size());
+	size_t bytes = sizeof(header) + message.text.size();
+	if (header.flags & SHARED_MATRIX) {
+		bytesShared += message.matrix.getBytes();
+	} else if (!message.matrix.isEmpty()) {
+		sendFully(socket, message.matrix.getRawData(), message.matrix.getBytes());
+		bytes += message.matrix.getBytes();
+	}
+	bytesSent += bytes;
+}
+
+bool SocketTransport::receive(TransportMessage &message) {
+	MessageHeader header;
+	struct iovec part;
+	part.iov_base = &header;
+	part.iov_len = sizeof(header);
+	struct msghdr socketMessage;
+	memset(&socketMessage, 0, sizeof(socketMessage));
+	socketMessage.msg_iov = &part;
+	socketMessage.msg_iovlen = 1;
+	union {
+		char           buffer[CMSG_SPACE(sizeof(int))];
+		struct cmsghdr alignment;
+	} control;
+	socketMessage.msg_control = control.buffer;
+	socketMessage.msg_controllen = sizeof(control.buffer);
+
+	ssize_t n;
+	do {
+		n = recvmsg(socket, &socketMessage, MSG_CMSG_CLOEXEC);
+	} while (n < 0 && errno == EINTR);
+	if (n < 0)
+		throw runtime_error(string("cannot receive message: ") + strerror(errno));
+	if (n == 0)
+		return false;
+
+	int descriptor = -1;
+	struct cmsghdr *rights = CMSG_FIRSTHDR(&socketMessage);
+	if (rights != 0 && rights->cmsg_level == SOL_SOCKET && rights->cmsg_type == SCM_RIGHTS)
+		memcpy(&descriptor, CMSG_DATA(rights), sizeof(int));
+	// the storage owns the descriptor once the matrix is mapped
+	unique_ptr<int, void (*)(int *)> closer(descriptor >= 0 ? &descriptor : 0, [](int *d) { close(*d); });
+
+	if ((size_t) n < sizeof(header) && !receiveFully(socket, (char *) &header + n, sizeof(header) - n))
+		throw runtime_error("connection closed in the middle of a message");
+	if ((header.flags & SHARED_MATRIX) && descriptor < 0)
+		throw runtime_error("shared matrix without its memory file");
+
+	message.type = header.type;
+	message.node = header.node;
+	message.hasScalar = (header.flags & HAS_SCALAR) != 0;
+	message.scalar = header.scalar;
+	message.text.resize(header.textBytes);
+	if (header.textBytes != 0 && !receiveFully(socket, &message.text[0], header.textBytes))
+		throw runtime_error("connection closed in the middle of a message");
+	size_t bytes = sizeof(header) + header.textBytes;
+
+	message.matrix = Matrix();
+	if (header.flags & HAS_MATRIX) {
+		ElementType type = (ElementType) header.elementType;
+		size_t matrixBytes = header.rows * header.columns * Matrix::elementSize(type);
+		if (header.flags & SHARED_MATRIX) {
+			message.matrix = Matrix(type, header.rows, header.columns,
+					make_shared<SharedMemoryStorage>(descriptor, header.offset + matrixBytes, header.offset));
+			closer.release();
+			bytesShared += matrixBytes;
+		} else {
+			message.matrix = Matrix(type, header.rows, header.columns);
+			if (matrixBytes != 0 && !receiveFully(socket, message.matrix.getRawData(), matrixBytes))
+				throw runtime_error("connection closed in the middle of a message");
+			bytes += matrixBytes;
+		}
+	}
+	bytesReceived += bytes;
+	return true;
+}
+
+void SocketTransport::shutdownSend() {
+	shutdown(socket, SHUT_WR);
+}
+
+int SharedMemoryTransport::shareMatrix(const Matrix &matrix, uint64_t &offset, bool &owned) {
+	// forwarding: the elements are already in a memory file
+	SharedMemoryStorage *shared = dynamic_cast<SharedMemoryStorage *>(matrix.getStorage().get());
+	if (shared != 0) {
+		offset = shared->getOffset() + ((char *) matrix.getRawData() - (char *) shared->getData());
+		owned = false;
+		return shared->getFileDescriptor();
+	}
+
+#ifdef __linux__
+	int descriptor = memfd_create("matrix", MFD_CLOEXEC);
+	if (descriptor < 0)
+		return -1;
+	void *mapping = MAP_FAILED;
+	if (ftruncate(descriptor, matrix.getBytes()) == 0)
+		mapping = mmap(0, matrix.getBytes(), PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+	if (mapping == MAP_FAILED) {
+		close(descriptor);
+		return -1;
+	}
+	memcpy(mapping, matrix.getRawData(), matrix.getBytes());
+	munmap(mapping, matrix.getBytes());
+	offset = 0;
+	owned = true;
+	return descriptor;
+#else
+	return -1;
+#endif
+}
+
+SharedMemoryStorage::SharedMemoryStorage(int fileDescriptor, size_t length, size_t offset) :
+		MatrixStorage(0, length - offset), descriptor(fileDescriptor), mapping(0), mappingLength(length),
+		dataOffset(offset) {
+	mapping = mmap(0, length, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+	if (mapping == MAP_FAILED)
+		throw runtime_error(string("cannot map shared matrix: ") + strerror(errno));
+	data = (char *) mapping + offset;
+}
+
+SharedMemoryStorage::~SharedMemoryStorage() {
+	munmap(mapping, mappingLength);
+	close(descriptor);
+	// the memory is not owned by the MatrixStorage allocator
+	data = 0;
+}
+
+void createTransportPair(TransportKind kind, unique_ptr<Transport> &first, unique_ptr<Transport> &second) {
+	int sockets[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) != 0)
+		throw runtime_error(string("cannot create socket pair: ") + strerror(errno));
+	if (kind == SHARED_MEMORY_TRANSPORT) {
+		first.reset(new SharedMemoryTransport(sockets[0]));
+		second.reset(new SharedMemoryTransport(sockets[1]));
+	} else {
+		first.reset(new SocketTransport(sockets[0]));
+		second.reset(new SocketTransport(sockets[1]));
+	}
+}
+
+const char * getTransportName(TransportKind kind) {
+	return kind == SHARED_MEMORY_TRANSPORT ? "shared memory" : "socket";
+}
@@ -0,0 +1,36 @@
+#include "matrix/cpuFeatures.h"
+#include <stdlib.h>
+#include <string.h>
+
+InstructionSet detectInstructionSet() {
+	InstructionSet isa = ISA_SCALAR;
+
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		isa = ISA_AVX2;
+	if (isa == ISA_AVX2 && __builtin_cpu_supports("avx512f"))
+		isa = ISA_AVX512;
+#endif
+
+	const char *requested = getenv("DAG_RUNTIME_ISA");
+	if (requested) {
+		if (strcmp(requested, "scalar") == 0)
+			isa = ISA_SCALAR;
+		else if (strcmp(requested, "avx2") == 0 && isa > ISA_AVX2)
+			isa = ISA_AVX2;
+	}
+	return isa;
+}
+
+const char * getInstructionSetName(InstructionSet isa) {
+	switch (isa) {
+	case ISA_SCALAR:
+		return "scalar";
+	case ISA_AVX2:
+		return "avx2";
+	case ISA_AVX512:
+		return "avx512";
+	}
+	return "unknown";
+}
@@ -0,0 +1,141 @@
+#include "matrix/elementwise.h"
+#include "matrix/parallel.h"
+#include <stdexcept>
+
+using namespace std;
+
+// elements per parallel chunk
+static const size_t ELEMENTWISE_GRAIN = 1 << 16;
+
+template<typename T>
+static void addLoop(const T *a, const T *b, T *result, size_t n) {
+	for (size_t i = 0; i < n; i++)
+		result[i] = a[i] + b[i];
+}
+
+template<typename T>
+static void addScalarLoop(const T *a, T scalar, T *result, size_t n) {
+	for (size_t i = 0; i < n; i++)
+		result[i] = a[i] + scalar;
+}
+
+template<typename T>
+static void multiplyScalarLoop(const T *a, T scalar, T *result, size_t n) {
+	for (size_t i = 0; i < n; i++)
+		result[i] = a[i] * scalar;
+}
+
+bool getScalarElementwiseKernels(ElementwiseKernels &kernels) {
+	kernels.isa = ISA_SCALAR;
+	kernels.addInt = addLoop<int32_t>;
+	kernels.addFloat = addLoop<float>;
+	kernels.addDouble = addLoop<double>;
+	kernels.addScalarInt = addScalarLoop<int32_t>;
+	kernels.addScalarFloat = addScalarLoop<float>;
+	kernels.addScalarDouble = addScalarLoop<double>;
+	kernels.multiplyScalarInt = multiplyScalarLoop<int32_t>;
+	kernels.multiplyScalarFloat = multiplyScalarLoop<float>;
+	kernels.multiplyScalarDouble = multiplyScalarLoop<double>;
+	return true;
+}
+
+static ElementwiseKernels selectElementwiseKernels() {
+	ElementwiseKernels kernels;
+	InstructionSet isa = detectInstructionSet();
+
+	if (isa >= ISA_AVX512 && getAvx512ElementwiseKernels(kernels))
+		return kernels;
+	if (isa >= ISA_AVX2 && getAvx2ElementwiseKernels(kernels))
+		return kernels;
+	getScalarElementwiseKernels(kernels);
+	return kernels;
+}
+
+const ElementwiseKernels &getElementwiseKernels() {
+	static const ElementwiseKernels kernels = selectElementwiseKernels();
+	return kernels;
+}
+
+// Allocates 'result' unless it can hold a matrix like 'a'
+static void prepareResult(const Matrix &a, Matrix &result) {
+	if (result.isEmpty() || !result.sameShape(a) || result.getType() != a.getType()
+			|| result.isReadOnly())
+		result = Matrix(a.getType(), a.getRows(), a.getColumns());
+}
+
+void add(const Matrix &left, const Matrix &right, Matrix &result) {
+	if (!left.sameShape(right) || left.getType() != right.getType())
+		throw invalid_argument("matrix addition with mismatched operands");
+
+	// keep the operands alive if result is one of them and gets reallocated
+	Matrix a = left;
+	Matrix b = right;
+	prepareResult(a, result);
+
+	const ElementwiseKernels &kernels = getElementwiseKernels();
+	Matrix &r = result;
+	parallelFor(a.getSize(), ELEMENTWISE_GRAIN, [&](size_t begin, size_t end) {
+		switch (a.getType()) {
+		case ELEMENT_INT:
+			kernels.addInt(a.getData<int32_t>() + begin, b.getData<int32_t>() + begin,
+					r.getData<int32_t>() + begin, end - begin);
+			break;
+		case ELEMENT_FLOAT:
+			kernels.addFloat(a.getData<float>() + begin, b.getData<float>() + begin,
+					r.getData<float>() + begin, end - begin);
+			break;
+		case ELEMENT_DOUBLE:
+			kernels.addDouble(a.getData<double>() + begin, b.getData<double>() + begin,
+					r.getData<double>() + begin, end - begin);
+			break;
+		}
+	});
+}
+
+void add(const Matrix &left, double scalar, Matrix &result) {
+	Matrix a = left;
+	prepareResult(a, result);
+
+	const ElementwiseKernels &kernels = getElementwiseKernels();
+	Matrix &r = result;
+	parallelFor(a.getSize(), ELEMENTWISE_GRAIN, [&](size_t begin, size_t end) {
+		switch (a.getType()) {
+		case ELEMENT_INT:
+			kernels.addScalarInt(a.getData<int32_t>() + begin, (int32_t) scalar,
+					r.getData<int32_t>() + begin, end - begin);
+			break;
+		case ELEMENT_FLOAT:
+			kernels.addScalarFloat(a.getData<float>() + begin, (float) scalar,
+					r.getData<float>() + begin, end - begin);
+			break;
+		case ELEMENT_DOUBLE:
+			kernels.addScalarDouble(a.getData<double>() + begin, scalar,
+					r.getData<double>() + begin, end - begin);
+			break;
+		}
+	});
+}
+
+void multiply(const Matrix &left, double scalar, Matrix &result) {
+	Matrix a = left;
+	prepareResult(a, result);
+
+	const ElementwiseKernels &kernels = getElementwiseKernels();
+	Matrix &r = result;
+	parallelFor(a.getSize(), ELEMENTWISE_GRAIN, [&](size_t begin, size_t end) {
+		switch (a.getType()) {
+		case ELEMENT_INT:
+			kernels.multiplyScalarInt(a.getData<int32_t>() + begin, (int32_t) scalar,
+					r.getData<int32_t>() + begin, end - begin);
+			break;
+		case ELEMENT_FLOAT:
+			kernels.multiplyScalarFloat(a.getData<float>() + begin, (float) scalar,
+					r.getData<float>() + begin, end - begin);
+			break;
+		case ELEMENT_DOUBLE:
+			kernels.multiplyScalarDouble(a.getData<double>() + begin, scalar,
+					r.getData<double>() + begin, end - begin);
+			break;
+		}
+	});
+}
@@ -0,0 +1,141 @@
+#include "matrix/elementwise.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <stdint.h>
+
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#include <immintrin.h>
+
+// internal linkage: the same names are compiled for other instruction sets
+namespace {
+
+// Vector operations for each element type
+struct Avx512Int {
+	typedef int32_t T;
+	typedef __m512i V;
+	static const size_t WIDTH = 16;
+	static V load(const T *p) { return _mm512_loadu_si512(p); }
+	static void store(T *p, V v) { _mm512_storeu_si512(p, v); }
+	static void stream(T *p, V v) { _mm512_stream_si512((__m512i *) p, v); }
+	static V broadcast(T s) { return _mm512_set1_epi32(s); }
+	static V add(V a, V b) { return _mm512_add_epi32(a, b); }
+	static V multiply(V a, V b) { return _mm512_mullo_epi32(a, b); }
+};
+
+struct Avx512Float {
+	typedef float T;
+	typedef __m512 V;
+	static const size_t WIDTH = 16;
+	static V load(const T *p) { return _mm512_loadu_ps(p); }
+	static void store(T *p, V v) { _mm512_storeu_ps(p, v); }
+	static void stream(T *p, V v) { _mm512_stream_ps(p, v); }
+	static V broadcast(T s) { return _mm512_set1_ps(s); }
+	static V add(V a, V b) { return _mm512_add_ps(a, b); }
+	static V multiply(V a, V b) { return _mm512_mul_ps(a, b); }
+};
+
+struct Avx512Double {
+	typedef double T;
+	typedef __m512d V;
+	static const size_t WIDTH = 8;
+	static V load(const T *p) { return _mm512_loadu_pd(p); }
+	static void store(T *p, V v) { _mm512_storeu_pd(p, v); }
+	static void stream(T *p, V v) { _mm512_stream_pd(p, v); }
+	static V broadcast(T s) { return _mm512_set1_pd(s); }
+	static V add(V a, V b) { return _mm512_add_pd(a, b); }
+	static V multiply(V a, V b) { return _mm512_mul_pd(a, b); }
+};
+
+struct AddOperation {
+	template<typename Ops>
+	static typename Ops::V apply(typename Ops::V a, typename Ops::V b) { return Ops::add(a, b); }
+	template<typename T>
+	static T apply(T a, T b) { return a + b; }
+};
+
+struct MultiplyOperation {
+	template<typename Ops>
+	static typename Ops::V apply(typename Ops::V a, typename Ops::V b) { return Ops::multiply(a, b); }
+	template<typename T>
+	static T apply(T a, T b) { return a * b; }
+};
+
+}
+
+// Streaming stores need an output that does not fit in cache and is vector aligned
+template<typename Ops>
+static bool useStreamingStores(const typename Ops::T *result, size_t n) {
+	return n * sizeof(typename Ops::T) >= STREAMING_STORE_THRESHOLD
+			&& ((uintptr_t) result % (Ops::WIDTH * sizeof(typename Ops::T))) == 0;
+}
+
+// result[i] = a[i] op b[i], two vectors per iteration
+template<typename Ops, typename Operation>
+static void binaryKernel(const typename Ops::T *a, const typename Ops::T *b, typename Ops::T *result, size_t n) {
+	const size_t W = Ops::WIDTH;
+	size_t i = 0;
+
+	if (useStreamingStores<Ops>(result, n)) {
+		for (; i + 2 * W <= n; i += 2 * W) {
+			Ops::stream(result + i, Operation::template apply<Ops>(Ops::load(a + i), Ops::load(b + i)));
+			Ops::stream(result + i + W, Operation::template apply<Ops>(Ops::load(a + i + W), Ops::load(b + i + W)));
+		}
+		_mm_sfence();
+	} else {
+		for (; i + 2 * W <= n; i += 2 * W) {
+			Ops::store(result + i, Operation::template apply<Ops>(Ops::load(a + i), Ops::load(b + i)));
+			Ops::store(result + i + W, Operation::template apply<Ops>(Ops::load(a + i + W), Ops::load(b + i + W)));
+		}
+	}
+	for (; i < n; i++)
+		result[i] = Operation::apply(a[i], b[i]);
+}
+
+// result[i] = a[i] op scalar
+template<typename Ops, typename Operation>
+static void scalarKernel(const typename Ops::T *a, typename Ops::T scalar, typename Ops::T *result, size_t n) {
+	const size_t W = Ops::WIDTH;
+	typename Ops::V s = Ops::broadcast(scalar);
+	size_t i = 0;
+
+	if (useStreamingStores<Ops>(result, n)) {
+		for (; i + 2 * W <= n; i += 2 * W) {
+			Ops::stream(result + i, Operation::template apply<Ops>(Ops::load(a + i), s));
+			Ops::stream(result + i + W, Operation::template apply<Ops>(Ops::load(a + i + W), s));
+		}
+		_mm_sfence();
+	} else {
+		for (; i + 2 * W <= n; i += 2 * W) {
+			Ops::store(result + i, Operation::template apply<Ops>(Ops::load(a + i), s));
+			Ops::store(result + i + W, Operation::template apply<Ops>(Ops::load(a + i + W), s));
+		}
+	}
+	for (; i < n; i++)
+		result[i] = Operation::apply(a[i], scalar);
+}
+
+bool getAvx512ElementwiseKernels(ElementwiseKernels &kernels) {
+	kernels.isa = ISA_AVX512;
+	kernels.addInt = binaryKernel<Avx512Int, AddOperation>;
+	kernels.addFloat = binaryKernel<Avx512Float, AddOperation>;
+	kernels.addDouble = binaryKernel<Avx512Double, AddOperation>;
+	kernels.addScalarInt = scalarKernel<Avx512Int, AddOperation>;
+	kernels.addScalarFloat = scalarKernel<Avx512Float, AddOperation>;
+	kernels.addScalarDouble = scalarKernel<Avx512Double, AddOperation>;
+	kernels.multiplyScalarInt = scalarKernel<Avx512Int, MultiplyOperation>;
+	kernels.multiplyScalarFloat = scalarKernel<Avx512Float, MultiplyOperation>;
+	kernels.multiplyScalarDouble = scalarKernel<Avx512Double, MultiplyOperation>;
+	return true;
+}
+
+#pragma GCC pop_options
+
+#else
+
+bool getAvx512ElementwiseKernels(ElementwiseKernels &kernels) {
+	return false;
+}
+
+#endif
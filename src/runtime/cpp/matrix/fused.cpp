@@ -0,0 +1,226 @@
+#include "matrix/fused.h"
+#include "matrix/elementwise.h"
+#include "matrix/parallel.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string.h>
+
+using namespace std;
+
+// elements per tile: the intermediate tiles of a step stay in the L1/L2 caches
+static const size_t FUSED_TILE = 1024;
+
+// elements per parallel chunk
+static const size_t FUSED_GRAIN = 1 << 16;
+
+// Typed access to the selected elementwise kernels
+template<typename T>
+struct TypedKernels;
+
+template<>
+struct TypedKernels<int32_t> {
+	static void add(const int32_t *a, const int32_t *b, int32_t *r, size_t n) {
+		getElementwiseKernels().addInt(a, b, r, n);
+	}
+	static void addScalar(const int32_t *a, double s, int32_t *r, size_t n) {
+		getElementwiseKernels().addScalarInt(a, (int32_t) s, r, n);
+	}
+	static void multiplyScalar(const int32_t *a, double s, int32_t *r, size_t n) {
+		getElementwiseKernels().multiplyScalarInt(a, (int32_t) s, r, n);
+	}
+};
+
+template<>
+struct TypedKernels<float> {
+	static void add(const float *a, const float *b, float *r, size_t n) {
+		getElementwiseKernels().addFloat(a, b, r, n);
+	}
+	static void addScalar(const float *a, double s, float *r, size_t n) {
+		getElementwiseKernels().addScalarFloat(a, (float) s, r, n);
+	}
+	static void multiplyScalar(const float *a, double s, float *r, size_t n) {
+		getElementwiseKernels().multiplyScalarFloat(a, (float) s, r, n);
+	}
+};
+
+template<>
+struct TypedKernels<double> {
+	static void add(const double *a, const double *b, double *r, size_t n) {
+		getElementwiseKernels().addDouble(a, b, r, n);
+	}
+	static void addScalar(const double *a, double s, double *r, size_t n) {
+		getElementwiseKernels().addScalarDouble(a, s, r, n);
+	}
+	static void multiplyScalar(const double *a, double s, double *r, size_t n) {
+		getElementwiseKernels().multiplyScalarDouble(a, s, r, n);
+	}
+};
+
+// Registers holding scalars, and their values, known before looking at the data
+static void foldScalarRegisters(const vector<FusedStep> &steps, const vector<FusedInput> &inputs,
+		vector<bool> &isScalar, vector<double> &scalars) {
+	size_t numberOfRegisters = inputs.size() + steps.size();
+	isScalar.assign(numberOfRegisters, false);
+	scalars.assign(numberOfRegisters, 0);
+
+	for (size_t i = 0; i < inputs.size(); i++) {
+		isScalar[i] = inputs[i].matrix == 0 && inputs[i].sparse == 0;
+		scalars[i] = inputs[i].scalar;
+	}
+	for (size_t j = 0; j < steps.size(); j++) {
+		const FusedStep &step = steps[j];
+		size_t r = inputs.size() + j;
+		if (step.operand0 >= r || step.operand1 >= r)
+			throw invalid_argument("fused step reads a register not yet computed");
+		if (isScalar[step.operand0] && isScalar[step.operand1]) {
+			isScalar[r] = true;
+			if (step.op == FUSED_ADD)
+				scalars[r] = scalars[step.operand0] + scalars[step.operand1];
+			else
+				scalars[r] = scalars[step.operand0] * scalars[step.operand1];
+		}
+	}
+}
+
+double evaluateFusedScalar(const vector<FusedStep> &steps, const vector<FusedInput> &inputs) {
+	vector<bool> isScalar;
+	vector<double> scalars;
+	foldScalarRegisters(steps, inputs, isScalar, scalars);
+	if (steps.empty() || !isScalar.back())
+		throw invalid_argument("fused expression does not produce a scalar");
+	return scalars.back();
+}
+
+// Expands elements begin to begin + n (row-major) of a CSR matrix into 'tile'
+template<typename T>
+static void expandTile(const SparseMatrix &a, size_t begin, size_t n, T *tile) {
+	memset(tile, 0, n * sizeof(T));
+	const size_t *offsets = a.getOffsets();
+	const uint32_t *indices = a.getIndices();
+	const T *v = a.getValues().getData<T>();
+	size_t columns = a.getColumns();
+
+	for (size_t row = begin / columns; row * columns < begin + n; row++) {
+		size_t rowStart = row * columns;
+		uint32_t first = (uint32_t) (begin > rowStart ? begin - rowStart : 0);
+		size_t last = begin + n - rowStart < columns ? begin + n - rowStart : columns;
+		const uint32_t *e = lower_bound(indices + offsets[row], indices + offsets[row + 1], first);
+		for (; e != indices + offsets[row + 1] && *e < last; e++)
+			tile[rowStart + *e - begin] = v[e - indices];
+	}
+}
+
+template<typename T>
+static void evaluateTiles(const vector<FusedStep> &steps, const vector<FusedInput> &inputs,
+		const vector<bool> &isScalar, const vector<double> &scalars,
+		T *result, size_t begin, size_t end) {
+	size_t numberOfInputs = inputs.size();
+	// the results of the steps, then the expanded sparse inputs
+	vector<T> scratch((steps.size() + numberOfInputs) * FUSED_TILE);
+	vector<const T *> registers(numberOfInputs + steps.size(), (const T *) 0);
+
+	for (size_t tile = begin; tile < end; tile += FUSED_TILE) {
+		size_t n = end - tile < FUSED_TILE ? end - tile : FUSED_TILE;
+
+		for (size_t i = 0; i < numberOfInputs; i++) {
+			if (inputs[i].sparse) {
+				T *expanded = &scratch[(steps.size() + i) * FUSED_TILE];
+				expandTile(*inputs[i].sparse, tile, n, expanded);
+				registers[i] = expanded;
+			} else if (!isScalar[i]) {
+				registers[i] = inputs[i].matrix->getData<T>() + tile;
+			}
+		}
+
+		for (size_t j = 0; j < steps.size(); j++) {
+			size_t r = numberOfInputs + j;
+			if (isScalar[r])
+				continue;
+
+			const FusedStep &step = steps[j];
+			T *output = j + 1 == steps.size() ? result + tile : &scratch[j * FUSED_TILE];
+			uint32_t a = step.operand0;
+			uint32_t b = step.operand1;
+
+			// put the matrix operand first, + and * are commutative
+			if (isScalar[a]) {
+				uint32_t temp = a;
+				a = b;
+				b = temp;
+			}
+
+			if (step.op == FUSED_ADD) {
+				if (isScalar[b])
+					TypedKernels<T>::addScalar(registers[a], scalars[b], output, n);
+				else
+					TypedKernels<T>::add(registers[a], registers[b], output, n);
+			} else {
+				if (isScalar[b]) {
+					TypedKernels<T>::multiplyScalar(registers[a], scalars[b], output, n);
+				} else {
+					for (size_t k = 0; k < n; k++)
+						output[k] = registers[a][k] * registers[b][k];
+				}
+			}
+			registers[r] = output;
+		}
+	}
+}
+
+void evaluateFused(const vector<FusedStep> &steps, const vector<FusedInput> &inputs, Matrix &result) {
+	// shape and type of the matrix inputs
+	bool matrixInput = false;
+	size_t rows = 0, columns = 0;
+	ElementType type = ELEMENT_DOUBLE;
+	for (const FusedInput &input : inputs) {
+		if (input.sparse && input.sparse->getFormat() != SparseMatrix::CSR)
+			throw invalid_argument("fused expression over a sparse matrix not in CSR");
+		if (input.matrix == 0 && input.sparse == 0)
+			continue;
+		size_t inputRows = input.matrix ? input.matrix->getRows() : input.sparse->getRows();
+		size_t inputColumns = input.matrix ? input.matrix->getColumns() : input.sparse->getColumns();
+		ElementType inputType = input.matrix ? input.matrix->getType() : input.sparse->getType();
+		if (matrixInput && (rows != inputRows || columns != inputColumns || type != inputType))
+			throw invalid_argument("fused expression over mismatched matrices");
+		matrixInput = true;
+		rows = inputRows;
+		columns = inputColumns;
+		type = inputType;
+	}
+	if (!matrixInput || steps.empty())
+		throw invalid_argument("fused expression without matrix inputs");
+
+	vector<bool> isScalar;
+	vector<double> scalars;
+	foldScalarRegisters(steps, inputs, isScalar, scalars);
+
+	// keep the inputs alive if result is one of them and gets reallocated
+	vector<Matrix> operands;
+	for (const FusedInput &input : inputs) {
+		if (input.matrix)
+			operands.push_back(*input.matrix);
+	}
+	if (result.isEmpty() || result.getRows() != rows || result.getColumns() != columns || result.getType() != type
+			|| result.isReadOnly())
+		result = Matrix(type, rows, columns);
+
+	if (isScalar.back()) {
+		result.fill(scalars.back());
+		return;
+	}
+
+	Matrix &r = result;
+	parallelFor(rows * columns, FUSED_GRAIN, [&](size_t begin, size_t end) {
+		switch (r.getType()) {
+		case ELEMENT_INT:
+			evaluateTiles<int32_t>(steps, inputs, isScalar, scalars, r.getData<int32_t>(), begin, end);
+			break;
+		case ELEMENT_FLOAT:
+			evaluateTiles<float>(steps, inputs, isScalar, scalars, r.getData<float>(), begin, end);
+			break;
+		case ELEMENT_DOUBLE:
+			evaluateTiles<double>(steps, inputs, isScalar, scalars, r.getData<double>(), begin, end);
+			break;
+		}
+	});
+}
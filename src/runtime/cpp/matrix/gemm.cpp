@@ -0,0 +1,231 @@
+#include "matrix/gemm.h"
+#include "matrix/parallel.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string.h>
+
+using namespace std;
+
+// depth of the packed slivers: a KC x NR sliver of b stays in L1
+static const size_t GEMM_KC = 256;
+
+// packed block of a (MC x KC), read from L2 by every tile of a panel of b
+static const size_t GEMM_A_BLOCK_BYTES = 256 * 1024;
+
+// packed panel of b (KC x NC), read from L3 by every block of a
+static const size_t GEMM_B_PANEL_BYTES = 4 * 1024 * 1024;
+
+// largest MR x NR tile of the microkernels
+static const size_t GEMM_MAX_TILE = 256;
+
+// floating point operations below which a thread is not worth starting
+static const size_t GEMM_FLOPS_PER_THREAD = 1 << 22;
+
+template<typename T, size_t MR, size_t NR>
+static void scalarMicrokernel(size_t k, const T *a, const T *b, T *c, size_t rowStride, bool accumulate) {
+	T tile[MR][NR] = {};
+	for (size_t p = 0; p < k; p++) {
+		for (size_t i = 0; i < MR; i++) {
+			T ai = a[i];
+			for (size_t j = 0; j < NR; j++)
+				tile[i][j] += ai * b[j];
+		}
+		a += MR;
+		b += NR;
+	}
+	for (size_t i = 0; i < MR; i++) {
+		T *row = c + i * rowStride;
+		for (size_t j = 0; j < NR; j++)
+			row[j] = accumulate ? row[j] + tile[i][j] : tile[i][j];
+	}
+}
+
+bool getScalarGemmKernels(GemmKernels &kernels) {
+	kernels.isa = ISA_SCALAR;
+	kernels.intKernel.mr = kernels.intKernel.nr = 4;
+	kernels.intKernel.kernel = scalarMicrokernel<int32_t, 4, 4>;
+	kernels.floatKernel.mr = kernels.floatKernel.nr = 4;
+	kernels.floatKernel.kernel = scalarMicrokernel<float, 4, 4>;
+	kernels.doubleKernel.mr = kernels.doubleKernel.nr = 4;
+	kernels.doubleKernel.kernel = scalarMicrokernel<double, 4, 4>;
+	return true;
+}
+
+static GemmKernels selectGemmKernels() {
+	GemmKernels kernels;
+	InstructionSet isa = detectInstructionSet();
+
+	if (isa >= ISA_AVX512 && getAvx512GemmKernels(kernels))
+		return kernels;
+	if (isa >= ISA_AVX2 && getAvx2GemmKernels(kernels))
+		return kernels;
+	getScalarGemmKernels(kernels);
+	return kernels;
+}
+
+const GemmKernels &getGemmKernels() {
+	static const GemmKernels kernels = selectGemmKernels();
+	return kernels;
+}
+
+static size_t roundUp(size_t value, size_t multiple) {
+	return (value + multiple - 1) / multiple * multiple;
+}
+
+// Copies 'rows' x 'depth' elements of a into slivers of 'mr' rows: for
+// each column, the 'mr' elements of the sliver are contiguous. The last
+// sliver is padded with zeros.
+template<typename T>
+static void packA(const T *a, size_t rowStride, size_t rows, size_t depth, size_t mr, T *packed) {
+	for (size_t i0 = 0; i0 < rows; i0 += mr) {
+		size_t height = min(mr, rows - i0);
+		for (size_t i = 0; i < mr; i++) {
+			if (i < height) {
+				const T *row = a + (i0 + i) * rowStride;
+				for (size_t p = 0; p < depth; p++)
+					packed[p * mr + i] = row[p];
+			} else {
+				for (size_t p = 0; p < depth; p++)
+					packed[p * mr + i] = 0;
+			}
+		}
+		packed += mr * depth;
+	}
+}
+
+// Copies 'depth' x 'columns' elements of b into slivers of 'nr' columns:
+// for each row, the 'nr' elements of the sliver are contiguous. The last
+// sliver is padded with zeros.
+template<typename T>
+static void packB(const T *b, size_t rowStride, size_t depth, size_t columns, size_t nr, T *packed) {
+	for (size_t j0 = 0; j0 < columns; j0 += nr) {
+		size_t width = min(nr, columns - j0);
+		for (size_t p = 0; p < depth; p++) {
+			const T *row = b + p * rowStride + j0;
+			size_t j = 0;
+			for (; j < width; j++)
+				packed[j] = row[j];
+			for (; j < nr; j++)
+				packed[j] = 0;
+			packed += nr;
+		}
+	}
+}
+
+// c (m x n) = a (m x k) * b (k x n), k > 0, on the calling thread
+template<typename T>
+static void gemmBlocked(const GemmMicrokernel<T> &microkernel, size_t m, size_t n, size_t k,
+		const T *a, size_t aStride, const T *b, size_t bStride, T *c, size_t cStride) {
+	const size_t MR = microkernel.mr;
+	const size_t NR = microkernel.nr;
+	size_t kc = min(GEMM_KC, k);
+	size_t mc = min(max(MR, GEMM_A_BLOCK_BYTES / (GEMM_KC * sizeof(T)) / MR * MR), roundUp(m, MR));
+	size_t nc = min(max(NR, GEMM_B_PANEL_BYTES / (GEMM_KC * sizeof(T)) / NR * NR), roundUp(n, NR));
+
+	// aligned buffers
+	MatrixStorage aStorage(mc * kc * sizeof(T));
+	MatrixStorage bStorage(kc * nc * sizeof(T));
+	T *aPacked = (T *) aStorage.getData();
+	T *bPacked = (T *) bStorage.getData();
+	alignas(MatrixStorage::ALIGNMENT) T tile[GEMM_MAX_TILE];
+
+	for (size_t jc = 0; jc < n; jc += nc) {
+		size_t columns = min(nc, n - jc);
+		for (size_t pc = 0; pc < k; pc += kc) {
+			size_t depth = min(kc, k - pc);
+			// the first slice of k stores the tiles, the next ones add to them
+			bool accumulate = pc != 0;
+			packB(b + pc * bStride + jc, bStride, depth, columns, NR, bPacked);
+
+			for (size_t ic = 0; ic < m; ic += mc) {
+				size_t rows = min(mc, m - ic);
+				packA(a + ic * aStride + pc, aStride, rows, depth, MR, aPacked);
+
+				for (size_t jr = 0; jr < columns; jr += NR) {
+					size_t width = min(NR, columns - jr);
+					const T *bSliver = bPacked + jr * depth;
+					for (size_t ir = 0; ir < rows; ir += MR) {
+						size_t height = min(MR, rows - ir);
+						const T *aSliver = aPacked + ir * depth;
+						T *cTile = c + (ic + ir) * cStride + jc + jr;
+						if (height == MR && width == NR) {
+							microkernel.kernel(depth, aSliver, bSliver, cTile, cStride, accumulate);
+							continue;
+						}
+						// edge tile: computed whole, stored in part
+						microkernel.kernel(depth, aSliver, bSliver, tile, NR, false);
+						for (size_t i = 0; i < height; i++) {
+							T *row = cTile + i * cStride;
+							for (size_t j = 0; j < width; j++)
+								row[j] = accumulate ? row[j] + tile[i * NR + j] : tile[i * NR + j];
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+// Splits the larger dimension of the result across the kernel threads,
+// each thread packing its own blocks
+template<typename T>
+static void product(const GemmMicrokernel<T> &microkernel, const Matrix &a, const Matrix &b, Matrix &result) {
+	size_t m = a.getRows();
+	size_t n = b.getColumns();
+	size_t k = a.getColumns();
+	const T *aData = a.getData<T>();
+	const T *bData = b.getData<T>();
+	T *c = result.getData<T>();
+
+	if (m >= n) {
+		size_t grain = max(microkernel.mr, GEMM_FLOPS_PER_THREAD / (2 * n * k) + 1);
+		parallelFor(m, grain, [&](size_t begin, size_t end) {
+			gemmBlocked(microkernel, end - begin, n, k, aData + begin * k, k, bData, n, c + begin * n, n);
+		});
+	} else {
+		size_t grain = max(microkernel.nr, GEMM_FLOPS_PER_THREAD / (2 * m * k) + 1);
+		parallelFor(n, grain, [&](size_t begin, size_t end) {
+			gemmBlocked(microkernel, m, end - begin, k, aData, k, bData + begin, n, c + begin, n);
+		});
+	}
+}
+
+static bool sharesStorage(const Matrix &a, const Matrix &b) {
+	return a.getStorage() && a.getStorage() == b.getStorage();
+}
+
+void matrixProduct(const Matrix &left, const Matrix &right, Matrix &result) {
+	if (left.getColumns() != right.getRows() || left.getType() != right.getType())
+		throw invalid_argument("matrix product with mismatched operands");
+
+	// keep the operands alive if result is one of them and gets reallocated
+	Matrix a = left;
+	Matrix b = right;
+	size_t m = a.getRows();
+	size_t n = b.getColumns();
+	// the operands are read until the end, so the result cannot overwrite them
+	if (result.isEmpty() || result.getRows() != m || result.getColumns() != n
+			|| result.getType() != a.getType() || result.isReadOnly()
+			|| sharesStorage(result, a) || sharesStorage(result, b))
+		result = Matrix(a.getType(), m, n);
+
+	if (m == 0 || n == 0)
+		return;
+	if (a.getColumns() == 0) {
+		memset(result.getRawData(), 0, result.getBytes());
+		return;
+	}
+
+	const GemmKernels &kernels = getGemmKernels();
+	switch (a.getType()) {
+	case ELEMENT_INT:
+		product(kernels.intKernel, a, b, result);
+		break;
+	case ELEMENT_FLOAT:
+		product(kernels.floatKernel, a, b, result);
+		break;
+	case ELEMENT_DOUBLE:
+		product(kernels.doubleKernel, a, b, result);
+		break;
+	}
+}
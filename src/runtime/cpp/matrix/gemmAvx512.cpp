@@ -0,0 +1,101 @@
+#include "matrix/gemm.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#include <immintrin.h>
+
+// internal linkage: the same names are compiled for other instruction sets
+namespace {
+
+// Vector operations for each element type; the packed slivers are aligned
+struct Avx512Float {
+	typedef float T;
+	typedef __m512 V;
+	static const size_t WIDTH = 16;
+	static V zero() { return _mm512_setzero_ps(); }
+	static V loadPacked(const T *p) { return _mm512_load_ps(p); }
+	static V load(const T *p) { return _mm512_loadu_ps(p); }
+	static void store(T *p, V v) { _mm512_storeu_ps(p, v); }
+	static V broadcast(T s) { return _mm512_set1_ps(s); }
+	static V add(V a, V b) { return _mm512_add_ps(a, b); }
+	static V multiplyAdd(V a, V b, V c) { return _mm512_fmadd_ps(a, b, c); }
+};
+
+struct Avx512Double {
+	typedef double T;
+	typedef __m512d V;
+	static const size_t WIDTH = 8;
+	static V zero() { return _mm512_setzero_pd(); }
+	static V loadPacked(const T *p) { return _mm512_load_pd(p); }
+	static V load(const T *p) { return _mm512_loadu_pd(p); }
+	static void store(T *p, V v) { _mm512_storeu_pd(p, v); }
+	static V broadcast(T s) { return _mm512_set1_pd(s); }
+	static V add(V a, V b) { return _mm512_add_pd(a, b); }
+	static V multiplyAdd(V a, V b, V c) { return _mm512_fmadd_pd(a, b, c); }
+};
+
+}
+
+// MR x (NV vectors) tile kept in registers: MR * NV accumulators, NV
+// vectors of b and a broadcast element of a, at most the 32 registers
+template<typename Ops, size_t MR, size_t NV>
+static void microkernel(size_t k, const typename Ops::T *a, const typename Ops::T *b,
+		typename Ops::T *c, size_t rowStride, bool accumulate) {
+	typedef typename Ops::V V;
+	const size_t W = Ops::WIDTH;
+	V tile[MR][NV];
+
+	#pragma GCC unroll 16
+	for (size_t i = 0; i < MR; i++)
+		#pragma GCC unroll 16
+		for (size_t j = 0; j < NV; j++)
+			tile[i][j] = Ops::zero();
+
+	for (size_t p = 0; p < k; p++) {
+		V row[NV];
+		#pragma GCC unroll 16
+		for (size_t j = 0; j < NV; j++)
+			row[j] = Ops::loadPacked(b + j * W);
+		#pragma GCC unroll 16
+		for (size_t i = 0; i < MR; i++) {
+			V ai = Ops::broadcast(a[i]);
+			#pragma GCC unroll 16
+			for (size_t j = 0; j < NV; j++)
+				tile[i][j] = Ops::multiplyAdd(ai, row[j], tile[i][j]);
+		}
+		a += MR;
+		b += NV * W;
+	}
+
+	#pragma GCC unroll 16
+	for (size_t i = 0; i < MR; i++) {
+		typename Ops::T *out = c + i * rowStride;
+		#pragma GCC unroll 16
+		for (size_t j = 0; j < NV; j++)
+			Ops::store(out + j * W, accumulate ? Ops::add(Ops::load(out + j * W), tile[i][j]) : tile[i][j]);
+	}
+}
+
+bool getAvx512GemmKernels(GemmKernels &kernels) {
+	getScalarGemmKernels(kernels);
+	kernels.isa = ISA_AVX512;
+	kernels.floatKernel.mr = 6;
+	kernels.floatKernel.nr = 2 * Avx512Float::WIDTH;
+	kernels.floatKernel.kernel = microkernel<Avx512Float, 6, 2>;
+	kernels.doubleKernel.mr = 6;
+	kernels.doubleKernel.nr = 2 * Avx512Double::WIDTH;
+	kernels.doubleKernel.kernel = microkernel<Avx512Double, 6, 2>;
+	return true;
+}
+
+#pragma GCC pop_options
+
+#else
+
+bool getAvx512GemmKernels(GemmKernels &kernels) {
+	return false;
+}
+
+#endif
@@ -0,0 +1,126 @@
+#include "matrix/matrix.h"
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+
+using namespace std;
+
+const size_t MatrixStorage::ALIGNMENT;
+
+MatrixStorage::MatrixStorage(size_t b) : data(0), bytes(b) {
+	// round up so vector kernels may touch a whole last cache line
+	size_t allocated = (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+	if (allocated == 0)
+		allocated = ALIGNMENT;
+	if (posix_memalign(&data, ALIGNMENT, allocated) != 0)
+		throw bad_alloc();
+}
+
+MatrixStorage::~MatrixStorage() {
+	free(data);
+}
+
+size_t Matrix::elementSize(ElementType elementType) {
+	switch (elementType) {
+	case ELEMENT_INT:
+		return sizeof(int32_t);
+	case ELEMENT_FLOAT:
+		return sizeof(float);
+	case ELEMENT_DOUBLE:
+		return sizeof(double);
+	}
+	return 0;
+}
+
+const char * Matrix::elementTypeName(ElementType elementType) {
+	switch (elementType) {
+	case ELEMENT_INT:
+		return "INT";
+	case ELEMENT_FLOAT:
+		return "FLOAT";
+	case ELEMENT_DOUBLE:
+		return "DOUBLE";
+	}
+	return "INVALID";
+}
+
+Matrix::Matrix(ElementType elementType, size_t numberOfRows, size_t numberOfColumns) :
+		type(elementType), rows(numberOfRows), columns(numberOfColumns),
+		storage(make_shared<MatrixStorage>(numberOfRows * numberOfColumns * elementSize(elementType))) {
+	data = storage->getData();
+}
+
+Matrix::Matrix(ElementType elementType, size_t numberOfRows, size_t numberOfColumns,
+		shared_ptr<MatrixStorage> matrixStorage, size_t offset) :
+		type(elementType), rows(numberOfRows), columns(numberOfColumns), storage(matrixStorage) {
+	if (offset + getBytes() > storage->getBytes())
+		throw invalid_argument("matrix does not fit in its storage");
+	data = (char *) storage->getData() + offset;
+}
+
+double Matrix::get(size_t row, size_t column) const {
+	size_t i = row * columns + column;
+	switch (type) {
+	case ELEMENT_INT:
+		return getData<int32_t>()[i];
+	case ELEMENT_FLOAT:
+		return getData<float>()[i];
+	case ELEMENT_DOUBLE:
+		return getData<double>()[i];
+	}
+	return 0;
+}
+
+void Matrix::makeWritable() {
+	if (isReadOnly())
+		*this = clone();
+}
+
+void Matrix::set(size_t row, size_t column, double value) {
+	makeWritable();
+	size_t i = row * columns + column;
+	switch (type) {
+	case ELEMENT_INT:
+		getData<int32_t>()[i] = (int32_t) value;
+		break;
+	case ELEMENT_FLOAT:
+		getData<float>()[i] = (float) value;
+		break;
+	case ELEMENT_DOUBLE:
+		getData<double>()[i] = value;
+		break;
+	}
+}
+
+void Matrix::fill(double value) {
+	makeWritable();
+	size_t size = getSize();
+	switch (type) {
+	case ELEMENT_INT:
+		std::fill(getData<int32_t>(), getData<int32_t>() + size, (int32_t) value);
+		break;
+	case ELEMENT_FLOAT:
+		std::fill(getData<float>(), getData<float>() + size, (float) value);
+		break;
+	case ELEMENT_DOUBLE:
+		std::fill(getData<double>(), getData<double>() + size, value);
+		break;
+	}
+}
+
+Matrix Matrix::clone() const {
+	Matrix copy(type, rows, columns);
+	memcpy(copy.data, data, getBytes());
+	return copy;
+}
+
+void Matrix::print() const {
+	cout << "Matrix " << elementTypeName(type) << " " << rows << "x" << columns << endl;
+	for (size_t r = 0; r < rows; r++) {
+		for (size_t c = 0; c < columns; c++)
+			cout << " " << get(r, c);
+		cout << endl;
+	}
+}
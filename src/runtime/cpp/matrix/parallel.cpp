@@ -0,0 +1,42 @@
+#include "matrix/parallel.h"
+#include <thread>
+#include <vector>
+#include <atomic>
+
+using namespace std;
+
+static atomic<unsigned> kernelThreads(1);
+
+unsigned getKernelThreads() {
+	return kernelThreads;
+}
+
+void setKernelThreads(unsigned numberOfThreads) {
+	kernelThreads = numberOfThreads == 0 ? 1 : numberOfThreads;
+}
+
+void parallelFor(size_t size, size_t grain, const function<void(size_t, size_t)> &body) {
+	size_t numberOfChunks = grain ? size / grain : 1;
+	if (numberOfChunks > kernelThreads)
+		numberOfChunks = kernelThreads;
+	if (numberOfChunks <= 1) {
+		body(0, size);
+		return;
+	}
+
+	// the calling thread runs the first chunk
+	vector<thread> threads;
+	// chunks start on multiples of 64 iterations, keeping vector kernels aligned
+	size_t chunk = (size + numberOfChunks - 1) / numberOfChunks;
+	size_t aligned = (chunk + 63) & ~(size_t) 63;
+	// unless the rounding leaves a single chunk
+	if (aligned < size)
+		chunk = aligned;
+	for (size_t begin = chunk; begin < size; begin += chunk) {
+		size_t end = begin + chunk < size ? begin + chunk : size;
+		threads.push_back(thread(body, begin, end));
+	}
+	body(0, chunk < size ? chunk : size);
+	for (thread &t : threads)
+		t.join();
+}
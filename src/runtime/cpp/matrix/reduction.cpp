@@ -0,0 +1,145 @@
+#include "matrix/reduction.h"
+#include "matrix/parallel.h"
+#include <vector>
+#include <stdexcept>
+
+using namespace std;
+
+// elements per chunk: each chunk computes one partial result
+static const size_t REDUCTION_CHUNK = 1 << 16;
+
+// four independent accumulators hide the latency of the additions
+template<typename T>
+static double sumLoop(const T *a, size_t n) {
+	double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		s0 += a[i];
+		s1 += a[i + 1];
+		s2 += a[i + 2];
+		s3 += a[i + 3];
+	}
+	for (; i < n; i++)
+		s0 += a[i];
+	return (s0 + s1) + (s2 + s3);
+}
+
+template<typename T>
+static double dotLoop(const T *a, const T *b, size_t n) {
+	double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		s0 += (double) a[i] * b[i];
+		s1 += (double) a[i + 1] * b[i + 1];
+		s2 += (double) a[i + 2] * b[i + 2];
+		s3 += (double) a[i + 3] * b[i + 3];
+	}
+	for (; i < n; i++)
+		s0 += (double) a[i] * b[i];
+	return (s0 + s1) + (s2 + s3);
+}
+
+template<typename T>
+static double minimumLoop(const T *a, size_t n) {
+	T result = a[0];
+	for (size_t i = 1; i < n; i++)
+		result = a[i] < result ? a[i] : result;
+	return result;
+}
+
+template<typename T>
+static double maximumLoop(const T *a, size_t n) {
+	T result = a[0];
+	for (size_t i = 1; i < n; i++)
+		result = a[i] > result ? a[i] : result;
+	return result;
+}
+
+// Runs chunk(begin, end) over the chunks of 'size' elements and returns
+// the partial results in chunk order
+template<typename Chunk>
+static vector<double> reduceChunks(size_t size, const Chunk &chunk) {
+	size_t numberOfChunks = (size + REDUCTION_CHUNK - 1) / REDUCTION_CHUNK;
+	vector<double> partials(numberOfChunks);
+	parallelFor(numberOfChunks, 1, [&](size_t begin, size_t end) {
+		for (size_t c = begin; c < end; c++) {
+			size_t first = c * REDUCTION_CHUNK;
+			size_t last = first + REDUCTION_CHUNK < size ? first + REDUCTION_CHUNK : size;
+			partials[c] = chunk(first, last - first);
+		}
+	});
+	return partials;
+}
+
+double sum(const Matrix &a) {
+	vector<double> partials = reduceChunks(a.getSize(), [&a](size_t begin, size_t n) {
+		switch (a.getType()) {
+		case ELEMENT_INT:
+			return sumLoop(a.getData<int32_t>() + begin, n);
+		case ELEMENT_FLOAT:
+			return sumLoop(a.getData<float>() + begin, n);
+		default:
+			return sumLoop(a.getData<double>() + begin, n);
+		}
+	});
+
+	double result = 0;
+	for (double partial : partials)
+		result += partial;
+	return result;
+}
+
+double dot(const Matrix &a, const Matrix &b) {
+	if (!a.sameShape(b) || a.getType() != b.getType())
+		throw invalid_argument("dot product with mismatched operands");
+
+	vector<double> partials = reduceChunks(a.getSize(), [&a, &b](size_t begin, size_t n) {
+		switch (a.getType()) {
+		case ELEMENT_INT:
+			return dotLoop(a.getData<int32_t>() + begin, b.getData<int32_t>() + begin, n);
+		case ELEMENT_FLOAT:
+			return dotLoop(a.getData<float>() + begin, b.getData<float>() + begin, n);
+		default:
+			return dotLoop(a.getData<double>() + begin, b.getData<double>() + begin, n);
+		}
+	});
+
+	double result = 0;
+	for (double partial : partials)
+		result += partial;
+	return result;
+}
+
+double minimum(const Matrix &a) {
+	if (a.getSize() == 0)
+		throw invalid_argument("minimum of an empty matrix");
+
+	vector<double> partials = reduceChunks(a.getSize(), [&a](size_t begin, size_t n) {
+		switch (a.getType()) {
+		case ELEMENT_INT:
+			return minimumLoop(a.getData<int32_t>() + begin, n);
+		case ELEMENT_FLOAT:
+			return minimumLoop(a.getData<float>() + begin, n);
+		default:
+			return minimumLoop(a.getData<double>() + begin, n);
+		}
+	});
+	return minimumLoop(partials.data(), partials.size());
+}
+
+double maximum(const Matrix &a) {
+	if (a.getSize() == 0)
+		throw invalid_argument("maximum of an empty matrix");
+
+	vector<double> partials = reduceChunks(a.getSize(), [&a](size_t begin, size_t n) {
+		switch (a.getType()) {
+		case ELEMENT_INT:
+			return maximumLoop(a.getData<int32_t>() + begin, n);
+		case ELEMENT_FLOAT:
+			return maximumLoop(a.getData<float>() + begin, n);
+		default:
+			return maximumLoop(a.getData<double>() + begin, n);
+		}
+	});
+	return maximumLoop(partials.data(), partials.size());
+}
@@ -0,0 +1,664 @@
+#include "matrix/sparse.h"
+#include "matrix/elementwise.h"
+#include "matrix/reduction.h"
+#include "matrix/parallel.h"
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <string.h>
+
+using namespace std;
+
+// stored elements (times the columns of a dense operand) below which a
+// thread is not worth starting
+static const size_t SPARSE_WORK_PER_THREAD = 1 << 16;
+
+// lines per parallel chunk, for 'work' units of work over 'lines' lines
+static size_t sparseGrain(size_t work, size_t lines) {
+	size_t perLine = lines == 0 ? 1 : work / lines + 1;
+	return max<size_t>(1, SPARSE_WORK_PER_THREAD / perLine);
+}
+
+static size_t lineSize(const SparseMatrix &a) {
+	return a.getFormat() == SparseMatrix::CSR ? a.getColumns() : a.getRows();
+}
+
+template<typename T>
+static void compress(const Matrix &dense, SparseMatrix::Format format, vector<size_t> &offsets,
+		vector<uint32_t> &indices, Matrix &values) {
+	const T *d = dense.getData<T>();
+	size_t rows = dense.getRows();
+	size_t columns = dense.getColumns();
+
+	if (format == SparseMatrix::CSR) {
+		// count the nonzeros of every row, then copy them
+		offsets.assign(rows + 1, 0);
+		parallelFor(rows, sparseGrain(dense.getSize(), rows), [&](size_t begin, size_t end) {
+			for (size_t r = begin; r < end; r++) {
+				size_t count = 0;
+				for (size_t c = 0; c < columns; c++)
+					count += d[r * columns + c] != 0;
+				offsets[r + 1] = count;
+			}
+		});
+		for (size_t r = 0; r < rows; r++)
+			offsets[r + 1] += offsets[r];
+
+		indices.resize(offsets[rows]);
+		values = Matrix(dense.getType(), 1, offsets[rows]);
+		T *v = values.getData<T>();
+		parallelFor(rows, sparseGrain(dense.getSize(), rows), [&](size_t begin, size_t end) {
+			for (size_t r = begin; r < end; r++) {
+				size_t e = offsets[r];
+				for (size_t c = 0; c < columns; c++) {
+					if (d[r * columns + c] != 0) {
+						indices[e] = c;
+						v[e++] = d[r * columns + c];
+					}
+				}
+			}
+		});
+		return;
+	}
+
+	// CSC: rows in increasing order within every column
+	offsets.assign(columns + 1, 0);
+	for (size_t i = 0; i < dense.getSize(); i++) {
+		if (d[i] != 0)
+			offsets[i % columns + 1]++;
+	}
+	for (size_t c = 0; c < columns; c++)
+		offsets[c + 1] += offsets[c];
+
+	indices.resize(offsets[columns]);
+	values = Matrix(dense.getType(), 1, offsets[columns]);
+	T *v = values.getData<T>();
+	vector<size_t> next(offsets.begin(), offsets.end() - 1);
+	for (size_t r = 0; r < rows; r++) {
+		for (size_t c = 0; c < columns; c++) {
+			if (d[r * columns + c] != 0) {
+				size_t e = next[c]++;
+				indices[e] = r;
+				v[e] = d[r * columns + c];
+			}
+		}
+	}
+}
+
+SparseMatrix::SparseMatrix(const Matrix &dense, Format sparseFormat) :
+		format(sparseFormat), rows(dense.getRows()), columns(dense.getColumns()) {
+	if (rows > UINT32_MAX || columns > UINT32_MAX)
+		throw invalid_argument("matrix too large for sparse storage");
+
+	shared_ptr<Structure> s = make_shared<Structure>();
+	switch (dense.getType()) {
+	case ELEMENT_INT:
+		compress<int32_t>(dense, format, s->offsets, s->indices, values);
+		break;
+	case ELEMENT_FLOAT:
+		compress<float>(dense, format, s->offsets, s->indices, values);
+		break;
+	case ELEMENT_DOUBLE:
+		compress<double>(dense, format, s->offsets, s->indices, values);
+		break;
+	}
+	structure = s;
+}
+
+SparseMatrix::SparseMatrix(Format sparseFormat, size_t numberOfRows, size_t numberOfColumns,
+		vector<size_t> &&offsets, vector<uint32_t> &&indices, const Matrix &elementValues) :
+		format(sparseFormat), rows(numberOfRows), columns(numberOfColumns), values(elementValues) {
+	if (offsets.size() != getMajorSize() + 1 || offsets.back() != indices.size()
+			|| values.getSize() != indices.size())
+		throw invalid_argument("sparse matrix with inconsistent structure");
+
+	shared_ptr<Structure> s = make_shared<Structure>();
+	s->offsets = move(offsets);
+	s->indices = move(indices);
+	structure = s;
+}
+
+SparseMatrix::SparseMatrix(const SparseMatrix &pattern, const Matrix &elementValues) :
+		format(pattern.format), rows(pattern.rows), columns(pattern.columns),
+		structure(pattern.structure), values(elementValues) {
+	if (values.getSize() != pattern.getNonZeros())
+		throw invalid_argument("sparse matrix with inconsistent structure");
+}
+
+size_t SparseMatrix::getBytes() const {
+	if (!structure)
+		return 0;
+	return values.getBytes() + structure->indices.size() * sizeof(uint32_t)
+			+ structure->offsets.size() * sizeof(size_t);
+}
+
+template<typename T>
+static void expand(const SparseMatrix &a, Matrix &dense) {
+	T *d = dense.getData<T>();
+	const size_t *offsets = a.getOffsets();
+	const uint32_t *indices = a.getIndices();
+	const T *v = a.getValues().getData<T>();
+	size_t columns = a.getColumns();
+	bool csr = a.getFormat() == SparseMatrix::CSR;
+
+	memset(d, 0, dense.getBytes());
+	// the lines write disjoint elements
+	parallelFor(a.getMajorSize(), sparseGrain(a.getNonZeros(), a.getMajorSize()), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			for (size_t e = offsets[i]; e < offsets[i + 1]; e++) {
+				if (csr)
+					d[i * columns + indices[e]] = v[e];
+				else
+					d[indices[e] * columns + i] = v[e];
+			}
+		}
+	});
+}
+
+Matrix SparseMatrix::toDense() const {
+	Matrix dense(getType(), rows, columns);
+	if (isEmpty())
+		return dense;
+	switch (getType()) {
+	case ELEMENT_INT:
+		expand<int32_t>(*this, dense);
+		break;
+	case ELEMENT_FLOAT:
+		expand<float>(*this, dense);
+		break;
+	case ELEMENT_DOUBLE:
+		expand<double>(*this, dense);
+		break;
+	}
+	return dense;
+}
+
+// CSR <-> CSC: a counting sort of the elements by their minor index
+template<typename T>
+static void transpose(const SparseMatrix &a, vector<size_t> &offsets, vector<uint32_t> &indices, Matrix &values) {
+	size_t major = a.getMajorSize();
+	size_t minor = lineSize(a);
+	const size_t *aOffsets = a.getOffsets();
+	const uint32_t *aIndices = a.getIndices();
+	const T *aValues = a.getValues().getData<T>();
+
+	offsets.assign(minor + 1, 0);
+	for (size_t e = 0; e < a.getNonZeros(); e++)
+		offsets[aIndices[e] + 1]++;
+	for (size_t i = 0; i < minor; i++)
+		offsets[i + 1] += offsets[i];
+
+	indices.resize(a.getNonZeros());
+	values = Matrix(a.getType(), 1, a.getNonZeros());
+	T *v = values.getData<T>();
+	vector<size_t> next(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < major; i++) {
+		for (size_t e = aOffsets[i]; e < aOffsets[i + 1]; e++) {
+			size_t position = next[aIndices[e]]++;
+			indices[position] = i;
+			v[position] = aValues[e];
+		}
+	}
+}
+
+SparseMatrix SparseMatrix::toFormat(Format newFormat) const {
+	if (newFormat == format || isEmpty())
+		return *this;
+
+	vector<size_t> offsets;
+	vector<uint32_t> indices;
+	Matrix newValues;
+	switch (getType()) {
+	case ELEMENT_INT:
+		transpose<int32_t>(*this, offsets, indices, newValues);
+		break;
+	case ELEMENT_FLOAT:
+		transpose<float>(*this, offsets, indices, newValues);
+		break;
+	case ELEMENT_DOUBLE:
+		transpose<double>(*this, offsets, indices, newValues);
+		break;
+	}
+	return SparseMatrix(newFormat, rows, columns, move(offsets), move(indices), newValues);
+}
+
+double SparseMatrix::get(size_t row, size_t column) const {
+	if (isEmpty())
+		return 0;
+	size_t line = format == CSR ? row : column;
+	uint32_t index = format == CSR ? column : row;
+	const uint32_t *first = getIndices() + getOffsets()[line];
+	const uint32_t *last = getIndices() + getOffsets()[line + 1];
+	const uint32_t *position = lower_bound(first, last, index);
+	if (position == last || *position != index)
+		return 0;
+	return values.get(0, position - getIndices());
+}
+
+void SparseMatrix::print() const {
+	cout << "Matrix " << Matrix::elementTypeName(getType()) << " " << rows << "x" << columns
+			<< " " << (format == CSR ? "CSR" : "CSC") << " " << getNonZeros() << " nonzeros" << endl;
+	for (size_t r = 0; r < rows; r++) {
+		for (size_t c = 0; c < columns; c++)
+			cout << " " << get(r, c);
+		cout << endl;
+	}
+}
+
+static void checkOperands(const char *operation, const SparseMatrix &a, ElementType type, bool sameShape) {
+	if (a.getType() != type || !sameShape)
+		throw invalid_argument(string(operation) + " with mismatched operands");
+}
+
+// Allocates 'result' unless it can hold a rows x columns matrix of 'type'
+// sharing no storage with 'operand', which is read until the end
+static void prepareProduct(ElementType type, size_t rows, size_t columns, const Matrix &operand, Matrix &result) {
+	if (result.isEmpty() || result.getRows() != rows || result.getColumns() != columns
+			|| result.getType() != type || result.isReadOnly()
+			|| (result.getStorage() && result.getStorage() == operand.getStorage()))
+		result = Matrix(type, rows, columns);
+}
+
+// Merges line i of a and b, calling element(index, value) in index order
+template<typename T, typename Element>
+static void mergeLine(const SparseMatrix &a, const SparseMatrix &b, size_t i, const Element &element) {
+	const size_t *aOffsets = a.getOffsets();
+	const size_t *bOffsets = b.getOffsets();
+	const uint32_t *aIndices = a.getIndices();
+	const uint32_t *bIndices = b.getIndices();
+	const T *aValues = a.getValues().getData<T>();
+	const T *bValues = b.getValues().getData<T>();
+
+	size_t p = aOffsets[i], q = bOffsets[i];
+	while (p < aOffsets[i + 1] || q < bOffsets[i + 1]) {
+		if (q == bOffsets[i + 1] || (p < aOffsets[i + 1] && aIndices[p] < bIndices[q])) {
+			element(aIndices[p], aValues[p]);
+			p++;
+		} else if (p == aOffsets[i + 1] || bIndices[q] < aIndices[p]) {
+			element(bIndices[q], bValues[q]);
+			q++;
+		} else {
+			element(aIndices[p], (T) (aValues[p] + bValues[q]));
+			p++;
+			q++;
+		}
+	}
+}
+
+template<typename T>
+static void addSparse(const SparseMatrix &a, const SparseMatrix &b, SparseMatrix &result) {
+	size_t lines = a.getMajorSize();
+	size_t grain = sparseGrain(a.getNonZeros() + b.getNonZeros(), lines);
+
+	vector<size_t> offsets(lines + 1, 0);
+	parallelFor(lines, grain, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			size_t count = 0;
+			mergeLine<T>(a, b, i, [&count](uint32_t, T) { count++; });
+			offsets[i + 1] = count;
+		}
+	});
+	for (size_t i = 0; i < lines; i++)
+		offsets[i + 1] += offsets[i];
+
+	vector<uint32_t> indices(offsets[lines]);
+	Matrix values(a.getType(), 1, offsets[lines]);
+	T *v = values.getData<T>();
+	parallelFor(lines, grain, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			size_t e = offsets[i];
+			mergeLine<T>(a, b, i, [&](uint32_t index, T value) {
+				indices[e] = index;
+				v[e++] = value;
+			});
+		}
+	});
+	result = SparseMatrix(a.getFormat(), a.getRows(), a.getColumns(), move(offsets), move(indices), values);
+}
+
+void add(const SparseMatrix &a, const SparseMatrix &right, SparseMatrix &result) {
+	checkOperands("sparse matrix addition", a, right.getType(), a.sameShape(right));
+	// keep the operands alive if result is one of them
+	SparseMatrix left = a;
+	SparseMatrix b = right.toFormat(a.getFormat());
+
+	switch (left.getType()) {
+	case ELEMENT_INT:
+		addSparse<int32_t>(left, b, result);
+		break;
+	case ELEMENT_FLOAT:
+		addSparse<float>(left, b, result);
+		break;
+	case ELEMENT_DOUBLE:
+		addSparse<double>(left, b, result);
+		break;
+	}
+}
+
+template<typename T>
+static void scatterAdd(const SparseMatrix &a, Matrix &result) {
+	T *r = result.getData<T>();
+	const size_t *offsets = a.getOffsets();
+	const uint32_t *indices = a.getIndices();
+	const T *v = a.getValues().getData<T>();
+	size_t columns = a.getColumns();
+	bool csr = a.getFormat() == SparseMatrix::CSR;
+
+	parallelFor(a.getMajorSize(), sparseGrain(a.getNonZeros(), a.getMajorSize()), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			for (size_t e = offsets[i]; e < offsets[i + 1]; e++) {
+				if (csr)
+					r[i * columns + indices[e]] += v[e];
+				else
+					r[indices[e] * columns + i] += v[e];
+			}
+		}
+	});
+}
+
+static void scatterAdd(const SparseMatrix &a, Matrix &result) {
+	switch (a.getType()) {
+	case ELEMENT_INT:
+		scatterAdd<int32_t>(a, result);
+		break;
+	case ELEMENT_FLOAT:
+		scatterAdd<float>(a, result);
+		break;
+	case ELEMENT_DOUBLE:
+		scatterAdd<double>(a, result);
+		break;
+	}
+}
+
+void add(const SparseMatrix &a, const Matrix &right, Matrix &result) {
+	checkOperands("matrix addition", a, right.getType(), a.sameShape(right));
+
+	// the result starts as a copy of b, unless it is b
+	Matrix b = right;
+	if (result.isEmpty() || !result.sameShape(b) || result.getType() != b.getType() || result.isReadOnly())
+		result = Matrix(b.getType(), b.getRows(), b.getColumns());
+	if (result.getRawData() != b.getRawData())
+		memcpy(result.getRawData(), b.getRawData(), b.getBytes());
+	scatterAdd(a, result);
+}
+
+void add(const SparseMatrix &a, const SparseMatrix &b, Matrix &result) {
+	checkOperands("matrix addition", a, b.getType(), a.sameShape(b));
+
+	// both operands are added to a zero result
+	if (result.isEmpty() || !a.sameShape(result) || result.getType() != a.getType() || result.isReadOnly())
+		result = Matrix(a.getType(), a.getRows(), a.getColumns());
+	memset(result.getRawData(), 0, result.getBytes());
+	scatterAdd(a, result);
+	scatterAdd(b, result);
+}
+
+void multiply(const SparseMatrix &a, double scalar, SparseMatrix &result) {
+	// the structure is shared, only the values are computed
+	Matrix values;
+	multiply(a.getValues(), scalar, values);
+	result = SparseMatrix(a, values);
+}
+
+// result = a * b with a in CSR: row i of the result is the sum of the rows
+// of b selected by the elements of row i of a
+template<typename T>
+static void productSparseDense(const SparseMatrix &a, const Matrix &b, Matrix &result) {
+	const size_t *offsets = a.getOffsets();
+	const uint32_t *indices = a.getIndices();
+	const T *v = a.getValues().getData<T>();
+	const T *bData = b.getData<T>();
+	T *r = result.getData<T>();
+	size_t n = b.getColumns();
+
+	parallelFor(a.getRows(), sparseGrain(a.getNonZeros() * n, a.getRows()), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			if (n == 1) {
+				// SpMV: a dot product per row
+				T s = 0;
+				for (size_t e = offsets[i]; e < offsets[i + 1]; e++)
+					s += v[e] * bData[indices[e]];
+				r[i] = s;
+				continue;
+			}
+			T *row = r + i * n;
+			fill(row, row + n, T(0));
+			for (size_t e = offsets[i]; e < offsets[i + 1]; e++) {
+				const T *bRow = bData + indices[e] * n;
+				T value = v[e];
+				for (size_t j = 0; j < n; j++)
+					row[j] += value * bRow[j];
+			}
+		}
+	});
+}
+
+void matrixProduct(const SparseMatrix &left, const Matrix &right, Matrix &result) {
+	if (left.getColumns() != right.getRows() || left.getType() != right.getType())
+		throw invalid_argument("matrix product with mismatched operands");
+
+	SparseMatrix a = left.toFormat(SparseMatrix::CSR);
+	Matrix b = right;
+	prepareProduct(a.getType(), a.getRows(), b.getColumns(), b, result);
+
+	switch (a.getType()) {
+	case ELEMENT_INT:
+		productSparseDense<int32_t>(a, b, result);
+		break;
+	case ELEMENT_FLOAT:
+		productSparseDense<float>(a, b, result);
+		break;
+	case ELEMENT_DOUBLE:
+		productSparseDense<double>(a, b, result);
+		break;
+	}
+}
+
+// result = a * b with b in CSR: every element a(i, p) adds a multiple of
+// row p of b to row i of the result
+template<typename T>
+static void productDenseSparse(const Matrix &a, const SparseMatrix &b, Matrix &result) {
+	const size_t *offsets = b.getOffsets();
+	const uint32_t *indices = b.getIndices();
+	const T *v = b.getValues().getData<T>();
+	const T *aData = a.getData<T>();
+	T *r = result.getData<T>();
+	size_t k = a.getColumns();
+	size_t n = b.getColumns();
+
+	parallelFor(a.getRows(), sparseGrain(a.getRows() * (k + b.getNonZeros()), a.getRows()), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			T *row = r + i * n;
+			fill(row, row + n, T(0));
+			for (size_t p = 0; p < k; p++) {
+				T aip = aData[i * k + p];
+				if (aip == 0)
+					continue;
+				for (size_t e = offsets[p]; e < offsets[p + 1]; e++)
+					row[indices[e]] += aip * v[e];
+			}
+		}
+	});
+}
+
+void matrixProduct(const Matrix &left, const SparseMatrix &right, Matrix &result) {
+	if (left.getColumns() != right.getRows() || left.getType() != right.getType())
+		throw invalid_argument("matrix product with mismatched operands");
+
+	Matrix a = left;
+	SparseMatrix b = right.toFormat(SparseMatrix::CSR);
+	prepareProduct(a.getType(), a.getRows(), b.getColumns(), a, result);
+
+	switch (a.getType()) {
+	case ELEMENT_INT:
+		productDenseSparse<int32_t>(a, b, result);
+		break;
+	case ELEMENT_FLOAT:
+		productDenseSparse<float>(a, b, result);
+		break;
+	case ELEMENT_DOUBLE:
+		productDenseSparse<double>(a, b, result);
+		break;
+	}
+}
+
+// result = a * b with a and b in CSR (Gustavson): row i of the result
+// accumulates the rows of b selected by the elements of row i of a
+template<typename T>
+static void productSparseSparse(const SparseMatrix &a, const SparseMatrix &b, Matrix &result) {
+	const size_t *aOffsets = a.getOffsets();
+	const uint32_t *aIndices = a.getIndices();
+	const T *aValues = a.getValues().getData<T>();
+	const size_t *bOffsets = b.getOffsets();
+	const uint32_t *bIndices = b.getIndices();
+	const T *bValues = b.getValues().getData<T>();
+	T *r = result.getData<T>();
+	size_t n = b.getColumns();
+	size_t work = a.getNonZeros() * (b.getNonZeros() / max<size_t>(1, b.getRows()) + 1) + a.getRows() * n;
+
+	parallelFor(a.getRows(), sparseGrain(work, a.getRows()), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			T *row = r + i * n;
+			fill(row, row + n, T(0));
+			for (size_t e = aOffsets[i]; e < aOffsets[i + 1]; e++) {
+				size_t p = aIndices[e];
+				T value = aValues[e];
+				for (size_t f = bOffsets[p]; f < bOffsets[p + 1]; f++)
+					row[bIndices[f]] += value * bValues[f];
+			}
+		}
+	});
+}
+
+void matrixProduct(const SparseMatrix &left, const SparseMatrix &right, Matrix &result) {
+	if (left.getColumns() != right.getRows() || left.getType() != right.getType())
+		throw invalid_argument("matrix product with mismatched operands");
+
+	SparseMatrix a = left.toFormat(SparseMatrix::CSR);
+	SparseMatrix b = right.toFormat(SparseMatrix::CSR);
+	prepareProduct(a.getType(), a.getRows(), b.getColumns(), Matrix(), result);
+
+	switch (a.getType()) {
+	case ELEMENT_INT:
+		productSparseSparse<int32_t>(a, b, result);
+		break;
+	case ELEMENT_FLOAT:
+		productSparseSparse<float>(a, b, result);
+		break;
+	case ELEMENT_DOUBLE:
+		productSparseSparse<double>(a, b, result);
+		break;
+	}
+}
+
+double sum(const SparseMatrix &a) {
+	return a.isEmpty() ? 0 : sum(a.getValues());
+}
+
+double minimum(const SparseMatrix &a) {
+	if (a.getSize() == 0)
+		throw invalid_argument("minimum of an empty matrix");
+	if (a.getNonZeros() == 0)
+		return 0;
+	double result = minimum(a.getValues());
+	// some elements are zeros
+	return a.getNonZeros() < a.getSize() && result > 0 ? 0 : result;
+}
+
+double maximum(const SparseMatrix &a) {
+	if (a.getSize() == 0)
+		throw invalid_argument("maximum of an empty matrix");
+	if (a.getNonZeros() == 0)
+		return 0;
+	double result = maximum(a.getValues());
+	return a.getNonZeros() < a.getSize() && result < 0 ? 0 : result;
+}
+
+// Sums the partial results of the lines in order, so the result does not
+// depend on the number of threads
+static double sumLines(size_t lines, size_t work, const function<double(size_t)> &line) {
+	vector<double> partials(lines);
+	parallelFor(lines, sparseGrain(work, lines), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+			partials[i] = line(i);
+	});
+
+	double result = 0;
+	for (double partial : partials)
+		result += partial;
+	return result;
+}
+
+template<typename T>
+static double dotSparseDense(const SparseMatrix &a, const Matrix &b) {
+	const size_t *offsets = a.getOffsets();
+	const uint32_t *indices = a.getIndices();
+	const T *v = a.getValues().getData<T>();
+	const T *bData = b.getData<T>();
+	size_t columns = a.getColumns();
+	bool csr = a.getFormat() == SparseMatrix::CSR;
+
+	return sumLines(a.getMajorSize(), a.getNonZeros(), [&](size_t i) {
+		double s = 0;
+		for (size_t e = offsets[i]; e < offsets[i + 1]; e++)
+			s += (double) v[e] * (csr ? bData[i * columns + indices[e]] : bData[indices[e] * columns + i]);
+		return s;
+	});
+}
+
+double dot(const SparseMatrix &a, const Matrix &b) {
+	checkOperands("dot product", a, b.getType(), a.sameShape(b));
+	if (a.isEmpty())
+		return 0;
+
+	switch (a.getType()) {
+	case ELEMENT_INT:
+		return dotSparseDense<int32_t>(a, b);
+	case ELEMENT_FLOAT:
+		return dotSparseDense<float>(a, b);
+	default:
+		return dotSparseDense<double>(a, b);
+	}
+}
+
+// the elements stored in both a and b, line by line
+template<typename T>
+static double dotSparseSparse(const SparseMatrix &a, const SparseMatrix &b) {
+	const size_t *aOffsets = a.getOffsets();
+	const size_t *bOffsets = b.getOffsets();
+	const uint32_t *aIndices = a.getIndices();
+	const uint32_t *bIndices = b.getIndices();
+	const T *aValues = a.getValues().getData<T>();
+	const T *bValues = b.getValues().getData<T>();
+
+	return sumLines(a.getMajorSize(), a.getNonZeros() + b.getNonZeros(), [&](size_t i) {
+		double s = 0;
+		size_t p = aOffsets[i], q = bOffsets[i];
+		while (p < aOffsets[i + 1] && q < bOffsets[i + 1]) {
+			if (aIndices[p] < bIndices[q]) {
+				p++;
+			} else if (bIndices[q] < aIndices[p]) {
+				q++;
+			} else {
+				s += (double) aValues[p++] * bValues[q++];
+			}
+		}
+		return s;
+	});
+}
+
+double dot(const SparseMatrix &a, const SparseMatrix &right) {
+	checkOperands("dot product", a, right.getType(), a.sameShape(right));
+	if (a.isEmpty() || right.isEmpty())
+		return 0;
+
+	SparseMatrix b = right.toFormat(a.getFormat());
+	switch (a.getType()) {
+	case ELEMENT_INT:
+		return dotSparseSparse<int32_t>(a, b);
+	case ELEMENT_FLOAT:
+		return dotSparseSparse<float>(a, b);
+	default:
+		return dotSparseSparse<double>(a, b);
+	}
+}
@@ -0,0 +1,71 @@
+#include "trace/perfCounters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <string.h>
+
+static int openCounter(uint64_t config, int group) {
+	struct perf_event_attr attributes;
+	memset(&attributes, 0, sizeof(attributes));
+	attributes.size = sizeof(attributes);
+	attributes.type = PERF_TYPE_HARDWARE;
+	attributes.config = config;
+	attributes.disabled = group < 0;
+	attributes.exclude_kernel = 1;
+	attributes.exclude_hv = 1;
+	attributes.read_format = PERF_FORMAT_GROUP;
+	// this thread, on any CPU
+	return (int) syscall(__NR_perf_event_open, &attributes, 0, -1, group, 0);
+}
+
+bool PerfCounters::open() {
+	if (isOpen())
+		return true;
+	groupDescriptor = openCounter(PERF_COUNT_HW_CPU_CYCLES, -1);
+	if (groupDescriptor < 0)
+		return false;
+	missesDescriptor = openCounter(PERF_COUNT_HW_CACHE_MISSES, groupDescriptor);
+	if (missesDescriptor < 0) {
+		close();
+		return false;
+	}
+	ioctl(groupDescriptor, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(groupDescriptor, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	return true;
+}
+
+void PerfCounters::close() {
+	if (missesDescriptor >= 0)
+		::close(missesDescriptor);
+	if (groupDescriptor >= 0)
+		::close(groupDescriptor);
+	groupDescriptor = missesDescriptor = -1;
+}
+
+bool PerfCounters::read(uint64_t &cycles, uint64_t &cacheMisses) const {
+	// PERF_FORMAT_GROUP: the number of counters, then their values
+	uint64_t values[3];
+	if (groupDescriptor < 0 || ::read(groupDescriptor, values, sizeof(values)) != (ssize_t) sizeof(values))
+		return false;
+	cycles = values[1];
+	cacheMisses = values[2];
+	return true;
+}
+
+#else
+
+bool PerfCounters::open() {
+	return false;
+}
+
+void PerfCounters::close() {
+}
+
+bool PerfCounters::read(uint64_t &cycles, uint64_t &cacheMisses) const {
+	return false;
+}
+
+#endif
@@ -0,0 +1,225 @@
+#include "trace/tracer.h"
+#include "trace/perfCounters.h"
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <fstream>
+#include <string.h>
+#include <stdio.h>
+
+using namespace std;
+
+atomic<bool> Tracer::enabled(false);
+
+namespace {
+
+// Events of one thread: a list of chunks, appended by the thread only. A
+// chunk publishes its size after writing the event, so the export may read
+// the events recorded so far while the thread goes on.
+struct TraceChunk {
+	static const uint32_t CAPACITY = 1024;
+
+	TraceEvent           events[CAPACITY];
+	atomic<uint32_t>     size;
+	atomic<TraceChunk *> next;
+
+	TraceChunk() : size(0), next(0) {
+	}
+};
+
+struct ThreadBuffer {
+	uint32_t     thread;
+	TraceChunk   *first;
+	TraceChunk   *last;
+	PerfCounters counters;
+	bool         countersTried;
+
+	ThreadBuffer(uint32_t t) : thread(t), first(new TraceChunk()), countersTried(false) {
+		last = first;
+	}
+};
+
+// The buffers outlive their threads (e.g. the workers of a pool that was
+// destroyed), so that their events can still be exported
+mutex                  registryLock;
+vector<ThreadBuffer *> buffers;
+atomic<bool>           countersRequested(false);
+atomic<bool>           countersAvailable(false);
+chrono::steady_clock::time_point epoch = chrono::steady_clock::now();
+
+thread_local ThreadBuffer *currentBuffer = 0;
+
+ThreadBuffer * getBuffer() {
+	if (currentBuffer == 0) {
+		lock_guard<mutex> guard(registryLock);
+		currentBuffer = new ThreadBuffer(buffers.size() + 1);
+		buffers.push_back(currentBuffer);
+	}
+	return currentBuffer;
+}
+
+// counters of the calling thread, opened on first use
+PerfCounters * getCounters(ThreadBuffer *buffer) {
+	if (!countersRequested.load(memory_order_relaxed))
+		return 0;
+	if (!buffer->countersTried) {
+		buffer->countersTried = true;
+		if (!buffer->counters.open())
+			countersAvailable.store(false, memory_order_relaxed);
+	}
+	return buffer->counters.isOpen() ? &buffer->counters : 0;
+}
+
+void writeString(ostream &out, const char *text) {
+	out << '"';
+	for (const char *c = text; *c != 0; c++) {
+		if (*c == '"' || *c == '\\')
+			out << '\\' << *c;
+		else if ((unsigned char) *c < 0x20)
+			out << ' ';
+		else
+			out << *c;
+	}
+	out << '"';
+}
+
+}
+
+void Tracer::enable(bool counters) {
+	countersRequested.store(counters, memory_order_relaxed);
+	countersAvailable.store(counters, memory_order_relaxed);
+	enabled.store(true, memory_order_relaxed);
+}
+
+void Tracer::disable() {
+	enabled.store(false, memory_order_relaxed);
+}
+
+bool Tracer::hasCounters() {
+	return countersAvailable.load(memory_order_relaxed);
+}
+
+uint64_t Tracer::now() {
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - epoch).count();
+}
+
+bool Tracer::begin(TraceEvent &event, const char *name, const char *category, uint32_t node, bool sampled) {
+	if (!isEnabled())
+		return false;
+	event.name = name;
+	event.category = category;
+	event.detail[0] = 0;
+	event.node = node;
+	event.bytes = event.flops = 0;
+	event.cycles = event.cacheMisses = 0;
+
+	PerfCounters *counters = sampled ? getCounters(getBuffer()) : 0;
+	if (counters && !counters->read(event.cycles, event.cacheMisses))
+		event.cycles = event.cacheMisses = 0;
+	event.start = now();
+	return true;
+}
+
+void Tracer::end(TraceEvent &event) {
+	event.end = now();
+	if (event.cycles != 0 || event.cacheMisses != 0) {
+		uint64_t cycles, cacheMisses;
+		PerfCounters *counters = getCounters(getBuffer());
+		if (counters && counters->read(cycles, cacheMisses)) {
+			event.cycles = cycles - event.cycles;
+			event.cacheMisses = cacheMisses - event.cacheMisses;
+		} else {
+			event.cycles = event.cacheMisses = 0;
+		}
+	}
+	record(event);
+}
+
+void Tracer::record(TraceEvent &event) {
+	ThreadBuffer *buffer = getBuffer();
+	event.thread = buffer->thread;
+
+	TraceChunk *chunk = buffer->last;
+	uint32_t size = chunk->size.load(memory_order_relaxed);
+	if (size == TraceChunk::CAPACITY) {
+		TraceChunk *next = new TraceChunk();
+		chunk->next.store(next, memory_order_release);
+		buffer->last = chunk = next;
+		size = 0;
+	}
+	chunk->events[size] = event;
+	chunk->size.store(size + 1, memory_order_release);
+}
+
+void Tracer::clear() {
+	lock_guard<mutex> guard(registryLock);
+	for (ThreadBuffer *buffer : buffers) {
+		TraceChunk *chunk = buffer->first->next.load(memory_order_acquire);
+		while (chunk != 0) {
+			TraceChunk *next = chunk->next.load(memory_order_acquire);
+			delete chunk;
+			chunk = next;
+		}
+		buffer->first->next.store(0, memory_order_relaxed);
+		buffer->first->size.store(0, memory_order_relaxed);
+		buffer->last = buffer->first;
+	}
+}
+
+size_t Tracer::getNumberOfEvents() {
+	lock_guard<mutex> guard(registryLock);
+	size_t events = 0;
+	for (ThreadBuffer *buffer : buffers) {
+		for (TraceChunk *chunk = buffer->first; chunk != 0; chunk = chunk->next.load(memory_order_acquire))
+			events += chunk->size.load(memory_order_acquire);
+	}
+	return events;
+}
+
+void Tracer::writeChromeTrace(ostream &out) {
+	lock_guard<mutex> guard(registryLock);
+	out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+	bool first = true;
+	char timestamp[64];
+	for (ThreadBuffer *buffer : buffers) {
+		out << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+				<< buffer->thread << ",\"args\":{\"name\":\"thread " << buffer->thread << "\"}}";
+		first = false;
+
+		for (TraceChunk *chunk = buffer->first; chunk != 0; chunk = chunk->next.load(memory_order_acquire)) {
+			uint32_t size = chunk->size.load(memory_order_acquire);
+			for (uint32_t i = 0; i < size; i++) {
+				const TraceEvent &event = chunk->events[i];
+				// complete events, in microseconds
+				snprintf(timestamp, sizeof(timestamp), "\"ts\":%.3f,\"dur\":%.3f",
+						event.start / 1e3, (event.end - event.start) / 1e3);
+				out << ",\n{\"name\":";
+				writeString(out, event.name);
+				out << ",\"cat\":";
+				writeString(out, event.category);
+				out << ",\"ph\":\"X\"," << timestamp << ",\"pid\":1,\"tid\":" << event.thread
+						<< ",\"args\":{\"node\":" << event.node << ",\"bytes\":" << event.bytes
+						<< ",\"flops\":" << event.flops;
+				if (event.cycles != 0 || event.cacheMisses != 0)
+					out << ",\"cycles\":" << event.cycles << ",\"llc_misses\":" << event.cacheMisses;
+				if (event.detail[0] != 0) {
+					out << ",\"detail\":";
+					writeString(out, event.detail);
+				}
+				out << "}}";
+			}
+		}
+	}
+	out << "\n]}" << endl;
+}
+
+bool Tracer::writeChromeTrace(const string &path) {
+	ofstream out(path.c_str());
+	writeChromeTrace(out);
+	return out.good();
+}
+
+void TraceSpan::setDetail(const string &detail) {
+	strncpy(event.detail, detail.c_str(), sizeof(event.detail) - 1);
+	event.detail[sizeof(event.detail) - 1] = 0;
+}
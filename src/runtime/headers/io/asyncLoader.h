@@ -0,0 +1,62 @@
+#ifndef ASYNC_LOADER_H
+#define ASYNC_LOADER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include "io/objectStore.h"
+
+using namespace std;
+
+// Fetches objects from a store in the background. Every I/O thread runs
+// one fetch at a time, so at most 'maxInFlight' requests are in flight;
+// the others wait in FIFO order. Requests for an object that is already
+// queued or being fetched share that fetch.
+class AsyncLoader {
+public:
+	// Called on an I/O thread with the object, or with the error of the fetch
+	using Callback = function<void(const Matrix &object, exception_ptr error)>;
+
+	AsyncLoader(ObjectStore &objectStore, unsigned maxInFlight = 4);
+
+	// Completes the queued requests before returning
+	~AsyncLoader();
+
+	AsyncLoader(const AsyncLoader &) = delete;
+	AsyncLoader &operator=(const AsyncLoader &) = delete;
+
+	// Requests object 'name', 'done' is called once it was fetched
+	void load(const string &name, const Callback &done);
+
+	// Requests object 'name' and waits for it
+	Matrix loadAndWait(const string &name);
+
+	unsigned getMaxInFlight() const {
+		return ioThreads.size();
+	}
+
+	// most requests that were in flight at the same time
+	unsigned getPeakInFlight();
+
+private:
+	ObjectStore                                 &store;
+	vector<thread>                              ioThreads;
+
+	mutex                                       lock;
+	condition_variable                          requestQueued;
+	deque<string>                               queue;
+	unordered_map<string, vector<Callback> >    pending;   // waiting callbacks by object
+	unsigned                                    inFlight;
+	unsigned                                    peakInFlight;
+	bool                                        stopping;
+
+	void ioLoop();
+};
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef MATRIX_FILE_H
+#define MATRIX_FILE_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "matrix/matrix.h"
+#include "io/tileStream.h"
+
+using namespace std;
+
+// Binary matrix file. A fixed header is followed by the elements,
+// starting at 'dataOffset' (a multiple of MatrixStorage::ALIGNMENT) so a
+// mapping of the file can be used as matrix storage without copying.
+// All fields are little endian.
+struct MatrixFileHeader {
+	char     magic[8];      // MATRIX_FILE_MAGIC
+	uint32_t version;       // MATRIX_FILE_VERSION
+	uint32_t elementType;   // ElementType, same numbering as the compiler Type (INT, FLOAT, DOUBLE)
+	uint64_t rows;
+	uint64_t columns;
+	uint64_t rowStride;     // bytes between the first elements of two rows
+	uint64_t columnStride;  // bytes between two elements of a row
+	uint64_t dataOffset;    // from the start of the file
+	uint64_t dataBytes;
+	uint64_t checksum;      // matrixChecksum of the data bytes
+};
+
+static const char     MATRIX_FILE_MAGIC[8] = { 'D', 'A', 'G', 'M', 'A', 'T', 'R', 'X' };
+static const uint32_t MATRIX_FILE_VERSION = 1;
+static const uint64_t MATRIX_FILE_DATA_OFFSET = 128;
+
+// Storage over a read-only, private mapping of a file. Writers must copy
+// the matrix first (Matrix::makeWritable), the kernels allocate a new
+// result instead of updating it in place.
+class MappedStorage: public MatrixStorage {
+public:
+	// maps 'length' bytes of the file, the matrix data starts at 'offset'
+	MappedStorage(int fileDescriptor, size_t length, size_t offset);
+	virtual ~MappedStorage();
+
+	virtual bool isReadOnly() const {
+		return true;
+	}
+
+private:
+	void   *mapping;
+	size_t mappingLength;
+};
+
+// Writes 'matrix' to 'path' as a dense row-major matrix file
+void writeMatrixFile(const string &path, const Matrix &matrix);
+
+// True when 'path' starts with the matrix file magic
+bool isMatrixFile(const string &path);
+
+// Maps the matrix file at 'path'. A dense row-major file is used in place
+// (zero copy, pages are read on first access); other strides are copied
+// into a dense matrix. The checksum is verified only on request, since it
+// reads the whole file. Throws runtime_error for invalid files.
+Matrix mapMatrixFile(const string &path, bool verifyChecksum = false);
+
+// 64 bit checksum of 'bytes' bytes (FNV-1a over 64 bit words)
+uint64_t matrixChecksum(const void *data, size_t bytes);
+
+// matrixChecksum of data given in consecutive pieces
+class MatrixChecksum {
+public:
+	MatrixChecksum();
+
+	void update(const void *data, size_t bytes);
+
+	// checksum of all the pieces so far
+	uint64_t getValue() const;
+
+private:
+	uint64_t      hash;
+	unsigned char pending[sizeof(uint64_t)];    // bytes of an incomplete word
+	size_t        pendingBytes;
+};
+
+// Reads a matrix file a range of rows at a time with pread(), instead of
+// mapping it: for files larger than memory, streamed through a bounded
+// buffer. Throws runtime_error for invalid files and failed reads.
+class MatrixFileReader: public TileSource {
+public:
+	MatrixFileReader(const string &path);
+	virtual ~MatrixFileReader();
+
+	MatrixFileReader(const MatrixFileReader &) = delete;
+	MatrixFileReader &operator=(const MatrixFileReader &) = delete;
+
+	virtual ElementType getType() const {
+		return (ElementType) header.elementType;
+	}
+	virtual size_t getRows() const {
+		return header.rows;
+	}
+	virtual size_t getColumns() const {
+		return header.columns;
+	}
+
+	// Reads rows [firstRow, firstRow + rows) into 'tile', gathering the
+	// elements of strided files
+	virtual void read(size_t firstRow, size_t rows, Matrix &tile);
+
+	// Drops the cached pages of the rows: a streamed file does not evict
+	// the rest of the page cache
+	virtual void release(size_t firstRow, size_t rows);
+
+private:
+	string           path;
+	int              fileDescriptor;
+	MatrixFileHeader header;
+	vector<char>     row;    // one strided row
+};
+
+// Writes a dense row-major matrix file as consecutive tiles of rows. The
+// header, with the checksum of all the rows, is written by finish().
+class MatrixFileWriter: public TileSink {
+public:
+	MatrixFileWriter(const string &path, ElementType type, size_t rows, size_t columns);
+	virtual ~MatrixFileWriter();
+
+	MatrixFileWriter(const MatrixFileWriter &) = delete;
+	MatrixFileWriter &operator=(const MatrixFileWriter &) = delete;
+
+	// 'firstRow' must be the next row to write
+	virtual void write(size_t firstRow, const Matrix &tile);
+
+	// throws runtime_error unless every row was written
+	virtual void finish();
+
+private:
+	string           path;
+	int              fileDescriptor;
+	MatrixFileHeader header;
+	size_t           rowsWritten;
+	MatrixChecksum   checksum;
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef OBJECT_STORE_H
+#define OBJECT_STORE_H
+
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+#include "matrix/matrix.h"
+
+using namespace std;
+
+// Source of the objects read by LOAD instructions (loadObj). fetch() blocks
+// until the object is available and throws runtime_error when it cannot be
+// read; the loader calls it concurrently from its I/O threads.
+class ObjectStore {
+public:
+	virtual ~ObjectStore() {
+	}
+
+	virtual Matrix fetch(const string &name) = 0;
+};
+
+// Objects kept in memory, for tests and benchmarks. Every fetch returns a
+// copy, like a transfer from a remote store would.
+class MemoryStore: public ObjectStore {
+public:
+	void put(const string &name, const Matrix &matrix);
+
+	virtual Matrix fetch(const string &name);
+
+private:
+	mutex                          lock;
+	unordered_map<string, Matrix>  objects;
+};
+
+// Stand-in for a remote store, or a node-local cache: object 'name' is the
+// file 'name' in a local directory. Binary matrix files (io/matrixFile.h)
+// are mapped without copying; other files are read in the text format
+// of readMatrix.
+class LocalDirectoryStore: public ObjectStore {
+public:
+	LocalDirectoryStore(const string &path) : directory(path) {
+	}
+
+	virtual Matrix fetch(const string &name);
+
+	// Writes 'matrix' as object 'name', in the binary format
+	void store(const string &name, const Matrix &matrix);
+
+	const string &getDirectory() const {
+		return directory;
+	}
+
+private:
+	string directory;
+};
+
+// Delays every fetch of another store by 'latency' plus a random jitter,
+// to model a remote endpoint offline
+class DelayedStore: public ObjectStore {
+public:
+	DelayedStore(ObjectStore &source, chrono::microseconds delay,
+			chrono::microseconds maximumJitter = chrono::microseconds(0)) :
+			store(source), latency(delay), jitter(maximumJitter) {
+	}
+
+	virtual Matrix fetch(const string &name);
+
+private:
+	ObjectStore          &store;
+	chrono::microseconds latency;
+	chrono::microseconds jitter;
+};
+
+// Text format of a matrix: a header line 'MATRIX <element type> <rows> <columns>'
+// followed by one line of elements per row
+Matrix readMatrix(istream &input);
+void writeMatrix(ostream &output, const Matrix &matrix);
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef TILE_STREAM_H
+#define TILE_STREAM_H
+
+#include "matrix/matrix.h"
+
+using namespace std;
+
+// Rows of a matrix read one tile (a range of rows) at a time, for matrices
+// that are not resident as a whole
+class TileSource {
+public:
+	virtual ~TileSource() {
+	}
+
+	virtual ElementType getType() const = 0;
+	virtual size_t getRows() const = 0;
+	virtual size_t getColumns() const = 0;
+
+	// Sets 'tile' to rows [firstRow, firstRow + rows). 'tile' is the matrix
+	// of an earlier read, its storage is reused when it is unique and has
+	// the right shape. Reads may run on another thread than the compute,
+	// one at a time.
+	virtual void read(size_t firstRow, size_t rows, Matrix &tile) = 0;
+
+	// rows [firstRow, firstRow + rows) will not be read again
+	virtual void release(size_t /* firstRow */, size_t /* rows */) {
+	}
+};
+
+// Receives the rows of a result one tile at a time, in order
+class TileSink {
+public:
+	virtual ~TileSink() {
+	}
+
+	// 'tile' holds rows [firstRow, firstRow + tile.getRows()) of the result
+	virtual void write(size_t firstRow, const Matrix &tile) = 0;
+
+	// called once every row was written
+	virtual void finish() {
+	}
+};
+
+// Tiles of a matrix that is already addressable, e.g. a mapped matrix file
+// returned by the loader: the tiles are views of its rows, not copies.
+// For read-only (mapped) storage, the pages of released rows are dropped
+// so the resident part of the file stays bounded.
+class MatrixTileSource: public TileSource {
+public:
+	MatrixTileSource(const Matrix &source) : matrix(source) {
+	}
+
+	virtual ElementType getType() const {
+		return matrix.getType();
+	}
+	virtual size_t getRows() const {
+		return matrix.getRows();
+	}
+	virtual size_t getColumns() const {
+		return matrix.getColumns();
+	}
+
+	virtual void read(size_t firstRow, size_t rows, Matrix &tile);
+	virtual void release(size_t firstRow, size_t rows);
+
+private:
+	Matrix matrix;
+};
+
+// Copies the tiles into a matrix allocated for the whole result
+class MatrixTileSink: public TileSink {
+public:
+	MatrixTileSink(ElementType type, size_t rows, size_t columns) : matrix(type, rows, columns) {
+	}
+
+	virtual void write(size_t firstRow, const Matrix &tile);
+
+	const Matrix &getMatrix() const {
+		return matrix;
+	}
+
+private:
+	Matrix matrix;
+};
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <string>
+#include <memory>
+#include <stdint.h>
+#include "matrix/matrix.h"
+
+using namespace std;
+
+// One message between the processes of a distributed evaluation: a type
+// and a node, whose meaning is up to the protocol, and optionally a
+// scalar, a matrix and a text
+struct TransportMessage {
+	uint32_t type;
+	uint32_t node;
+	bool     hasScalar;
+	double   scalar;
+	Matrix   matrix;    // empty when the message has none
+	string   text;
+
+	TransportMessage(uint32_t messageType = 0, uint32_t messageNode = 0) :
+			type(messageType), node(messageNode), hasScalar(false), scalar(0) {
+	}
+};
+
+// Ordered, two way connection between two processes. One thread may send
+// while another one receives, but there is at most one sender and one
+// receiver at a time. Errors throw runtime_error.
+class Transport {
+public:
+	Transport() : bytesSent(0), bytesReceived(0), bytesShared(0) {
+	}
+
+	virtual ~Transport() {
+	}
+
+	Transport(const Transport &) = delete;
+	Transport &operator=(const Transport &) = delete;
+
+	// Blocks until the message was handed to the connection
+	virtual void send(const TransportMessage &message) = 0;
+
+	// Blocks for the next message, false once the other end stopped sending
+	virtual bool receive(TransportMessage &message) = 0;
+
+	// No more messages will be sent: the other end receives false after the last one
+	virtual void shutdownSend() = 0;
+
+	// bytes written to and read from the connection
+	uint64_t getBytesSent() const {
+		return bytesSent;
+	}
+	uint64_t getBytesReceived() const {
+		return bytesReceived;
+	}
+	// bytes of the matrices sent and received in shared memory instead
+	uint64_t getBytesShared() const {
+		return bytesShared;
+	}
+
+protected:
+	uint64_t bytesSent;
+	uint64_t bytesReceived;
+	uint64_t bytesShared;
+};
+
+enum TransportKind {
+	SOCKET_TRANSPORT, SHARED_MEMORY_TRANSPORT
+};
+
+// Transport over a Unix stream socket (one end of a socketpair, or a
+// connected AF_UNIX socket): the elements of the matrices are copied
+// through the socket.
+class SocketTransport: public Transport {
+public:
+	// takes ownership of 'socket'
+	SocketTransport(int socket);
+	virtual ~SocketTransport();
+
+	virtual void send(const TransportMessage &message);
+	virtual bool receive(TransportMessage &message);
+	virtual void shutdownSend();
+
+protected:
+	int socket;
+
+	// Descriptor of a memory file holding the elements of 'matrix' from
+	// 'offset', to send instead of the elements, or -1 to send them inline.
+	// 'owned' descriptors are closed once sent.
+	virtual int shareMatrix(const Matrix & /* matrix */, uint64_t & /* offset */, bool & /* owned */) {
+		return -1;
+	}
+};
+
+// Socket transport passing the elements of the matrices in shared memory:
+// every matrix is copied once into a memory file (memfd) whose descriptor
+// goes with the message (SCM_RIGHTS), and the receiver maps it without
+// copying. A received matrix is sent on with the same descriptor, so a
+// process forwarding it copies nothing. Matrices go inline where memory
+// files are not available.
+class SharedMemoryTransport: public SocketTransport {
+public:
+	SharedMemoryTransport(int socket) : SocketTransport(socket) {
+	}
+
+protected:
+	virtual int shareMatrix(const Matrix &matrix, uint64_t &offset, bool &owned);
+};
+
+// Storage of a matrix received in shared memory: a read-only mapping of
+// the memory file, which other processes may still read
+class SharedMemoryStorage: public MatrixStorage {
+public:
+	// maps 'length' bytes of 'fileDescriptor', and then owns the
+	// descriptor; the matrix data starts at 'offset'
+	SharedMemoryStorage(int fileDescriptor, size_t length, size_t offset);
+	virtual ~SharedMemoryStorage();
+
+	virtual bool isReadOnly() const {
+		return true;
+	}
+
+	int getFileDescriptor() const {
+		return descriptor;
+	}
+	// of the data in the memory file
+	size_t getOffset() const {
+		return dataOffset;
+	}
+
+private:
+	int    descriptor;
+	void   *mapping;
+	size_t mappingLength;
+	size_t dataOffset;
+};
+
+// Two connected transports of 'kind', e.g. one for each process after fork()
+void createTransportPair(TransportKind kind, unique_ptr<Transport> &first, unique_ptr<Transport> &second);
+
+const char * getTransportName(TransportKind kind);
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+// Instruction set levels the runtime has kernels for, from the most generic
+typedef enum {
+	ISA_SCALAR, ISA_AVX2, ISA_AVX512
+} InstructionSet;
+
+// Best instruction set supported by the CPU (and the OS) running the program.
+// The DAG_RUNTIME_ISA environment variable (scalar, avx2, avx512) can lower it.
+InstructionSet detectInstructionSet();
+
+const char * getInstructionSetName(InstructionSet isa);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef ELEMENTWISE_H
+#define ELEMENTWISE_H
+
+#include "matrix/matrix.h"
+#include "matrix/cpuFeatures.h"
+
+// Elementwise matrix operations. 'result' is (re)allocated when it is empty
+// or does not have the shape and type of the operands; otherwise it is
+// overwritten, and it may be one of the operands (in-place update).
+// Scalars are converted to the element type of the matrix.
+
+// result = a + b
+void add(const Matrix &a, const Matrix &b, Matrix &result);
+
+// result = a + scalar
+void add(const Matrix &a, double scalar, Matrix &result);
+
+// result = a * scalar
+void multiply(const Matrix &a, double scalar, Matrix &result);
+
+// Kernels over raw arrays of n elements, selected once for the running CPU
+struct ElementwiseKernels {
+	InstructionSet isa;
+
+	void (*addInt)(const int32_t *a, const int32_t *b, int32_t *result, size_t n);
+	void (*addFloat)(const float *a, const float *b, float *result, size_t n);
+	void (*addDouble)(const double *a, const double *b, double *result, size_t n);
+
+	void (*addScalarInt)(const int32_t *a, int32_t scalar, int32_t *result, size_t n);
+	void (*addScalarFloat)(const float *a, float scalar, float *result, size_t n);
+	void (*addScalarDouble)(const double *a, double scalar, double *result, size_t n);
+
+	void (*multiplyScalarInt)(const int32_t *a, int32_t scalar, int32_t *result, size_t n);
+	void (*multiplyScalarFloat)(const float *a, float scalar, float *result, size_t n);
+	void (*multiplyScalarDouble)(const double *a, double scalar, double *result, size_t n);
+};
+
+const ElementwiseKernels &getElementwiseKernels();
+
+// Kernels for one instruction set; false when not compiled for this target
+bool getScalarElementwiseKernels(ElementwiseKernels &kernels);
+bool getAvx2ElementwiseKernels(ElementwiseKernels &kernels);
+bool getAvx512ElementwiseKernels(ElementwiseKernels &kernels);
+
+// Results of at least this many bytes are written with non-temporal
+// stores, which bypass the caches and save the read for ownership
+static const size_t STREAMING_STORE_THRESHOLD = 4 * 1024 * 1024;
+
+#endif
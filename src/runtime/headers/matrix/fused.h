@@ -0,0 +1,41 @@
+#ifndef FUSED_H
+#define FUSED_H
+
+#include <vector>
+#include "matrix/matrix.h"
+#include "matrix/sparse.h"
+
+using namespace std;
+
+typedef enum {
+	FUSED_ADD, FUSED_MULTIPLY
+} FusedOperator;
+
+// One step of a fused elementwise expression. Operands are registers:
+// the inputs first, then the results of the previous steps. The last
+// step produces the result of the expression.
+struct FusedStep {
+	FusedOperator op;
+	uint32_t      operand0;
+	uint32_t      operand1;
+};
+
+// Input of a fused expression: a dense matrix, a sparse matrix in CSR
+// format, or a scalar when both are 0
+struct FusedInput {
+	const Matrix       *matrix;
+	const SparseMatrix *sparse;
+	double             scalar;
+};
+
+// Evaluates the expression in a single pass over memory: the inputs are
+// processed in cache sized tiles and only the final values are stored.
+// All matrix inputs must have the same shape and element type. The tiles
+// of sparse inputs are expanded as they are read.
+// MULTIPLY of two matrices is the elementwise product here.
+void evaluateFused(const vector<FusedStep> &steps, const vector<FusedInput> &inputs, Matrix &result);
+
+// Evaluates an expression whose inputs are all scalars
+double evaluateFusedScalar(const vector<FusedStep> &steps, const vector<FusedInput> &inputs);
+
+#endif
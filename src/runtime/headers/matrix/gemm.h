@@ -0,0 +1,48 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#include "matrix/matrix.h"
+#include "matrix/cpuFeatures.h"
+
+// Matrix product: result = a * b, where a is m x k and b is k x n, of the
+// same element type. 'result' is (re)allocated unless it is an m x n
+// matrix of that type sharing no storage with the operands; INT products
+// wrap around like the elementwise kernels.
+//
+// The product is cache blocked: b is copied ("packed") KC rows by NC
+// columns at a time into a buffer read from L3/L2, a MC rows by KC
+// columns at a time into a buffer read from L2, and a microkernel
+// computes MR x NR tiles of the result from the packed slivers, keeping
+// the tile in registers. Large products are split across
+// getKernelThreads() threads, by rows or by columns of the result.
+void matrixProduct(const Matrix &a, const Matrix &b, Matrix &result);
+
+// c = (accumulate ? c : 0) + a * b for one MR x NR tile of the result,
+// whose rows are 'rowStride' elements apart: a is a packed sliver of MR
+// rows (k columns of MR elements), b a packed sliver of NR columns (k
+// rows of NR elements), both aligned to MatrixStorage::ALIGNMENT.
+template<typename T>
+struct GemmMicrokernel {
+	size_t mr;
+	size_t nr;
+	void (*kernel)(size_t k, const T *a, const T *b, T *c, size_t rowStride, bool accumulate);
+};
+
+// Microkernels selected once for the running CPU
+struct GemmKernels {
+	InstructionSet isa;
+
+	GemmMicrokernel<int32_t> intKernel;
+	GemmMicrokernel<float>   floatKernel;
+	GemmMicrokernel<double>  doubleKernel;
+};
+
+const GemmKernels &getGemmKernels();
+
+// Microkernels for one instruction set; false when not compiled for this
+// target. INT products use the scalar microkernel on every target.
+bool getScalarGemmKernels(GemmKernels &kernels);
+bool getAvx2GemmKernels(GemmKernels &kernels);
+bool getAvx512GemmKernels(GemmKernels &kernels);
+
+#endif
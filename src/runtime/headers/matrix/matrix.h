@@ -0,0 +1,136 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <cstddef>
+#include <stdint.h>
+#include <memory>
+
+using namespace std;
+
+// Element types of a matrix. The values match INT, FLOAT and DOUBLE
+// of the compiler Type enum (ir/instruction.h).
+typedef enum {
+	ELEMENT_INT, ELEMENT_FLOAT, ELEMENT_DOUBLE
+} ElementType;
+
+// Memory holding the elements of a matrix. The default storage is a
+// heap buffer aligned to ALIGNMENT bytes.
+class MatrixStorage {
+public:
+	static const size_t ALIGNMENT = 64;
+
+	MatrixStorage(size_t bytes);
+	virtual ~MatrixStorage();
+
+	MatrixStorage(const MatrixStorage &) = delete;
+	MatrixStorage &operator=(const MatrixStorage &) = delete;
+
+	void * getData() const {
+		return data;
+	}
+
+	size_t getBytes() const {
+		return bytes;
+	}
+
+	// read-only storage must be copied before it is written
+	virtual bool isReadOnly() const {
+		return false;
+	}
+
+protected:
+	void   *data;
+	size_t bytes;
+
+	// for subclasses providing their own memory
+	MatrixStorage(void *d, size_t b) : data(d), bytes(b) {
+	}
+};
+
+// Dense, row-major matrix. Copies of a Matrix share the same storage;
+// use clone() for a deep copy.
+class Matrix {
+public:
+	Matrix() : type(ELEMENT_DOUBLE), rows(0), columns(0), data(0) {
+	}
+
+	// uninitialized matrix
+	Matrix(ElementType elementType, size_t numberOfRows, size_t numberOfColumns);
+
+	// matrix over existing storage, starting at 'offset' bytes
+	Matrix(ElementType elementType, size_t numberOfRows, size_t numberOfColumns,
+			shared_ptr<MatrixStorage> matrixStorage, size_t offset = 0);
+
+	ElementType getType() const {
+		return type;
+	}
+	size_t getRows() const {
+		return rows;
+	}
+	size_t getColumns() const {
+		return columns;
+	}
+	size_t getSize() const {
+		return rows * columns;
+	}
+	size_t getBytes() const {
+		return getSize() * elementSize(type);
+	}
+	bool isEmpty() const {
+		return data == 0;
+	}
+	bool sameShape(const Matrix &other) const {
+		return rows == other.rows && columns == other.columns;
+	}
+
+	template<typename T>
+	T * getData() {
+		return (T *) data;
+	}
+	template<typename T>
+	const T * getData() const {
+		return (const T *) data;
+	}
+	void * getRawData() const {
+		return data;
+	}
+
+	const shared_ptr<MatrixStorage> &getStorage() const {
+		return storage;
+	}
+
+	bool isReadOnly() const {
+		return storage && storage->isReadOnly();
+	}
+
+	// true when no other Matrix shares the storage, so it can be updated in place
+	bool isUnique() const {
+		return storage.use_count() == 1;
+	}
+
+	// Copies read-only storage (e.g. a mapped file) before it is written:
+	// afterwards the matrix has a private, writable copy of its elements
+	void makeWritable();
+
+	// element access converting to/from double, for tests and printing.
+	// set and fill copy read-only storage first.
+	double get(size_t row, size_t column) const;
+	void set(size_t row, size_t column, double value);
+	void fill(double value);
+
+	Matrix clone() const;
+
+	void print() const;
+
+	static size_t elementSize(ElementType elementType);
+	static const char * elementTypeName(ElementType elementType);
+
+private:
+	ElementType               type;
+	size_t                    rows;
+	size_t                    columns;
+	shared_ptr<MatrixStorage> storage;
+	void                      *data;
+};
+
+#endif
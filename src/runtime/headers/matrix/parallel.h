@@ -0,0 +1,18 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <cstddef>
+#include <functional>
+
+using namespace std;
+
+// Number of threads a single runtime kernel may use. Defaults to 1, since
+// the DAG executor already runs independent nodes in parallel.
+unsigned getKernelThreads();
+void setKernelThreads(unsigned numberOfThreads);
+
+// Runs body(begin, end) over [0, size) split in chunks of at least
+// 'grain' iterations, using up to getKernelThreads() threads
+void parallelFor(size_t size, size_t grain, const function<void(size_t, size_t)> &body);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef REDUCTION_H
+#define REDUCTION_H
+
+#include "matrix/matrix.h"
+
+// Reductions of a matrix to a scalar, computed in double precision. The
+// elements are split in fixed chunks whose partial results are combined
+// in order, so the result does not depend on the number of threads.
+
+// sum of the elements, 0 for an empty matrix
+double sum(const Matrix &a);
+
+// smallest and largest element; invalid_argument for an empty matrix
+double minimum(const Matrix &a);
+double maximum(const Matrix &a);
+
+// sum of the elementwise products of a and b (same shape and type)
+double dot(const Matrix &a, const Matrix &b);
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include <vector>
+#include <memory>
+#include <stdint.h>
+#include "matrix/matrix.h"
+
+using namespace std;
+
+// Compressed sparse matrix: only the nonzero elements are stored. In CSR
+// the elements are grouped by row, in CSC by column; the rows (columns)
+// are the "major" lines. Line i holds the elements offsets[i] to
+// offsets[i + 1] - 1, whose column (row) indices are sorted in increasing
+// order. The values are a 1 x nonzeros Matrix of the element type.
+// Copies of a SparseMatrix share the same storage.
+class SparseMatrix {
+public:
+	enum Format {
+		CSR, CSC
+	};
+
+	SparseMatrix() : format(CSR), rows(0), columns(0) {
+	}
+
+	// compresses the nonzero elements of 'dense'
+	SparseMatrix(const Matrix &dense, Format format = CSR);
+
+	Format getFormat() const {
+		return format;
+	}
+	ElementType getType() const {
+		return values.getType();
+	}
+	size_t getRows() const {
+		return rows;
+	}
+	size_t getColumns() const {
+		return columns;
+	}
+	size_t getSize() const {
+		return rows * columns;
+	}
+	size_t getNonZeros() const {
+		return structure ? structure->indices.size() : 0;
+	}
+	// fraction of the elements stored
+	double getDensity() const {
+		return getSize() == 0 ? 0 : (double) getNonZeros() / getSize();
+	}
+	// of the values, indices and offsets
+	size_t getBytes() const;
+	bool isEmpty() const {
+		return !structure;
+	}
+	bool sameShape(const SparseMatrix &other) const {
+		return rows == other.rows && columns == other.columns;
+	}
+	bool sameShape(const Matrix &other) const {
+		return rows == other.getRows() && columns == other.getColumns();
+	}
+
+	// number of major lines: rows in CSR, columns in CSC
+	size_t getMajorSize() const {
+		return format == CSR ? rows : columns;
+	}
+	const size_t * getOffsets() const {
+		return &structure->offsets[0];
+	}
+	const uint32_t * getIndices() const {
+		return structure->indices.empty() ? 0 : &structure->indices[0];
+	}
+	const Matrix &getValues() const {
+		return values;
+	}
+
+	Matrix toDense() const;
+
+	// the same matrix in 'format' (itself when it is already in it)
+	SparseMatrix toFormat(Format format) const;
+
+	// element access converting to double, for tests and printing
+	double get(size_t row, size_t column) const;
+
+	void print() const;
+
+	// Matrix of the given structure, for the kernels: 'offsets' has
+	// getMajorSize() + 1 entries, and 'values' as many elements as 'indices'
+	SparseMatrix(Format format, size_t numberOfRows, size_t numberOfColumns,
+			vector<size_t> &&offsets, vector<uint32_t> &&indices, const Matrix &values);
+
+	// same structure as 'pattern', with other values
+	SparseMatrix(const SparseMatrix &pattern, const Matrix &values);
+
+private:
+	struct Structure {
+		vector<size_t>   offsets;
+		vector<uint32_t> indices;
+	};
+
+	Format                          format;
+	size_t                          rows;
+	size_t                          columns;
+	shared_ptr<const Structure>     structure;
+	Matrix                          values;
+};
+
+// Sparse kernels. They follow the dense ones (matrix/elementwise.h,
+// matrix/gemm.h, matrix/reduction.h): the operands have the same element
+// type, invalid_argument otherwise, and dense results are (re)allocated
+// unless they have the shape and type of the result. Operands in
+// different formats are converted to the format of the first one.
+
+// result = a + b, sparse: the nonzeros of both
+void add(const SparseMatrix &a, const SparseMatrix &b, SparseMatrix &result);
+
+// result = a + b, dense; 'result' may be b (in-place update)
+void add(const SparseMatrix &a, const Matrix &b, Matrix &result);
+
+// result = a + b, dense: for sums too dense to be kept sparse
+void add(const SparseMatrix &a, const SparseMatrix &b, Matrix &result);
+
+// result = a * scalar, with the structure of a
+void multiply(const SparseMatrix &a, double scalar, SparseMatrix &result);
+
+// result = a * b, dense. A sparse matrix times a dense vector (SpMV) or
+// matrix (SpMM) reads every stored element once, split by rows of the
+// result across getKernelThreads() threads.
+void matrixProduct(const SparseMatrix &a, const Matrix &b, Matrix &result);
+void matrixProduct(const Matrix &a, const SparseMatrix &b, Matrix &result);
+void matrixProduct(const SparseMatrix &a, const SparseMatrix &b, Matrix &result);
+
+// reductions over all the elements, the zeros included
+double sum(const SparseMatrix &a);
+double minimum(const SparseMatrix &a);
+double maximum(const SparseMatrix &a);
+
+// sum of the elementwise products of a and b (same shape and type)
+double dot(const SparseMatrix &a, const Matrix &b);
+double dot(const SparseMatrix &a, const SparseMatrix &b);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stdint.h>
+
+// Hardware counters of the calling thread (user space only), read with
+// perf_event_open on Linux: CPU cycles and last level cache misses, in one
+// group so that a single read returns both. open() fails elsewhere, or
+// when the kernel does not allow it (see /proc/sys/kernel/perf_event_paranoid).
+class PerfCounters {
+public:
+	PerfCounters() : groupDescriptor(-1), missesDescriptor(-1) {
+	}
+
+	~PerfCounters() {
+		close();
+	}
+
+	PerfCounters(const PerfCounters &) = delete;
+	PerfCounters &operator=(const PerfCounters &) = delete;
+
+	// Starts counting on the calling thread, false if the counters are not available
+	bool open();
+
+	void close();
+
+	bool isOpen() const {
+		return groupDescriptor >= 0;
+	}
+
+	// Counts since open(), false if they could not be read
+	bool read(uint64_t &cycles, uint64_t &cacheMisses) const;
+
+private:
+	int groupDescriptor;    // cycles, the group leader
+	int missesDescriptor;
+};
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <ostream>
+
+using namespace std;
+
+// Execution tracing, opt-in twice: the instrumentation points (the TRACE_*
+// macros below) only exist when the code is compiled with -DDAG_TRACING,
+// and record nothing until Tracer::enable() is called. Every thread
+// appends its events to a buffer of its own, without locks; the events are
+// exported in the Chrome trace format (chrome://tracing, ui.perfetto.dev).
+
+// A kernel or a load, timestamps in ns since the tracer was first enabled
+struct TraceEvent {
+	const char *name;         // static string, e.g. the operator name
+	const char *category;     // static string: "kernel", "load"
+	char        detail[48];   // e.g. the name of the loaded object, truncated
+	uint32_t    node;         // flat DAG node id
+	uint32_t    thread;       // set by Tracer::record
+	uint64_t    start;
+	uint64_t    end;
+	uint64_t    bytes;        // bytes read and written
+	uint64_t    flops;
+	uint64_t    cycles;       // hardware counters, 0 when not sampled
+	uint64_t    cacheMisses;
+};
+
+class Tracer {
+public:
+	// Starts recording. With 'counters', the kernels also sample the cycles
+	// and last level cache misses of their thread (Linux perf_event_open).
+	static void enable(bool counters = false);
+
+	static void disable();
+
+	static bool isEnabled() {
+		return enabled.load(memory_order_relaxed);
+	}
+
+	// true when the counters were requested and could be opened so far
+	static bool hasCounters();
+
+	static uint64_t now();
+
+	// Fills the identity and the start of 'event', sampling the counters
+	// when 'sampled' and they are on. Returns false when tracing is disabled.
+	static bool begin(TraceEvent &event, const char *name, const char *category, uint32_t node,
+			bool sampled = true);
+
+	// Sets the end of 'event' (and the counter deltas) and records it
+	static void end(TraceEvent &event);
+
+	// Appends 'event' to the buffer of the calling thread
+	static void record(TraceEvent &event);
+
+	// Drops the recorded events. No thread may be recording.
+	static void clear();
+
+	static size_t getNumberOfEvents();
+
+	// Chrome trace JSON of the events recorded so far
+	static void writeChromeTrace(ostream &out);
+	static bool writeChromeTrace(const string &path);
+
+private:
+	static atomic<bool> enabled;
+};
+
+// Records a span from its construction to its destruction, if enabled
+class TraceSpan {
+public:
+	TraceSpan(const char *name, const char *category, uint32_t node = 0) {
+		active = Tracer::isEnabled() && Tracer::begin(event, name, category, node);
+	}
+
+	~TraceSpan() {
+		if (active)
+			Tracer::end(event);
+	}
+
+	TraceSpan(const TraceSpan &) = delete;
+	TraceSpan &operator=(const TraceSpan &) = delete;
+
+	bool isActive() const {
+		return active;
+	}
+
+	void setWork(uint64_t bytes, uint64_t flops) {
+		event.bytes = bytes;
+		event.flops = flops;
+	}
+
+	void setDetail(const string &detail);
+
+private:
+	bool       active;
+	TraceEvent event;
+};
+
+#ifdef DAG_TRACING
+#define TRACE_SPAN(span, name, category, node) TraceSpan span(name, category, node)
+// the arguments are only evaluated when the span records
+#define TRACE_WORK(span, bytes, flops) do { if ((span).isActive()) (span).setWork(bytes, flops); } while (0)
+#define TRACE_DETAIL(span, detail) do { if ((span).isActive()) (span).setDetail(detail); } while (0)
+#else
+#define TRACE_SPAN(span, name, category, node)
+#define TRACE_WORK(span, bytes, flops)
+#define TRACE_DETAIL(span, detail)
+#endif
+
+// true when the including code was compiled with the instrumentation
+inline bool isTracingCompiledIn() {
+#ifdef DAG_TRACING
+	return true;
+#else
+	return false;
+#endif
+}
+
+#endif